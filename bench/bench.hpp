@@ -0,0 +1,75 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bench
+{
+    /// @brief Options shared by every benchmark.
+    struct Options
+    {
+            /// @brief Item counts to run the size dependent benchmarks at.
+            std::vector<size_t> sizes;
+    };
+
+    /// @brief Writes a single result as one line of JSON to stdout.
+    /// @param name Name of the benchmark.
+    /// @param items Number of items the benchmark ran against.
+    /// @param value Measured value.
+    /// @param unit Unit of the value.
+    void report(std::string_view name, size_t items, double value, std::string_view unit);
+
+    /// @brief Returns the number of bytes currently allocated on the heap.
+    /// @return Bytes in use.
+    size_t heap_in_use(void);
+
+    /// @brief Returns a synthetic, Drive-like 33 character ID for index.
+    /// @param index Index to generate the ID for.
+    /// @return ID string.
+    std::string make_id(size_t index);
+
+    /// @brief Runs function once and returns how long it took in nanoseconds.
+    /// @tparam Function Type of the function.
+    /// @param function Function to time.
+    /// @return Elapsed nanoseconds.
+    template <typename Function>
+    double time_ns(Function function)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        function();
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - begin).count();
+    }
+
+    /// @brief Catalog benchmarks.
+    void run_catalog(const bench::Options &options);
+
+    /// @brief Listing parser benchmarks.
+    void run_listing(const bench::Options &options);
+
+    /// @brief Compression ratio and speed on a synthetic save corpus.
+    void run_compression(const bench::Options &options);
+
+    /// @brief Cost of a log call to the caller with the writer thread running.
+    void run_logger(const bench::Options &options);
+
+    /// @brief Rate controller against a simulated server that throttles past its capacity.
+    void run_rate_control(const bench::Options &options);
+
+    /// @brief Cost of updating a counter and a histogram from several threads at once.
+    void run_metrics(const bench::Options &options);
+
+    /// @brief Storage lookups by name and the memory each item takes.
+    void run_storage(const bench::Options &options);
+
+    /// @brief Local listing of a directory filled with empty files.
+    void run_local_listing(const bench::Options &options);
+
+    /// @brief Recursive walk of a tree of empty files with the scanner against std::filesystem.
+    void run_scanner(const bench::Options &options);
+
+    /// @brief Response header collection and lookup.
+    void run_headers(const bench::Options &options);
+} // namespace bench
@@ -0,0 +1,73 @@
+#include "Catalog.hpp"
+#include "Snapshot.hpp"
+#include "bench.hpp"
+#include <string>
+#include <vector>
+
+namespace
+{
+    /// @brief Number of items per synthetic folder.
+    constexpr size_t ITEMS_PER_FOLDER = 64;
+
+    /// @brief Path the snapshot benchmark writes to.
+    constexpr std::string_view PATH_BENCH_SNAPSHOT = "./bench_catalog.bin";
+
+    /// @brief Mirrors the layout Item had before the catalog stored everything in an arena.
+    struct StringItem
+    {
+            std::string name;
+            std::string id;
+            std::string parent;
+            bool isDirectory;
+    };
+} // namespace
+
+void bench::run_catalog(const bench::Options &options)
+{
+    for (size_t size : options.sizes)
+    {
+        // Generate everything up front so only the catalog is measured.
+        std::vector<std::string> ids(size), names(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            ids[i] = bench::make_id(i);
+            names[i] = "save_" + std::to_string(i) + ".zip";
+        }
+
+        {
+            size_t heapBegin = bench::heap_in_use();
+            std::vector<StringItem> items;
+            double elapsed = bench::time_ns([&]() {
+                for (size_t i = 0; i < size; i++)
+                {
+                    items.push_back({names[i], ids[i], ids[(i / ITEMS_PER_FOLDER) * ITEMS_PER_FOLDER], false});
+                }
+            });
+            bench::report("string_items_add", size, elapsed / size, "ns/item");
+            bench::report("string_items_memory", size, double(bench::heap_in_use() - heapBegin) / size, "bytes/item");
+        }
+
+        size_t heapBegin = bench::heap_in_use();
+        Catalog catalog{};
+        double elapsed = bench::time_ns([&]() {
+            for (size_t i = 0; i < size; i++)
+            {
+                // Every ITEMS_PER_FOLDER items share the first item of their block as a parent.
+                catalog.add(names[i], ids[i], ids[(i / ITEMS_PER_FOLDER) * ITEMS_PER_FOLDER], false);
+            }
+        });
+        bench::report("catalog_add", size, elapsed / size, "ns/item");
+        bench::report("catalog_memory", size, double(bench::heap_in_use() - heapBegin) / size, "bytes/item");
+        bench::report("catalog_memory_usage", size, double(catalog.memory_usage()) / size, "bytes/item");
+
+        // Startup from a warm snapshot.
+        snapshot::Metadata metadata = {.account = "bench", .root = ids[0], .changesToken = {}, .timestamp = 0};
+        double writeTime = bench::time_ns([&]() { snapshot::write(PATH_BENCH_SNAPSHOT, catalog, metadata); });
+        bench::report("snapshot_write", size, writeTime / 1e6, "ms");
+
+        Catalog loaded{};
+        double readTime = bench::time_ns([&]() { snapshot::read(PATH_BENCH_SNAPSHOT, loaded, metadata); });
+        bench::report("snapshot_read", size, readTime / 1e6, "ms");
+        std::filesystem::remove(PATH_BENCH_SNAPSHOT);
+    }
+}
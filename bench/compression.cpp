@@ -0,0 +1,154 @@
+#include "bench.hpp"
+#include "compression.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    /// @brief Number of files in the synthetic save corpus.
+    constexpr size_t CORPUS_FILES = 48;
+
+    /// @brief Levels to measure. Negative levels are zstd's fast levels.
+    constexpr int LEVELS[] = {-5, 1, 3, 9};
+
+    /// @brief Size of the chunks the compressed output is read in. This matches what upload_session asks for.
+    constexpr size_t SIZE_READ_CHUNK = 0x800000;
+
+    /// @brief Size of the pieces compressed data is fed to the decompressor in, like curl's write callback.
+    constexpr size_t SIZE_FEED_CHUNK = 0x4000;
+
+    /// @brief Size of the buffer decompressed data is written to. This matches SIZE_DOWNLOAD_BUFFER.
+    constexpr size_t SIZE_DOWNLOAD_BUFFER = 0x100000;
+
+    /// @brief Names entities in saves are drawn from.
+    constexpr std::string_view ENTITY_NAMES[] = {"Player", "Goblin", "Chest", "Door", "Villager", "Torch", "Slime"};
+
+    /// @brief Fixed size record most of a save is made of.
+    struct SaveRecord
+    {
+            uint32_t id;
+            uint16_t flags;
+            uint16_t count;
+            float position[3];
+            char name[16];
+            uint8_t reserved[16];
+    };
+
+    /// @brief Generates a save file. Saves are mostly fixed records that barely differ from each other, zeroed
+    /// slots, and a screenshot or other blob that's already compressed.
+    std::string make_save(std::mt19937_64 &random, size_t index)
+    {
+        size_t size = size_t(0x10000) << (index % 7);
+        std::string save(size, '\0');
+
+        // A small header, then records until 3/4 of the way through.
+        std::snprintf(save.data(), size, "SAVE v%zu slot %zu", index % 3 + 1, index);
+        size_t offset = 64;
+        for (uint32_t id = 0; offset + sizeof(SaveRecord) < size * 3 / 4; id++, offset += sizeof(SaveRecord))
+        {
+            // One in four slots is empty.
+            if (random() % 4 == 0)
+            {
+                continue;
+            }
+
+            SaveRecord record{};
+            record.id = id;
+            record.flags = static_cast<uint16_t>(random() % 8);
+            record.count = static_cast<uint16_t>(random() % 100);
+            for (float &coordinate : record.position)
+            {
+                coordinate = static_cast<float>(random() % 4096) / 16.0f;
+            }
+            std::string_view name = ENTITY_NAMES[random() % std::size(ENTITY_NAMES)];
+            std::memcpy(record.name, name.data(), name.length());
+            std::memcpy(save.data() + offset, &record, sizeof(SaveRecord));
+        }
+
+        // Every third save has a thumbnail or something else that won't compress.
+        if (index % 3 == 0)
+        {
+            for (size_t i = size * 3 / 4; i < size; i++)
+            {
+                save[i] = static_cast<char>(random());
+            }
+        }
+        return save;
+    }
+} // namespace
+
+void bench::run_compression(const bench::Options &options)
+{
+    (void)options;
+
+    std::mt19937_64 random{0x4A4B5356};
+    std::vector<std::string> corpus{};
+    size_t corpusSize = 0;
+    for (size_t i = 0; i < CORPUS_FILES; i++)
+    {
+        corpusSize += corpus.emplace_back(make_save(random, i)).length();
+    }
+    bench::report("compression_corpus_size", CORPUS_FILES, double(corpusSize) / 0x100000, "MiB");
+
+    std::unique_ptr<char[]> chunk = std::make_unique_for_overwrite<char[]>(SIZE_READ_CHUNK);
+    std::unique_ptr<char[]> output = std::make_unique_for_overwrite<char[]>(SIZE_DOWNLOAD_BUFFER);
+    for (int level : LEVELS)
+    {
+        std::string suffix = "_level_" + std::to_string(level);
+
+        // Compress the same way uploads do, keeping the output to decompress afterwards.
+        std::vector<std::string> compressed(corpus.size());
+        size_t compressedSize = 0;
+        double compressTime = bench::time_ns([&]() {
+            for (size_t i = 0; i < corpus.size(); i++)
+            {
+                std::istringstream source{corpus[i]};
+                compression::Compressor compressor{source, level};
+                while (!compressor.is_finished() && !compressor.has_failed())
+                {
+                    compressed[i].append(chunk.get(), compressor.read(chunk.get(), SIZE_READ_CHUNK));
+                }
+                compressedSize += compressed[i].length();
+            }
+        });
+
+        // Same as downloads. Small pieces in, a fixed buffer out.
+        size_t decompressedSize = 0;
+        double decompressTime = bench::time_ns([&]() {
+            for (const std::string &file : compressed)
+            {
+                compression::Decompressor decompressor{};
+                for (size_t offset = 0; offset < file.length(); offset += SIZE_FEED_CHUNK)
+                {
+                    const char *data = file.data() + offset;
+                    size_t length = std::min(SIZE_FEED_CHUNK, file.length() - offset);
+                    size_t outputUsed = 0;
+                    do
+                    {
+                        outputUsed = 0;
+                        decompressor.decompress(data, length, output.get(), SIZE_DOWNLOAD_BUFFER, outputUsed);
+                        decompressedSize += outputUsed;
+                    } while (outputUsed == SIZE_DOWNLOAD_BUFFER);
+                }
+            }
+        });
+
+        if (decompressedSize != corpusSize)
+        {
+            bench::report("compression_roundtrip_failed" + suffix, CORPUS_FILES, double(decompressedSize), "bytes");
+            continue;
+        }
+
+        // Bytes on the wire as a percentage of the original, and how fast each side runs on one core.
+        bench::report("compression_wire" + suffix, CORPUS_FILES, 100.0 * compressedSize / corpusSize, "percent");
+        bench::report("compression_speed" + suffix, CORPUS_FILES, corpusSize / (compressTime / 1e9) / 1e6, "MB/s");
+        bench::report(
+            "decompression_speed" + suffix, CORPUS_FILES, corpusSize / (decompressTime / 1e9) / 1e6, "MB/s");
+    }
+}
@@ -0,0 +1,72 @@
+#include "bench.hpp"
+#include "curl.hpp"
+#include <string>
+#include <string_view>
+
+namespace
+{
+    /// @brief Number of responses whose headers are handled.
+    constexpr size_t RESPONSE_COUNT = 100000;
+
+    /// @brief Headers of a resumable upload session response, the way curl hands them to the header callback one line
+    /// at a time. Location is near the end like it is in Drive's responses.
+    constexpr std::string_view RESPONSE_HEADERS[] = {
+        "HTTP/2 200\r\n",
+        "content-type: text/plain; charset=utf-8\r\n",
+        "x-guploader-uploadid: ABPtcPoAbCdEfGhIjKlMnOpQrStUvWxYz0123456789-_AbCdEfGhIjKlMnOpQrStUvWxYz\r\n",
+        "vary: Origin\r\n",
+        "vary: X-Origin\r\n",
+        "vary: Referer\r\n",
+        "cache-control: no-cache, no-store, max-age=0, must-revalidate\r\n",
+        "pragma: no-cache\r\n",
+        "expires: Mon, 01 Jan 1990 00:00:00 GMT\r\n",
+        "date: Wed, 01 May 2024 12:34:56 GMT\r\n",
+        "x-goog-upload-status: active\r\n",
+        "location: https://www.googleapis.com/upload/drive/v3/files?uploadType=resumable&upload_id=ABPtcPoAbCdEfGh\r\n",
+        "content-length: 0\r\n",
+        "server: UploadServer\r\n",
+        "alt-svc: h3=\":443\"; ma=2592000,h3-29=\":443\"; ma=2592000\r\n",
+        "\r\n"};
+} // namespace
+
+void bench::run_headers(const bench::Options &options)
+{
+    (void)options;
+
+    curl::HeaderArray headers{};
+    double writeTime = bench::time_ns([&]() {
+        for (size_t i = 0; i < RESPONSE_COUNT; i++)
+        {
+            headers.clear();
+            for (std::string_view line : RESPONSE_HEADERS)
+            {
+                curl::write_headers_array(line.data(), 1, line.length(), &headers);
+            }
+        }
+    });
+    bench::report("headers_write_array", RESPONSE_COUNT, writeTime / RESPONSE_COUNT, "ns/response");
+
+    // Each lookup is timed on its own since how far into the array the header is decides what it costs.
+    constexpr std::string_view LOOKUPS[][2] = {{"content-type", "headers_get_first"},
+                                               {"location", "headers_get_location"},
+                                               {"range", "headers_get_missing"}};
+    std::string value{};
+    for (const auto &[header, name] : LOOKUPS)
+    {
+        size_t found = 0;
+        double lookupTime = bench::time_ns([&]() {
+            for (size_t i = 0; i < RESPONSE_COUNT; i++)
+            {
+                found += curl::get_header_value(headers, header, value);
+            }
+        });
+
+        // Found counts keep the lookups from being optimized away and catch a broken parser.
+        if (found != (header == "range" ? 0 : RESPONSE_COUNT))
+        {
+            bench::report(std::string(name) + "_mismatch", RESPONSE_COUNT, 1.0, "bool");
+            continue;
+        }
+        bench::report(name, RESPONSE_COUNT, lookupTime / RESPONSE_COUNT, "ns/lookup");
+    }
+}
@@ -0,0 +1,147 @@
+#include "Catalog.hpp"
+#include "ListingParser.hpp"
+#include "bench.hpp"
+#include "json.hpp"
+#include <algorithm>
+#include <string>
+
+namespace
+{
+    /// @brief Page sizes to run. 256 is what a typical folder page looks like, 1000 is the largest Drive returns.
+    constexpr size_t PAGE_SIZES[] = {256, 1000};
+
+    /// @brief Size of the chunks the response is fed to the streaming parser in. This is roughly what curl hands the
+    /// write callback at a time.
+    constexpr size_t SIZE_CHUNK = 0x4000;
+
+    /// @brief Mimetype of directories.
+    constexpr std::string_view MIME_TYPE_DIRECTORY = "application/vnd.google-apps.folder";
+
+    /// @brief Builds a listing page the way Drive formats it.
+    std::string make_page(size_t pageSize, size_t first)
+    {
+        std::string page = "{\n \"nextPageToken\": \"" + bench::make_id(first + pageSize) + "\",\n \"files\": [\n";
+        for (size_t i = first; i < first + pageSize; i++)
+        {
+            bool isDirectory = i % 8 == 0;
+            page += "  {\n   \"mimeType\": \"";
+            page += isDirectory ? MIME_TYPE_DIRECTORY : "application/zip";
+            page += "\",\n   \"parents\": [\n    \"" + bench::make_id(first) + "\"\n   ],\n";
+            page += "   \"size\": \"" + std::to_string(i * 4096) + "\",\n";
+            page += "   \"modifiedTime\": \"2024-05-0" + std::to_string(1 + i % 9) + "T12:34:56.789Z\",\n";
+            page += isDirectory ? "" : "   \"md5Checksum\": \"" + std::string(32, "0123456789abcdef"[i % 16]) + "\",\n";
+            page += "   \"id\": \"" + bench::make_id(i) + "\",\n";
+            page += "   \"name\": \"save_" + std::to_string(i) + ".zip\"\n  }";
+            page += i + 1 < first + pageSize ? ",\n" : "\n";
+        }
+        page += " ]\n}\n";
+        return page;
+    }
+
+    /// @brief Parses page the way GoogleDrive did before the streaming parser: the chunks curl hands over are
+    /// appended to a response string, which is parsed into a json-c tree once the transfer is over.
+    bool parse_dom(const std::string &page, std::string &response, Catalog &catalog)
+    {
+        response.clear();
+        for (size_t offset = 0; offset < page.length(); offset += SIZE_CHUNK)
+        {
+            response.append(page, offset, std::min(SIZE_CHUNK, page.length() - offset));
+        }
+
+        json::Object parser = json::new_object(json_tokener_parse, response.c_str());
+        json_object *files = parser ? json::get_object(parser, "files") : nullptr;
+        if (!files)
+        {
+            return false;
+        }
+
+        size_t arrayLength = json_object_array_length(files);
+        for (size_t i = 0; i < arrayLength; i++)
+        {
+            json_object *currentFile = json_object_array_get_idx(files, i);
+            json_object *mimeType = json_object_object_get(currentFile, "mimeType");
+            json_object *parents = json_object_object_get(currentFile, "parents");
+            json_object *id = json_object_object_get(currentFile, "id");
+            json_object *name = json_object_object_get(currentFile, "name");
+            json_object *parent = parents ? json_object_array_get_idx(parents, 0) : nullptr;
+            if (!mimeType || !parent || !id || !name)
+            {
+                return false;
+            }
+
+            catalog.add(json_object_get_string(name),
+                        json_object_get_string(id),
+                        json_object_get_string(parent),
+                        json_object_get_string(mimeType) == MIME_TYPE_DIRECTORY);
+        }
+        return json::get_object(parser, "nextPageToken") != nullptr;
+    }
+
+    /// @brief Parses page with the streaming parser, fed in chunks like curl would.
+    bool parse_stream(const std::string &page, ListingParser &parser)
+    {
+        parser.reset();
+        for (size_t offset = 0; offset < page.length(); offset += SIZE_CHUNK)
+        {
+            if (!parser.feed(page.data() + offset, std::min(SIZE_CHUNK, page.length() - offset)))
+            {
+                return false;
+            }
+        }
+        return parser.finish() && !parser.get_next_page_token().empty();
+    }
+} // namespace
+
+void bench::run_listing(const bench::Options &options)
+{
+    for (size_t size : options.sizes)
+    {
+        for (size_t pageSize : PAGE_SIZES)
+        {
+            // Every page is generated up front so only parsing is measured.
+            size_t pageCount = std::max<size_t>(size / pageSize, 1);
+            std::vector<std::string> pages(pageCount);
+            size_t bytes = 0;
+            for (size_t i = 0; i < pageCount; i++)
+            {
+                pages[i] = make_page(pageSize, i * pageSize);
+                bytes += pages[i].length();
+            }
+
+            size_t items = pageCount * pageSize;
+            std::string suffix = "_" + std::to_string(pageSize);
+
+            Catalog domCatalog{};
+            std::string response{};
+            bool domSuccess = true;
+            double domTime = bench::time_ns([&]() {
+                for (const std::string &page : pages)
+                {
+                    domSuccess = parse_dom(page, response, domCatalog) && domSuccess;
+                }
+            });
+
+            Catalog streamCatalog{};
+            ListingParser parser(streamCatalog);
+            bool streamSuccess = true;
+            double streamTime = bench::time_ns([&]() {
+                for (const std::string &page : pages)
+                {
+                    streamSuccess = parse_stream(page, parser) && streamSuccess;
+                }
+            });
+
+            if (!domSuccess || !streamSuccess || domCatalog.size() != streamCatalog.size())
+            {
+                bench::report("listing_mismatch" + suffix, items, 1.0, "bool");
+                continue;
+            }
+
+            bench::report("listing_json_c" + suffix, items, domTime / items, "ns/item");
+            bench::report("listing_stream" + suffix, items, streamTime / items, "ns/item");
+            bench::report("listing_json_c_throughput" + suffix, items, (bytes / 1e6) / (domTime / 1e9), "MB/s");
+            bench::report("listing_stream_throughput" + suffix, items, (bytes / 1e6) / (streamTime / 1e9), "MB/s");
+            bench::report("listing_stream_speedup" + suffix, items, domTime / streamTime, "x");
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#include "bench.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    /// @brief Thread counts to log from at once.
+    constexpr size_t THREAD_COUNTS[] = {1, 4, 16};
+
+    /// @brief Lines each thread logs. Even with every thread, this is less than the queue holds, so nothing is dropped.
+    constexpr size_t LINES_PER_THREAD = 0x80;
+
+    /// @brief Lines each thread logs before pausing, like a transfer logging on each retry.
+    constexpr size_t LINES_PER_BURST = 16;
+
+    /// @brief Pause between bursts.
+    constexpr std::chrono::microseconds BURST_GAP{200};
+} // namespace
+
+void bench::run_logger(const bench::Options &options)
+{
+    (void)options;
+
+    // The writer thread is running like it is in the app, so this measures what a call costs the caller. The file
+    // itself is written in the background.
+    logger::initialize();
+    for (size_t threadCount : THREAD_COUNTS)
+    {
+        std::vector<std::vector<double>> latencies(threadCount);
+        std::vector<std::thread> threads{};
+        for (size_t i = 0; i < threadCount; i++)
+        {
+            threads.emplace_back([i, &latencies]() {
+                latencies[i].reserve(LINES_PER_THREAD);
+                for (size_t line = 0; line < LINES_PER_THREAD; line++)
+                {
+                    latencies[i].push_back(bench::time_ns([&]() {
+                        logger::error("Error performing CURL: %i. Thread %zu, line %zu.", 28, i, line);
+                    }));
+
+                    if ((line + 1) % LINES_PER_BURST == 0)
+                    {
+                        std::this_thread::sleep_for(BURST_GAP);
+                    }
+                }
+            });
+        }
+
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+
+        std::vector<double> all{};
+        for (std::vector<double> &threadLatencies : latencies)
+        {
+            all.insert(all.end(), threadLatencies.begin(), threadLatencies.end());
+        }
+        std::sort(all.begin(), all.end());
+
+        std::string suffix = "_threads_" + std::to_string(threadCount);
+        bench::report("logger_call_p50" + suffix, all.size(), all[all.size() / 2], "ns");
+        bench::report("logger_call_p99" + suffix, all.size(), all[all.size() * 99 / 100], "ns");
+    }
+    logger::exit();
+}
@@ -0,0 +1,100 @@
+#include "bench.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <iterator>
+#include <malloc.h>
+#include <thread>
+
+namespace
+{
+    /// @brief Characters Drive IDs are made of.
+    constexpr std::string_view ID_CHARACTERS = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz-_";
+
+    /// @brief Length of a Drive ID.
+    constexpr size_t LENGTH_DRIVE_ID = 33;
+
+    /// @brief Sizes run when none are passed. 10000000 can be passed to run the largest size, but it needs several
+    /// gigabytes of memory for the catalog comparisons.
+    constexpr size_t DEFAULT_SIZES[] = {1000, 10000, 100000, 1000000};
+
+    /// @brief Writes a line describing the run before any results so results from different builds and machines can
+    /// be told apart when they're compared.
+    void report_environment(void)
+    {
+        std::printf("{\"suite\":\"google_drive_bench\",\"compiler\":\"%s\",\"optimized\":%s,\"cores\":%u,"
+                    "\"timestamp\":%lld}\n",
+                    __VERSION__,
+#ifdef __OPTIMIZE__
+                    "true",
+#else
+                    "false",
+#endif
+                    std::thread::hardware_concurrency(),
+                    static_cast<long long>(std::time(nullptr)));
+        std::fflush(stdout);
+    }
+} // namespace
+
+void bench::report(std::string_view name, size_t items, double value, std::string_view unit)
+{
+    std::printf("{\"bench\":\"%.*s\",\"items\":%zu,\"value\":%.3f,\"unit\":\"%.*s\"}\n",
+                static_cast<int>(name.length()),
+                name.data(),
+                items,
+                value,
+                static_cast<int>(unit.length()),
+                unit.data());
+    std::fflush(stdout);
+}
+
+size_t bench::heap_in_use(void)
+{
+    // Large blocks are mmapped and only show up in hblkhd.
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+std::string bench::make_id(size_t index)
+{
+    // Scramble the index so IDs don't share long prefixes.
+    size_t state = (index + 1) * 0x9E3779B97F4A7C15ull;
+    std::string id(LENGTH_DRIVE_ID, '0');
+    for (char &c : id)
+    {
+        state ^= state >> 29;
+        state *= 0xBF58476D1CE4E5B9ull;
+        c = ID_CHARACTERS[state % ID_CHARACTERS.length()];
+    }
+    return id;
+}
+
+int main(int argc, const char *argv[])
+{
+    bench::Options options{};
+
+    // Sizes can be passed on the command line. Otherwise, run the default.
+    for (int i = 1; i < argc; i++)
+    {
+        options.sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+    }
+
+    if (options.sizes.empty())
+    {
+        options.sizes.assign(std::begin(DEFAULT_SIZES), std::end(DEFAULT_SIZES));
+    }
+
+    report_environment();
+    bench::run_catalog(options);
+    bench::run_storage(options);
+    bench::run_listing(options);
+    bench::run_headers(options);
+    bench::run_local_listing(options);
+    bench::run_scanner(options);
+    bench::run_compression(options);
+    bench::run_rate_control(options);
+    bench::run_logger(options);
+    bench::run_metrics(options);
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "bench.hpp"
+#include "metrics.hpp"
+#include <chrono>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    /// @brief Thread counts to update from at once.
+    constexpr size_t THREAD_COUNTS[] = {1, 4, 16};
+
+    /// @brief Updates each thread makes.
+    constexpr size_t UPDATES_PER_THREAD = 0x100000;
+
+    /// @brief Returns the CPU time the calling thread has used in nanoseconds. Threads are timed by CPU time so the
+    /// result doesn't depend on how many cores there are to run them on.
+    double thread_time_ns(void)
+    {
+        timespec time{};
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+        return static_cast<double>(time.tv_sec) * 1e9 + time.tv_nsec;
+    }
+
+    /// @brief Runs update UPDATES_PER_THREAD times on threadCount threads at once.
+    /// @return Mean nanoseconds of CPU time per update.
+    template <typename Function>
+    double time_updates(size_t threadCount, Function update)
+    {
+        std::vector<double> elapsed(threadCount);
+        std::vector<std::thread> threads{};
+        for (size_t i = 0; i < threadCount; i++)
+        {
+            threads.emplace_back([i, &elapsed, &update]() {
+                double begin = thread_time_ns();
+                for (size_t j = 0; j < UPDATES_PER_THREAD; j++)
+                {
+                    update(j);
+                }
+                elapsed[i] = thread_time_ns() - begin;
+            });
+        }
+
+        double total = 0;
+        for (size_t i = 0; i < threadCount; i++)
+        {
+            threads[i].join();
+            total += elapsed[i];
+        }
+        return total / threadCount / UPDATES_PER_THREAD;
+    }
+} // namespace
+
+void bench::run_metrics(const bench::Options &options)
+{
+    (void)options;
+
+    metrics::Counter &counter = metrics::counter("bench_updates_total", "Updates made by the metrics benchmark.");
+    metrics::Histogram &histogram =
+        metrics::histogram("bench_update_duration_seconds", "Durations observed by the metrics benchmark.");
+
+    for (size_t threadCount : THREAD_COUNTS)
+    {
+        std::string suffix = "_threads_" + std::to_string(threadCount);
+
+        double counterNs = time_updates(threadCount, [&](size_t) { counter.add(); });
+        bench::report("metrics_counter_add" + suffix, threadCount * UPDATES_PER_THREAD, counterNs, "ns");
+
+        // Durations are spread over every bucket so the bucket search isn't always the shortest.
+        double histogramNs = time_updates(threadCount, [&](size_t update) {
+            histogram.observe(std::chrono::microseconds((update * 7919) % 100000000));
+        });
+        bench::report("metrics_histogram_observe" + suffix, threadCount * UPDATES_PER_THREAD, histogramNs, "ns");
+    }
+}
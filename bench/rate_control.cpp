@@ -0,0 +1,145 @@
+#include "RateController.hpp"
+#include "bench.hpp"
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    /// @brief Number of requests every run has to get through.
+    constexpr size_t REQUEST_COUNT = 400;
+
+    /// @brief Requests the simulated server handles at once. Anything past this is answered with a 429.
+    constexpr int SERVER_CAPACITY = 12;
+
+    /// @brief Time the simulated server takes to answer a request it accepts.
+    constexpr std::chrono::milliseconds SERVER_LATENCY{20};
+
+    /// @brief Time the simulated server takes to turn a request away.
+    constexpr std::chrono::milliseconds THROTTLE_LATENCY{2};
+
+    /// @brief How often the simulation checks for finished requests.
+    constexpr std::chrono::milliseconds TICK{1};
+
+    /// @brief Clock everything is timed with.
+    using Clock = std::chrono::steady_clock;
+
+    /// @brief A request the simulated server is working on.
+    struct Request
+    {
+            /// @brief Time the response arrives.
+            Clock::time_point finish;
+
+            /// @brief Whether the server turned the request away.
+            bool throttled;
+
+            /// @brief Number of times this request was throttled before.
+            int failures;
+    };
+
+    /// @brief A request waiting out its backoff.
+    struct Retry
+    {
+            /// @brief Time the request can be sent again.
+            Clock::time_point due;
+
+            /// @brief Number of times the request was throttled.
+            int failures;
+    };
+} // namespace
+
+void bench::run_rate_control(const bench::Options &options)
+{
+    (void)options;
+
+    // Requests are answered in real time by a server that throttles anything over its capacity, the same way Drive
+    // answers a burst with 429s. The controller is used exactly like the loop uses it.
+    RateController controller{};
+    std::vector<Request> inFlight{};
+    std::vector<Retry> backingOff{};
+    std::deque<int> ready{};
+    size_t started = 0, finished = 0, attempts = 0, throttled = 0, samples = 0;
+    int serverLoad = 0;
+    double limitTotal = 0.0, loadTotal = 0.0;
+
+    double elapsed = bench::time_ns([&]() {
+        while (finished < REQUEST_COUNT)
+        {
+            Clock::time_point now = Clock::now();
+            for (auto request = inFlight.begin(); request != inFlight.end();)
+            {
+                if (request->finish > now)
+                {
+                    ++request;
+                    continue;
+                }
+
+                long code = request->throttled ? 429 : 200;
+                RateController::Outcome outcome = RateController::classify(true, code, {});
+                controller.release(outcome);
+                if (outcome == RateController::Outcome::Success)
+                {
+                    --serverLoad;
+                    ++finished;
+                }
+                else
+                {
+                    int failures = request->failures + 1;
+                    backingOff.push_back({.due = now + controller.get_backoff(failures), .failures = failures});
+                }
+                request = inFlight.erase(request);
+            }
+
+            for (auto retry = backingOff.begin(); retry != backingOff.end();)
+            {
+                if (retry->due > now)
+                {
+                    ++retry;
+                    continue;
+                }
+                ready.push_back(retry->failures);
+                retry = backingOff.erase(retry);
+            }
+
+            // Retries go before new requests, same as listings.
+            while ((!ready.empty() || started < REQUEST_COUNT) && controller.try_acquire())
+            {
+                int failures = 0;
+                if (!ready.empty())
+                {
+                    failures = ready.front();
+                    ready.pop_front();
+                }
+                else
+                {
+                    ++started;
+                }
+
+                bool turnedAway = serverLoad >= SERVER_CAPACITY;
+                serverLoad += turnedAway ? 0 : 1;
+                throttled += turnedAway ? 1 : 0;
+                ++attempts;
+                inFlight.push_back({.finish = now + (turnedAway ? THROTTLE_LATENCY : SERVER_LATENCY),
+                                    .throttled = turnedAway,
+                                    .failures = failures});
+            }
+
+            // Only the part where there's always more to send says anything about the controller. The tail is
+            // whatever was unlucky enough to be throttled last waiting out its backoff.
+            if (started < REQUEST_COUNT)
+            {
+                limitTotal += controller.get_limit();
+                loadTotal += serverLoad;
+                ++samples;
+            }
+            std::this_thread::sleep_for(TICK);
+        }
+    });
+
+    // Utilization is how much of the server's capacity was in use. The limit should hover around the capacity.
+    bench::report("rate_control_time", REQUEST_COUNT, elapsed / 1e6, "ms");
+    bench::report("rate_control_utilization", REQUEST_COUNT, 100.0 * loadTotal / samples / SERVER_CAPACITY, "percent");
+    bench::report("rate_control_throttled", REQUEST_COUNT, 100.0 * throttled / attempts, "percent");
+    bench::report("rate_control_mean_limit", REQUEST_COUNT, limitTotal / samples, "requests");
+}
@@ -0,0 +1,122 @@
+#include "bench.hpp"
+#include "scanner.hpp"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    /// @brief Files in each folder at the bottom of the tree.
+    constexpr size_t FILES_PER_FOLDER = 100;
+
+    /// @brief Folders in each folder at the top of the tree.
+    constexpr size_t FOLDERS_PER_FOLDER = 100;
+
+    /// @brief Most files written for the scanner benchmark. Larger sizes are capped to keep the tree's creation from
+    /// taking most of the run.
+    constexpr size_t MAX_SCAN_FILES = 1000000;
+
+    /// @brief Directory the scanner benchmark fills. This is removed afterward.
+    constexpr std::string_view PATH_BENCH_DIRECTORY = "./bench_scan";
+
+    /// @brief Adds files to the tree until it holds fileCount. File index always lands in the same place, so the tree
+    /// only has to be extended for each larger size.
+    /// @param begin Number of files already in the tree.
+    /// @param fileCount Number of files the tree should hold.
+    void extend_tree(size_t begin, size_t fileCount)
+    {
+        std::error_code error{};
+        std::filesystem::path root{PATH_BENCH_DIRECTORY};
+        for (size_t i = begin; i < fileCount; i++)
+        {
+            size_t folder = i / FILES_PER_FOLDER;
+            std::filesystem::path directory = root / ("folder_" + std::to_string(folder / FOLDERS_PER_FOLDER)) /
+                                              ("folder_" + std::to_string(folder % FOLDERS_PER_FOLDER));
+            if (i % FILES_PER_FOLDER == 0)
+            {
+                std::filesystem::create_directories(directory, error);
+            }
+            std::ofstream(directory / ("save_" + std::to_string(i) + ".zip"));
+        }
+    }
+
+    /// @brief Walks the tree the way Local listed directories before the scanner: a directory_iterator with a path
+    /// built for every entry and a stat for the size and time of every file.
+    /// @return Number of entries found.
+    size_t walk_filesystem(void)
+    {
+        std::vector<scanner::Entry> entries{};
+        std::error_code error{};
+        for (std::filesystem::recursive_directory_iterator entry{PATH_BENCH_DIRECTORY, error}, end{};
+             !error && entry != end;
+             entry.increment(error))
+        {
+            std::string parent = entry->path().parent_path().string();
+            scanner::Entry &scanned = entries.emplace_back();
+            scanned.name = entry->path().filename().string();
+            scanned.isDirectory = entry->is_directory(error);
+            scanned.isRegularFile = entry->is_regular_file(error);
+            if (scanned.isRegularFile)
+            {
+                scanned.size = entry->file_size(error);
+                scanned.modifiedTime = entry->last_write_time(error).time_since_epoch().count();
+            }
+        }
+        return entries.size();
+    }
+
+    /// @brief Walks the tree with scanner::scan_tree.
+    /// @param threads Number of threads to walk with. 0 uses one per core.
+    /// @return Number of entries found.
+    size_t walk_scanner(size_t threads)
+    {
+        std::vector<scanner::Directory> directories{};
+        scanner::scan_tree(PATH_BENCH_DIRECTORY, directories, threads);
+
+        size_t count = 0;
+        for (const scanner::Directory &directory : directories)
+        {
+            count += directory.entries.size();
+        }
+        return count;
+    }
+} // namespace
+
+void bench::run_scanner(const bench::Options &options)
+{
+    std::vector<size_t> sizes{};
+    for (size_t size : options.sizes)
+    {
+        sizes.push_back(std::min(size, MAX_SCAN_FILES));
+    }
+    std::sort(sizes.begin(), sizes.end());
+    sizes.erase(std::unique(sizes.begin(), sizes.end()), sizes.end());
+
+    std::error_code error{};
+    std::filesystem::remove_all(PATH_BENCH_DIRECTORY, error);
+    std::filesystem::create_directory(PATH_BENCH_DIRECTORY, error);
+
+    size_t filesWritten = 0;
+    for (size_t fileCount : sizes)
+    {
+        extend_tree(filesWritten, fileCount);
+        filesWritten = fileCount;
+
+        // The tree was just written, so every walk reads from the page cache. Entries are counted to make sure each
+        // walk found the whole tree.
+        size_t expected = 0;
+        double filesystemTime = bench::time_ns([&]() { expected = walk_filesystem(); });
+        bench::report("scan_tree_filesystem", fileCount, filesystemTime / fileCount, "ns/file");
+
+        size_t found = 0;
+        double singleTime = bench::time_ns([&]() { found = walk_scanner(1); });
+        bench::report("scan_tree_single", fileCount, found == expected ? singleTime / fileCount : -1.0, "ns/file");
+
+        double parallelTime = bench::time_ns([&]() { found = walk_scanner(0); });
+        bench::report("scan_tree_parallel", fileCount, found == expected ? parallelTime / fileCount : -1.0, "ns/file");
+    }
+    std::filesystem::remove_all(PATH_BENCH_DIRECTORY, error);
+}
@@ -0,0 +1,175 @@
+#include "Local.hpp"
+#include "Storage.hpp"
+#include "bench.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    /// @brief Every this many items is a directory instead of a file.
+    constexpr size_t DIRECTORY_INTERVAL = 8;
+
+    /// @brief Number of lookups timed for each kind. Lookups cycle through the names if there are fewer items.
+    constexpr size_t LOOKUP_COUNT = 0x100000;
+
+    /// @brief Most files written for the local listing benchmark. Creating millions of files takes far longer than
+    /// listing them, so larger sizes are capped.
+    constexpr size_t MAX_LOCAL_FILES = 200000;
+
+    /// @brief Directory the local listing benchmark fills. This is removed afterward.
+    constexpr std::string_view PATH_BENCH_DIRECTORY = "./bench_local";
+
+    /// @brief Storage with nothing behind it. It only exists to reach Storage's lookups with a filled listing.
+    class BenchStorage final : public Storage
+    {
+        public:
+            BenchStorage(std::string_view root) : Storage(root) {};
+
+            using Storage::find_directory;
+            using Storage::find_file;
+
+            /// @brief Adds an item for each name, all directly in the root like a large Drive root.
+            void fill(const std::vector<std::string> &names)
+            {
+                for (size_t i = 0; i < names.size(); i++)
+                {
+                    m_list.add(names[i], bench::make_id(i), m_root, i % DIRECTORY_INTERVAL == 0);
+                }
+            }
+
+            void change_directory(std::string_view name) override
+            {
+                (void)name;
+            }
+
+            bool create_directory(std::string_view name) override
+            {
+                (void)name;
+                return false;
+            }
+
+            bool delete_directory(std::string_view name) override
+            {
+                (void)name;
+                return false;
+            }
+
+            std::optional<size_t> count_directory(std::string_view name) override
+            {
+                (void)name;
+                return std::nullopt;
+            }
+
+            bool delete_file(std::string_view name) override
+            {
+                (void)name;
+                return false;
+            }
+
+            void list_contents(void) const override {};
+
+            bool refresh(void) override
+            {
+                return true;
+            }
+    };
+
+    /// @brief Times LOOKUP_COUNT calls to lookup, cycling through names in a shuffled order so they don't hit the
+    /// cache in the order they were added.
+    /// @return Nanoseconds per lookup. Negative if any lookup didn't return what was expected.
+    template <typename Lookup>
+    double time_lookups(const std::vector<std::string> &names, Lookup lookup)
+    {
+        std::vector<size_t> order(names.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), std::minstd_rand{});
+
+        bool correct = true;
+        double elapsed = bench::time_ns([&]() {
+            for (size_t i = 0; i < LOOKUP_COUNT; i++)
+            {
+                correct = lookup(order[i % order.size()]) && correct;
+            }
+        });
+        return correct ? elapsed / LOOKUP_COUNT : -1.0;
+    }
+} // namespace
+
+void bench::run_storage(const bench::Options &options)
+{
+    for (size_t size : options.sizes)
+    {
+        std::vector<std::string> names(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            names[i] = "save_" + std::to_string(i) + ".zip";
+        }
+
+        BenchStorage storage{"root"};
+        size_t heapBegin = bench::heap_in_use();
+        storage.fill(names);
+        bench::report("storage_memory", size, double(bench::heap_in_use() - heapBegin) / size, "bytes/item");
+
+        double fileTime = time_lookups(names, [&](size_t index) {
+            Storage::ItemIndex found = storage.find_file(names[index]);
+            return (found != Catalog::NOT_FOUND) == (index % DIRECTORY_INTERVAL != 0);
+        });
+        bench::report("storage_find_file", size, fileTime, "ns/lookup");
+
+        double directoryTime = time_lookups(names, [&](size_t index) {
+            Storage::ItemIndex found = storage.find_directory(names[index]);
+            return (found != Catalog::NOT_FOUND) == (index % DIRECTORY_INTERVAL == 0);
+        });
+        bench::report("storage_find_directory", size, directoryTime, "ns/lookup");
+
+        // Names that are close to real ones but never match, like a typo in a command.
+        double missTime = time_lookups(names, [&](size_t index) {
+            return storage.find_file(names[index] + "~") == Catalog::NOT_FOUND;
+        });
+        bench::report("storage_find_miss", size, missTime, "ns/lookup");
+    }
+}
+
+void bench::run_local_listing(const bench::Options &options)
+{
+    std::filesystem::path directory{PATH_BENCH_DIRECTORY};
+    for (size_t size : options.sizes)
+    {
+        size_t fileCount = std::min(size, MAX_LOCAL_FILES);
+
+        std::error_code error{};
+        std::filesystem::remove_all(directory, error);
+        std::filesystem::create_directory(directory, error);
+        for (size_t i = 0; i < fileCount; i++)
+        {
+            if (i % DIRECTORY_INTERVAL == 0)
+            {
+                std::filesystem::create_directory(directory / ("folder_" + std::to_string(i)), error);
+                continue;
+            }
+            std::ofstream(directory / ("save_" + std::to_string(i) + ".zip"));
+        }
+
+        // Constructing Local lists the root. The files were just written, so this reads from the page cache either
+        // way. The refresh is what listing the same directory again costs.
+        size_t heapBegin = bench::heap_in_use();
+        std::optional<Local> local{};
+        double firstTime = bench::time_ns([&]() { local.emplace(PATH_BENCH_DIRECTORY); });
+        double memory = double(bench::heap_in_use() - heapBegin) / fileCount;
+        bench::report("local_listing", fileCount, firstTime / fileCount, "ns/item");
+        bench::report("local_listing_memory", fileCount, memory, "bytes/item");
+
+        double refreshTime = bench::time_ns([&]() { local->refresh(); });
+        bench::report("local_listing_refresh", fileCount, refreshTime / fileCount, "ns/item");
+    }
+    std::error_code error{};
+    std::filesystem::remove_all(directory, error);
+}
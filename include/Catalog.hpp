@@ -0,0 +1,440 @@
+#pragma once
+#include "Item.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+/// @brief Indexed list of storage items. Lookups by ID and by parent + name are hashed and listings only walk the
+/// children of the parent requested instead of the entire list.
+/// @note Every string is stored once in an arena of fixed size blocks and referred to by offset. Parent IDs are
+/// interned so children only store a small handle to their parent. Items returned are views into the arena. Blocks
+/// never move, so items stay valid through adds, but removing items can compact the arena.
+class Catalog
+{
+    public:
+        /// @brief Type used to refer to an item in the catalog.
+        using Index = uint32_t;
+
+        /// @brief Value returned by the find functions when nothing is found.
+        static constexpr Catalog::Index NOT_FOUND = std::numeric_limits<Catalog::Index>::max();
+
+        /// @brief Iterator for walking every item in the catalog.
+        class Iterator
+        {
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = Item;
+                using difference_type = std::ptrdiff_t;
+                using pointer = void;
+                using reference = Item;
+
+                /// @brief Creates an iterator at index, skipping forward to the next live item.
+                /// @param catalog Catalog being iterated.
+                /// @param index Starting index.
+                Iterator(const Catalog *catalog, Catalog::Index index);
+
+                /// @brief Returns the item the iterator is at.
+                Item operator*(void) const;
+
+                /// @brief Moves to the next live item.
+                Iterator &operator++(void);
+
+                /// @brief Compares two iterators.
+                bool operator==(const Iterator &iterator) const = default;
+
+            private:
+                /// @brief Catalog being iterated.
+                const Catalog *m_catalog;
+
+                /// @brief Current index.
+                Catalog::Index m_index;
+
+                /// @brief Skips dead entries.
+                void skip_dead(void);
+        };
+
+        /// @brief Default catalog constructor.
+        Catalog(void) = default;
+
+        /// @brief Reserves space for count items.
+        /// @param count Number of items to reserve space for.
+        void reserve(size_t count);
+
+        /// @brief Adds an item to the catalog. If an item with the same ID already exists, it is replaced.
+        /// @param name Name of the item.
+        /// @param id ID of the item.
+        /// @param parent Parent ID of the item.
+        /// @param isDirectory Whether or not the item is a directory.
+        /// @param size Size of the item in bytes.
+        /// @param modifiedTime Last modification time in milliseconds since the Unix epoch.
+        /// @param md5Checksum Hex MD5 checksum of the item. Empty if it isn't known.
+        /// @return True on success. False if the name, ID, parent, or checksum are too long to be stored.
+        bool add(std::string_view name,
+                 std::string_view id,
+                 std::string_view parent,
+                 bool isDirectory,
+                 uint64_t size = 0,
+                 int64_t modifiedTime = 0,
+                 std::string_view md5Checksum = {});
+
+        /// @brief Removes the item with the ID passed.
+        /// @param id ID of the item to remove.
+        /// @return True if the item was found and removed. False if it wasn't found.
+        bool remove(std::string_view id);
+
+        /// @brief Removes the item with the ID passed and everything under it. Only the subtree is walked, so this
+        /// takes time proportional to its size instead of the size of the catalog.
+        /// @param id ID of the item to remove.
+        /// @return Number of items removed.
+        size_t remove_subtree(std::string_view id);
+
+        /// @brief Clears the catalog and all of its indexes.
+        void clear(void);
+
+        /// @brief Returns the number of items in the catalog.
+        /// @return Number of items.
+        size_t size(void) const;
+
+        /// @brief Returns whether or not the catalog is empty.
+        /// @return True if the catalog is empty. False if it isn't.
+        bool empty(void) const;
+
+        /// @brief Returns whether or not index refers to an item in the catalog.
+        /// @param index Index to check.
+        /// @return True if the index is valid. False if it isn't.
+        bool is_valid(Catalog::Index index) const;
+
+        /// @brief Returns the item at index.
+        /// @param index Index of the item.
+        /// @return View of the item.
+        /// @note This does not bounds check. Use is_valid first if the index didn't come from a find function.
+        Item at(Catalog::Index index) const;
+
+        /// @brief Locates an item using its ID.
+        /// @param id ID to search for.
+        /// @return Index of the item on success. NOT_FOUND on failure.
+        Catalog::Index find_by_id(std::string_view id) const;
+
+        /// @brief Locates an item using its parent and name.
+        /// @param parent Parent ID of the item.
+        /// @param name Name of the item.
+        /// @param isDirectory Whether the item searched for is a directory or file.
+        /// @return Index of the item on success. NOT_FOUND on failure.
+        Catalog::Index find_child(std::string_view parent, std::string_view name, bool isDirectory) const;
+
+        /// @brief Calls function for every item whose parent is parent.
+        /// @tparam Function Type of the function. Should take a const Item &.
+        /// @param parent Parent ID to list the children of.
+        /// @param function Function to call for each child.
+        template <typename Function>
+        void for_each_child(std::string_view parent, Function function) const
+        {
+            Catalog::Index parentHandle = Catalog::find_parent(parent);
+            if (parentHandle == Catalog::NOT_FOUND)
+            {
+                return;
+            }
+
+            for (Catalog::Index index = m_parents[parentHandle].firstChild; index != Catalog::NOT_FOUND;
+                 index = m_entries[index].nextSibling)
+            {
+                function(Catalog::at(index));
+            }
+        }
+
+        /// @brief Returns an iterator to the beginning of the catalog.
+        Catalog::Iterator begin(void) const;
+
+        /// @brief Returns an iterator to the end of the catalog.
+        Catalog::Iterator end(void) const;
+
+        /// @brief Returns the number of bytes the catalog currently has allocated.
+        /// @return Allocated size in bytes.
+        size_t memory_usage(void) const;
+
+        /// @brief Returns an estimate of the memory used by the items currently in the catalog. Unlike memory_usage,
+        /// this goes down as soon as items are removed.
+        /// @return Estimated size in bytes.
+        size_t live_memory_usage(void) const;
+
+        /// @brief Writes the catalog's records, arena, and indexes to stream as is.
+        /// @param stream Stream to write to.
+        /// @return True on success. False on failure.
+        /// @note The layout is only meant to be read back by the same build. Versioning is left to the caller.
+        bool write(std::ostream &stream) const;
+
+        /// @brief Replaces the catalog with one previously written with write.
+        /// @param data Data to read from. The view is advanced past the catalog on success.
+        /// @return True on success. False if the data is truncated or doesn't match this build's layout. The catalog is
+        /// left empty on failure.
+        bool read(std::string_view &data);
+
+    private:
+        /// @brief Flag set for directories.
+        static constexpr uint8_t FLAG_DIRECTORY = 1 << 0;
+
+        /// @brief Flag set for entries that are in use.
+        static constexpr uint8_t FLAG_ALIVE = 1 << 1;
+
+        /// @brief Longest name that can be stored.
+        static constexpr size_t MAX_NAME_LENGTH = std::numeric_limits<uint16_t>::max();
+
+        /// @brief Longest ID that can be stored.
+        static constexpr size_t MAX_ID_LENGTH = std::numeric_limits<uint8_t>::max();
+
+        /// @brief Longest checksum that can be stored.
+        static constexpr size_t MAX_CHECKSUM_LENGTH = std::numeric_limits<uint8_t>::max();
+
+        /// @brief ID length given to parents that were freed.
+        static constexpr uint32_t DEAD_PARENT = std::numeric_limits<uint32_t>::max();
+
+        /// @brief Compact record for a single item.
+        struct Entry
+        {
+                /// @brief Arena offset of the name.
+                uint32_t nameOffset;
+
+                /// @brief Arena offset of the ID. This is the same as nameOffset when they match.
+                uint32_t idOffset;
+
+                /// @brief Length of the name.
+                uint16_t nameLength;
+
+                /// @brief Length of the ID.
+                uint8_t idLength;
+
+                /// @brief Directory and alive flags.
+                uint8_t flags;
+
+                /// @brief Interned parent handle.
+                Catalog::Index parent;
+
+                /// @brief Previous child of the same parent.
+                Catalog::Index previousSibling;
+
+                /// @brief Next child of the same parent. Doubles as the free list link for dead entries.
+                Catalog::Index nextSibling;
+
+                /// @brief Arena offset of the checksum.
+                uint32_t checksumOffset;
+
+                /// @brief Length of the checksum. 0 if there isn't one.
+                uint8_t checksumLength;
+
+                /// @brief Size of the item.
+                uint64_t size;
+
+                /// @brief Modification time in milliseconds since the Unix epoch.
+                int64_t modifiedTime;
+        };
+
+        /// @brief Interned parent ID with the head and tail of its child list.
+        struct Parent
+        {
+                /// @brief Arena offset of the ID.
+                uint32_t idOffset;
+
+                /// @brief Length of the ID. DEAD_PARENT once the parent is freed.
+                uint32_t idLength;
+
+                /// @brief First child.
+                Catalog::Index firstChild;
+
+                /// @brief Last child. Doubles as the free list link for freed parents.
+                Catalog::Index lastChild;
+        };
+
+        /// @brief Open addressing hash table of 32-bit values. The full hash is stored alongside so growing never
+        /// needs to touch the keys.
+        class Table
+        {
+            public:
+                /// @brief Finds the first value with hash that equals returns true for.
+                /// @tparam Equals Type of the comparison function.
+                /// @param hash Hash of the key.
+                /// @param equals Function taking a value and returning whether it matches the key.
+                /// @return Value on success. NOT_FOUND on failure.
+                template <typename Equals>
+                Catalog::Index find(uint32_t hash, Equals equals) const
+                {
+                    if (m_slots.empty())
+                    {
+                        return Catalog::NOT_FOUND;
+                    }
+
+                    size_t mask = m_slots.size() - 1;
+                    for (size_t i = hash & mask;; i = (i + 1) & mask)
+                    {
+                        const Slot &slot = m_slots[i];
+                        if (slot.value == Table::EMPTY)
+                        {
+                            return Catalog::NOT_FOUND;
+                        }
+                        else if (slot.value != Table::TOMBSTONE && slot.hash == hash && equals(slot.value))
+                        {
+                            return slot.value;
+                        }
+                    }
+                }
+
+                /// @brief Inserts value.
+                /// @param hash Hash of the value's key.
+                /// @param value Value to insert.
+                void insert(uint32_t hash, Catalog::Index value);
+
+                /// @brief Erases value.
+                /// @param hash Hash of the value's key.
+                /// @param value Value to erase.
+                void erase(uint32_t hash, Catalog::Index value);
+
+                /// @brief Makes sure count values fit without growing.
+                /// @param count Number of values.
+                void reserve(size_t count);
+
+                /// @brief Clears the table.
+                void clear(void);
+
+                /// @brief Returns the number of bytes allocated by the table.
+                size_t memory_usage(void) const;
+
+                /// @brief Writes the table to stream.
+                bool write(std::ostream &stream) const;
+
+                /// @brief Reads a table previously written with write.
+                bool read(std::string_view &data);
+
+                /// @brief Checks a table that was just read before anything is looked up in it.
+                /// @tparam Valid Type of the check function.
+                /// @param valid Function taking a value and returning whether it refers to something that exists.
+                /// @return True if every value passes and lookups are guaranteed to find an empty slot to stop at.
+                template <typename Valid>
+                bool validate(Valid valid) const
+                {
+                    if (!m_slots.empty() && m_used >= m_slots.size())
+                    {
+                        return false;
+                    }
+
+                    for (const Slot &slot : m_slots)
+                    {
+                        if (slot.value != Table::EMPTY && slot.value != Table::TOMBSTONE && !valid(slot.value))
+                        {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+
+            private:
+                /// @brief Marks an empty slot.
+                static constexpr Catalog::Index EMPTY = Catalog::NOT_FOUND;
+
+                /// @brief Marks a slot whose value was erased.
+                static constexpr Catalog::Index TOMBSTONE = Catalog::NOT_FOUND - 1;
+
+                /// @brief Table slot.
+                struct Slot
+                {
+                        uint32_t hash;
+                        Catalog::Index value;
+                };
+
+                /// @brief Slots. The size is always a power of two.
+                std::vector<Slot> m_slots;
+
+                /// @brief Number of slots holding values or tombstones.
+                size_t m_used = 0;
+
+                /// @brief Number of slots holding values.
+                size_t m_live = 0;
+
+                /// @brief Rebuilds the table with capacity slots, dropping tombstones.
+                /// @param capacity New slot count.
+                void rehash(size_t capacity);
+        };
+
+        /// @brief Size of the blocks strings are stored in.
+        static constexpr size_t SIZE_ARENA_BLOCK = 0x10000;
+
+        /// @brief String arena blocks.
+        std::vector<std::unique_ptr<char[]>> m_arena;
+
+        /// @brief Number of bytes used in the last block.
+        size_t m_blockUsed = Catalog::SIZE_ARENA_BLOCK;
+
+        /// @brief Number of bytes in the arena belonging to removed items.
+        size_t m_deadBytes = 0;
+
+        /// @brief Item records.
+        std::vector<Catalog::Entry> m_entries;
+
+        /// @brief Interned parents.
+        std::vector<Catalog::Parent> m_parents;
+
+        /// @brief Head of the free entry list.
+        Catalog::Index m_freeHead = Catalog::NOT_FOUND;
+
+        /// @brief Head of the free parent list.
+        Catalog::Index m_freeParentHead = Catalog::NOT_FOUND;
+
+        /// @brief Number of live items.
+        size_t m_count = 0;
+
+        /// @brief Number of live parents.
+        size_t m_parentCount = 0;
+
+        /// @brief ID -> entry.
+        Catalog::Table m_idIndex;
+
+        /// @brief Parent + type + name -> entry.
+        Catalog::Table m_nameIndex;
+
+        /// @brief Parent ID -> parent handle.
+        Catalog::Table m_parentIndex;
+
+        /// @brief Hashes a string.
+        static uint32_t hash_string(std::string_view string);
+
+        /// @brief Hashes the key used by the name index.
+        static uint32_t hash_name(Catalog::Index parent, std::string_view name, bool isDirectory);
+
+        /// @brief Returns a view of the arena at offset.
+        std::string_view get_string(uint32_t offset, size_t length) const;
+
+        /// @brief Returns whether a string at offset would lie entirely within the used part of a single arena block.
+        bool is_stored(uint32_t offset, size_t length) const;
+
+        /// @brief Checks every handle, link, and string offset of a catalog that was just read.
+        /// @return True if the catalog can be used without reading outside of what was loaded.
+        bool validate(void) const;
+
+        /// @brief Copies string to the end of the arena.
+        /// @return Offset of the string.
+        uint32_t store_string(std::string_view string);
+
+        /// @brief Finds the handle of an interned parent.
+        /// @return Parent handle on success. NOT_FOUND on failure.
+        Catalog::Index find_parent(std::string_view parent) const;
+
+        /// @brief Finds or interns parent.
+        /// @return Parent handle.
+        Catalog::Index intern_parent(std::string_view parent);
+
+        /// @brief Removes the entry at index without compacting the arena. Its parent is freed if this was its last
+        /// child.
+        void remove_entry(Catalog::Index index);
+
+        /// @brief Frees a parent with no children left so its handle can be reused.
+        void free_parent(Catalog::Index handle);
+
+        /// @brief Rebuilds the free parent list and the live parent count from the parents themselves.
+        void link_free_parents(void);
+
+        /// @brief Rewrites the arena without the strings of removed items once enough of it is dead.
+        void compact_arena(void);
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief Builds Drive batch requests and splits their responses back up. Each request added becomes one part of a
+/// multipart/mixed body that is sent to the batch endpoint in a single round trip.
+/// @note This only deals with the framing. Sending the batch and acting on the responses is up to the caller.
+class DriveBatch
+{
+    public:
+        /// @brief The most requests Drive accepts in a single batch.
+        static constexpr size_t MAX_REQUESTS = 100;
+
+        /// @brief Response to a single request in the batch.
+        struct Response
+        {
+                /// @brief HTTP status code. 0 if the batch response didn't contain a response for the request.
+                long code = 0;
+
+                /// @brief Body of the response.
+                std::string body;
+        };
+
+        /// @brief Creates a new, empty batch.
+        DriveBatch(void);
+
+        /// @brief Adds a request to the batch.
+        /// @param method HTTP method of the request.
+        /// @param path Path and query of the request. For example, /drive/v3/files/ID.
+        /// @param body JSON body of the request. Empty for requests without one.
+        /// @return Index of the request on success. MAX_REQUESTS if the batch is already full.
+        size_t add(std::string_view method, std::string_view path, std::string_view body);
+
+        /// @brief Returns the number of requests in the batch.
+        size_t size(void) const;
+
+        /// @brief Returns whether or not the batch is empty.
+        bool empty(void) const;
+
+        /// @brief Returns whether or not the batch can't take any more requests.
+        bool full(void) const;
+
+        /// @brief Removes every request from the batch.
+        void clear(void);
+
+        /// @brief Returns the multipart body of the batch, closing boundary included.
+        /// @return Body of the batch.
+        const std::string &get_body(void);
+
+        /// @brief Returns the Content-Type header the batch needs to be sent with.
+        /// @return Content-Type header.
+        const std::string &get_content_type_header(void) const;
+
+        /// @brief Splits a batch response into the responses to each request.
+        /// @param contentType Value of the Content-Type header of the response. The boundary is read from this.
+        /// @param response Body of the response.
+        /// @param responsesOut Vector to write the responses to. This is resized to size() and each response is
+        /// written to the index of the request it answers.
+        /// @return True on success. False if the response isn't a multipart response.
+        bool parse_response(std::string_view contentType,
+                            std::string_view response,
+                            std::vector<DriveBatch::Response> &responsesOut) const;
+
+    private:
+        /// @brief Boundary between parts of the body.
+        std::string m_boundary;
+
+        /// @brief Content-Type header with the boundary.
+        std::string m_contentTypeHeader;
+
+        /// @brief Body of the batch.
+        std::string m_body;
+
+        /// @brief Number of requests in m_body.
+        size_t m_count = 0;
+
+        /// @brief Whether or not the closing boundary has been appended to m_body.
+        bool m_closed = false;
+};
@@ -0,0 +1,281 @@
+#pragma once
+#include "Task.hpp"
+#include "curl.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/// @brief Single threaded event loop that drives CURL transfers with curl_multi_socket_action and epoll. Tasks run on
+/// the loop's thread and can have any number of transfers in flight at once without blocking each other.
+class EventLoop
+{
+    public:
+        /// @brief Awaitable for a single transfer. Resumes with the result once the transfer finishes.
+        class Transfer
+        {
+            public:
+                /// @brief Creates a new transfer awaitable.
+                /// @param loop Loop to perform the transfer on.
+                /// @param handle Handle to perform. It needs to be fully set up beforehand.
+                Transfer(EventLoop &loop, curl::Handle &handle) : m_loop(loop), m_handle(handle) {};
+
+                bool await_ready(void) const noexcept
+                {
+                    return false;
+                }
+
+                /// @brief Adds the handle to the loop's multi handle.
+                bool await_suspend(std::coroutine_handle<> awaiting);
+
+                /// @brief Returns the result of the transfer.
+                CURLcode await_resume(void) const noexcept
+                {
+                    return m_result;
+                }
+
+            private:
+                /// @brief Loop performing the transfer.
+                EventLoop &m_loop;
+
+                /// @brief Handle being performed.
+                curl::Handle &m_handle;
+
+                /// @brief Coroutine to resume once it's done.
+                std::coroutine_handle<> m_awaiting;
+
+                /// @brief Result of the transfer.
+                CURLcode m_result = CURLE_OK;
+
+                friend class EventLoop;
+        };
+
+        /// @brief Awaitable that resumes after a delay without holding up anything else on the loop.
+        class Sleep
+        {
+            public:
+                /// @brief Creates a new sleep.
+                /// @param loop Loop to sleep on.
+                /// @param delay How long to sleep.
+                Sleep(EventLoop &loop, std::chrono::milliseconds delay) : m_loop(loop), m_delay(delay) {};
+
+                bool await_ready(void) const noexcept
+                {
+                    return m_delay.count() <= 0;
+                }
+
+                /// @brief Schedules the awaiting coroutine to be resumed once the delay is up.
+                void await_suspend(std::coroutine_handle<> awaiting);
+
+                void await_resume(void) const noexcept {};
+
+            private:
+                /// @brief Loop sleeping.
+                EventLoop &m_loop;
+
+                /// @brief Delay.
+                std::chrono::milliseconds m_delay;
+        };
+
+        /// @brief Awaitable that runs a blocking function on a thread of its own and resumes on the loop once it
+        /// returns.
+        class Work
+        {
+            public:
+                /// @brief Creates a new work awaitable.
+                /// @param loop Loop to resume on.
+                /// @param function Function to run. It can't touch anything the loop's tasks use while it runs.
+                Work(EventLoop &loop, std::function<void(void)> function)
+                    : m_loop(loop), m_function(std::move(function)) {};
+
+                bool await_ready(void) const noexcept
+                {
+                    return false;
+                }
+
+                /// @brief Starts the thread running the function.
+                void await_suspend(std::coroutine_handle<> awaiting);
+
+                /// @brief Joins the thread.
+                void await_resume(void);
+
+            private:
+                /// @brief Loop to resume on.
+                EventLoop &m_loop;
+
+                /// @brief Function being run.
+                std::function<void(void)> m_function;
+
+                /// @brief Thread running the function.
+                std::thread m_thread;
+        };
+
+        /// @brief Starts the loop's thread.
+        EventLoop(void);
+
+        /// @brief Stops the loop. See stop.
+        ~EventLoop();
+
+        /// @brief Returns whether or not the loop was started.
+        bool is_running(void) const;
+
+        /// @brief Returns whether or not this is being called from the loop's thread.
+        bool in_loop_thread(void) const;
+
+        /// @brief Starts a task on the loop without waiting for it.
+        /// @param task Task to start. The loop owns it from here on.
+        void spawn(Task<void> task);
+
+        /// @brief Runs a task on the loop and waits for its result. Other tasks keep running in the meantime. This
+        /// can be called from the loop's thread as well, in which case the loop is run from here until it finishes.
+        /// @tparam Type Type of the task's result.
+        /// @param task Task to run.
+        /// @return Result of the task.
+        template <typename Type>
+        Type run(Task<Type> task)
+        {
+            std::optional<Type> result{};
+            EventLoop::run_until_done(EventLoop::store_result(std::move(task), result));
+            return std::move(*result);
+        }
+
+        /// @brief Runs a task that doesn't return anything and waits for it to finish.
+        /// @param task Task to run.
+        void run(Task<void> task);
+
+        /// @brief Runs function on the loop's thread and waits for it to return.
+        /// @tparam Function Type of the function.
+        /// @param function Function to run.
+        /// @return Whatever function returns.
+        template <typename Function>
+        auto call(Function function) -> decltype(function())
+        {
+            if (EventLoop::in_loop_thread())
+            {
+                return function();
+            }
+            return EventLoop::run(EventLoop::call_task(function));
+        }
+
+        /// @brief Performs a transfer. co_await the result.
+        /// @param handle Handle to perform.
+        /// @return Awaitable for the transfer.
+        EventLoop::Transfer transfer(curl::Handle &handle);
+
+        /// @brief Performs a transfer and logs it if it fails. This is the loop's version of curl::perform.
+        /// @param handle Handle to perform.
+        /// @return True on success. False on failure.
+        Task<bool> perform(curl::Handle &handle);
+
+        /// @brief Runs a blocking function on a thread of its own so everything else on the loop keeps going.
+        /// @tparam Function Type of the function.
+        /// @param function Function to run.
+        /// @return Task for whatever function returns.
+        template <typename Function>
+        Task<decltype(std::declval<Function>()())> run_in_thread(Function function)
+        {
+            std::optional<decltype(function())> result{};
+            co_await EventLoop::Work(*this, [&function, &result](void) { result.emplace(function()); });
+            co_return std::move(*result);
+        }
+
+        /// @brief Waits without blocking the loop. co_await the result.
+        /// @param delay How long to wait.
+        /// @return Awaitable for the delay.
+        EventLoop::Sleep sleep_for(std::chrono::milliseconds delay);
+
+        /// @brief Waits for every spawned task to finish, then stops the loop's thread.
+        void stop(void);
+
+    private:
+        /// @brief Multi handle transfers are performed with.
+        curl::MultiHandle m_multi;
+
+        /// @brief epoll instance for the sockets CURL wants watched.
+        int m_epoll = -1;
+
+        /// @brief eventfd used to wake the loop up when something is posted from another thread.
+        int m_wakeup = -1;
+
+        /// @brief The loop's thread.
+        std::thread m_thread;
+
+        /// @brief ID of the loop's thread.
+        std::thread::id m_threadId;
+
+        /// @brief Guards m_posted.
+        std::mutex m_postLock;
+
+        /// @brief Coroutines posted from other threads and finished transfers waiting to be resumed on the loop.
+        std::deque<std::coroutine_handle<>> m_posted;
+
+        /// @brief Sleeping coroutines by the time they wake up.
+        std::multimap<std::chrono::steady_clock::time_point, std::coroutine_handle<>> m_timers;
+
+        /// @brief When CURL wants socket_action called with CURL_SOCKET_TIMEOUT. Empty if it doesn't.
+        std::optional<std::chrono::steady_clock::time_point> m_curlDeadline;
+
+        /// @brief Number of spawned tasks that haven't finished.
+        std::atomic<size_t> m_taskCount = 0;
+
+        /// @brief Set once stop is called.
+        std::atomic<bool> m_stopping = false;
+
+        /// @brief Guards m_doneSignal.
+        std::mutex m_doneLock;
+
+        /// @brief Signaled whenever a task started by run_until_done from another thread finishes.
+        std::condition_variable m_doneSignal;
+
+        /// @brief The loop's thread function.
+        void run_loop(void);
+
+        /// @brief Waits for and handles one round of events.
+        /// @param maxWait Longest time to wait in milliseconds. -1 waits until something happens.
+        void run_once(int maxWait);
+
+        /// @brief Resumes the coroutines of any transfers that finished.
+        void check_transfers(void);
+
+        /// @brief Posts a coroutine to be resumed on the loop's thread.
+        void post(std::coroutine_handle<> handle);
+
+        /// @brief Wakes the loop up if it's waiting.
+        void wake(void);
+
+        /// @brief Wraps a spawned task so the loop knows when it's finished.
+        task::Deferred run_spawned(Task<void> task);
+
+        /// @brief Wraps a task so done is set once it's finished.
+        Task<void> signal_done(Task<void> task, bool &done);
+
+        /// @brief Starts task on the loop and waits for it to finish.
+        void run_until_done(Task<void> task);
+
+        /// @brief Wraps a task so its result is written to result.
+        template <typename Type>
+        static Task<void> store_result(Task<Type> task, std::optional<Type> &result)
+        {
+            result.emplace(co_await task);
+        }
+
+        /// @brief Wraps a function call in a task.
+        template <typename Function>
+        static Task<decltype(std::declval<Function>()())> call_task(Function function)
+        {
+            co_return function();
+        }
+
+        /// @brief CURL callback for the sockets it wants watched.
+        static int socket_callback(CURL *handle, curl_socket_t socket, int what, EventLoop *loop, void *socketData);
+
+        /// @brief CURL callback for the timeout it wants.
+        static int timer_callback(CURLM *multi, long timeout, EventLoop *loop);
+};
@@ -1,20 +1,88 @@
 #pragma once
+#include "EventLoop.hpp"
 #include "Item.hpp"
+#include "RateController.hpp"
 #include "Remote.hpp"
+#include "Task.hpp"
+#include "compression.hpp"
 #include "curl.hpp"
 #include "json.hpp"
+#include "md5.hpp"
 #include <ctime>
+#include <list>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+/// @brief Google Drive storage. Everything here runs on the instance's event loop thread. Synchronous calls made from
+/// another thread need to go through call so they don't race with whatever is running in the background.
 class GoogleDrive final : public Remote
 {
     public:
+        /// @brief A metadata operation that can be sent in a batch with run_batch.
+        struct BatchOperation
+        {
+                /// @brief Types of operations.
+                enum class Type
+                {
+                    Delete,
+                    CreateDirectory,
+                    Rename,
+                    Move
+                };
+
+                /// @brief Type of the operation.
+                Type type;
+
+                /// @brief ID of the item to operate on. For CreateDirectory, this is the name of the new directory.
+                std::string target;
+
+                /// @brief New name for Rename. New parent ID for Move. Parent ID for CreateDirectory, where empty
+                /// means the current parent. Unused for Delete.
+                std::string value;
+
+                /// @brief Whether or not the operation succeeded.
+                bool success = false;
+
+                /// @brief ID of the directory created by CreateDirectory.
+                std::string id;
+        };
+
+        /// @brief Counts of what sync_directory did, or would have done for a dry run.
+        struct SyncResult
+        {
+                /// @brief New files uploaded.
+                size_t uploaded = 0;
+
+                /// @brief Existing files whose content was replaced.
+                size_t replaced = 0;
+
+                /// @brief Files and folders deleted because they aren't in the local directory.
+                size_t deleted = 0;
+
+                /// @brief Files that were already up to date.
+                size_t unchanged = 0;
+
+                /// @brief Anything that failed.
+                size_t failed = 0;
+
+                /// @brief Paths relative to the synced directory of everything deleted, or that would have been.
+                std::vector<std::string> deletedPaths;
+
+                /// @brief Paths of folders that share their name with a newer folder next to them. Only the newest is
+                /// synced. The rest are left alone since deleting them would take everything in them too.
+                std::vector<std::string> duplicateDirectories;
+        };
+
         /// @brief Initializes a new instance of the GoogleDrive class.
         /// @param clientSecret Path to the client secret from Google's API.
         GoogleDrive(std::string_view configFile);
 
+        /// @brief Waits for background tasks to finish, then saves a snapshot of the catalog so the next launch doesn't
+        /// need to request the full listing.
+        ~GoogleDrive();
+
         /// @brief Changes the current parent directory/ID.
         /// @param name ID of the directory to change to.
         void change_directory(std::string_view name) override;
@@ -24,31 +92,143 @@ class GoogleDrive final : public Remote
         /// @return True on success. False on failure.
         bool create_directory(std::string_view name) override;
 
-        /// @brief Deletes a directory from Google Drive. To do: Make this recursive, even if it is a pain.
-        /// @param name ID of the directory to delete.
+        /// @brief Deletes a directory and everything under it from Google Drive, then drops the whole subtree from
+        /// the catalog.
+        /// @param name Name/ID of the directory to delete.
         /// @return True on success. False on failure.
         bool delete_directory(std::string_view name) override;
 
+        /// @brief Counts the items delete_directory would remove. In lazy mode, folders that aren't cached are
+        /// listed to count them, but the catalog isn't changed.
+        /// @param name Name/ID of the directory.
+        /// @return Number of items under the directory plus the directory itself. std::nullopt on failure.
+        std::optional<size_t> count_directory(std::string_view name) override;
+
         /// @brief Deletes a file from Google Drive.
         /// @param name ID of the file to delete.
         /// @return True on success. False on failure.
         bool delete_file(std::string_view name) override;
 
+        /// @brief Creates directories in the current parent in batches instead of one request at a time.
+        /// @param names Names of the directories to create.
+        /// @return Whether or not each directory was created, in the same order as names.
+        std::vector<bool> create_directories(const std::vector<std::string> &names) override;
+
+        /// @brief Deletes files in batches instead of one request at a time.
+        /// @param names Names/IDs of the files to delete.
+        /// @return Whether or not each file was deleted, in the same order as names.
+        std::vector<bool> delete_files(const std::vector<std::string> &names) override;
+
+        /// @brief Sends operations to Drive in batches of up to DriveBatch::MAX_REQUESTS and applies the ones that
+        /// succeed to the catalog.
+        /// @param operations Operations to run. The success and id of each are written back.
+        /// @return True if every batch was sent and answered. False if one wasn't. Individual operations can still
+        /// fail either way.
+        bool run_batch(std::vector<GoogleDrive::BatchOperation> &operations);
+
+        /// @brief Mirrors a local directory into the current parent directory. Files are compared by size and
+        /// modification time first and by MD5 checksum only when the times differ. New and changed files are uploaded,
+        /// and anything under the current parent that isn't in the local directory is deleted. When Drive has more than
+        /// one item with the same name, the most recently modified one is synced and older files are deleted.
+        /// @param directory Local directory whose contents are mirrored.
+        /// @param dryRun Whether to only count what would change.
+        /// @return Counts of what changed.
+        GoogleDrive::SyncResult sync_directory(const std::filesystem::path &directory, bool dryRun);
+
         /// @brief Lists the contents of the current parent directory.
         void list_contents(void) const override;
 
+        /// @brief Applies everything that changed on Drive since the last listing or refresh to the catalog.
+        /// @return True on success. False on failure.
+        bool refresh(void) override;
+
         /// @brief Uploads a file to Google Drive under the currently set parent.
         /// @param path Path of the file to upload.
         /// @return True on success. False on failure.
         bool upload_file(const std::filesystem::path &path) override;
 
+        /// @brief Uploads files to the current parent, running up to upload_concurrency uploads at once.
+        /// @param paths Paths of the files to upload.
+        /// @return Result of each upload in the same order as paths.
+        std::vector<Remote::UploadResult> upload_files(const std::vector<std::filesystem::path> &paths) override;
+
         /// @brief Downloads a file from Google Drive.
         /// @param name ID of the file to download.
         /// @param path Path of the file to write the downloaded data to.
         /// @return True on success. False on failure.
         bool download_file(std::string_view name, const std::filesystem::path &path) override;
 
+        /// @brief Creates a new directory in the current parent without blocking the loop.
+        /// @param name Name of the directory to create.
+        /// @return True on success. False on failure.
+        Task<bool> create_directory_async(std::string name) override;
+
+        /// @brief Creates a new directory under parent without blocking the loop.
+        /// @param name Name of the directory to create.
+        /// @param parent ID of the parent to create it in.
+        /// @return ID of the new directory. Empty on failure.
+        Task<std::string> create_directory_async(std::string name, std::string parent) override;
+
+        /// @brief Uploads a file to the parent that's current when the task starts without blocking the loop.
+        /// @param path Path of the file to upload.
+        /// @return True on success. False on failure.
+        Task<bool> upload_file_async(std::filesystem::path path) override;
+
+        /// @brief Uploads a file to parent without blocking the loop.
+        /// @param path Path of the file to upload.
+        /// @param parent ID of the parent to upload to.
+        /// @return Result of the upload.
+        Task<Remote::UploadResult> upload_file_async(std::filesystem::path path, std::string parent) override;
+
+        /// @brief Returns how much memory a single upload holds in buffers while it runs. Compressed uploads hold a
+        /// whole chunk.
+        size_t get_upload_memory(void) const override;
+
+        /// @brief Downloads a file without blocking the loop.
+        /// @param name Name/ID of the file to download.
+        /// @param path Path of the file to write the downloaded data to. This is only replaced once the download is
+        /// verified.
+        /// @return True on success. False on failure.
+        Task<bool> download_file_async(std::string name, std::filesystem::path path) override;
+
+        /// @brief Makes sure the children of a folder are in the catalog without blocking the loop. This only needs
+        /// to list anything in lazy mode.
+        /// @param id ID of the folder.
+        /// @return True on success. False on failure.
+        Task<bool> load_folder_async(std::string id);
+
+        /// @brief Starts a task on the event loop in the background.
+        /// @param task Task to start.
+        void spawn(Task<void> task) override;
+
+        /// @brief Waits for everything running in the background to finish, then stops the event loop. Nothing that
+        /// talks to Drive can be used afterward.
+        void shut_down(void);
+
+        /// @brief Runs function on the event loop's thread and waits for it to return.
+        /// @tparam Function Type of the function.
+        /// @param function Function to run.
+        /// @return Whatever function returns.
+        template <typename Function>
+        auto call(Function function) -> decltype(function())
+        {
+            return m_loop.call(function);
+        }
+
     private:
+        /// @brief A file for run_uploads to upload.
+        struct UploadOperation
+        {
+                /// @brief ID of the folder to upload to.
+                std::string parent;
+
+                /// @brief ID of an existing file to replace the content of. Empty uploads a new file.
+                std::string replaceId;
+
+                /// @brief Path of the file and how the upload went. The path needs to be set beforehand.
+                Remote::UploadResult result;
+        };
+
         /// @brief String for storing client ID.
         std::string m_clientId;
 
@@ -64,19 +244,239 @@ class GoogleDrive final : public Remote
         /// @brief String for storing the authentication header.
         std::string m_authHeader;
 
-        /// @brief Curl handle.
-        curl::Handle m_curl;
+        /// @brief URL for getting the initial login code.
+        std::string m_urlDeviceCode;
+
+        /// @brief URL access tokens are requested from.
+        std::string m_urlToken;
+
+        /// @brief URL of the about endpoint.
+        std::string m_urlAbout;
+
+        /// @brief URL of the files endpoint.
+        std::string m_urlFiles;
+
+        /// @brief URL uploads are started at.
+        std::string m_urlUpload;
+
+        /// @brief URL batches are sent to.
+        std::string m_urlBatch;
+
+        /// @brief URL of the changes feed.
+        std::string m_urlChanges;
+
+        /// @brief URL the changes feed's start token is requested from.
+        std::string m_urlChangesToken;
 
         /// @brief This stores the time the token expires at.
         std::time_t m_tokenExpiration;
 
+        /// @brief Number of listing requests to run at once. 1 reads the flat listing one page at a time.
+        int m_listingConcurrency = 8;
+
+        /// @brief Number of files upload_files and sync_directory upload at once.
+        int m_uploadConcurrency = 4;
+
+        /// @brief Number of connections large downloads are split across.
+        int m_downloadConcurrency = 4;
+
+        /// @brief Whether a task is already refreshing the token.
+        bool m_refreshingToken = false;
+
+        /// @brief Size of the chunks files are uploaded in. This is always a multiple of 256 KiB.
+        uint64_t m_uploadChunkSize = 0x800000;
+
+        /// @brief Whether folders are only listed when they're needed instead of all at once.
+        bool m_lazyListing = false;
+
+        /// @brief Memory budget for cached folder listings in lazy mode.
+        size_t m_listingCacheBudget = 64 * 1024 * 1024;
+
+        /// @brief Codec uploads are compressed with. Downloads are decompressed according to the file's own codec.
+        compression::Codec m_compression = compression::Codec::None;
+
+        /// @brief Level uploads are compressed at.
+        int m_compressionLevel = compression::DEFAULT_LEVEL;
+
+        /// @brief IDs of the folders with cached listings. The front is the most recently used.
+        std::list<std::string> m_folderLru;
+
+        /// @brief Folder ID -> position in m_folderLru.
+        std::unordered_map<std::string, std::list<std::string>::iterator> m_loadedFolders;
+
+        /// @brief Page token for the changes feed. Everything before this is already in the catalog.
+        std::string m_changesToken;
+
+        /// @brief Limits requests in flight and decides how long to back off when Drive throttles.
+        RateController m_rateController;
+
+        /// @brief Event loop transfers are run on. This is last so it's destroyed before anything its tasks use.
+        EventLoop m_loop;
+
+        /// @brief Runs uploads over up to m_uploadConcurrency connections at once. Every connection takes the next
+        /// upload until there aren't any left.
+        /// @param uploads Uploads to run. The result of each is written back.
+        void run_uploads(std::vector<GoogleDrive::UploadOperation> &uploads);
+
+        /// @brief Uploads a file using handle.
+        /// @param handle Handle to upload with.
+        /// @param path Path of the file to upload.
+        /// @param parent ID of the parent to upload to.
+        /// @param resultOut Optional result to write the ID and checksum of the uploaded file to.
+        /// @param replaceId ID of an existing file to replace the content of instead of creating a new one.
+        /// @return True on success. False on failure.
+        /// @note Any number of these can run at once as long as each has its own handle.
+        Task<bool> upload_file(curl::Handle &handle,
+                               const std::filesystem::path &path,
+                               std::string parent,
+                               Remote::UploadResult *resultOut,
+                               std::string replaceId = {});
+
+        /// @brief Uploads a file to a resumable upload session in m_uploadChunkSize chunks. Failed chunks are retried
+        /// from whatever offset Google reports it committed.
+        /// @param handle Handle to upload with.
+        /// @param location URL of the upload session.
+        /// @param target File being uploaded.
+        /// @param fileSize Size of the file.
+        /// @param response String to write the final response to.
+        /// @param compressor Optional compressor reading target. What it returns is uploaded instead of the file.
+        /// @param compressedMd5 Optional context the compressed data is hashed into.
+        /// @return True if the upload completed. False on failure.
+        Task<bool> upload_session(curl::Handle &handle,
+                                  const std::string &location,
+                                  std::ifstream &target,
+                                  uint64_t fileSize,
+                                  std::string &response,
+                                  compression::Compressor *compressor = nullptr,
+                                  md5::Context *compressedMd5 = nullptr);
+
+        /// @brief Sends a single chunk to an upload session or asks it how much it has received.
+        /// @param handle Handle to upload with.
+        /// @param location URL of the upload session.
+        /// @param target Stream the chunk is read from. This needs to already be at the start of the chunk.
+        /// @param offset Offset of the chunk. On a 308 response, this is updated to the offset Google expects next.
+        /// @param length Length of the chunk.
+        /// @param fileSize Size of the file. UINT64_MAX if it isn't known yet.
+        /// @param isStatusQuery Whether this is only a query for the committed offset.
+        /// @param response String to write the response to.
+        /// @param code HTTP response code.
+        /// @return True if a response was received. False if the transfer itself failed.
+        Task<bool> upload_chunk(curl::Handle &handle,
+                                const std::string &location,
+                                std::istream &target,
+                                uint64_t &offset,
+                                uint64_t length,
+                                uint64_t fileSize,
+                                bool isStatusQuery,
+                                std::string &response,
+                                long &code);
+
+        /// @brief Refreshes the token if needed and copies the authorization header. If another task is already
+        /// refreshing it, this waits for that one instead of refreshing it again.
+        /// @param headerOut String to write the header to.
+        /// @return True on success. False if the token couldn't be refreshed.
+        Task<bool> get_auth_header(std::string &headerOut);
+
+        /// @brief Waits until the rate controller has a slot free for another request. The slot needs to be given
+        /// back with finish_request or release_request_slot.
+        Task<void> acquire_request_slot(void);
+
+        /// @brief Gives back a request slot without retrying and records how the request went.
+        /// @param outcome Outcome of the request.
+        void release_request_slot(RateController::Outcome outcome);
+
+        /// @brief Gives back a request slot and backs off if the request is worth retrying.
+        /// @param outcome Outcome of the request.
+        /// @param failures Number of times in a row the request failed. This is incremented for failures.
+        /// @return True if the request should be retried. False if it succeeded or shouldn't be retried.
+        Task<bool> finish_request(RateController::Outcome outcome, int &failures);
+
+        /// @brief Performs a request with a JSON response under the rate controller. Throttled requests, server errors
+        /// and network errors are retried with backoff.
+        /// @param handle Handle to perform. It needs to be fully set up beforehand.
+        /// @param response String the handle writes the response to. This is cleared before every attempt.
+        /// @return True if a response was received. False if the transfer itself failed.
+        Task<bool> perform_request(curl::Handle &handle, std::string &response);
+
+        /// @brief Downloads a file in a single stream, hashing it as it comes in.
+        /// @param id ID of the file.
+        /// @param descriptor Descriptor of the file to write to.
+        /// @param digestOut Digest of the data received. For compressed files, this is of the compressed data.
+        /// @param codec Codec the file is stored with. It's decompressed before it's written.
+        /// @return Number of bytes written on success. std::nullopt on failure.
+        Task<std::optional<uint64_t>> download_stream(std::string_view id,
+                                                      int descriptor,
+                                                      md5::Digest &digestOut,
+                                                      compression::Codec codec = compression::Codec::None);
+
+        /// @brief Splits a file into ranges and downloads them over m_downloadConcurrency connections at once. Each
+        /// range is written at its offset and retried on its own if it fails.
+        /// @param id ID of the file.
+        /// @param descriptor Descriptor of the file to write to.
+        /// @param fileSize Size of the file.
+        /// @param rangeIgnoredOut Set to true if the server answered a range with something other than partial content.
+        /// @return True on success. False on failure.
+        Task<bool> download_segments(std::string_view id, int descriptor, uint64_t fileSize, bool &rangeIgnoredOut);
+
+        /// @brief Downloads the range [begin, end) of a file and writes it at the same offset. Failures resume from
+        /// the last byte written.
+        /// @param handle Handle to download with.
+        /// @param id ID of the file.
+        /// @param descriptor Descriptor of the file to write to.
+        /// @param begin Offset of the first byte.
+        /// @param end Offset after the last byte.
+        /// @param rangeIgnoredOut Set to true if the server answered with something other than partial content. The
+        /// range isn't retried when this happens.
+        /// @return True on success. False once the range has failed too many times or the server ignored it.
+        Task<bool> download_range(curl::Handle &handle,
+                                  std::string_view id,
+                                  int descriptor,
+                                  uint64_t begin,
+                                  uint64_t end,
+                                  bool &rangeIgnoredOut);
+
+        /// @brief Deletes a file or folder by ID.
+        /// @param id ID of the item to delete.
+        /// @return True on success. False on failure.
+        Task<bool> delete_file_async(std::string id);
+
+        /// @brief Sends operations [begin, end) as a single batch request.
+        /// @param operations Operations being run.
+        /// @param begin Index of the first operation to send.
+        /// @param end Index after the last operation to send.
+        /// @return True if the batch was answered. False on failure.
+        Task<bool> send_batch(std::vector<GoogleDrive::BatchOperation> &operations, size_t begin, size_t end);
+
+        /// @brief Applies a successful batch operation to the catalog.
+        /// @param operation Operation that succeeded.
+        /// @param body Body of the response to it.
+        /// @return True on success. False if the response was malformed.
+        bool apply_batch_operation(GoogleDrive::BatchOperation &operation, const std::string &body);
+
+        /// @brief Gets the size, MD5 checksum, and codec of a file.
+        /// @param id ID of the file.
+        /// @param sizeOut Variable to write the size to. For compressed files, this is the uncompressed size.
+        /// @param md5Out String to write the checksum to. This is empty for files Google doesn't checksum.
+        /// @param codecOut Variable to write the codec the file is stored with to.
+        /// @return True on success. False on failure, if the file has no content to download, or if its codec isn't
+        /// supported.
+        Task<bool> get_file_metadata(std::string_view id,
+                                     uint64_t &sizeOut,
+                                     std::string &md5Out,
+                                     compression::Codec &codecOut);
+
+        /// @brief Builds the URL of every endpoint from the base URLs passed.
+        /// @param driveBaseUrl Base URL of the Drive API. For example, https://www.googleapis.com.
+        /// @param oauth2BaseUrl Base URL of the OAUTH2 endpoints.
+        void set_base_urls(std::string_view driveBaseUrl, std::string_view oauth2BaseUrl);
+
         /// @brief Signs in to Google Drive using the information read from the client_secret.json file.
         /// @return True on success. False on failure.
-        bool sign_in(void);
+        Task<bool> sign_in(void);
 
         /// @brief Uses V2 of Drive's API to get the root ID and set it.
         /// @return True on success. False on failure.
-        bool get_set_root_id(void);
+        Task<bool> get_set_root_id(void);
 
         /// @brief Returns whether or not the token is valid. Includes a small grace period just to be 100% safe.
         /// @return True if the token is still valid. False if it isn't.
@@ -86,19 +486,74 @@ class GoogleDrive final : public Remote
         /// @return True on success. False on failure.
         bool refresh_token(void);
 
+        /// @brief Refreshes the access token without blocking the loop. Use get_auth_header instead of calling this
+        /// directly from tasks.
+        /// @return True on success. False on failure.
+        Task<bool> refresh_token_async(void);
+
         /// @brief Requests the full listing of everything JKSV has created and uploaded to Drive.
         /// @return True on success. False on failure.
-        bool request_listing(void);
+        Task<bool> request_listing(void);
+
+        /// @brief Requests the full listing by walking the folder tree from the root, listing up to
+        /// m_listingConcurrency folders at once.
+        /// @return True on success. False on failure.
+        /// @note Only items reachable from the root are found this way.
+        Task<bool> request_listing_concurrent(void);
+
+        /// @brief Requests the listing of a single folder's children and adds them to the catalog.
+        /// @param folder ID of the folder.
+        /// @param catalog Optional catalog to add the children to instead of m_list.
+        /// @return True on success. False on failure.
+        Task<bool> request_folder_listing(std::string folder, Catalog *catalog = nullptr);
+
+        /// @brief Makes sure the children of the folder are in the catalog, listing it if they aren't, then evicts
+        /// the least recently used folders until the catalog fits in m_listingCacheBudget again.
+        /// @param id ID of the folder.
+        /// @return True on success. False on failure.
+        bool load_folder(std::string_view id);
 
-        /// @brief Processes a listing response from Google.
+        /// @brief Marks a folder's listing as cached.
+        /// @param id ID of the folder.
+        void mark_folder_loaded(std::string_view id);
+
+        /// @brief Drops a folder's cached listing and the cached listings of everything under it.
+        /// @param id ID of the folder.
+        void evict_folder(const std::string &id);
+
+        /// @brief Throws out every cached listing and relists the path from the root to the current parent.
+        /// @return True on success. False on failure.
+        bool refresh_lazy(void);
+
+        /// @brief Gets the starting page token for the changes feed and stores it in m_changesToken.
+        /// @return True on success. False on failure.
+        Task<bool> request_changes_token(void);
+
+        /// @brief Reads the changes feed from m_changesToken on and applies everything in it to the list.
+        /// @return True on success. False on failure.
+        Task<bool> request_changes(void);
+
+        /// @brief Processes a changes.list response from Google.
         /// @param json json::Object containing the response.
         /// @return True on success. False on failure.
-        bool process_listing(json::Object &json);
+        bool process_changes(json::Object &json);
+
+        /// @brief Loads the catalog and root ID from the snapshot if it's still fresh and belongs to this account.
+        /// @return True if the snapshot was loaded. False if a full listing is needed.
+        bool load_snapshot(void);
+
+        /// @brief Writes the catalog and root ID to the snapshot.
+        /// @return True on success. False on failure.
+        bool save_snapshot(void);
+
+        /// @brief Returns the string used to tell snapshots from different accounts apart.
+        /// @return Account string.
+        std::string get_account_key(void) const;
 
         /// @brief Locates the directory using the ID passed.
         /// @param id ID to search for.
-        /// @return True on success. False on failure.
-        Storage::ItemIterator find_directory_by_id(std::string_view id);
+        /// @return Index of the directory on success. Catalog::NOT_FOUND on failure.
+        Storage::ItemIndex find_directory_by_id(std::string_view id) const;
 
         /// @brief Performs a quick check on the json::Object passed to see if the error key is present.
         /// @param json json::Object to check.
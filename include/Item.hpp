@@ -1,6 +1,10 @@
 #pragma once
-#include <string>
+#include <cstdint>
+#include <string_view>
 
+/// @brief Lightweight view of an item stored in a Catalog.
+/// @note The strings an Item points to are owned by the Catalog it came from. Items are only valid until that
+/// catalog is modified.
 class Item
 {
     public:
@@ -9,7 +13,16 @@ class Item
         /// @param id ID of the item.
         /// @param parent Parent ID of the item.
         /// @param isDirectory Whether or not the item is a directory.
-        Item(std::string_view name, std::string_view id, std::string_view parent, bool isDirectory);
+        /// @param size Size of the item in bytes.
+        /// @param modifiedTime Last modification time in milliseconds since the Unix epoch.
+        /// @param md5Checksum Hex MD5 checksum of the item. Empty if it isn't known.
+        Item(std::string_view name,
+             std::string_view id,
+             std::string_view parent,
+             bool isDirectory,
+             uint64_t size = 0,
+             int64_t modifiedTime = 0,
+             std::string_view md5Checksum = {});
 
         /// @brief Returns the name of the item.
         /// @return Name of the item.
@@ -27,32 +40,37 @@ class Item
         /// @return True if the item is a directory. False if it isn't.
         bool is_directory(void) const;
 
-        /// @brief Sets the name of the item.
-        /// @param name New name of the item.
-        void set_name(std::string_view name);
+        /// @brief Returns the size of the item.
+        /// @return Size in bytes. 0 for directories.
+        uint64_t get_size(void) const;
 
-        /// @brief Sets the ID of the item.
-        /// @param id New ID of the item.
-        void set_id(std::string_view id);
+        /// @brief Returns when the item was last modified.
+        /// @return Milliseconds since the Unix epoch. 0 if it isn't known.
+        int64_t get_modified_time(void) const;
 
-        /// @brief Sets the parent ID of the item.
-        /// @param parent New parent ID of the item.
-        void set_parent_id(std::string_view parent);
-
-        /// @brief Sets whether the item is a directory.
-        /// @param isDirectory Whether the item is a directory.
-        void set_is_directory(bool isDirectory);
+        /// @brief Returns the MD5 checksum of the item.
+        /// @return Hex checksum. Empty if it isn't known.
+        std::string_view get_md5_checksum(void) const;
 
     private:
         /// @brief Item's name.
-        std::string m_name;
+        std::string_view m_name;
 
         /// @brief Item's ID.
-        std::string m_id;
+        std::string_view m_id;
 
         /// @brief Item's parent.
-        std::string m_parent;
+        std::string_view m_parent;
 
         /// @brief Whether or not the item is a directory.
         bool m_isDirectory;
+
+        /// @brief Item's size.
+        uint64_t m_size;
+
+        /// @brief Item's modification time.
+        int64_t m_modifiedTime;
+
+        /// @brief Item's checksum.
+        std::string_view m_md5Checksum;
 };
@@ -0,0 +1,179 @@
+#pragma once
+#include "Catalog.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief Streaming parser for Drive file listing responses. Bytes are fed as they arrive from curl and only
+/// files[].{id,name,parents,mimeType,size,modifiedTime,md5Checksum,appProperties}, nextPageToken, and errors are
+/// decoded. Files go straight into a catalog as soon as their object closes.
+/// @note Nothing is allocated per value. Strings are decoded into buffers that are reused for the life of the parser.
+class ListingParser
+{
+    public:
+        /// @brief Creates a new parser that adds files to catalog.
+        /// @param catalog Catalog to add files to.
+        ListingParser(Catalog &catalog);
+
+        /// @brief Resets the parser so it can read a new response.
+        /// @param directories Optional vector the IDs of directories found are appended to.
+        void reset(std::vector<std::string> *directories = nullptr);
+
+        /// @brief Feeds the next chunk of the response to the parser.
+        /// @param data Data to parse.
+        /// @param length Length of data.
+        /// @return True on success. False if the response isn't valid JSON.
+        bool feed(const char *data, size_t length);
+
+        /// @brief Checks that the response was complete and well formed.
+        /// @return True if the response was a complete listing. False if it was cut off, malformed, or an error.
+        bool finish(void);
+
+        /// @brief Returns the page token for the next page of the listing.
+        /// @return Page token. Empty if this was the last page.
+        std::string_view get_next_page_token(void) const;
+
+        /// @brief Returns whether or not the response was an error from Google.
+        /// @return True if an error was returned. False if one wasn't.
+        bool error_occurred(void) const;
+
+        /// @brief Returns the error message from Google.
+        /// @return Error message.
+        std::string_view get_error_message(void) const;
+
+        /// @brief Curl callback function that feeds the response to a ListingParser.
+        /// @param buffer Incoming buffer from CURL.
+        /// @param size Element size.
+        /// @param count Element count.
+        /// @param parser Parser to feed.
+        /// @return size * count on success. 0 to make curl abort the transfer if the response is bad.
+        static size_t write_callback(const char *buffer, size_t size, size_t count, ListingParser *parser);
+
+    private:
+        /// @brief Deepest nesting the parser will follow.
+        static constexpr size_t MAX_DEPTH = 64;
+
+        /// @brief State of the tokenizer between bytes.
+        enum class State : uint8_t
+        {
+            Value,
+            String,
+            Escape,
+            Unicode,
+            Literal,
+            Done,
+            Failed
+        };
+
+        /// @brief What's expected next inside the current container.
+        enum class Expect : uint8_t
+        {
+            Value,
+            Key,
+            Colon,
+            Comma
+        };
+
+        /// @brief Part of the listing the tokenizer is currently in.
+        enum class Section : uint8_t
+        {
+            None,
+            Files,
+            File,
+            Parents,
+            AppProperties,
+            Error
+        };
+
+        /// @brief Catalog files are added to.
+        Catalog &m_catalog;
+
+        /// @brief Optional vector directories are appended to.
+        std::vector<std::string> *m_directories = nullptr;
+
+        /// @brief Tokenizer state.
+        ListingParser::State m_state = ListingParser::State::Value;
+
+        /// @brief What the tokenizer expects next.
+        ListingParser::Expect m_expect = ListingParser::Expect::Value;
+
+        /// @brief Section of the listing being read.
+        ListingParser::Section m_section = ListingParser::Section::None;
+
+        /// @brief Container stack. True for objects, false for arrays.
+        bool m_containers[ListingParser::MAX_DEPTH] = {false};
+
+        /// @brief Number of containers open.
+        size_t m_depth = 0;
+
+        /// @brief Whether the string being read is a key.
+        bool m_readingKey = false;
+
+        /// @brief Code point being read from a \u escape.
+        uint32_t m_codePoint = 0;
+
+        /// @brief Number of hex digits read for the current \u escape.
+        int m_hexDigits = 0;
+
+        /// @brief High surrogate waiting for its low half.
+        uint32_t m_highSurrogate = 0;
+
+        /// @brief Last key read.
+        std::string m_key;
+
+        /// @brief String the current string is decoded to. nullptr if it isn't needed and is skipped.
+        std::string *m_target = nullptr;
+
+        /// @brief Fields of the file being read.
+        std::string m_id, m_name, m_mimeType, m_parent, m_size, m_modifiedTime, m_md5Checksum;
+
+        /// @brief Codec and uncompressed size from the appProperties of the file being read.
+        std::string m_codec, m_originalSize;
+
+        /// @brief Bit mask of the fields read for the current file.
+        uint8_t m_fields = 0;
+
+        /// @brief Whether or not the files array was found.
+        bool m_foundFiles = false;
+
+        /// @brief Page token for the next page.
+        std::string m_nextPageToken;
+
+        /// @brief Whether or not the response was an error.
+        bool m_error = false;
+
+        /// @brief Error message.
+        std::string m_errorMessage;
+
+        /// @brief Processes a byte outside of strings and literals.
+        bool process_structure(char byte);
+
+        /// @brief Processes the byte following a backslash.
+        bool process_escape(char byte);
+
+        /// @brief Processes a hex digit of a \u escape.
+        bool process_unicode(char byte);
+
+        /// @brief Appends a code point to the target as UTF-8, pairing surrogates.
+        void append_code_point(uint32_t codePoint);
+
+        /// @brief Writes a replacement character for a high surrogate that never got its low half.
+        void flush_surrogate(void);
+
+        /// @brief Picks where the string value about to be read goes.
+        void begin_string_value(void);
+
+        /// @brief Called when a container opens.
+        bool open_container(bool isObject);
+
+        /// @brief Called when a container closes.
+        bool close_container(bool isObject);
+
+        /// @brief Adds the file just read to the catalog.
+        bool add_file(void);
+
+        /// @brief Called after any value is complete.
+        void end_value(void);
+};
@@ -1,4 +1,7 @@
 #include "Storage.hpp"
+#include "hasher.hpp"
+#include <string>
+#include <vector>
 
 /// @brief Local type storage class.
 class Local final : public Storage
@@ -22,6 +25,11 @@ class Local final : public Storage
         /// @return True on success. False on failure.
         bool delete_directory(std::string_view name) override;
 
+        /// @brief Counts the items delete_directory would remove.
+        /// @param name Name of the directory.
+        /// @return Number of items under the directory plus the directory itself. std::nullopt on failure.
+        std::optional<size_t> count_directory(std::string_view name) override;
+
         /// @brief Attempts to delete a file named name from the current parent/working directory.
         /// @param name Name of the file to delete.
         /// @return True on success. False on failure.
@@ -30,6 +38,16 @@ class Local final : public Storage
         /// @brief Lists the contents of the current parent folder.
         void list_contents(void) const override;
 
+        /// @brief Reloads the listing of the current parent folder.
+        /// @return True.
+        bool refresh(void) override;
+
+        /// @brief Hashes files in the current parent/working directory with hasher::hash_files.
+        /// @param names Names of the files to hash. Directories are hashed recursively. Passing none hashes every file
+        /// directly in the current directory.
+        /// @return Result for each file hashed.
+        std::vector<hasher::Result> hash_files(const std::vector<std::string> &names);
+
     private:
         /// @brief Loads and stores the listing of the current parent/working directory.
         void load_parent_listing(void);
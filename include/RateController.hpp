@@ -0,0 +1,98 @@
+#pragma once
+#include <chrono>
+#include <random>
+#include <string_view>
+
+/// @brief Decides how many requests can be in flight at once and how long to wait before retrying one. The limit grows
+/// by one for every window of successful requests and is halved whenever the server starts throttling. Retries back off
+/// exponentially with full jitter so a group of throttled requests doesn't come back all at once.
+/// @note This isn't thread safe. It's only meant to be used from the event loop's thread.
+class RateController
+{
+    public:
+        /// @brief Default limit for requests in flight.
+        static constexpr int DEFAULT_MAX_LIMIT = 32;
+
+        /// @brief Number of requests allowed in flight to start with.
+        static constexpr int INITIAL_LIMIT = 8;
+
+        /// @brief Backoff before the first retry. This doubles for every retry after.
+        static constexpr std::chrono::milliseconds BACKOFF_BASE{500};
+
+        /// @brief Longest backoff before a retry.
+        static constexpr std::chrono::milliseconds BACKOFF_MAX{32000};
+
+        /// @brief How a request went.
+        enum class Outcome
+        {
+            /// @brief The request went through.
+            Success,
+
+            /// @brief The request failed in a way that's worth trying again. Network errors and server errors.
+            Retryable,
+
+            /// @brief The server is rate limiting. This is worth trying again after slowing down.
+            Throttled,
+
+            /// @brief The request was rejected and will be rejected again.
+            Fatal
+        };
+
+        /// @brief Creates a new controller.
+        /// @param maxLimit Most requests ever allowed in flight at once.
+        RateController(int maxLimit = RateController::DEFAULT_MAX_LIMIT);
+
+        /// @brief Sorts the result of a request into an outcome.
+        /// @param performed Whether curl performed the request without a transport error.
+        /// @param code HTTP status code. 0 if there wasn't a response.
+        /// @param response Body of the response or the error message from it. Google's 403s only say whether they're
+        /// rate limits in the body.
+        /// @return Outcome of the request.
+        static RateController::Outcome classify(bool performed, long code, std::string_view response);
+
+        /// @brief Sets the most requests ever allowed in flight at once.
+        /// @param maxLimit Limit to set.
+        void set_max_limit(int maxLimit);
+
+        /// @brief Takes a slot for a request if there's one free and the server isn't being waited out.
+        /// @return True if a slot was taken. False if the request needs to wait.
+        bool try_acquire(void);
+
+        /// @brief Gives back a slot taken with try_acquire and adjusts the limit according to how the request went.
+        /// @param outcome Outcome of the request.
+        void release(RateController::Outcome outcome);
+
+        /// @brief Picks a random delay before a retry. The range it's picked from doubles with each attempt.
+        /// @param attempt Number of the retry, starting from 1.
+        /// @return Delay to wait.
+        std::chrono::milliseconds get_backoff(int attempt);
+
+        /// @brief Returns the current limit for requests in flight.
+        int get_limit(void) const;
+
+        /// @brief Returns the number of requests currently in flight.
+        int get_in_flight(void) const;
+
+    private:
+        /// @brief Clock everything is timed with.
+        using Clock = std::chrono::steady_clock;
+
+        /// @brief Current limit. This is fractional so additive increase can be spread over a window of requests.
+        double m_limit = RateController::INITIAL_LIMIT;
+
+        /// @brief Upper bound for m_limit.
+        int m_maxLimit = RateController::DEFAULT_MAX_LIMIT;
+
+        /// @brief Number of slots taken.
+        int m_inFlight = 0;
+
+        /// @brief Number of throttled requests since the last success. This is how far the shared backoff has grown.
+        int m_throttleStreak = 0;
+
+        /// @brief No new requests start before this when the server throttles even a single request at a time.
+        /// Drive's limits are per user, so every request waits, not just the one that was throttled.
+        Clock::time_point m_pausedUntil{};
+
+        /// @brief Random generator for jitter.
+        std::minstd_rand m_random{std::random_device{}()};
+};
@@ -1,10 +1,29 @@
 #pragma once
 #include "Storage.hpp"
+#include "Task.hpp"
 #include <filesystem>
+#include <string>
+#include <vector>
 
 class Remote : public Storage
 {
     public:
+        /// @brief Result of a single upload from upload_files.
+        struct UploadResult
+        {
+                /// @brief Path of the file.
+                std::filesystem::path path;
+
+                /// @brief Whether or not the upload succeeded.
+                bool success = false;
+
+                /// @brief ID of the uploaded file. Empty if the upload failed.
+                std::string id;
+
+                /// @brief MD5 checksum the remote computed for the file. Empty if it doesn't provide one.
+                std::string md5;
+        };
+
         /// @brief Default Remote constructor.
         Remote(void) = default;
 
@@ -13,16 +32,83 @@ class Remote : public Storage
         virtual void change_directory(std::string_view name) = 0;
         virtual bool create_directory(std::string_view name) = 0;
         virtual bool delete_directory(std::string_view name) = 0;
+        virtual std::optional<size_t> count_directory(std::string_view name) = 0;
         virtual bool delete_file(std::string_view name) = 0;
+        virtual bool refresh(void) = 0;
 
         /// @brief Virtual function for uploading a file from the local file system.
         /// @param path Path of the file to upload.
         /// @return True on success. False on failure.
         virtual bool upload_file(const std::filesystem::path &path) = 0;
 
+        /// @brief Uploads multiple files. By default, this uploads them one at a time.
+        /// @param paths Paths of the files to upload.
+        /// @return Result of each upload in the same order as paths.
+        virtual std::vector<Remote::UploadResult> upload_files(const std::vector<std::filesystem::path> &paths)
+        {
+            std::vector<Remote::UploadResult> results{};
+            for (const std::filesystem::path &path : paths)
+            {
+                // This needs to go through the vtable to reach the derived upload_file.
+                results.push_back({.path = path, .success = this->upload_file(path), .id = {}, .md5 = {}});
+            }
+            return results;
+        }
+
         /// @brief Virtual function for downloading a file from the remote storage.
         /// @param name Name/ID of the file to download.
         /// @param path Path to write the downloaded file to.
         /// @return True on success. False on failure.
         virtual bool download_file(std::string_view name, const std::filesystem::path &path) = 0;
+
+        /// @brief Creates a directory as a task. By default, this just calls create_directory.
+        /// @param name Name of the directory to create.
+        /// @return True on success. False on failure.
+        virtual Task<bool> create_directory_async(std::string name)
+        {
+            co_return this->create_directory(name);
+        }
+
+        /// @brief Creates a directory under parent as a task.
+        /// @param name Name of the directory to create.
+        /// @param parent ID of the parent to create it in.
+        /// @return ID of the new directory. Empty on failure.
+        virtual Task<std::string> create_directory_async(std::string name, std::string parent) = 0;
+
+        /// @brief Uploads a file as a task. By default, this just calls upload_file.
+        /// @param path Path of the file to upload.
+        /// @return True on success. False on failure.
+        virtual Task<bool> upload_file_async(std::filesystem::path path)
+        {
+            co_return this->upload_file(path);
+        }
+
+        /// @brief Uploads a file to parent as a task.
+        /// @param path Path of the file to upload.
+        /// @param parent ID of the parent to upload to.
+        /// @return Result of the upload.
+        virtual Task<Remote::UploadResult> upload_file_async(std::filesystem::path path, std::string parent) = 0;
+
+        /// @brief Returns how much memory a single upload holds in buffers while it runs.
+        virtual size_t get_upload_memory(void) const
+        {
+            return 0;
+        }
+
+        /// @brief Downloads a file as a task. By default, this just calls download_file.
+        /// @param name Name/ID of the file to download.
+        /// @param path Path to write the downloaded file to.
+        /// @return True on success. False on failure.
+        virtual Task<bool> download_file_async(std::string name, std::filesystem::path path)
+        {
+            co_return this->download_file(name, path);
+        }
+
+        /// @brief Starts a task in the background. Remotes without an event loop run it to completion right here,
+        /// which works since the default tasks above never wait on anything.
+        /// @param task Task to start.
+        virtual void spawn(Task<void> task)
+        {
+            [](Task<void> task) -> task::Detached { co_await task; }(std::move(task));
+        }
 };
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include "Catalog.hpp"
+#include <ctime>
+#include <filesystem>
+#include <string>
+
+namespace snapshot
+{
+    /// @brief Information stored alongside the catalog in a snapshot.
+    struct Metadata
+    {
+            /// @brief String identifying the account the snapshot belongs to.
+            std::string account;
+
+            /// @brief ID of the root directory.
+            std::string root;
+
+            /// @brief Changes feed page token the catalog is current as of.
+            std::string changesToken;
+
+            /// @brief Time the snapshot was written.
+            std::time_t timestamp;
+    };
+
+    /// @brief Writes a snapshot of catalog to path. The file is written next to path and renamed over it once it's
+    /// complete so a crash never leaves a half written snapshot behind.
+    /// @param path Path of the snapshot.
+    /// @param catalog Catalog to save.
+    /// @param metadata Metadata to save with it.
+    /// @return True on success. False on failure.
+    bool write(const std::filesystem::path &path, const Catalog &catalog, const snapshot::Metadata &metadata);
+
+    /// @brief Memory maps and reads a snapshot written with write.
+    /// @param path Path of the snapshot.
+    /// @param catalog Catalog to read into.
+    /// @param metadata Metadata to read into.
+    /// @return True on success. False if the snapshot doesn't exist, is from a different version, or is corrupted.
+    bool read(const std::filesystem::path &path, Catalog &catalog, snapshot::Metadata &metadata);
+} // namespace snapshot
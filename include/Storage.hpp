@@ -1,5 +1,7 @@
 #pragma once
+#include "Catalog.hpp"
 #include "Item.hpp"
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -8,10 +10,10 @@ class Storage
 {
     public:
         /// @brief List type definition.
-        using ItemList = std::vector<Item>;
+        using ItemList = Catalog;
 
-        /// @brief Item list iterator.
-        using ItemIterator = std::vector<Item>::iterator;
+        /// @brief Type used to refer to items in the list.
+        using ItemIndex = Catalog::Index;
 
         /// @brief Base, default storage constructor.
         Storage(void) = default;
@@ -26,6 +28,9 @@ class Storage
         /// @brief Returns the parent directory to the root/starting directory.
         void return_to_root(void);
 
+        /// @brief Returns the name/ID of the current parent directory.
+        const std::string &get_parent_id(void) const;
+
         /// @brief Returns whether or not a directory exists within the current parent.
         /// @param name Name of the directory to search for.
         /// @return True if one is found. False if one isn't.
@@ -75,14 +80,49 @@ class Storage
         /// @return True on success. False on failure.
         virtual bool delete_directory(std::string_view name) = 0;
 
+        /// @brief Virtual function to count what deleting a directory would remove without deleting anything.
+        /// @param name Name/ID of the directory.
+        /// @return Number of items under the directory plus the directory itself. std::nullopt on failure.
+        virtual std::optional<size_t> count_directory(std::string_view name) = 0;
+
         /// @brief Virtual function to delete a file in the currently set parent.
         /// @param name Name/ID of the file to delete.
         /// @return True on success. False on failure.
         virtual bool delete_file(std::string_view name) = 0;
 
+        /// @brief Creates multiple directories in the current parent. By default, this creates them one at a time.
+        /// @param names Names of the directories to create.
+        /// @return Whether or not each directory was created, in the same order as names.
+        virtual std::vector<bool> create_directories(const std::vector<std::string> &names)
+        {
+            std::vector<bool> results{};
+            for (const std::string &name : names)
+            {
+                results.push_back(this->create_directory(name));
+            }
+            return results;
+        }
+
+        /// @brief Deletes multiple files in the current parent. By default, this deletes them one at a time.
+        /// @param names Names/IDs of the files to delete.
+        /// @return Whether or not each file was deleted, in the same order as names.
+        virtual std::vector<bool> delete_files(const std::vector<std::string> &names)
+        {
+            std::vector<bool> results{};
+            for (const std::string &name : names)
+            {
+                results.push_back(this->delete_file(name));
+            }
+            return results;
+        }
+
         /// @brief Prints the contents of m_list.
         virtual void list_contents(void) const = 0;
 
+        /// @brief Brings m_list up to date with the storage.
+        /// @return True on success. False on failure.
+        virtual bool refresh(void) = 0;
+
     protected:
         /// @brief Stores whether or not init'ing the Storage was successful.
         bool m_isInitialized = false;
@@ -98,11 +138,11 @@ class Storage
 
         /// @brief Returns if a directory with the currently set parent can be found.
         /// @param name Name of the directory to search for.
-        /// @return Iterator to the directory. m_list.end() on failure.
-        Storage::ItemIterator find_directory(std::string_view name);
+        /// @return Index of the directory. Catalog::NOT_FOUND on failure.
+        Storage::ItemIndex find_directory(std::string_view name) const;
 
         /// @brief Returns if a file with the currently set parent can be found.
         /// @param name Name of the file to search for.
-        /// @return Iterator to the file. m_list.end() on failure.
-        Storage::ItemIterator find_file(std::string_view name);
+        /// @return Index of the file. Catalog::NOT_FOUND on failure.
+        Storage::ItemIndex find_file(std::string_view name) const;
 };
\ No newline at end of file
@@ -0,0 +1,283 @@
+#pragma once
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+template <typename Type>
+class Task;
+
+namespace task
+{
+    /// @brief Final awaiter for tasks. Hands control straight back to whatever was awaiting the task.
+    struct FinalAwaiter
+    {
+            bool await_ready(void) const noexcept
+            {
+                return false;
+            }
+
+            template <typename Promise>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+            {
+                return handle.promise().continuation;
+            }
+
+            void await_resume(void) const noexcept {};
+    };
+
+    /// @brief Parts of the promise shared by every task type.
+    struct PromiseBase
+    {
+            /// @brief Coroutine to resume once the task finishes.
+            std::coroutine_handle<> continuation = std::noop_coroutine();
+
+            std::suspend_always initial_suspend(void) const noexcept
+            {
+                return {};
+            }
+
+            task::FinalAwaiter final_suspend(void) const noexcept
+            {
+                return {};
+            }
+
+            // Nothing in here throws. If something does anyway, there's nowhere sensible for it to go.
+            void unhandled_exception(void) const noexcept
+            {
+                std::terminate();
+            }
+    };
+
+    /// @brief Coroutine that starts right away and frees itself once it's finished. Nothing can await it.
+    struct Detached
+    {
+            struct promise_type
+            {
+                    Detached get_return_object(void) const noexcept
+                    {
+                        return {};
+                    }
+
+                    std::suspend_never initial_suspend(void) const noexcept
+                    {
+                        return {};
+                    }
+
+                    std::suspend_never final_suspend(void) const noexcept
+                    {
+                        return {};
+                    }
+
+                    void return_void(void) const noexcept {};
+
+                    void unhandled_exception(void) const noexcept
+                    {
+                        std::terminate();
+                    }
+            };
+    };
+
+    /// @brief Coroutine that waits to be resumed once, then frees itself once it's finished. This is for starting work
+    /// on a different thread than the one creating it.
+    struct Deferred
+    {
+            struct promise_type
+            {
+                    Deferred get_return_object(void) noexcept
+                    {
+                        return Deferred{std::coroutine_handle<promise_type>::from_promise(*this)};
+                    }
+
+                    std::suspend_always initial_suspend(void) const noexcept
+                    {
+                        return {};
+                    }
+
+                    std::suspend_never final_suspend(void) const noexcept
+                    {
+                        return {};
+                    }
+
+                    void return_void(void) const noexcept {};
+
+                    void unhandled_exception(void) const noexcept
+                    {
+                        std::terminate();
+                    }
+            };
+
+            /// @brief Handle to resume to start it.
+            std::coroutine_handle<> handle;
+    };
+
+    /// @brief Counts down the tasks started by when_all and resumes it once the last one finishes.
+    struct Counter
+    {
+            /// @brief Number of tasks still running.
+            size_t remaining;
+
+            /// @brief when_all's coroutine. Empty until it's waiting.
+            std::coroutine_handle<> waiting{};
+
+            bool await_ready(void) const noexcept
+            {
+                return remaining == 0;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) noexcept
+            {
+                waiting = handle;
+            }
+
+            void await_resume(void) const noexcept {};
+
+            /// @brief Marks a task as finished.
+            void finish(void)
+            {
+                if (--remaining == 0 && waiting)
+                {
+                    waiting.resume();
+                }
+            }
+    };
+
+    /// @brief Runs task, writes its result to out, then counts it as finished.
+    template <typename Type>
+    task::Detached run_counted(Task<Type> task, Type *out, task::Counter *counter)
+    {
+        *out = co_await task;
+        counter->finish();
+    }
+} // namespace task
+
+/// @brief Lazily started coroutine that produces a Type. Nothing runs until the task is awaited. Once it finishes, the
+/// awaiter is resumed with the result.
+/// @tparam Type Type of the result.
+/// @note Tasks aren't thread safe. A task and everything it awaits are expected to run on the same thread.
+template <typename Type>
+class Task
+{
+    public:
+        struct promise_type : task::PromiseBase
+        {
+                /// @brief Result of the task.
+                std::optional<Type> value;
+
+                Task get_return_object(void) noexcept
+                {
+                    return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+                }
+
+                void return_value(Type returnValue)
+                {
+                    value.emplace(std::move(returnValue));
+                }
+        };
+
+        /// @brief Tasks are move only.
+        Task(Task &&task) noexcept : m_handle(std::exchange(task.m_handle, {})) {};
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        /// @brief Frees the coroutine.
+        ~Task()
+        {
+            if (m_handle)
+            {
+                m_handle.destroy();
+            }
+        }
+
+        bool await_ready(void) const noexcept
+        {
+            return false;
+        }
+
+        /// @brief Starts the task and arranges for awaiting to be resumed once it finishes.
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            m_handle.promise().continuation = awaiting;
+            return m_handle;
+        }
+
+        Type await_resume(void)
+        {
+            return std::move(*m_handle.promise().value);
+        }
+
+    private:
+        /// @brief Handle of the coroutine.
+        std::coroutine_handle<promise_type> m_handle;
+
+        /// @brief Only promise_type creates tasks.
+        explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {};
+};
+
+/// @brief Task that doesn't produce anything.
+template <>
+class Task<void>
+{
+    public:
+        struct promise_type : task::PromiseBase
+        {
+                Task get_return_object(void) noexcept
+                {
+                    return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+                }
+
+                void return_void(void) const noexcept {};
+        };
+
+        Task(Task &&task) noexcept : m_handle(std::exchange(task.m_handle, {})) {};
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+
+        ~Task()
+        {
+            if (m_handle)
+            {
+                m_handle.destroy();
+            }
+        }
+
+        bool await_ready(void) const noexcept
+        {
+            return false;
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            m_handle.promise().continuation = awaiting;
+            return m_handle;
+        }
+
+        void await_resume(void) const noexcept {};
+
+    private:
+        std::coroutine_handle<promise_type> m_handle;
+
+        explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {};
+};
+
+/// @brief Runs every task at the same time and finishes once they all have.
+/// @tparam Type Type of the results.
+/// @param tasks Tasks to run.
+/// @return Results of the tasks in the same order.
+template <typename Type>
+Task<std::vector<Type>> when_all(std::vector<Task<Type>> tasks)
+{
+    // std::vector<bool> can't hand out pointers to its elements, so the results are collected here first.
+    std::unique_ptr<Type[]> values = std::make_unique<Type[]>(tasks.size());
+    task::Counter counter{.remaining = tasks.size()};
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        task::run_counted(std::move(tasks[i]), &values[i], &counter);
+    }
+    co_await counter;
+
+    co_return std::vector<Type>(values.get(), values.get() + tasks.size());
+}
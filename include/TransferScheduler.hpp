@@ -0,0 +1,279 @@
+#pragma once
+#include "Remote.hpp"
+#include "Task.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// @brief Runs backup and restore jobs against a Remote. Local directories are listed on a pool of worker threads that
+/// steal work from each other. Network transfers are handed to the remote's own loop so they never hold up a worker.
+/// Uploads read their files straight from disk, and the buffers they do it with come out of a fixed memory budget, so
+/// the size of the tree doesn't matter.
+class TransferScheduler
+{
+    public:
+        /// @brief Default memory budget for upload buffers.
+        static constexpr size_t DEFAULT_MEMORY_BUDGET = 0x10000000;
+
+        /// @brief Default number of transfers handed to the remote at once.
+        static constexpr size_t DEFAULT_MAX_TRANSFERS = 8;
+
+        /// @brief Types of work the scheduler runs.
+        enum class TaskType
+        {
+            /// @brief Lists a local directory.
+            Read,
+
+            /// @brief Creates a directory, uploads a file, or downloads a file on the remote.
+            Transfer
+        };
+
+        /// @brief Progress and results of a single job. Everything here can be read while the job is running.
+        class Job
+        {
+            public:
+                /// @brief Snapshot of a job's counters.
+                struct Progress
+                {
+                        /// @brief Files and directories found so far.
+                        size_t itemsTotal;
+
+                        /// @brief Items that finished, including the ones that failed.
+                        size_t itemsDone;
+
+                        /// @brief Items that failed.
+                        size_t itemsFailed;
+
+                        /// @brief Total size of the files found so far.
+                        uint64_t bytesTotal;
+
+                        /// @brief Bytes of files that finished transferring.
+                        uint64_t bytesTransferred;
+                };
+
+                /// @brief Creates a new job.
+                /// @param name Name of the job to show in progress reports.
+                Job(std::string_view name) : m_name(name) {};
+
+                /// @brief Returns the name of the job.
+                const std::string &get_name(void) const;
+
+                /// @brief Returns the current counters.
+                Job::Progress get_progress(void) const;
+
+                /// @brief Returns whether or not every item in the job is done.
+                bool is_finished(void) const;
+
+                /// @brief Blocks until every item in the job is done. This can't be called from the remote's loop.
+                void wait(void);
+
+                /// @brief Returns the local paths of the items that failed.
+                std::vector<std::filesystem::path> get_failures(void);
+
+            private:
+                /// @brief Name of the job.
+                std::string m_name;
+
+                /// @brief Counters. See Progress.
+                std::atomic<size_t> m_itemsTotal = 0;
+                std::atomic<size_t> m_itemsDone = 0;
+                std::atomic<size_t> m_itemsFailed = 0;
+                std::atomic<uint64_t> m_bytesTotal = 0;
+                std::atomic<uint64_t> m_bytesTransferred = 0;
+
+                /// @brief Guards m_failures and m_finished.
+                std::mutex m_lock;
+
+                /// @brief Signaled once the job finishes.
+                std::condition_variable m_finishedSignal;
+
+                /// @brief Whether the job finished.
+                bool m_finished = false;
+
+                /// @brief Local paths of the items that failed.
+                std::vector<std::filesystem::path> m_failures;
+
+                friend class TransferScheduler;
+        };
+
+        /// @brief Starts the worker threads.
+        /// @param remote Remote jobs are run against. It needs to outlive the scheduler.
+        /// @param workerCount Number of worker threads. 0 uses one per core.
+        /// @param memoryBudget Most memory upload buffers can hold at once.
+        /// @param maxTransfers Most transfers handed to the remote at once.
+        TransferScheduler(Remote &remote,
+                          size_t workerCount = 0,
+                          size_t memoryBudget = DEFAULT_MEMORY_BUDGET,
+                          size_t maxTransfers = DEFAULT_MAX_TRANSFERS);
+
+        /// @brief Waits for every job. See shut_down.
+        ~TransferScheduler();
+
+        /// @brief Starts backing up a local directory. A directory with the same name is created under parent and the
+        /// tree is recreated under it.
+        /// @param directory Local directory to back up.
+        /// @param parent ID of the remote directory to back up to.
+        /// @return Job to track progress with.
+        std::shared_ptr<TransferScheduler::Job> backup(const std::filesystem::path &directory, std::string_view parent);
+
+        /// @brief Starts restoring files from the remote.
+        /// @param files Pairs of remote names/IDs and the local paths to write them to.
+        /// @return Job to track progress with.
+        std::shared_ptr<TransferScheduler::Job> restore(
+            const std::vector<std::pair<std::string, std::filesystem::path>> &files);
+
+        /// @brief Returns every job started so far.
+        std::vector<std::shared_ptr<TransferScheduler::Job>> get_jobs(void);
+
+        /// @brief Waits for every job to finish, then stops the worker threads. This needs to happen before the
+        /// remote's loop stops. Nothing can be started afterward.
+        void shut_down(void);
+
+    private:
+        /// @brief A single file or directory moving through the scheduler.
+        struct Entry
+        {
+                /// @brief Job the entry belongs to.
+                std::shared_ptr<TransferScheduler::Job> job;
+
+                /// @brief Local path.
+                std::filesystem::path path;
+
+                /// @brief Name/ID on the remote. For backups, this is the ID of the parent before the entry is created
+                /// and the entry's own ID after.
+                std::string remote;
+
+                /// @brief Whether this is a directory.
+                bool isDirectory = false;
+
+                /// @brief Whether this is being restored instead of backed up.
+                bool isRestore = false;
+
+                /// @brief Size of the file when it was found.
+                uint64_t size = 0;
+
+                /// @brief Modification time of the file when it was found.
+                std::filesystem::file_time_type modifiedTime{};
+
+                /// @brief Memory taken from the budget for the upload's buffers. It's held until the upload finishes.
+                size_t memory = 0;
+        };
+
+        /// @brief A single piece of work.
+        struct Work
+        {
+                /// @brief What to do.
+                TransferScheduler::TaskType type;
+
+                /// @brief What to do it to.
+                std::shared_ptr<TransferScheduler::Entry> entry;
+        };
+
+        /// @brief A worker thread and its queue.
+        struct Worker
+        {
+                /// @brief Guards queue.
+                std::mutex lock;
+
+                /// @brief The owner takes work from the back. Everyone else steals from the front.
+                std::deque<TransferScheduler::Work> queue;
+
+                /// @brief The worker's thread.
+                std::thread thread;
+        };
+
+        /// @brief Remote jobs run against.
+        Remote &m_remote;
+
+        /// @brief Workers.
+        std::vector<std::unique_ptr<TransferScheduler::Worker>> m_workers;
+
+        /// @brief Number of work items in every queue combined.
+        std::atomic<size_t> m_queued = 0;
+
+        /// @brief Worker the next submission from outside the pool goes to.
+        std::atomic<size_t> m_nextWorker = 0;
+
+        /// @brief Guards m_idleSignal.
+        std::mutex m_idleLock;
+
+        /// @brief Idle workers wait on this for more work.
+        std::condition_variable m_idleSignal;
+
+        /// @brief Set once the workers should exit.
+        std::atomic<bool> m_stopping = false;
+
+        /// @brief Guards m_memoryUsed and m_memoryWaiters.
+        std::mutex m_memoryLock;
+
+        /// @brief Memory budget for upload buffers.
+        size_t m_memoryBudget;
+
+        /// @brief Memory currently held by upload buffers.
+        size_t m_memoryUsed = 0;
+
+        /// @brief Uploads waiting for memory to be released.
+        std::deque<TransferScheduler::Work> m_memoryWaiters;
+
+        /// @brief Guards m_transfersRunning and m_transferWaiters.
+        std::mutex m_transferLock;
+
+        /// @brief Most transfers handed to the remote at once.
+        size_t m_maxTransfers;
+
+        /// @brief Transfers the remote is running.
+        size_t m_transfersRunning = 0;
+
+        /// @brief Transfers waiting for a free slot.
+        std::deque<TransferScheduler::Work> m_transferWaiters;
+
+        /// @brief Guards m_jobs.
+        std::mutex m_jobLock;
+
+        /// @brief Every job started so far.
+        std::vector<std::shared_ptr<TransferScheduler::Job>> m_jobs;
+
+        /// @brief Worker thread function.
+        /// @param index Index of the worker.
+        void run_worker(size_t index);
+
+        /// @brief Takes the next piece of work for a worker, stealing from the others if its own queue is empty.
+        /// @param index Index of the worker.
+        /// @param workOut Work to write to.
+        /// @return True if work was found. False if every queue is empty.
+        bool take_work(size_t index, TransferScheduler::Work &workOut);
+
+        /// @brief Queues work.
+        /// @param work Work to queue.
+        /// @param index Index of the worker submitting it. Work from outside the pool is spread across the workers.
+        void submit(TransferScheduler::Work work, size_t index = SIZE_MAX);
+
+        /// @brief Lists a local directory and queues everything in it.
+        void read_directory(std::shared_ptr<TransferScheduler::Entry> entry, size_t index);
+
+        /// @brief Hands a transfer to the remote once there's memory for its buffers and a free slot for it.
+        void start_transfer(TransferScheduler::Work work);
+
+        /// @brief Runs a transfer on the remote and reports back.
+        Task<void> run_transfer(std::shared_ptr<TransferScheduler::Entry> entry);
+
+        /// @brief Frees a transfer slot and starts the next waiting transfer.
+        void finish_transfer(void);
+
+        /// @brief Takes memory from the budget. Entries that can't get any are parked until some is released.
+        /// @return True if the memory was taken. False if the work was parked.
+        bool acquire_memory(TransferScheduler::Work &work, size_t size);
+
+        /// @brief Returns memory to the budget and requeues parked work.
+        void release_memory(size_t size);
+
+        /// @brief Counts an item as finished.
+        void finish_item(TransferScheduler::Entry &entry, bool success);
+};
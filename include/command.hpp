@@ -1,7 +1,9 @@
 #pragma once
 #include "Storage.hpp"
+#include "TransferScheduler.hpp"
 
 /// @brief Executes the command passed using the storage reference passed.
 /// @param storage Reference to storage to use.
+/// @param scheduler Scheduler backup and restore jobs are started on.
 /// @return True on success. False on bad command parameters or error.
-bool execute_command(Storage &storage);
\ No newline at end of file
+bool execute_command(Storage &storage, TransferScheduler &scheduler);
\ No newline at end of file
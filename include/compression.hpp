@@ -0,0 +1,134 @@
+#pragma once
+#include "md5.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string_view>
+#include <zstd.h>
+
+namespace compression
+{
+    /// @brief Codecs files can be stored with.
+    enum class Codec
+    {
+        None,
+        Zstd
+    };
+
+    /// @brief Name of the zstd codec in the config and in appProperties.
+    constexpr std::string_view CODEC_NAME_ZSTD = "zstd";
+
+    /// @brief appProperties key the codec of a compressed file is recorded under.
+    constexpr std::string_view PROPERTY_CODEC = "jksvCodec";
+
+    /// @brief appProperties key the uncompressed size of a compressed file is recorded under. Drive's own size is the
+    /// compressed size.
+    constexpr std::string_view PROPERTY_SIZE = "jksvSize";
+
+    /// @brief Default compression level. Level 1 compresses a lot faster than gigabit uploads on a single core.
+    constexpr int DEFAULT_LEVEL = 1;
+
+    /// @brief Definition for a self cleaning zstd compression context.
+    using CompressContext = std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)>;
+
+    /// @brief Definition for a self cleaning zstd decompression context.
+    using DecompressContext = std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)>;
+
+    /// @brief Gets the codec with the name passed.
+    /// @param name Name of the codec.
+    /// @param codecOut Codec to write to.
+    /// @return True on success. False if the codec isn't supported.
+    bool parse_codec(std::string_view name, compression::Codec &codecOut);
+
+    /// @brief Compresses a stream as it's read. Only a single input buffer is held at a time, so memory doesn't depend
+    /// on the size of the stream.
+    class Compressor
+    {
+        public:
+            /// @brief Creates a new compressor.
+            /// @param source Stream to compress.
+            /// @param level zstd compression level. Negative levels trade ratio for even more speed.
+            /// @param sourceMd5 Optional context the uncompressed data is hashed into as it's read.
+            Compressor(std::istream &source, int level, md5::Context *sourceMd5 = nullptr);
+
+            /// @brief Returns whether or not the zstd context was created.
+            bool is_initialized(void) const;
+
+            /// @brief Compresses the next part of the source into buffer.
+            /// @param buffer Buffer to write to.
+            /// @param length Size of buffer.
+            /// @return Number of bytes written. This is only less than length once the stream is finished or failed.
+            size_t read(char *buffer, size_t length);
+
+            /// @brief Returns whether the whole source was read and every compressed byte was returned by read.
+            bool is_finished(void) const;
+
+            /// @brief Returns whether reading or compressing the source failed.
+            bool has_failed(void) const;
+
+            /// @brief Returns the number of bytes read from the source so far.
+            uint64_t get_bytes_read(void) const;
+
+        private:
+            /// @brief Stream being compressed.
+            std::istream &m_source;
+
+            /// @brief zstd context.
+            compression::CompressContext m_context;
+
+            /// @brief Buffer the source is read into.
+            std::unique_ptr<char[]> m_input;
+
+            /// @brief Part of m_input zstd hasn't consumed yet.
+            ZSTD_inBuffer m_inputBuffer{};
+
+            /// @brief Optional context the source is hashed into.
+            md5::Context *m_sourceMd5 = nullptr;
+
+            /// @brief Number of bytes read from the source.
+            uint64_t m_bytesRead = 0;
+
+            /// @brief Whether the end of the source was reached.
+            bool m_sourceFinished = false;
+
+            /// @brief Whether the frame was closed and flushed.
+            bool m_finished = false;
+
+            /// @brief Whether something went wrong.
+            bool m_failed = false;
+    };
+
+    /// @brief Decompresses a zstd stream as it arrives. Frames are checksummed by the compressor, so corruption is
+    /// caught here as well.
+    class Decompressor
+    {
+        public:
+            /// @brief Creates a new decompressor.
+            Decompressor(void);
+
+            /// @brief Returns whether or not the zstd context was created.
+            bool is_initialized(void) const;
+
+            /// @brief Decompresses as much of data as fits into output.
+            /// @param data Compressed data. This is advanced past whatever was consumed.
+            /// @param length Length of data. This is decreased by whatever was consumed.
+            /// @param output Buffer to write to.
+            /// @param outputSize Size of output.
+            /// @param outputUsed Number of bytes in output already. This is increased by whatever was written.
+            /// @return True on success. False if the data is corrupt.
+            /// @note If output ends up full, there might be more to write even if data was all consumed. This needs
+            /// to be called again once output is emptied.
+            bool decompress(const char *&data, size_t &length, char *output, size_t outputSize, size_t &outputUsed);
+
+            /// @brief Returns whether the data so far ended on a complete frame. Anything else means it was cut off.
+            bool is_finished(void) const;
+
+        private:
+            /// @brief zstd context.
+            compression::DecompressContext m_context;
+
+            /// @brief Whether the last frame was completed.
+            bool m_frameFinished = false;
+    };
+} // namespace compression
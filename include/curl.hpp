@@ -1,5 +1,6 @@
 #pragma once
 #include "logger.hpp"
+#include <cstdint>
 #include <curl/curl.h>
 #include <fstream>
 #include <memory>
@@ -14,24 +15,49 @@ namespace curl
     /// @brief Definition for a self cleaning CURL handle.
     using Handle = std::unique_ptr<CURL, decltype(&curl_easy_cleanup)>;
 
+    /// @brief Definition for a self cleaning CURL multi handle.
+    using MultiHandle = std::unique_ptr<CURLM, decltype(&curl_multi_cleanup)>;
+
     /// @brief Definition for a self cleaning CURL slist/header list.
     using HeaderList = std::unique_ptr<curl_slist, decltype(&curl_slist_free_all)>;
 
     /// @brief Definition for a vector of header strings from CURL.
     using HeaderArray = std::vector<std::string>;
 
-    /// @brief Initializes libCURL
-    /// @return True on success. False on failure.
-    static inline bool initialize(void)
+    /// @brief Section of a file being uploaded.
+    struct FileSection
     {
-        return curl_global_init(CURL_GLOBAL_DEFAULT) == CURLE_OK;
-    }
+            /// @brief Stream to read from. This should already be at the beginning of the section.
+            std::istream *file;
 
-    /// @brief Exits libCURL.
-    static inline void exit(void)
-    {
-        curl_global_cleanup();
-    }
+            /// @brief Position in the stream the section starts at.
+            std::streampos begin;
+
+            /// @brief Length of the section.
+            uint64_t length;
+
+            /// @brief Number of bytes left in the section.
+            uint64_t remaining;
+    };
+
+    /// @brief Initializes libCURL and the connection pool every handle prepared with prepare_* shares.
+    /// @return True on success. False on failure.
+    bool initialize(void);
+
+    /// @brief Frees the connection pool and exits libCURL.
+    void exit(void);
+
+    /// @brief Attaches handle to the shared connection pool. DNS lookups, TLS sessions, and open connections are
+    /// shared with every other handle in the pool and HTTP/2 is used where the server supports it.
+    /// @param handle Handle to attach.
+    /// @note curl_easy_reset detaches handles. prepare_* call this after resetting, so this only needs to be called
+    /// for handles that aren't prepared that way.
+    void attach_pool(curl::Handle &handle);
+
+    /// @brief Opens connections to the hosts of urls ahead of time so the first real requests to them don't need to
+    /// wait on DNS or TLS. The connections are opened at the same time and left in the pool.
+    /// @param urls URLs to warm up.
+    void warm_up(const std::vector<std::string_view> &urls);
 
     /// @brief Inline function that returns a unique_ptr wrapped, self cleaning CURL handle.
     /// @return Self cleaning CURL handle.
@@ -40,6 +66,13 @@ namespace curl
         return curl::Handle(curl_easy_init(), curl_easy_cleanup);
     }
 
+    /// @brief Inline function that returns a unique_ptr wrapped, self cleaning CURL multi handle.
+    /// @return Self cleaning CURL multi handle.
+    static inline curl::MultiHandle new_multi_handle(void)
+    {
+        return curl::MultiHandle(curl_multi_init(), curl_multi_cleanup);
+    }
+
     /// @brief Returns a unique_ptr for creating a curl_slist that will free itself.
     /// @return nullptr'd unique_ptr to create an slist with.
     /// @note curl_slists created this way must be built using <unique_ptr>.reset(curl_slist_append(<unique_ptr>.get(), PARAM))
@@ -55,14 +88,31 @@ namespace curl
         curl_easy_reset(handle.get());
     }
 
+    /// @brief Returns the HTTP response code of the last transfer performed with handle.
+    /// @param handle Handle to get the response code of.
+    /// @return HTTP response code. 0 if nothing was received.
+    static inline long get_response_code(curl::Handle &handle)
+    {
+        long code = 0;
+        curl_easy_getinfo(handle.get(), CURLINFO_RESPONSE_CODE, &code);
+        return code;
+    }
+
+    /// @brief Records a finished transfer in the HTTP metrics. Requests are broken down by the Drive endpoint they
+    /// went to and the class of their status code.
+    /// @param handle Handle the transfer was performed with.
+    /// @param result Result curl reported for the transfer.
+    void record_transfer(CURL *handle, CURLcode result);
+
     static inline bool perform(curl::Handle &handle)
     {
-        logger::log("before perform");
+        logger::debug("before perform");
         CURLcode error = curl_easy_perform(handle.get());
-        logger::log("after perform");
+        logger::debug("after perform");
+        curl::record_transfer(handle.get(), error);
         if (error != CURLE_OK)
         {
-            logger::log("Error performing CURL: %i.", error);
+            logger::error("Error performing CURL: %i.", error);
             return false;
         }
         return true;
@@ -107,6 +157,22 @@ namespace curl
     /// @return Number of bytes successfully read from the file.
     size_t read_data_file(char *buffer, size_t size, size_t count, std::ifstream *file);
 
+    /// @brief Curl callback function that reads data from a section of a file.
+    /// @param buffer Incoming buffer from curl to read to.
+    /// @param size Element size.
+    /// @param count Element count.
+    /// @param section Section of the file to read from.
+    /// @return Number of bytes successfully read from the section. 0 once the end of the section is reached.
+    size_t read_data_file_section(char *buffer, size_t size, size_t count, curl::FileSection *section);
+
+    /// @brief Curl callback function that seeks within a section of a file. Curl needs this to send the section
+    /// again when a reused connection turns out to be dead.
+    /// @param section Section of the file to seek in.
+    /// @param offset Offset from the beginning of the section.
+    /// @param origin Where offset is from. Only SEEK_SET is supported.
+    /// @return CURL_SEEKFUNC_OK on success. CURL_SEEKFUNC_CANTSEEK or CURL_SEEKFUNC_FAIL on failure.
+    int seek_data_file_section(curl::FileSection *section, curl_off_t offset, int origin);
+
     /// @brief Curl callback function to store headers in a HeaderArray.
     /// @param buffer Incoming buffer from CURL.
     /// @param size Element size
@@ -123,7 +189,8 @@ namespace curl
     /// @return size * count so curl thinks everything went fine nothing bad totally happened at all!
     size_t write_response_string(const char *buffer, size_t size, size_t count, std::string *string);
 
-    /// @brief Tries to locate and extract the value of header and write it to valueOut.
+    /// @brief Tries to locate and extract the value of header and write it to valueOut. Header names are compared
+    /// without regard to case.
     /// @param list List to search for the header for.
     /// @param header Header string to search for.
     /// @param valueOut String to write the value of the header to.
@@ -0,0 +1,73 @@
+#pragma once
+#include "md5.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace hasher
+{
+    /// @brief What identifies a version of a file to the cache. Anything that rewrites the file changes at least one.
+    struct FileKey
+    {
+            /// @brief Device the file is on.
+            uint64_t device;
+
+            /// @brief Inode of the file.
+            uint64_t inode;
+
+            /// @brief Size of the file.
+            uint64_t size;
+
+            /// @brief Modification time in nanoseconds since the Unix epoch.
+            int64_t modifiedTime;
+
+            /// @brief Compares two keys.
+            bool operator==(const FileKey &key) const = default;
+    };
+
+    /// @brief Result of hashing a single file.
+    struct Result
+    {
+            /// @brief Path of the file.
+            std::filesystem::path path;
+
+            /// @brief Whether or not the file was hashed.
+            bool success = false;
+
+            /// @brief Whether the digest came from the cache instead of reading the file.
+            bool cached = false;
+
+            /// @brief MD5 of the file.
+            md5::Digest digest{};
+    };
+
+    /// @brief Loads the hash cache from disk.
+    void initialize(void);
+
+    /// @brief Writes the hash cache back to disk if anything was added to it.
+    void exit(void);
+
+    /// @brief Gets the cache key of a file.
+    /// @param path Path of the file.
+    /// @param keyOut Key to write to.
+    /// @return True on success. False if the file couldn't be stat'd.
+    bool get_file_key(const std::filesystem::path &path, hasher::FileKey &keyOut);
+
+    /// @brief Looks a file up in the cache without reading it.
+    /// @param path Path of the file.
+    /// @param digestOut Digest to write to.
+    /// @return True if an up to date digest was cached. False if it wasn't.
+    bool find_cached(const std::filesystem::path &path, md5::Digest &digestOut);
+
+    /// @brief Looks a file up in the cache by a key that was already read.
+    /// @param key Key of the file.
+    /// @param digestOut Digest to write to.
+    /// @return True if an up to date digest was cached. False if it wasn't.
+    bool find_cached(const hasher::FileKey &key, md5::Digest &digestOut);
+
+    /// @brief Hashes files on every core. Each worker reads up to md5::LANES files at a time and hashes them side by
+    /// side. Files the cache already has an up to date digest for aren't read at all.
+    /// @param paths Paths of the files to hash.
+    /// @return Result for each file in the same order as paths.
+    std::vector<hasher::Result> hash_files(const std::vector<std::filesystem::path> &paths);
+} // namespace hasher
@@ -1,12 +1,91 @@
 #pragma once
+#include <cstdarg>
+
+/// @brief Lowest level compiled in. Anything below this compiles away entirely. 0 is debug, 1 is info, 2 is warning, 3
+/// is error.
+#ifndef LOGGER_MIN_LEVEL
+#define LOGGER_MIN_LEVEL 1
+#endif
 
 namespace logger
 {
-    /// @brief Initializes and creates the log file.
+    /// @brief Severity of a line.
+    enum class Level
+    {
+        Debug,
+        Info,
+        Warning,
+        Error
+    };
+
+    /// @brief Lowest level compiled in.
+    constexpr logger::Level MIN_LEVEL = static_cast<logger::Level>(LOGGER_MIN_LEVEL);
+
+    /// @brief Creates the log file and starts the thread that writes to it.
     void initialize(void);
 
-    /// @brief Writes a formatted string to the log.
+    /// @brief Writes whatever is still queued and stops the writer thread. Anything logged afterward is written
+    /// straight to the file.
+    void exit(void);
+
+    /// @brief Formats a line and queues it to be written. This never blocks or touches the file. If the queue is full,
+    /// the line is dropped and counted instead.
+    /// @param level Severity of the line.
+    /// @param format Format of the string.
+    /// @param ... Arguments to format the string with.
+    void write(logger::Level level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    /// @brief Same as write with the arguments already collected.
+    /// @param level Severity of the line.
     /// @param format Format of the string.
-    /// @param args Arguments to format the string with.
-    void log(const char *format, ...);
+    /// @param vaList Arguments to format the string with.
+    void write_list(logger::Level level, const char *format, std::va_list vaList) __attribute__((format(printf, 2, 0)));
+
+    /// @brief Logs a line at debug level. This compiles away unless LOGGER_MIN_LEVEL is 0.
+    inline __attribute__((format(printf, 1, 2))) void debug(const char *format, ...)
+    {
+        if constexpr (logger::MIN_LEVEL <= logger::Level::Debug)
+        {
+            std::va_list vaList;
+            va_start(vaList, format);
+            logger::write_list(logger::Level::Debug, format, vaList);
+            va_end(vaList);
+        }
+    }
+
+    /// @brief Logs a line at info level.
+    inline __attribute__((format(printf, 1, 2))) void info(const char *format, ...)
+    {
+        if constexpr (logger::MIN_LEVEL <= logger::Level::Info)
+        {
+            std::va_list vaList;
+            va_start(vaList, format);
+            logger::write_list(logger::Level::Info, format, vaList);
+            va_end(vaList);
+        }
+    }
+
+    /// @brief Logs a line at warning level.
+    inline __attribute__((format(printf, 1, 2))) void warning(const char *format, ...)
+    {
+        if constexpr (logger::MIN_LEVEL <= logger::Level::Warning)
+        {
+            std::va_list vaList;
+            va_start(vaList, format);
+            logger::write_list(logger::Level::Warning, format, vaList);
+            va_end(vaList);
+        }
+    }
+
+    /// @brief Logs a line at error level.
+    inline __attribute__((format(printf, 1, 2))) void error(const char *format, ...)
+    {
+        if constexpr (logger::MIN_LEVEL <= logger::Level::Error)
+        {
+            std::va_list vaList;
+            va_start(vaList, format);
+            logger::write_list(logger::Level::Error, format, vaList);
+            va_end(vaList);
+        }
+    }
 } // namespace logger
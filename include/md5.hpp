@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace md5
+{
+    /// @brief Definition for an MD5 digest.
+    using Digest = std::array<uint8_t, 16>;
+
+    /// @brief Number of independent messages transform_lanes hashes side by side.
+    constexpr size_t LANES = 8;
+
+    /// @brief Incremental MD5 hasher. Data can be fed in pieces of any size as it arrives.
+    class Context
+    {
+        public:
+            /// @brief Creates a new context ready to hash.
+            Context(void);
+
+            /// @brief Hashes length bytes of data.
+            /// @param data Data to hash.
+            /// @param length Length of data.
+            void update(const void *data, size_t length);
+
+            /// @brief Finishes hashing and returns the digest. The context is reset afterwards.
+            /// @return MD5 digest of everything passed to update.
+            md5::Digest finish(void);
+
+            /// @brief Hashes the same number of whole blocks into several contexts at once with transform_lanes.
+            /// Contexts that aren't on a block boundary are updated one at a time instead.
+            /// @param contexts Context for each lane. Lanes that are nullptr are skipped.
+            /// @param data Data for each lane.
+            /// @param blocks Number of 64 byte blocks to hash into every lane.
+            static void update_lanes(md5::Context *const contexts[md5::LANES],
+                                     const uint8_t *const data[md5::LANES],
+                                     size_t blocks);
+
+        private:
+            /// @brief Current hash state.
+            uint32_t m_state[4];
+
+            /// @brief Partial block waiting for more data.
+            uint8_t m_block[64];
+
+            /// @brief Total number of bytes hashed.
+            uint64_t m_length;
+
+            /// @brief Resets the context.
+            void reset(void);
+    };
+
+    /// @brief Hashes whole 64 byte blocks of data into state.
+    /// @param state Hash state.
+    /// @param data Blocks to hash.
+    /// @param blocks Number of blocks.
+    void transform(uint32_t state[4], const uint8_t *data, size_t blocks);
+
+    /// @brief Hashes whole 64 byte blocks of up to LANES messages at once. MD5 can't be split up within a message,
+    /// but separate messages can share SIMD registers.
+    /// @param states Hash state of each lane.
+    /// @param data Blocks for each lane. Lanes that are nullptr are left alone.
+    /// @param blocks Number of blocks to hash into every lane.
+    void transform_lanes(uint32_t states[md5::LANES][4], const uint8_t *const data[md5::LANES], size_t blocks);
+
+    /// @brief Converts a digest to the lowercase hex string Google uses for md5Checksum.
+    /// @param digest Digest to convert.
+    /// @return Hex string.
+    std::string to_hex(const md5::Digest &digest);
+} // namespace md5
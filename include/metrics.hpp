@@ -0,0 +1,205 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+namespace metrics
+{
+    /// @brief Number of cells counters and histograms are split across. Threads are spread over them so updates
+    /// from different threads don't fight over the same cache line.
+    constexpr size_t STRIPES = 16;
+
+    /// @brief Upper bounds of the latency histogram buckets in seconds. Anything slower lands in +Inf.
+    constexpr double BUCKET_BOUNDS[] = {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60};
+
+    /// @brief Number of buckets including +Inf.
+    constexpr size_t BUCKET_COUNT = std::size(BUCKET_BOUNDS) + 1;
+
+    /// @brief Returns the stripe the calling thread updates. Threads are handed stripes in turn the first time they
+    /// update anything.
+    inline size_t get_stripe(void)
+    {
+        static std::atomic<size_t> nextStripe = 0;
+        thread_local size_t stripe = nextStripe.fetch_add(1, std::memory_order_relaxed) % metrics::STRIPES;
+        return stripe;
+    }
+
+    /// @brief Counter that only goes up. Updates are a single relaxed add to a cell only a few threads share.
+    class Counter
+    {
+        public:
+            /// @brief Adds to the counter.
+            /// @param value Amount to add.
+            inline void add(uint64_t value = 1)
+            {
+                m_cells[metrics::get_stripe()].value.fetch_add(value, std::memory_order_relaxed);
+            }
+
+            /// @brief Returns the total of every cell.
+            uint64_t get(void) const;
+
+        private:
+            /// @brief Cell on its own cache line.
+            struct alignas(64) Cell
+            {
+                    std::atomic<uint64_t> value = 0;
+            };
+
+            /// @brief Cells.
+            Cell m_cells[metrics::STRIPES];
+    };
+
+    /// @brief Value that can go up and down.
+    class Gauge
+    {
+        public:
+            /// @brief Sets the gauge.
+            /// @param value Value to set.
+            inline void set(int64_t value)
+            {
+                m_value.store(value, std::memory_order_relaxed);
+            }
+
+            /// @brief Adds to the gauge.
+            /// @param value Amount to add. This can be negative.
+            inline void add(int64_t value)
+            {
+                m_value.fetch_add(value, std::memory_order_relaxed);
+            }
+
+            /// @brief Returns the current value.
+            int64_t get(void) const;
+
+        private:
+            /// @brief Current value.
+            std::atomic<int64_t> m_value = 0;
+    };
+
+    /// @brief Latency histogram with fixed buckets.
+    class Histogram
+    {
+        public:
+            /// @brief Totals of a histogram at one point in time.
+            struct Snapshot
+            {
+                    /// @brief Number of observations in each bucket. These aren't cumulative.
+                    uint64_t buckets[metrics::BUCKET_COUNT];
+
+                    /// @brief Number of observations.
+                    uint64_t count;
+
+                    /// @brief Sum of every observation in seconds.
+                    double sum;
+            };
+
+            /// @brief Records a duration.
+            /// @param duration Duration to record.
+            void observe(std::chrono::nanoseconds duration);
+
+            /// @brief Adds up every cell.
+            Histogram::Snapshot get(void) const;
+
+        private:
+            /// @brief Cell on its own cache lines.
+            struct alignas(64) Cell
+            {
+                    std::atomic<uint64_t> buckets[metrics::BUCKET_COUNT] = {};
+                    std::atomic<uint64_t> sumNs = 0;
+            };
+
+            /// @brief Cells.
+            Cell m_cells[metrics::STRIPES];
+    };
+
+    /// @brief Counters and latency of a single kind of operation.
+    struct Operation
+    {
+            /// @brief Operations that succeeded.
+            metrics::Counter &succeeded;
+
+            /// @brief Operations that failed.
+            metrics::Counter &failed;
+
+            /// @brief Bytes the operation moved, if it moves any.
+            metrics::Counter &bytes;
+
+            /// @brief How long the operation took.
+            metrics::Histogram &duration;
+    };
+
+    /// @brief Times an operation from construction to destruction and counts it. It's counted as a failure unless
+    /// succeed is called before then.
+    class ScopedOperation
+    {
+        public:
+            /// @brief Starts timing.
+            /// @param operation Operation to count.
+            ScopedOperation(metrics::Operation &operation)
+                : m_operation(operation), m_start(std::chrono::steady_clock::now()) {};
+
+            /// @brief Records the operation.
+            ~ScopedOperation();
+
+            /// @brief Marks the operation as successful.
+            /// @param bytes Number of bytes the operation moved.
+            void succeed(uint64_t bytes = 0);
+
+        private:
+            /// @brief Operation being timed.
+            metrics::Operation &m_operation;
+
+            /// @brief Time the operation started.
+            std::chrono::steady_clock::time_point m_start;
+
+            /// @brief Whether succeed was called.
+            bool m_succeeded = false;
+    };
+
+    /// @brief Starts the thread that writes the Prometheus export periodically.
+    void initialize(void);
+
+    /// @brief Stops the export thread and writes the export one last time.
+    void exit(void);
+
+    /// @brief Gets or creates a counter. References stay valid for the life of the program, so call sites only need
+    /// to look them up once.
+    /// @param name Name of the metric.
+    /// @param help Description of the metric.
+    /// @param labels Labels of this series in Prometheus format, without braces. For example, endpoint="files".
+    /// @return Counter.
+    metrics::Counter &counter(std::string_view name, std::string_view help, std::string_view labels = {});
+
+    /// @brief Gets or creates a gauge.
+    /// @param name Name of the metric.
+    /// @param help Description of the metric.
+    /// @param labels Labels of this series in Prometheus format, without braces.
+    /// @return Gauge.
+    metrics::Gauge &gauge(std::string_view name, std::string_view help, std::string_view labels = {});
+
+    /// @brief Gets or creates a latency histogram.
+    /// @param name Name of the metric.
+    /// @param help Description of the metric.
+    /// @param labels Labels of this series in Prometheus format, without braces.
+    /// @return Histogram.
+    metrics::Histogram &histogram(std::string_view name, std::string_view help, std::string_view labels = {});
+
+    /// @brief Gets or creates the metrics of an operation. These are registered as <subsystem>_operations_total,
+    /// <subsystem>_operation_bytes_total and <subsystem>_operation_duration_seconds, labeled with the operation.
+    /// @param subsystem Subsystem the operation belongs to. For example, drive or local.
+    /// @param name Name of the operation.
+    /// @return Operation.
+    metrics::Operation &operation(std::string_view subsystem, std::string_view name);
+
+    /// @brief Renders every metric in the Prometheus text format.
+    /// @return Text of the export.
+    std::string export_prometheus(void);
+
+    /// @brief Renders every metric in a shorter, human readable form. Histograms are shown as a count, a mean and a
+    /// 99th percentile estimate.
+    /// @return Text of the summary.
+    std::string export_summary(void);
+} // namespace metrics
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace scanner
+{
+    /// @brief A single entry read from a directory.
+    struct Entry
+    {
+            /// @brief Name of the entry.
+            std::string name;
+
+            /// @brief Whether the entry is a directory. Links report what they point to.
+            bool isDirectory = false;
+
+            /// @brief Whether the entry is a regular file. Links report what they point to.
+            bool isRegularFile = false;
+
+            /// @brief Whether the entry itself is a symbolic link. Links are never walked into.
+            bool isLink = false;
+
+            /// @brief Device the entry is on. Only filled in for regular files.
+            uint64_t device = 0;
+
+            /// @brief Inode of the entry. Only filled in for regular files.
+            uint64_t inode = 0;
+
+            /// @brief Size of the file. Only filled in for regular files.
+            uint64_t size = 0;
+
+            /// @brief Modification time in nanoseconds since the Unix epoch. Only filled in for regular files.
+            int64_t modifiedTime = 0;
+    };
+
+    /// @brief Every entry read from a single directory.
+    struct Directory
+    {
+            /// @brief Full path of the directory.
+            std::string path;
+
+            /// @brief Entries in the directory in the order the file system returned them.
+            std::vector<scanner::Entry> entries;
+    };
+
+    /// @brief Reads a single directory. Entries are read in bulk straight from the kernel and only regular files are
+    /// stat'd. The type of everything else comes from the directory itself.
+    /// @param path Path of the directory.
+    /// @param entriesOut Vector to append the entries to. . and .. are skipped.
+    /// @return True on success. False if the directory couldn't be opened or read.
+    bool scan_directory(std::string_view path, std::vector<scanner::Entry> &entriesOut);
+
+    /// @brief Reads a directory and every directory under it across a pool of threads. Links aren't followed.
+    /// @param root Path of the directory to start at.
+    /// @param directoriesOut Vector to append every directory read to, root included, in no particular order.
+    /// @param threads Number of threads to read with. 0 uses one per core.
+    /// @return True if every directory was read. False if any failed. Whatever could be read is still returned.
+    bool scan_tree(std::string_view root, std::vector<scanner::Directory> &directoriesOut, size_t threads = 0);
+} // namespace scanner
@@ -1,5 +1,7 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 namespace stringutil
 {
@@ -7,4 +9,15 @@ namespace stringutil
     /// @param target Target string to strip the character from.
     /// @param c Character to strip from the string.
     void strip_character(std::string &target, char c);
+
+    /// @brief Parses an RFC 3339 UTC timestamp like the ones Drive returns. Fractional seconds are optional.
+    /// @param timestamp Timestamp to parse.
+    /// @param millisecondsOut Milliseconds since the Unix epoch.
+    /// @return True on success. False if the timestamp isn't in UTC or is malformed.
+    bool parse_timestamp(std::string_view timestamp, int64_t &millisecondsOut);
+
+    /// @brief Formats milliseconds since the Unix epoch as an RFC 3339 UTC timestamp Drive accepts.
+    /// @param milliseconds Milliseconds since the Unix epoch.
+    /// @return Formatted timestamp.
+    std::string format_timestamp(int64_t milliseconds);
 } // namespace stringutil
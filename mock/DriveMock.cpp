@@ -0,0 +1,965 @@
+#include "DriveMock.hpp"
+#include "json.hpp"
+#include "md5.hpp"
+#include "stringutil.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+    /// @brief Paths of the OAUTH2 endpoints. They're under /oauth2 so the client's metrics still file them as oauth.
+    constexpr std::string_view PATH_OAUTH2_TOKEN = "/oauth2/token";
+    constexpr std::string_view PATH_OAUTH2_DEVICE_CODE = "/oauth2/device/code";
+
+    /// @brief Paths of the Drive endpoints. These are the same as Google's.
+    constexpr std::string_view PATH_DRIVE_ABOUT_API = "/drive/v2/about";
+    constexpr std::string_view PATH_DRIVE_FILE_API = "/drive/v3/files";
+    constexpr std::string_view PATH_DRIVE_CHANGES_TOKEN_API = "/drive/v3/changes/startPageToken";
+    constexpr std::string_view PATH_DRIVE_CHANGES_API = "/drive/v3/changes";
+    constexpr std::string_view PATH_DRIVE_BATCH_API = "/batch/drive/v3";
+    constexpr std::string_view PATH_DRIVE_UPLOAD_API = "/upload/drive/v3/files";
+
+    /// @brief Line ending used in headers and batch bodies.
+    constexpr std::string_view CRLF = "\r\n";
+
+    /// @brief Content-Type header of every JSON response.
+    constexpr std::string_view HEADER_CONTENT_TYPE_JSON = "Content-Type: application/json; charset=UTF-8\r\n";
+
+    /// @brief Boundary of batch responses. Bodies are JSON with escaped names, so this never shows up in them.
+    constexpr std::string_view BATCH_BOUNDARY = "batch_mock_boundary";
+
+    /// @brief Mime type of folders.
+    constexpr std::string_view MIME_TYPE_DIRECTORY = "application/vnd.google-apps.folder";
+
+    /// @brief Mime type of files uploaded without one.
+    constexpr std::string_view MIME_TYPE_DEFAULT = "application/octet-stream";
+
+    /// @brief Grant type of the device login polling loop.
+    constexpr std::string_view GRANT_TYPE_DEVICE_CODE = "urn:ietf:params:oauth:grant-type:device_code";
+
+    /// @brief Refresh token handed out when signing in. Every refresh token is accepted anyway.
+    constexpr std::string_view MOCK_REFRESH_TOKEN = "mock_refresh_token";
+
+    /// @brief Page size used when the request doesn't ask for one.
+    constexpr size_t DEFAULT_PAGE_SIZE = 100;
+
+    /// @brief Largest page Drive returns.
+    constexpr size_t MAX_PAGE_SIZE = 1000;
+
+    /// @brief Closes the ID in a files.list query that asks for the children of a folder.
+    constexpr std::string_view QUERY_IN_PARENTS = "' in parents";
+
+    /// @brief Writes a JSON response.
+    void write_json(HttpServer::Response &response, long code, std::string_view body)
+    {
+        response.code = code;
+        response.headers.append(HEADER_CONTENT_TYPE_JSON);
+        response.body.assign(body);
+    }
+
+    /// @brief Writes an error in the format Drive uses.
+    /// @param code Status code.
+    /// @param reason Reason of the error. For example, notFound. RateController looks for these.
+    /// @param message Message of the error.
+    void write_error(HttpServer::Response &response, long code, std::string_view reason, std::string_view message)
+    {
+        json::Object error = json::new_object(json_object_new_object);
+        json_object *details = json_object_new_object();
+        json_object_object_add(details, "domain", json_object_new_string("global"));
+        json_object_object_add(details, "reason", json_object_new_string_len(reason.data(), reason.length()));
+        json_object_object_add(details, "message", json_object_new_string_len(message.data(), message.length()));
+        json_object *errors = json_object_new_array();
+        json_object_array_add(errors, details);
+
+        json_object *body = json_object_new_object();
+        json_object_object_add(body, "code", json_object_new_int64(code));
+        json_object_object_add(body, "message", json_object_new_string_len(message.data(), message.length()));
+        json_object_object_add(body, "errors", errors);
+        json::add_object(error, "error", body);
+
+        write_json(response, code, json_object_to_json_string_ext(error.get(), JSON_C_TO_STRING_PLAIN));
+    }
+
+    /// @brief Writes the error Drive returns for IDs it doesn't know.
+    void write_not_found(HttpServer::Response &response, std::string_view id)
+    {
+        write_error(response, 404, "notFound", "File not found: " + std::string(id) + ".");
+    }
+
+    /// @brief Returns a string member of object. Empty if it isn't there.
+    std::string_view get_string(json_object *object, const char *key)
+    {
+        json_object *value = json_object_object_get(object, key);
+        return value ? json_object_get_string(value) : std::string_view{};
+    }
+
+    /// @brief Returns the first ID in the parents array of object. Empty if there isn't one.
+    std::string_view get_first_parent(json_object *object)
+    {
+        json_object *parents = json_object_object_get(object, "parents");
+        json_object *parent = parents ? json_object_array_get_idx(parents, 0) : nullptr;
+        return parent ? json_object_get_string(parent) : std::string_view{};
+    }
+
+    /// @brief Reads the page size parameter of a query.
+    size_t get_page_size(std::string_view query)
+    {
+        std::string pageSize = HttpServer::get_parameter(query, "pageSize");
+        size_t size = pageSize.empty() ? DEFAULT_PAGE_SIZE : std::strtoull(pageSize.c_str(), nullptr, 10);
+        return std::clamp<size_t>(size, 1, MAX_PAGE_SIZE);
+    }
+
+    /// @brief Returns the current time as an RFC 3339 timestamp.
+    std::string get_timestamp(void)
+    {
+        std::chrono::system_clock::duration now = std::chrono::system_clock::now().time_since_epoch();
+        return stringutil::format_timestamp(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+    }
+
+    /// @brief Finds the blank line that ends a block of headers.
+    /// @param data Data to search.
+    /// @param bodyOut Offset of the first byte after the blank line.
+    /// @return Offset of the blank line. npos if there isn't one.
+    size_t find_blank_line(std::string_view data, size_t &bodyOut)
+    {
+        size_t blankLine = data.find("\r\n\r\n");
+        bodyOut = blankLine + 4;
+        return blankLine;
+    }
+} // namespace
+
+DriveMock::DriveMock(const DriveMock::Options &options)
+    : m_options(options), m_random(options.seed), m_rateTokens(options.requestRate),
+      m_rateUpdated(std::chrono::steady_clock::now())
+{
+    m_rootId = DriveMock::new_id();
+    m_files[m_rootId] = {.name = "My Drive",
+                         .parent = {},
+                         .mimeType = std::string(MIME_TYPE_DIRECTORY),
+                         .modifiedTime = {},
+                         .content = {},
+                         .md5Checksum = {},
+                         .appProperties = {}};
+}
+
+void DriveMock::handle(const HttpServer::Request &request, HttpServer::Response &response)
+{
+    // Everything waiting out its latency counts as in flight, the same as it would against Google.
+    int inFlight = m_inFlight.fetch_add(1) + 1;
+    ++m_requestCount;
+    for (int peak = m_peakInFlight.load(); inFlight > peak && !m_peakInFlight.compare_exchange_weak(peak, inFlight);)
+    {
+    }
+
+    std::chrono::microseconds delay{0};
+    bool admitted = DriveMock::admit(response, delay);
+    if (admitted && m_options.maxConcurrency > 0 && inFlight > m_options.maxConcurrency)
+    {
+        write_error(response, 429, "rateLimitExceeded", "Rate Limit Exceeded");
+        ++m_overConcurrencyCount;
+        admitted = false;
+    }
+
+    std::this_thread::sleep_for(delay);
+    if (admitted)
+    {
+        std::string_view host = HttpServer::get_header(request, "host");
+        DriveMock::route(request, host.empty() ? "127.0.0.1" : host, response);
+    }
+    m_inFlight.fetch_sub(1);
+}
+
+const std::string &DriveMock::get_root_id(void) const
+{
+    return m_rootId;
+}
+
+DriveMock::Stats DriveMock::get_stats(void) const
+{
+    return {.requests = m_requestCount.load(),
+            .rateLimited = m_rateLimitedCount.load(),
+            .overConcurrency = m_overConcurrencyCount.load(),
+            .peakInFlight = m_peakInFlight.load()};
+}
+
+bool DriveMock::admit(HttpServer::Response &response, std::chrono::microseconds &delayOut)
+{
+    std::lock_guard<std::mutex> driveGuard(m_lock);
+
+    delayOut = m_options.latency;
+    if (m_options.jitter.count() > 0)
+    {
+        std::uniform_int_distribution<int64_t> jitter(0, m_options.jitter.count());
+        delayOut += std::chrono::microseconds(jitter(m_random));
+    }
+
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    if (m_options.dropRate > 0.0 && chance(m_random) < m_options.dropRate)
+    {
+        response.code = 0;
+        return false;
+    }
+
+    // Token bucket holding up to a second's worth of requests.
+    if (m_options.requestRate > 0.0)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = now - m_rateUpdated;
+        m_rateUpdated = now;
+        m_rateTokens = std::min(m_rateTokens + elapsed.count() * m_options.requestRate, m_options.requestRate);
+        if (m_rateTokens < 1.0)
+        {
+            write_error(response, 403, "userRateLimitExceeded", "User Rate Limit Exceeded");
+            ++m_rateLimitedCount;
+            return false;
+        }
+        m_rateTokens -= 1.0;
+    }
+
+    if (m_options.errorRate > 0.0 && chance(m_random) < m_options.errorRate)
+    {
+        write_error(response, 500, "backendError", "Backend Error");
+        return false;
+    }
+    return true;
+}
+
+void DriveMock::route(const HttpServer::Request &request, std::string_view host, HttpServer::Response &response)
+{
+    std::string_view path = request.path;
+    std::string_view method = request.method;
+
+    // Upload sessions are authorized by their ID alone.
+    if (path == PATH_OAUTH2_TOKEN && method == "POST")
+    {
+        DriveMock::handle_token(request, response);
+        return;
+    }
+    else if (path == PATH_OAUTH2_DEVICE_CODE)
+    {
+        DriveMock::handle_device_code(request, response);
+        return;
+    }
+    else if (path == PATH_DRIVE_UPLOAD_API && method == "PUT")
+    {
+        DriveMock::handle_upload_chunk(request, response);
+        return;
+    }
+    else if (!DriveMock::is_authorized(request))
+    {
+        write_error(response, 401, "authError", "Invalid Credentials");
+        return;
+    }
+
+    // Everything past a trailing slash is a file ID.
+    std::string_view id{};
+    if (path.starts_with(PATH_DRIVE_FILE_API) && path.length() > PATH_DRIVE_FILE_API.length() + 1 &&
+        path[PATH_DRIVE_FILE_API.length()] == '/')
+    {
+        id = path.substr(PATH_DRIVE_FILE_API.length() + 1);
+        path = PATH_DRIVE_FILE_API;
+    }
+    else if (path.starts_with(PATH_DRIVE_UPLOAD_API) && path.length() > PATH_DRIVE_UPLOAD_API.length() + 1 &&
+             path[PATH_DRIVE_UPLOAD_API.length()] == '/')
+    {
+        id = path.substr(PATH_DRIVE_UPLOAD_API.length() + 1);
+        path = PATH_DRIVE_UPLOAD_API;
+    }
+
+    if (path == PATH_DRIVE_ABOUT_API && method == "GET")
+    {
+        DriveMock::handle_about(response);
+    }
+    else if (path == PATH_DRIVE_FILE_API && id.empty() && method == "GET")
+    {
+        DriveMock::handle_list(request, response);
+    }
+    else if (path == PATH_DRIVE_FILE_API && id.empty() && method == "POST")
+    {
+        DriveMock::handle_create(request, response);
+    }
+    else if (path == PATH_DRIVE_FILE_API && method == "GET")
+    {
+        DriveMock::handle_get(request, id, response);
+    }
+    else if (path == PATH_DRIVE_FILE_API && method == "PATCH")
+    {
+        DriveMock::handle_update(request, id, response);
+    }
+    else if (path == PATH_DRIVE_FILE_API && method == "DELETE")
+    {
+        DriveMock::handle_delete(id, response);
+    }
+    else if (path == PATH_DRIVE_UPLOAD_API && (method == "POST" || (method == "PATCH" && !id.empty())))
+    {
+        DriveMock::handle_upload_start(request, id, host, response);
+    }
+    else if (path == PATH_DRIVE_BATCH_API && method == "POST")
+    {
+        DriveMock::handle_batch(request, host, response);
+    }
+    else if (path == PATH_DRIVE_CHANGES_TOKEN_API && method == "GET")
+    {
+        DriveMock::handle_changes_token(response);
+    }
+    else if (path == PATH_DRIVE_CHANGES_API && method == "GET")
+    {
+        DriveMock::handle_changes(request, response);
+    }
+    else
+    {
+        write_error(response, 404, "notFound", "Not Found");
+    }
+}
+
+void DriveMock::handle_token(const HttpServer::Request &request, HttpServer::Response &response)
+{
+    // Google takes both JSON and form bodies.
+    json::Object body = json::new_object(json_tokener_parse, request.body.c_str());
+    std::string grantType = body ? std::string(get_string(body.get(), "grant_type"))
+                                 : HttpServer::get_parameter(request.body, "grant_type");
+    std::string clientId = body ? std::string(get_string(body.get(), "client_id"))
+                                : HttpServer::get_parameter(request.body, "client_id");
+    bool isDeviceGrant = grantType == GRANT_TYPE_DEVICE_CODE;
+    if (clientId.empty() || (grantType != "refresh_token" && !isDeviceGrant))
+    {
+        write_json(response, 400, R"({"error":"invalid_request","error_description":"Missing client_id or grant."})");
+        return;
+    }
+
+    std::string token{};
+    {
+        std::lock_guard<std::mutex> driveGuard(m_lock);
+        token = "mock_access_" + DriveMock::new_id();
+        m_tokens[token] = std::chrono::steady_clock::now() + std::chrono::seconds(m_options.tokenLifetime);
+    }
+
+    json::Object tokenJson = json::new_object(json_object_new_object);
+    json::add_object(tokenJson, "access_token", json_object_new_string(token.c_str()));
+    json::add_object(tokenJson, "expires_in", json_object_new_int64(m_options.tokenLifetime));
+    json::add_object(tokenJson, "token_type", json_object_new_string("Bearer"));
+    json::add_object(tokenJson, "scope", json_object_new_string("https://www.googleapis.com/auth/drive.file"));
+    if (isDeviceGrant)
+    {
+        json::add_object(tokenJson, "refresh_token", json_object_new_string(MOCK_REFRESH_TOKEN.data()));
+    }
+    write_json(response, 200, json_object_to_json_string_ext(tokenJson.get(), JSON_C_TO_STRING_PLAIN));
+}
+
+void DriveMock::handle_device_code(const HttpServer::Request &request, HttpServer::Response &response)
+{
+    std::string verificationUrl = "http://" + std::string(HttpServer::get_header(request, "host")) + "/device";
+
+    json::Object codeJson = json::new_object(json_object_new_object);
+    json::add_object(codeJson, "device_code", json_object_new_string("mock_device_code"));
+    json::add_object(codeJson, "user_code", json_object_new_string("MOCK-CODE"));
+    json::add_object(codeJson, "verification_url", json_object_new_string(verificationUrl.c_str()));
+    json::add_object(codeJson, "expires_in", json_object_new_int64(1800));
+    json::add_object(codeJson, "interval", json_object_new_int64(1));
+    write_json(response, 200, json_object_to_json_string_ext(codeJson.get(), JSON_C_TO_STRING_PLAIN));
+}
+
+void DriveMock::handle_about(HttpServer::Response &response)
+{
+    write_json(response, 200, R"({"kind":"drive#about","rootFolderId":")" + m_rootId + "\"}");
+}
+
+void DriveMock::handle_list(const HttpServer::Request &request, HttpServer::Response &response)
+{
+    // The only queries GoogleDrive sends are everything and the children of a folder. Nothing is ever trashed here.
+    std::string query = HttpServer::get_parameter(request.query, "q");
+    std::string parent{};
+    size_t parentEnd = query.find(QUERY_IN_PARENTS);
+    size_t parentBegin = parentEnd == query.npos ? query.npos : query.rfind('\'', parentEnd - 1);
+    if (parentBegin != query.npos)
+    {
+        parent = query.substr(parentBegin + 1, parentEnd - parentBegin - 1);
+        if (parent == "root")
+        {
+            parent = m_rootId;
+        }
+    }
+
+    size_t pageSize = get_page_size(request.query);
+    size_t offset = std::strtoull(HttpServer::get_parameter(request.query, "pageToken").c_str(), nullptr, 10);
+
+    std::lock_guard<std::mutex> driveGuard(m_lock);
+    if (!parent.empty() && !m_files.contains(parent))
+    {
+        write_not_found(response, parent);
+        return;
+    }
+
+    // Pages are offsets into the listing sorted by name, so they're stable as long as nothing changes in between.
+    std::vector<std::pair<std::string_view, const std::string *>> matches{};
+    for (const auto &[id, file] : m_files)
+    {
+        if (id != m_rootId && (parent.empty() || file.parent == parent))
+        {
+            matches.emplace_back(file.name, &id);
+        }
+    }
+    std::sort(matches.begin(), matches.end(), [](const auto &a, const auto &b) {
+        return a.first != b.first ? a.first < b.first : *a.second < *b.second;
+    });
+
+    size_t end = std::min(offset + pageSize, matches.size());
+    std::string body = R"({"kind":"drive#fileList","files":[)";
+    for (size_t i = offset; i < end; i++)
+    {
+        const std::string &id = *matches[i].second;
+        body.append(i == offset ? "" : ",").append(DriveMock::render_file(id, m_files.at(id)));
+    }
+    body.append("]");
+    if (end < matches.size())
+    {
+        body.append(R"(,"nextPageToken":")").append(std::to_string(end)).append("\"");
+    }
+    body.append("}");
+    write_json(response, 200, body);
+}
+
+void DriveMock::handle_create(const HttpServer::Request &request, HttpServer::Response &response)
+{
+    json::Object body = json::new_object(json_tokener_parse, request.body.c_str());
+    if (!body || get_string(body.get(), "name").empty())
+    {
+        write_error(response, 400, "required", "Required parameter: name");
+        return;
+    }
+
+    std::string_view mimeType = get_string(body.get(), "mimeType");
+    std::string_view modifiedTime = get_string(body.get(), "modifiedTime");
+    std::string_view parent = get_first_parent(body.get());
+
+    std::lock_guard<std::mutex> driveGuard(m_lock);
+    DriveMock::File file = {.name = std::string(get_string(body.get(), "name")),
+                            .parent = parent.empty() ? m_rootId : std::string(parent),
+                            .mimeType = std::string(mimeType.empty() ? MIME_TYPE_DEFAULT : mimeType),
+                            .modifiedTime = modifiedTime.empty() ? get_timestamp() : std::string(modifiedTime),
+                            .content = {},
+                            .md5Checksum = {},
+                            .appProperties = {}};
+    if (!m_files.contains(file.parent))
+    {
+        write_not_found(response, file.parent);
+        return;
+    }
+    if (file.mimeType != MIME_TYPE_DIRECTORY)
+    {
+        md5::Context context{};
+        file.md5Checksum = md5::to_hex(context.finish());
+    }
+
+    std::string id = DriveMock::new_id();
+    DriveMock::File &created = m_files[id] = std::move(file);
+    DriveMock::record_change(id);
+    write_json(response, 200, DriveMock::render_file(id, created));
+}
+
+void DriveMock::handle_get(const HttpServer::Request &request, std::string_view id, HttpServer::Response &response)
+{
+    std::lock_guard<std::mutex> driveGuard(m_lock);
+    auto findFile = m_files.find(std::string(id));
+    if (findFile == m_files.end())
+    {
+        write_not_found(response, id);
+        return;
+    }
+    const DriveMock::File &file = findFile->second;
+
+    if (HttpServer::get_parameter(request.query, "alt") != "media")
+    {
+        write_json(response, 200, DriveMock::render_file(findFile->first, file));
+        return;
+    }
+    else if (file.mimeType == MIME_TYPE_DIRECTORY)
+    {
+        write_error(response, 403, "fileNotDownloadable", "Only files with binary content can be downloaded.");
+        return;
+    }
+
+    // Only the single range curl sends is supported.
+    std::string_view range = HttpServer::get_header(request, "range");
+    uint64_t begin = 0;
+    uint64_t last = UINT64_MAX;
+    if (!range.empty() &&
+        std::sscanf(std::string(range).c_str(), "bytes=%" SCNu64 "-%" SCNu64, &begin, &last) < 1)
+    {
+        write_error(response, 400, "badRange", "Invalid range.");
+        return;
+    }
+
+    response.headers.append("Content-Type: ").append(MIME_TYPE_DEFAULT).append(CRLF);
+    if (range.empty() || m_options.ignoreRanges)
+    {
+        response.code = 200;
+        response.body = file.content;
+        return;
+    }
+    else if (begin >= file.content.length())
+    {
+        response.code = 416;
+        response.headers.append("Content-Range: bytes */").append(std::to_string(file.content.length())).append(CRLF);
+        return;
+    }
+
+    last = std::min<uint64_t>(last, file.content.length() - 1);
+    response.code = 206;
+    response.headers.append("Content-Range: bytes ")
+        .append(std::to_string(begin))
+        .append("-")
+        .append(std::to_string(last))
+        .append("/")
+        .append(std::to_string(file.content.length()))
+        .append(CRLF);
+    response.body = file.content.substr(begin, last - begin + 1);
+}
+
+void DriveMock::handle_update(const HttpServer::Request &request, std::string_view id, HttpServer::Response &response)
+{
+    json::Object body = json::new_object(json_tokener_parse, request.body.empty() ? "{}" : request.body.c_str());
+    if (!body)
+    {
+        write_error(response, 400, "parseError", "Parse Error");
+        return;
+    }
+    std::string addParents = HttpServer::get_parameter(request.query, "addParents");
+
+    std::lock_guard<std::mutex> driveGuard(m_lock);
+    auto findFile = m_files.find(std::string(id));
+    if (findFile == m_files.end() || findFile->first == m_rootId)
+    {
+        write_not_found(response, id);
+        return;
+    }
+    else if (!addParents.empty() && !m_files.contains(addParents))
+    {
+        write_not_found(response, addParents);
+        return;
+    }
+
+    DriveMock::File &file = findFile->second;
+    std::string_view name = get_string(body.get(), "name");
+    std::string_view modifiedTime = get_string(body.get(), "modifiedTime");
+    if (!name.empty())
+    {
+        file.name = name;
+    }
+    if (!modifiedTime.empty())
+    {
+        file.modifiedTime = modifiedTime;
+    }
+    if (!addParents.empty())
+    {
+        file.parent = addParents;
+    }
+
+    DriveMock::record_change(findFile->first);
+    write_json(response, 200, DriveMock::render_file(findFile->first, file));
+}
+
+void DriveMock::handle_delete(std::string_view id, HttpServer::Response &response)
+{
+    std::lock_guard<std::mutex> driveGuard(m_lock);
+    std::string fileId{id};
+    if (!m_files.contains(fileId) || fileId == m_rootId)
+    {
+        write_not_found(response, id);
+        return;
+    }
+
+    DriveMock::remove_subtree(fileId);
+    response.code = 204;
+}
+
+void DriveMock::handle_upload_start(const HttpServer::Request &request,
+                                    std::string_view replaceId,
+                                    std::string_view host,
+                                    HttpServer::Response &response)
+{
+    if (HttpServer::get_parameter(request.query, "uploadType") != "resumable")
+    {
+        write_error(response, 400, "invalid", "Only resumable uploads are supported.");
+        return;
+    }
+
+    json::Object body = json::new_object(json_tokener_parse, request.body.empty() ? "{}" : request.body.c_str());
+    if (!body || (replaceId.empty() && get_string(body.get(), "name").empty()))
+    {
+        write_error(response, 400, "required", "Required parameter: name");
+        return;
+    }
+
+    DriveMock::UploadSession session = {.replaceId = std::string(replaceId), .metadata = {}, .clearedProperties = {}};
+    session.metadata.name = get_string(body.get(), "name");
+    session.metadata.parent = get_first_parent(body.get());
+    session.metadata.mimeType = get_string(body.get(), "mimeType");
+    session.metadata.modifiedTime = get_string(body.get(), "modifiedTime");
+
+    // Properties set to null are removed from the file.
+    json_object *appProperties = json_object_object_get(body.get(), "appProperties");
+    if (appProperties && json_object_is_type(appProperties, json_type_object))
+    {
+        json_object_object_foreach(appProperties, key, value)
+        {
+            if (value)
+            {
+                session.metadata.appProperties[key] = json_object_get_string(value);
+                continue;
+            }
+            session.clearedProperties.emplace_back(key);
+        }
+    }
+
+    std::lock_guard<std::mutex> driveGuard(m_lock);
+    if (!replaceId.empty() && !m_files.contains(session.replaceId))
+    {
+        write_not_found(response, replaceId);
+        return;
+    }
+    else if (replaceId.empty() && session.metadata.parent.empty())
+    {
+        session.metadata.parent = m_rootId;
+    }
+
+    if (!session.metadata.parent.empty() && !m_files.contains(session.metadata.parent))
+    {
+        write_not_found(response, session.metadata.parent);
+        return;
+    }
+
+    std::string uploadId = DriveMock::new_id();
+    m_sessions.emplace(uploadId, std::move(session));
+
+    response.code = 200;
+    response.headers.append("Location: http://")
+        .append(host)
+        .append(PATH_DRIVE_UPLOAD_API)
+        .append("?uploadType=resumable&upload_id=")
+        .append(uploadId)
+        .append(CRLF);
+}
+
+void DriveMock::handle_upload_chunk(const HttpServer::Request &request, HttpServer::Response &response)
+{
+    // Content-Range is either bytes first-last/total or bytes */total for a status query. The total is * until the
+    // client knows it.
+    std::string contentRange{HttpServer::get_header(request, "content-range")};
+    uint64_t first = 0;
+    uint64_t last = 0;
+    uint64_t total = UINT64_MAX;
+    bool hasData = std::sscanf(contentRange.c_str(), "bytes %" SCNu64 "-%" SCNu64, &first, &last) == 2;
+    size_t totalBegin = contentRange.find('/');
+    if (totalBegin != contentRange.npos && contentRange.compare(totalBegin + 1, 1, "*") != 0)
+    {
+        total = std::strtoull(contentRange.c_str() + totalBegin + 1, nullptr, 10);
+    }
+
+    bool lengthMismatch = hasData && (last < first || last - first + 1 != request.body.length());
+    if (!contentRange.empty() && (totalBegin == contentRange.npos || lengthMismatch))
+    {
+        write_error(response, 400, "badContent", "Content-Range doesn't match the body.");
+        return;
+    }
+
+    std::lock_guard<std::mutex> driveGuard(m_lock);
+    std::string uploadId = HttpServer::get_parameter(request.query, "upload_id");
+    auto findSession = m_sessions.find(uploadId);
+    if (findSession == m_sessions.end())
+    {
+        write_error(response, 404, "notFound", "Upload session not found.");
+        return;
+    }
+    DriveMock::UploadSession &session = findSession->second;
+    std::string &content = session.metadata.content;
+
+    // Chunks that overlap what's already committed are fine. Chunks past it leave a gap and commit nothing.
+    if (hasData && first <= content.length() && last >= content.length())
+    {
+        content.append(request.body, content.length() - first);
+    }
+
+    if (total != UINT64_MAX && content.length() > total)
+    {
+        write_error(response, 400, "badContent", "Upload is larger than its total size.");
+        return;
+    }
+    else if (total == UINT64_MAX || content.length() < total)
+    {
+        response.code = 308;
+        if (!content.empty())
+        {
+            response.headers.append("Range: bytes=0-").append(std::to_string(content.length() - 1)).append(CRLF);
+        }
+        return;
+    }
+
+    // That's everything. The file is created or replaced in one step like Drive does.
+    std::string fileId = session.replaceId.empty() ? DriveMock::new_id() : session.replaceId;
+    DriveMock::File &file = m_files[fileId];
+    file.name = session.metadata.name.empty() ? file.name : session.metadata.name;
+    file.parent = session.metadata.parent.empty() ? file.parent : session.metadata.parent;
+    file.mimeType = session.metadata.mimeType.empty() ? std::string(MIME_TYPE_DEFAULT) : session.metadata.mimeType;
+    file.modifiedTime = session.metadata.modifiedTime.empty() ? get_timestamp() : session.metadata.modifiedTime;
+    file.content = std::move(content);
+    for (auto &[key, value] : session.metadata.appProperties)
+    {
+        file.appProperties[key] = std::move(value);
+    }
+    for (const std::string &key : session.clearedProperties)
+    {
+        file.appProperties.erase(key);
+    }
+
+    md5::Context context{};
+    context.update(file.content.data(), file.content.length());
+    file.md5Checksum = md5::to_hex(context.finish());
+
+    m_sessions.erase(findSession);
+    DriveMock::record_change(fileId);
+    write_json(response, 200, DriveMock::render_file(fileId, file));
+}
+
+void DriveMock::handle_batch(const HttpServer::Request &request, std::string_view host, HttpServer::Response &response)
+{
+    std::string_view contentType = HttpServer::get_header(request, "content-type");
+    size_t boundaryBegin = contentType.find("boundary=");
+    if (boundaryBegin == contentType.npos)
+    {
+        write_error(response, 400, "badContent", "Batch requests need to be multipart/mixed.");
+        return;
+    }
+    std::string delimiter = "--" + std::string(contentType.substr(boundaryBegin + 9));
+
+    // Every part is a request of its own. They're answered in order and tagged with the Content-ID they came with.
+    std::string body{};
+    std::string_view batch = request.body;
+    size_t partBegin = batch.find(delimiter);
+    while (partBegin != batch.npos)
+    {
+        partBegin += delimiter.length();
+        if (batch.substr(partBegin, 2) == "--")
+        {
+            break;
+        }
+        size_t partEnd = batch.find(delimiter, partBegin);
+        std::string_view part = batch.substr(partBegin, partEnd - partBegin);
+        partBegin = partEnd;
+
+        size_t httpBegin = 0;
+        size_t outerEnd = find_blank_line(part, httpBegin);
+        if (outerEnd == part.npos)
+        {
+            continue;
+        }
+        std::string_view outer = part.substr(0, outerEnd);
+        std::string_view contentId{};
+        size_t idBegin = outer.find("<item");
+        if (idBegin != outer.npos)
+        {
+            contentId = outer.substr(idBegin + 5, outer.find('>', idBegin) - idBegin - 5);
+        }
+
+        // Request line, headers, then the body.
+        std::string_view http = part.substr(httpBegin);
+        size_t lineEnd = http.find(CRLF);
+        std::string_view line = http.substr(0, lineEnd);
+        size_t methodEnd = line.find(' ');
+        size_t targetEnd = line.rfind(' ');
+        if (methodEnd == line.npos || targetEnd <= methodEnd)
+        {
+            continue;
+        }
+        std::string_view target = line.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+        size_t queryBegin = target.find('?');
+
+        // The batch's own authorization carries over to every part.
+        HttpServer::Request inner = {.method = std::string(line.substr(0, methodEnd)),
+                                     .path = std::string(target.substr(0, queryBegin)),
+                                     .query = std::string(queryBegin == target.npos ? std::string_view{}
+                                                                                    : target.substr(queryBegin + 1)),
+                                     .headers = request.headers,
+                                     .body = {}};
+        size_t innerBodyBegin = 0;
+        if (find_blank_line(http, innerBodyBegin) != http.npos)
+        {
+            std::string_view innerBody = http.substr(innerBodyBegin);
+            while (!innerBody.empty() && (innerBody.back() == '\r' || innerBody.back() == '\n'))
+            {
+                innerBody.remove_suffix(1);
+            }
+            inner.body = innerBody;
+        }
+
+        HttpServer::Response innerResponse{};
+        DriveMock::route(inner, host, innerResponse);
+
+        body.append("--").append(BATCH_BOUNDARY).append(CRLF);
+        body.append("Content-Type: application/http").append(CRLF);
+        body.append("Content-ID: <response-item").append(contentId).append(">").append(CRLF).append(CRLF);
+        body.append("HTTP/1.1 ").append(std::to_string(innerResponse.code)).append(CRLF);
+        body.append(innerResponse.headers).append(CRLF);
+        body.append(innerResponse.body).append(CRLF);
+    }
+    body.append("--").append(BATCH_BOUNDARY).append("--").append(CRLF);
+
+    response.code = 200;
+    response.headers.append("Content-Type: multipart/mixed; boundary=").append(BATCH_BOUNDARY).append(CRLF);
+    response.body = std::move(body);
+}
+
+void DriveMock::handle_changes_token(HttpServer::Response &response)
+{
+    std::lock_guard<std::mutex> driveGuard(m_lock);
+    write_json(response, 200, R"({"kind":"drive#startPageToken","startPageToken":")" +
+                                  std::to_string(m_changes.size()) + "\"}");
+}
+
+void DriveMock::handle_changes(const HttpServer::Request &request, HttpServer::Response &response)
+{
+    std::string pageToken = HttpServer::get_parameter(request.query, "pageToken");
+    if (pageToken.empty())
+    {
+        write_error(response, 400, "required", "Required parameter: pageToken");
+        return;
+    }
+    size_t pageSize = get_page_size(request.query);
+
+    std::lock_guard<std::mutex> driveGuard(m_lock);
+    size_t offset = std::min<size_t>(std::strtoull(pageToken.c_str(), nullptr, 10), m_changes.size());
+    size_t end = std::min(offset + pageSize, m_changes.size());
+
+    // Changes only say what a file looks like now, the same as Drive.
+    std::string body = R"({"kind":"drive#changeList","changes":[)";
+    for (size_t i = offset; i < end; i++)
+    {
+        const std::string &id = m_changes[i];
+        auto findFile = m_files.find(id);
+        body.append(i == offset ? "" : ",").append(R"({"fileId":")").append(id).append("\",");
+        if (findFile == m_files.end())
+        {
+            body.append(R"("removed":true})");
+            continue;
+        }
+        body.append(R"("removed":false,"file":)").append(DriveMock::render_file(id, findFile->second, true));
+        body.append("}");
+    }
+    body.append("],");
+
+    if (end < m_changes.size())
+    {
+        body.append(R"("nextPageToken":")").append(std::to_string(end)).append("\"}");
+    }
+    else
+    {
+        body.append(R"("newStartPageToken":")").append(std::to_string(end)).append("\"}");
+    }
+    write_json(response, 200, body);
+}
+
+bool DriveMock::is_authorized(const HttpServer::Request &request)
+{
+    std::string_view authorization = HttpServer::get_header(request, "authorization");
+    if (!authorization.starts_with("Bearer "))
+    {
+        return false;
+    }
+    std::string token{authorization.substr(7)};
+
+    std::lock_guard<std::mutex> driveGuard(m_lock);
+    auto findToken = m_tokens.find(token);
+    if (findToken == m_tokens.end())
+    {
+        return false;
+    }
+    else if (findToken->second < std::chrono::steady_clock::now())
+    {
+        m_tokens.erase(findToken);
+        return false;
+    }
+    return true;
+}
+
+std::string DriveMock::new_id(void)
+{
+    // Same length as Drive's IDs so anything sized around them still fits.
+    char id[34] = {0};
+    std::snprintf(id, sizeof(id), "mock%029" PRIx64, m_nextId++);
+    return id;
+}
+
+std::string DriveMock::render_file(const std::string &id, const DriveMock::File &file, bool trashed) const
+{
+    json::Object fileJson = json::new_object(json_object_new_object);
+    json::add_object(fileJson, "kind", json_object_new_string("drive#file"));
+    json::add_object(fileJson, "id", json_object_new_string(id.c_str()));
+    json::add_object(fileJson, "name", json_object_new_string(file.name.c_str()));
+    json::add_object(fileJson, "mimeType", json_object_new_string(file.mimeType.c_str()));
+    if (!file.parent.empty())
+    {
+        json_object *parents = json_object_new_array();
+        json_object_array_add(parents, json_object_new_string(file.parent.c_str()));
+        json::add_object(fileJson, "parents", parents);
+    }
+    json::add_object(fileJson, "modifiedTime", json_object_new_string(file.modifiedTime.c_str()));
+
+    // Drive sends sizes as strings and leaves them and the checksum off of folders.
+    if (file.mimeType != MIME_TYPE_DIRECTORY)
+    {
+        json::add_object(fileJson, "size", json_object_new_string(std::to_string(file.content.length()).c_str()));
+        json::add_object(fileJson, "md5Checksum", json_object_new_string(file.md5Checksum.c_str()));
+    }
+
+    if (!file.appProperties.empty())
+    {
+        json_object *appProperties = json_object_new_object();
+        for (const auto &[key, value] : file.appProperties)
+        {
+            json_object_object_add(appProperties, key.c_str(), json_object_new_string(value.c_str()));
+        }
+        json::add_object(fileJson, "appProperties", appProperties);
+    }
+
+    if (trashed)
+    {
+        json::add_object(fileJson, "trashed", json_object_new_boolean(false));
+    }
+    return json_object_to_json_string_ext(fileJson.get(), JSON_C_TO_STRING_PLAIN);
+}
+
+void DriveMock::remove_subtree(const std::string &id)
+{
+    // Children are found by scanning once and following the parent links from there.
+    std::unordered_map<std::string_view, std::vector<std::string_view>> children{};
+    if (m_files.at(id).mimeType == MIME_TYPE_DIRECTORY)
+    {
+        for (const auto &[childId, file] : m_files)
+        {
+            children[file.parent].push_back(childId);
+        }
+    }
+
+    std::vector<std::string> removed{id};
+    for (size_t i = 0; i < removed.size(); i++)
+    {
+        auto findChildren = children.find(removed[i]);
+        if (findChildren != children.end())
+        {
+            removed.insert(removed.end(), findChildren->second.begin(), findChildren->second.end());
+        }
+    }
+
+    for (const std::string &removedId : removed)
+    {
+        m_files.erase(removedId);
+        DriveMock::record_change(removedId);
+    }
+}
+
+void DriveMock::record_change(const std::string &id)
+{
+    m_changes.push_back(id);
+}
@@ -0,0 +1,243 @@
+#pragma once
+#include "HttpServer.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/// @brief In-memory stand-in for the parts of Google Drive and its OAUTH2 endpoints GoogleDrive uses. Every file lives
+/// in memory and is gone when the process exits.
+/// @note This emulates Drive closely enough for GoogleDrive to run against it. It doesn't check scopes, quotas or
+/// anything else GoogleDrive never runs into.
+class DriveMock
+{
+    public:
+        /// @brief How the stand-in behaves.
+        struct Options
+        {
+                /// @brief Delay added before every response.
+                std::chrono::microseconds latency{0};
+
+                /// @brief Random delay of up to this much added on top of latency.
+                std::chrono::microseconds jitter{0};
+
+                /// @brief Fraction of requests answered with a 500 instead of being handled.
+                double errorRate = 0.0;
+
+                /// @brief Fraction of requests whose connection is closed without any response.
+                double dropRate = 0.0;
+
+                /// @brief Requests per second allowed before answering with userRateLimitExceeded. 0 doesn't limit.
+                double requestRate = 0.0;
+
+                /// @brief Requests allowed in flight at once before answering with 429. 0 doesn't limit.
+                int maxConcurrency = 0;
+
+                /// @brief Seconds access tokens are good for.
+                int64_t tokenLifetime = 3600;
+
+                /// @brief Whether range requests are answered with the whole file, like servers that don't support
+                /// them.
+                bool ignoreRanges = false;
+
+                /// @brief Seed for the error and jitter generator so runs can be repeated.
+                uint64_t seed = 0;
+        };
+
+        /// @brief What the throttles did since the stand-in started.
+        struct Stats
+        {
+                /// @brief Requests received. The parts of a batch aren't counted on their own.
+                uint64_t requests = 0;
+
+                /// @brief Requests answered with userRateLimitExceeded for going over requestRate.
+                uint64_t rateLimited = 0;
+
+                /// @brief Requests answered with 429 for going over maxConcurrency.
+                uint64_t overConcurrency = 0;
+
+                /// @brief Most requests in flight at once.
+                int peakInFlight = 0;
+        };
+
+        /// @brief Creates an empty Drive with only a root folder.
+        /// @param options Behavior of the stand-in.
+        DriveMock(const DriveMock::Options &options);
+
+        /// @brief Handles a request. This is passed to HttpServer and can be called from several threads at once.
+        /// @param request Request to handle.
+        /// @param response Response to write to.
+        void handle(const HttpServer::Request &request, HttpServer::Response &response);
+
+        /// @brief Returns the ID of the root folder.
+        const std::string &get_root_id(void) const;
+
+        /// @brief Returns what the throttles did so far.
+        DriveMock::Stats get_stats(void) const;
+
+    private:
+        /// @brief File or folder.
+        struct File
+        {
+                /// @brief Name of the file.
+                std::string name;
+
+                /// @brief ID of the parent folder.
+                std::string parent;
+
+                /// @brief Mime type. Folders have Drive's folder type.
+                std::string mimeType;
+
+                /// @brief Modification time as an RFC 3339 timestamp.
+                std::string modifiedTime;
+
+                /// @brief Contents of the file.
+                std::string content;
+
+                /// @brief Hex MD5 of content.
+                std::string md5Checksum;
+
+                /// @brief Private properties of the file.
+                std::map<std::string, std::string> appProperties;
+        };
+
+        /// @brief Resumable upload that hasn't finished yet.
+        struct UploadSession
+        {
+                /// @brief ID of the file being replaced. Empty for new files.
+                std::string replaceId;
+
+                /// @brief Metadata the session was started with. Content is appended to this as chunks arrive.
+                DriveMock::File metadata;
+
+                /// @brief Properties the session clears by setting them to null.
+                std::vector<std::string> clearedProperties;
+        };
+
+        /// @brief Behavior of the stand-in.
+        DriveMock::Options m_options;
+
+        /// @brief ID of the root folder.
+        std::string m_rootId;
+
+        /// @brief Lock for everything below.
+        std::mutex m_lock;
+
+        /// @brief ID -> file.
+        std::unordered_map<std::string, DriveMock::File> m_files;
+
+        /// @brief Upload ID -> session.
+        std::unordered_map<std::string, DriveMock::UploadSession> m_sessions;
+
+        /// @brief IDs of every file changed, in order. Change page tokens are offsets into this.
+        std::vector<std::string> m_changes;
+
+        /// @brief Access tokens handed out -> time they expire at.
+        std::unordered_map<std::string, std::chrono::steady_clock::time_point> m_tokens;
+
+        /// @brief Counter IDs are generated from.
+        uint64_t m_nextId = 0;
+
+        /// @brief Generator for errors and jitter.
+        std::mt19937_64 m_random;
+
+        /// @brief Requests allowed right now under requestRate.
+        double m_rateTokens = 0.0;
+
+        /// @brief Last time m_rateTokens was topped up.
+        std::chrono::steady_clock::time_point m_rateUpdated;
+
+        /// @brief Requests being handled right now.
+        std::atomic<int> m_inFlight = 0;
+
+        /// @brief Most requests handled at once.
+        std::atomic<int> m_peakInFlight = 0;
+
+        /// @brief Requests received.
+        std::atomic<uint64_t> m_requestCount = 0;
+
+        /// @brief Requests turned away for going over requestRate.
+        std::atomic<uint64_t> m_rateLimitedCount = 0;
+
+        /// @brief Requests turned away for going over maxConcurrency.
+        std::atomic<uint64_t> m_overConcurrencyCount = 0;
+
+        /// @brief Decides whether a request gets through the throttles and error injection.
+        /// @param response Response to write the error to if it doesn't.
+        /// @param delayOut Delay to wait before responding either way.
+        /// @return True if the request should be handled.
+        bool admit(HttpServer::Response &response, std::chrono::microseconds &delayOut);
+
+        /// @brief Sends request to whatever handles its path. Batches come back through here for every part.
+        /// @param request Request to route.
+        /// @param host Host the client connected to. Upload locations point back at it.
+        /// @param response Response to write to.
+        void route(const HttpServer::Request &request, std::string_view host, HttpServer::Response &response);
+
+        /// @brief Handles the OAUTH2 token endpoint. Refresh tokens and device codes are both accepted as is.
+        void handle_token(const HttpServer::Request &request, HttpServer::Response &response);
+
+        /// @brief Handles the OAUTH2 device code endpoint. The code is approved immediately.
+        void handle_device_code(const HttpServer::Request &request, HttpServer::Response &response);
+
+        /// @brief Handles the about endpoint.
+        void handle_about(HttpServer::Response &response);
+
+        /// @brief Handles files.list.
+        void handle_list(const HttpServer::Request &request, HttpServer::Response &response);
+
+        /// @brief Handles files.create for anything that isn't an upload.
+        void handle_create(const HttpServer::Request &request, HttpServer::Response &response);
+
+        /// @brief Handles files.get, both metadata and alt=media.
+        void handle_get(const HttpServer::Request &request, std::string_view id, HttpServer::Response &response);
+
+        /// @brief Handles files.update for metadata. This covers renames and moves.
+        void handle_update(const HttpServer::Request &request, std::string_view id, HttpServer::Response &response);
+
+        /// @brief Handles files.delete. Folders take everything in them along.
+        void handle_delete(std::string_view id, HttpServer::Response &response);
+
+        /// @brief Starts a resumable upload session.
+        /// @param replaceId ID of the file being replaced. Empty for new files.
+        void handle_upload_start(const HttpServer::Request &request,
+                                 std::string_view replaceId,
+                                 std::string_view host,
+                                 HttpServer::Response &response);
+
+        /// @brief Handles a chunk or status query sent to an upload session.
+        void handle_upload_chunk(const HttpServer::Request &request, HttpServer::Response &response);
+
+        /// @brief Handles a batch by routing every part and stitching the responses back together.
+        void handle_batch(const HttpServer::Request &request, std::string_view host, HttpServer::Response &response);
+
+        /// @brief Handles changes.getStartPageToken.
+        void handle_changes_token(HttpServer::Response &response);
+
+        /// @brief Handles changes.list.
+        void handle_changes(const HttpServer::Request &request, HttpServer::Response &response);
+
+        /// @brief Returns whether the request carries an access token that was handed out and hasn't expired.
+        bool is_authorized(const HttpServer::Request &request);
+
+        /// @brief Returns a new, unique, Drive-like ID. m_lock must be held.
+        std::string new_id(void);
+
+        /// @brief Renders a file resource with every field GoogleDrive asks for. m_lock must be held.
+        /// @param id ID of the file.
+        /// @param file File to render.
+        /// @param trashed Whether to include the trashed field like the changes feed does.
+        std::string render_file(const std::string &id, const DriveMock::File &file, bool trashed = false) const;
+
+        /// @brief Removes a file and everything in it, recording a change for each. m_lock must be held.
+        void remove_subtree(const std::string &id);
+
+        /// @brief Records a change to a file. m_lock must be held.
+        void record_change(const std::string &id);
+};
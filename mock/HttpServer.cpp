@@ -0,0 +1,461 @@
+#include "HttpServer.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+    /// @brief Line ending HTTP uses.
+    constexpr std::string_view CRLF = "\r\n";
+
+    /// @brief Largest block of headers accepted.
+    constexpr size_t SIZE_MAX_HEADERS = 0x10000;
+
+    /// @brief Size of the reads and writes done on sockets. This is also how finely bandwidth is shaped.
+    constexpr size_t SIZE_IO_BLOCK = 0x10000;
+
+    /// @brief Connections waiting to be accepted.
+    constexpr int LISTEN_BACKLOG = 128;
+
+    /// @brief Reason phrases for the status codes Drive uses.
+    constexpr std::pair<long, std::string_view> REASON_PHRASES[] = {{100, "Continue"},
+                                                                    {200, "OK"},
+                                                                    {201, "Created"},
+                                                                    {204, "No Content"},
+                                                                    {206, "Partial Content"},
+                                                                    {308, "Resume Incomplete"},
+                                                                    {400, "Bad Request"},
+                                                                    {401, "Unauthorized"},
+                                                                    {403, "Forbidden"},
+                                                                    {404, "Not Found"},
+                                                                    {416, "Range Not Satisfiable"},
+                                                                    {429, "Too Many Requests"},
+                                                                    {500, "Internal Server Error"},
+                                                                    {503, "Service Unavailable"}};
+
+    /// @brief Returns the reason phrase for code.
+    std::string_view get_reason_phrase(long code)
+    {
+        for (const auto &[phraseCode, phrase] : REASON_PHRASES)
+        {
+            if (phraseCode == code)
+            {
+                return phrase;
+            }
+        }
+        return "Unknown";
+    }
+
+    /// @brief Decodes percent escapes and plus signs in a query value.
+    std::string decode_url(std::string_view value)
+    {
+        std::string decoded{};
+        decoded.reserve(value.length());
+        for (size_t i = 0; i < value.length(); i++)
+        {
+            if (value[i] == '%' && i + 2 < value.length())
+            {
+                char hex[3] = {value[i + 1], value[i + 2], '\0'};
+                decoded.push_back(static_cast<char>(std::strtoul(hex, nullptr, 16)));
+                i += 2;
+            }
+            else
+            {
+                decoded.push_back(value[i] == '+' ? ' ' : value[i]);
+            }
+        }
+        return decoded;
+    }
+
+    /// @brief Trims spaces and tabs from both ends of value.
+    std::string_view trim(std::string_view value)
+    {
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+        {
+            value.remove_prefix(1);
+        }
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t' || value.back() == '\r'))
+        {
+            value.remove_suffix(1);
+        }
+        return value;
+    }
+} // namespace
+
+HttpServer::HttpServer(uint16_t port,
+                       HttpServer::Handler handler,
+                       uint64_t bandwidth,
+                       std::chrono::microseconds connectLatency)
+    : m_handler(std::move(handler)), m_bandwidth(bandwidth), m_connectLatency(connectLatency),
+      m_linkFree(std::chrono::steady_clock::now())
+{
+    m_socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_socket < 0)
+    {
+        return;
+    }
+
+    int reuse = 1;
+    setsockopt(m_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    // Loopback only. This has no business being reachable from anywhere else.
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addressLength = sizeof(address);
+    if (bind(m_socket, reinterpret_cast<sockaddr *>(&address), addressLength) != 0 ||
+        listen(m_socket, LISTEN_BACKLOG) != 0 ||
+        getsockname(m_socket, reinterpret_cast<sockaddr *>(&address), &addressLength) != 0)
+    {
+        close(m_socket);
+        m_socket = -1;
+        return;
+    }
+    m_port = ntohs(address.sin_port);
+    m_running = true;
+}
+
+HttpServer::~HttpServer()
+{
+    if (m_socket >= 0)
+    {
+        close(m_socket);
+    }
+}
+
+bool HttpServer::is_listening(void) const
+{
+    return m_socket >= 0;
+}
+
+uint16_t HttpServer::get_port(void) const
+{
+    return m_port;
+}
+
+void HttpServer::run(void)
+{
+    while (m_running)
+    {
+        int descriptor = accept4(m_socket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (descriptor < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            break;
+        }
+
+        // Responses are small writes followed by waiting on the next request. Nagle would hold every one of them.
+        int noDelay = 1;
+        setsockopt(descriptor, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        // Connections outlive nothing but the process, so they're left to finish on their own.
+        std::thread(&HttpServer::serve_connection, this, descriptor).detach();
+    }
+}
+
+void HttpServer::stop(void)
+{
+    m_running = false;
+    shutdown(m_socket, SHUT_RDWR);
+}
+
+std::string_view HttpServer::get_header(const HttpServer::Request &request, std::string_view name)
+{
+    for (const auto &[headerName, value] : request.headers)
+    {
+        if (headerName == name)
+        {
+            return value;
+        }
+    }
+    return {};
+}
+
+std::string HttpServer::get_parameter(std::string_view query, std::string_view name)
+{
+    while (!query.empty())
+    {
+        size_t end = query.find('&');
+        std::string_view parameter = query.substr(0, end);
+        query = end == query.npos ? std::string_view{} : query.substr(end + 1);
+
+        if (parameter.length() > name.length() && parameter.starts_with(name) && parameter[name.length()] == '=')
+        {
+            return decode_url(parameter.substr(name.length() + 1));
+        }
+    }
+    return {};
+}
+
+void HttpServer::serve_connection(int descriptor)
+{
+    std::string buffer{};
+    bool keepAlive = true;
+    bool firstRequest = true;
+    while (keepAlive)
+    {
+        HttpServer::Request request{};
+        if (!HttpServer::read_request(descriptor, buffer, request, keepAlive))
+        {
+            break;
+        }
+
+        // Only a new connection pays for the handshakes. Requests on a connection that's kept alive don't.
+        if (firstRequest)
+        {
+            std::this_thread::sleep_for(m_connectLatency);
+            firstRequest = false;
+        }
+
+        HttpServer::Response response{};
+        m_handler(request, response);
+
+        // HEAD never has a body. Sending one anyway leaves bytes the client won't read and it drops the connection.
+        if (request.method == "HEAD")
+        {
+            response.body.clear();
+        }
+
+        if (response.code == 0 || !HttpServer::write_response(descriptor, response, keepAlive))
+        {
+            break;
+        }
+    }
+    close(descriptor);
+}
+
+bool HttpServer::read_request(int descriptor,
+                              std::string &buffer,
+                              HttpServer::Request &requestOut,
+                              bool &keepAliveOut)
+{
+    // Headers first.
+    size_t headersEnd = buffer.find("\r\n\r\n");
+    while (headersEnd == buffer.npos)
+    {
+        if (buffer.length() > SIZE_MAX_HEADERS || !HttpServer::fill_buffer(descriptor, buffer, buffer.length() + 1))
+        {
+            return false;
+        }
+        headersEnd = buffer.find("\r\n\r\n");
+    }
+    std::string_view headers = std::string_view(buffer).substr(0, headersEnd + CRLF.length());
+
+    // Request line.
+    size_t lineEnd = headers.find(CRLF);
+    std::string_view line = headers.substr(0, lineEnd);
+    size_t methodEnd = line.find(' ');
+    size_t targetEnd = line.rfind(' ');
+    if (methodEnd == line.npos || targetEnd <= methodEnd)
+    {
+        return false;
+    }
+    std::string_view target = line.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+
+    // The buffer is erased below, so the version is checked before anything that points into it goes stale.
+    bool isHttp11 = line.substr(targetEnd + 1) == "HTTP/1.1";
+
+    size_t queryBegin = target.find('?');
+    requestOut.method = line.substr(0, methodEnd);
+    requestOut.path = target.substr(0, queryBegin);
+    requestOut.query = queryBegin == target.npos ? std::string_view{} : target.substr(queryBegin + 1);
+
+    // Header lines.
+    headers.remove_prefix(lineEnd + CRLF.length());
+    while (!headers.empty())
+    {
+        lineEnd = headers.find(CRLF);
+        line = headers.substr(0, lineEnd);
+        headers.remove_prefix(lineEnd + CRLF.length());
+
+        size_t colon = line.find(':');
+        if (colon == line.npos)
+        {
+            continue;
+        }
+        std::string name{line.substr(0, colon)};
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+        requestOut.headers.emplace_back(std::move(name), trim(line.substr(colon + 1)));
+    }
+    buffer.erase(0, headersEnd + 4);
+
+    std::string_view connection = HttpServer::get_header(requestOut, "connection");
+    keepAliveOut = isHttp11 ? strcasecmp(std::string(connection).c_str(), "close") != 0
+                           : strcasecmp(std::string(connection).c_str(), "keep-alive") == 0;
+
+    // curl holds large bodies back until it's told to go ahead.
+    if (strcasecmp(std::string(HttpServer::get_header(requestOut, "expect")).c_str(), "100-continue") == 0 &&
+        !HttpServer::write_all(descriptor, "HTTP/1.1 100 Continue\r\n\r\n"))
+    {
+        return false;
+    }
+
+    // Body.
+    if (strcasecmp(std::string(HttpServer::get_header(requestOut, "transfer-encoding")).c_str(), "chunked") == 0)
+    {
+        return HttpServer::read_chunked_body(descriptor, buffer, requestOut.body);
+    }
+
+    size_t contentLength = std::strtoull(std::string(HttpServer::get_header(requestOut, "content-length")).c_str(),
+                                         nullptr,
+                                         10);
+    if (!HttpServer::fill_buffer(descriptor, buffer, contentLength))
+    {
+        return false;
+    }
+    requestOut.body.assign(buffer, 0, contentLength);
+    buffer.erase(0, contentLength);
+
+    return true;
+}
+
+bool HttpServer::read_chunked_body(int descriptor, std::string &buffer, std::string &bodyOut)
+{
+    while (true)
+    {
+        size_t lineEnd = buffer.find(CRLF);
+        while (lineEnd == buffer.npos)
+        {
+            if (!HttpServer::fill_buffer(descriptor, buffer, buffer.length() + 1))
+            {
+                return false;
+            }
+            lineEnd = buffer.find(CRLF);
+        }
+
+        // Chunk extensions after the size are ignored.
+        size_t chunkSize = std::strtoull(buffer.c_str(), nullptr, 16);
+        buffer.erase(0, lineEnd + CRLF.length());
+        if (chunkSize == 0)
+        {
+            break;
+        }
+
+        if (!HttpServer::fill_buffer(descriptor, buffer, chunkSize + CRLF.length()))
+        {
+            return false;
+        }
+        bodyOut.append(buffer, 0, chunkSize);
+        buffer.erase(0, chunkSize + CRLF.length());
+    }
+
+    // Trailers, if there are any, end with a blank line like headers do.
+    size_t trailersEnd = buffer.find(CRLF);
+    while (trailersEnd != 0)
+    {
+        if (trailersEnd != buffer.npos)
+        {
+            buffer.erase(0, trailersEnd + CRLF.length());
+        }
+        else if (!HttpServer::fill_buffer(descriptor, buffer, buffer.length() + 1))
+        {
+            return false;
+        }
+        trailersEnd = buffer.find(CRLF);
+    }
+    buffer.erase(0, CRLF.length());
+
+    return true;
+}
+
+bool HttpServer::fill_buffer(int descriptor, std::string &buffer, size_t length)
+{
+    char block[SIZE_IO_BLOCK];
+    while (buffer.length() < length)
+    {
+        ssize_t received = recv(descriptor, block, SIZE_IO_BLOCK, 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (received <= 0)
+        {
+            return false;
+        }
+        HttpServer::wait_for_link(received);
+        buffer.append(block, received);
+    }
+    return true;
+}
+
+bool HttpServer::write_response(int descriptor, const HttpServer::Response &response, bool keepAlive)
+{
+    std::string_view reason = get_reason_phrase(response.code);
+    std::string head = "HTTP/1.1 " + std::to_string(response.code) + " ";
+    head.append(reason).append(CRLF);
+    head.append("Content-Length: ").append(std::to_string(response.body.length())).append(CRLF);
+    if (!keepAlive)
+    {
+        head.append("Connection: close").append(CRLF);
+    }
+    head.append(response.headers).append(CRLF);
+
+    if (!HttpServer::write_all(descriptor, head))
+    {
+        return false;
+    }
+
+    // The body goes out a block at a time so bandwidth is shaped over the whole transfer.
+    std::string_view body = response.body;
+    while (!body.empty())
+    {
+        std::string_view block = body.substr(0, SIZE_IO_BLOCK);
+        HttpServer::wait_for_link(block.length());
+        if (!HttpServer::write_all(descriptor, block))
+        {
+            return false;
+        }
+        body.remove_prefix(block.length());
+    }
+    return true;
+}
+
+bool HttpServer::write_all(int descriptor, std::string_view data)
+{
+    while (!data.empty())
+    {
+        ssize_t sent = send(descriptor, data.data(), data.length(), MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (sent <= 0)
+        {
+            return false;
+        }
+        data.remove_prefix(sent);
+    }
+    return true;
+}
+
+void HttpServer::wait_for_link(size_t length)
+{
+    if (m_bandwidth == 0)
+    {
+        return;
+    }
+
+    // Every transfer takes its turn on the same link, so the total never goes over the limit no matter how many
+    // connections there are.
+    std::chrono::nanoseconds duration{length * 1000000000ull / m_bandwidth};
+    std::chrono::steady_clock::time_point done{};
+    {
+        std::lock_guard<std::mutex> linkGuard(m_linkLock);
+        m_linkFree = std::max(m_linkFree, std::chrono::steady_clock::now()) + duration;
+        done = m_linkFree;
+    }
+    std::this_thread::sleep_until(done);
+}
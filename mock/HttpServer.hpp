@@ -0,0 +1,153 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// @brief Minimal HTTP/1.1 server bound to the loopback interface. Every connection is served on its own thread and
+/// kept alive between requests like curl expects.
+/// @note This only understands what curl sends. It isn't meant to be exposed to anything else.
+class HttpServer
+{
+    public:
+        /// @brief Request as it was received.
+        struct Request
+        {
+                /// @brief Method of the request. For example, GET.
+                std::string method;
+
+                /// @brief Path without the query.
+                std::string path;
+
+                /// @brief Query without the leading ?. This is left encoded.
+                std::string query;
+
+                /// @brief Headers in the order they were received. Names are lowercased.
+                std::vector<std::pair<std::string, std::string>> headers;
+
+                /// @brief Body of the request.
+                std::string body;
+        };
+
+        /// @brief Response to send back.
+        struct Response
+        {
+                /// @brief Status code. 0 closes the connection without responding at all.
+                long code = 200;
+
+                /// @brief Extra header lines, each ending in CRLF. Content-Length is added by the server.
+                std::string headers;
+
+                /// @brief Body of the response.
+                std::string body;
+        };
+
+        /// @brief Function requests are handed to.
+        using Handler = std::function<void(const HttpServer::Request &, HttpServer::Response &)>;
+
+        /// @brief Opens the listening socket.
+        /// @param port Port to listen on. 0 picks a free one.
+        /// @param handler Function every request is passed to. This is called from several threads at once.
+        /// @param bandwidth Bytes per second shared by every body sent and received. 0 doesn't limit it.
+        /// @param connectLatency Delay added before the first response on every connection. This stands in for the
+        /// TCP and TLS handshakes a real server would need.
+        HttpServer(uint16_t port,
+                   HttpServer::Handler handler,
+                   uint64_t bandwidth,
+                   std::chrono::microseconds connectLatency);
+
+        /// @brief Closes the listening socket.
+        ~HttpServer();
+
+        /// @brief Returns whether the socket was opened and is listening.
+        bool is_listening(void) const;
+
+        /// @brief Returns the port the server is listening on.
+        uint16_t get_port(void) const;
+
+        /// @brief Accepts connections until stop is called.
+        void run(void);
+
+        /// @brief Stops accepting connections. This is safe to call from a signal handler.
+        void stop(void);
+
+        /// @brief Returns the value of a header of request.
+        /// @param request Request to search.
+        /// @param name Lowercase name of the header.
+        /// @return Value of the header. Empty if it wasn't sent.
+        static std::string_view get_header(const HttpServer::Request &request, std::string_view name);
+
+        /// @brief Returns the value of a parameter in a query string, decoded.
+        /// @param query Query to search.
+        /// @param name Name of the parameter.
+        /// @return Value of the parameter. Empty if it isn't in the query.
+        static std::string get_parameter(std::string_view query, std::string_view name);
+
+    private:
+        /// @brief Listening socket.
+        int m_socket = -1;
+
+        /// @brief Port being listened on.
+        uint16_t m_port = 0;
+
+        /// @brief Request handler.
+        HttpServer::Handler m_handler;
+
+        /// @brief Shared bandwidth in bytes per second.
+        uint64_t m_bandwidth;
+
+        /// @brief Delay before the first response on every connection.
+        std::chrono::microseconds m_connectLatency;
+
+        /// @brief Time the link is free again. Everything sent or received is queued behind this.
+        std::chrono::steady_clock::time_point m_linkFree;
+
+        /// @brief Lock for m_linkFree.
+        std::mutex m_linkLock;
+
+        /// @brief Whether run should keep accepting connections.
+        std::atomic<bool> m_running = false;
+
+        /// @brief Reads and answers requests on a connection until either side closes it.
+        /// @param descriptor Socket of the connection.
+        void serve_connection(int descriptor);
+
+        /// @brief Reads a single request.
+        /// @param descriptor Socket to read from.
+        /// @param buffer Data read past the end of the last request. Anything past this request is left in it.
+        /// @param requestOut Request to write to.
+        /// @param keepAliveOut Whether the connection should stay open after the response.
+        /// @return True on success. False if the connection was closed or the request is malformed.
+        bool read_request(int descriptor, std::string &buffer, HttpServer::Request &requestOut, bool &keepAliveOut);
+
+        /// @brief Reads a chunked request body.
+        /// @param descriptor Socket to read from.
+        /// @param buffer Data already read from the socket.
+        /// @param bodyOut String to write the body to.
+        /// @return True on success. False on failure.
+        bool read_chunked_body(int descriptor, std::string &buffer, std::string &bodyOut);
+
+        /// @brief Reads from descriptor until buffer holds at least length bytes.
+        /// @return True on success. False if the connection was closed first.
+        bool fill_buffer(int descriptor, std::string &buffer, size_t length);
+
+        /// @brief Sends response.
+        /// @param descriptor Socket to send on.
+        /// @param response Response to send.
+        /// @param keepAlive Whether the connection is staying open.
+        /// @return True on success. False if the connection was closed.
+        bool write_response(int descriptor, const HttpServer::Response &response, bool keepAlive);
+
+        /// @brief Sends everything in data.
+        /// @return True on success. False if the connection was closed.
+        bool write_all(int descriptor, std::string_view data);
+
+        /// @brief Waits until length bytes would have made it across the shared link.
+        /// @param length Number of bytes.
+        void wait_for_link(size_t length);
+};
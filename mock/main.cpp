@@ -0,0 +1,163 @@
+#include "DriveMock.hpp"
+#include "HttpServer.hpp"
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+namespace
+{
+    /// @brief Port listened on unless another is passed.
+    constexpr uint16_t DEFAULT_PORT = 8080;
+
+    /// @brief Usage printed for --help or anything that isn't understood.
+    constexpr std::string_view USAGE =
+        "Usage: google_drive_mock [options]\n"
+        "  --port N             Port to listen on. 0 picks a free one. Default 8080.\n"
+        "  --latency MS         Delay added to every response.\n"
+        "  --jitter MS          Random delay of up to this much added on top of the latency.\n"
+        "  --bandwidth BYTES    Bytes per second shared by every transfer. 0 doesn't limit it.\n"
+        "  --connect-latency MS Delay before the first response on every connection, for the handshakes.\n"
+        "  --error-rate F       Fraction of requests answered with a 500.\n"
+        "  --drop-rate F        Fraction of requests whose connection is closed without a response.\n"
+        "  --request-rate N     Requests per second before answering with 403 userRateLimitExceeded.\n"
+        "  --max-concurrency N  Requests in flight before answering with 429.\n"
+        "  --token-lifetime S   Seconds access tokens are good for. Default 3600.\n"
+        "  --ignore-ranges 0|1  Answer range requests with the whole file.\n"
+        "  --seed N             Seed for errors and jitter.\n";
+
+    /// @brief Server being run. The signal handler stops it.
+    HttpServer *s_server = nullptr;
+
+    /// @brief Stops the server on SIGINT and SIGTERM.
+    void handle_signal(int signal)
+    {
+        (void)signal;
+        if (s_server)
+        {
+            s_server->stop();
+        }
+    }
+
+    /// @brief Converts milliseconds from the command line to microseconds.
+    std::chrono::microseconds parse_milliseconds(const char *value)
+    {
+        return std::chrono::microseconds(static_cast<int64_t>(std::strtod(value, nullptr) * 1000.0));
+    }
+} // namespace
+
+int main(int argc, const char *argv[])
+{
+    DriveMock::Options options{};
+    uint16_t port = DEFAULT_PORT;
+    uint64_t bandwidth = 0;
+    std::chrono::microseconds connectLatency{0};
+
+    // Every option takes a value.
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view option = argv[i];
+        const char *value = i + 1 < argc ? argv[++i] : nullptr;
+        if (!value)
+        {
+            std::fputs(USAGE.data(), stderr);
+            return -1;
+        }
+
+        if (option == "--port")
+        {
+            port = static_cast<uint16_t>(std::strtoul(value, nullptr, 10));
+        }
+        else if (option == "--latency")
+        {
+            options.latency = parse_milliseconds(value);
+        }
+        else if (option == "--jitter")
+        {
+            options.jitter = parse_milliseconds(value);
+        }
+        else if (option == "--bandwidth")
+        {
+            bandwidth = std::strtoull(value, nullptr, 10);
+        }
+        else if (option == "--connect-latency")
+        {
+            connectLatency = parse_milliseconds(value);
+        }
+        else if (option == "--error-rate")
+        {
+            options.errorRate = std::strtod(value, nullptr);
+        }
+        else if (option == "--drop-rate")
+        {
+            options.dropRate = std::strtod(value, nullptr);
+        }
+        else if (option == "--request-rate")
+        {
+            options.requestRate = std::strtod(value, nullptr);
+        }
+        else if (option == "--max-concurrency")
+        {
+            options.maxConcurrency = std::atoi(value);
+        }
+        else if (option == "--token-lifetime")
+        {
+            options.tokenLifetime = std::strtoll(value, nullptr, 10);
+        }
+        else if (option == "--ignore-ranges")
+        {
+            options.ignoreRanges = std::atoi(value) != 0;
+        }
+        else if (option == "--seed")
+        {
+            options.seed = std::strtoull(value, nullptr, 10);
+        }
+        else
+        {
+            std::fputs(USAGE.data(), stderr);
+            return -1;
+        }
+    }
+
+    DriveMock drive{options};
+    HttpServer server{port,
+                      [&drive](const HttpServer::Request &request, HttpServer::Response &response) {
+                          drive.handle(request, response);
+                      },
+                      bandwidth,
+                      connectLatency};
+    if (!server.is_listening())
+    {
+        std::fprintf(stderr, "Error listening on 127.0.0.1:%u: %s\n", port, std::strerror(errno));
+        return -2;
+    }
+
+    s_server = &server;
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+
+    // This is what goes in the installed object of client_secret.json to point the client here.
+    std::printf("Mock Drive listening on 127.0.0.1:%u. Root folder is %s.\n"
+                "\"drive_base_url\": \"http://127.0.0.1:%u\", \"oauth2_base_url\": \"http://127.0.0.1:%u/oauth2\"\n",
+                server.get_port(),
+                drive.get_root_id().c_str(),
+                server.get_port(),
+                server.get_port());
+    std::fflush(stdout);
+
+    server.run();
+
+    // Printed once it's stopped so a run against the throttles can be checked from the server's side.
+    DriveMock::Stats stats = drive.get_stats();
+    std::printf("Handled %llu requests. %llu went over the request rate and %llu over the concurrency limit. At "
+                "most %i were in flight at once.\n",
+                static_cast<unsigned long long>(stats.requests),
+                static_cast<unsigned long long>(stats.rateLimited),
+                static_cast<unsigned long long>(stats.overConcurrency),
+                stats.peakInFlight);
+    return 0;
+}
@@ -0,0 +1,783 @@
+#include "Catalog.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <functional>
+
+namespace
+{
+    /// @brief The arena isn't compacted until it's at least this many blocks.
+    constexpr size_t MIN_COMPACT_BLOCKS = 16;
+
+    /// @brief Writes a trivially copyable value to stream.
+    template <typename Type>
+    void write_value(std::ostream &stream, const Type &value)
+    {
+        stream.write(reinterpret_cast<const char *>(&value), sizeof(Type));
+    }
+
+    /// @brief Writes the length of vector followed by its contents to stream.
+    template <typename Type>
+    void write_vector(std::ostream &stream, const std::vector<Type> &vector)
+    {
+        write_value<uint64_t>(stream, vector.size());
+        stream.write(reinterpret_cast<const char *>(vector.data()), vector.size() * sizeof(Type));
+    }
+
+    /// @brief Reads a trivially copyable value from data and advances it.
+    template <typename Type>
+    bool read_value(std::string_view &data, Type &value)
+    {
+        if (data.length() < sizeof(Type))
+        {
+            return false;
+        }
+        std::memcpy(&value, data.data(), sizeof(Type));
+        data.remove_prefix(sizeof(Type));
+        return true;
+    }
+
+    /// @brief Reads a vector written by write_vector from data and advances it.
+    template <typename Type>
+    bool read_vector(std::string_view &data, std::vector<Type> &vector)
+    {
+        uint64_t length = 0;
+        if (!read_value(data, length) || length > data.length() / sizeof(Type))
+        {
+            return false;
+        }
+        vector.resize(length);
+        std::memcpy(vector.data(), data.data(), length * sizeof(Type));
+        data.remove_prefix(length * sizeof(Type));
+        return true;
+    }
+} // namespace
+
+Catalog::Iterator::Iterator(const Catalog *catalog, Catalog::Index index) : m_catalog(catalog), m_index(index)
+{
+    Iterator::skip_dead();
+}
+
+Item Catalog::Iterator::operator*(void) const
+{
+    return m_catalog->at(m_index);
+}
+
+Catalog::Iterator &Catalog::Iterator::operator++(void)
+{
+    ++m_index;
+    Iterator::skip_dead();
+    return *this;
+}
+
+void Catalog::Iterator::skip_dead(void)
+{
+    while (m_index < m_catalog->m_entries.size() && !(m_catalog->m_entries[m_index].flags & Catalog::FLAG_ALIVE))
+    {
+        ++m_index;
+    }
+}
+
+void Catalog::reserve(size_t count)
+{
+    m_entries.reserve(count);
+    m_idIndex.reserve(count);
+    m_nameIndex.reserve(count);
+}
+
+bool Catalog::add(std::string_view name,
+                  std::string_view id,
+                  std::string_view parent,
+                  bool isDirectory,
+                  uint64_t size,
+                  int64_t modifiedTime,
+                  std::string_view md5Checksum)
+{
+    if (name.length() > Catalog::MAX_NAME_LENGTH || id.length() > Catalog::MAX_ID_LENGTH ||
+        parent.length() > Catalog::SIZE_ARENA_BLOCK || md5Checksum.length() > Catalog::MAX_CHECKSUM_LENGTH)
+    {
+        return false;
+    }
+
+    // IDs are unique. If this one already exists, it's being replaced.
+    Catalog::Index existing = Catalog::find_by_id(id);
+    if (existing != Catalog::NOT_FOUND)
+    {
+        Catalog::remove_entry(existing);
+    }
+
+    Catalog::Index parentHandle = Catalog::intern_parent(parent);
+
+    Catalog::Entry entry{};
+    entry.nameOffset = Catalog::store_string(name);
+    // Local uses the name as the ID. No point in storing it twice.
+    entry.idOffset = id == name ? entry.nameOffset : Catalog::store_string(id);
+    entry.nameLength = static_cast<uint16_t>(name.length());
+    entry.idLength = static_cast<uint8_t>(id.length());
+    entry.flags = Catalog::FLAG_ALIVE | (isDirectory ? Catalog::FLAG_DIRECTORY : 0);
+    entry.parent = parentHandle;
+    entry.nextSibling = Catalog::NOT_FOUND;
+    entry.checksumOffset = md5Checksum.empty() ? 0 : Catalog::store_string(md5Checksum);
+    entry.checksumLength = static_cast<uint8_t>(md5Checksum.length());
+    entry.size = size;
+    entry.modifiedTime = modifiedTime;
+
+    // Reuse a dead entry if there is one.
+    Catalog::Index index = m_freeHead;
+    if (index != Catalog::NOT_FOUND)
+    {
+        m_freeHead = m_entries[index].nextSibling;
+    }
+    else
+    {
+        index = static_cast<Catalog::Index>(m_entries.size());
+        m_entries.emplace_back();
+    }
+
+    // Append to the parent's child list so listings keep the order items were added in.
+    Catalog::Parent &parentRecord = m_parents[parentHandle];
+    entry.previousSibling = parentRecord.lastChild;
+    if (parentRecord.lastChild != Catalog::NOT_FOUND)
+    {
+        m_entries[parentRecord.lastChild].nextSibling = index;
+    }
+    else
+    {
+        parentRecord.firstChild = index;
+    }
+    parentRecord.lastChild = index;
+
+    m_entries[index] = entry;
+    m_idIndex.insert(Catalog::hash_string(id), index);
+    m_nameIndex.insert(Catalog::hash_name(parentHandle, name, isDirectory), index);
+    ++m_count;
+
+    return true;
+}
+
+bool Catalog::remove(std::string_view id)
+{
+    Catalog::Index index = Catalog::find_by_id(id);
+    if (index == Catalog::NOT_FOUND)
+    {
+        return false;
+    }
+
+    Catalog::remove_entry(index);
+    Catalog::compact_arena();
+
+    return true;
+}
+
+size_t Catalog::remove_subtree(std::string_view id)
+{
+    size_t removed = 0;
+    Catalog::Index index = Catalog::find_by_id(id);
+    if (index != Catalog::NOT_FOUND)
+    {
+        Catalog::remove_entry(index);
+        ++removed;
+    }
+
+    // Children are found through their parent's child list. The item itself might not be in the catalog, but its
+    // children still can be.
+    std::vector<Catalog::Index> pending{};
+    Catalog::Index parentHandle = Catalog::find_parent(id);
+    if (parentHandle != Catalog::NOT_FOUND)
+    {
+        pending.push_back(parentHandle);
+    }
+
+    while (!pending.empty())
+    {
+        parentHandle = pending.back();
+        pending.pop_back();
+
+        // Removing a child unlinks it, so the head of the list is always the next one.
+        while ((index = m_parents[parentHandle].firstChild) != Catalog::NOT_FOUND)
+        {
+            const Catalog::Entry &entry = m_entries[index];
+            if (entry.flags & Catalog::FLAG_DIRECTORY)
+            {
+                Catalog::Index childHandle = Catalog::find_parent(Catalog::get_string(entry.idOffset, entry.idLength));
+                if (childHandle != Catalog::NOT_FOUND)
+                {
+                    pending.push_back(childHandle);
+                }
+            }
+            Catalog::remove_entry(index);
+            ++removed;
+        }
+    }
+
+    // Only compact once for the whole subtree.
+    Catalog::compact_arena();
+
+    return removed;
+}
+
+void Catalog::clear(void)
+{
+    m_arena.clear();
+    m_blockUsed = Catalog::SIZE_ARENA_BLOCK;
+    m_deadBytes = 0;
+    m_entries.clear();
+    m_parents.clear();
+    m_freeHead = Catalog::NOT_FOUND;
+    m_freeParentHead = Catalog::NOT_FOUND;
+    m_count = 0;
+    m_parentCount = 0;
+    m_idIndex.clear();
+    m_nameIndex.clear();
+    m_parentIndex.clear();
+}
+
+size_t Catalog::size(void) const
+{
+    return m_count;
+}
+
+bool Catalog::empty(void) const
+{
+    return m_count == 0;
+}
+
+bool Catalog::is_valid(Catalog::Index index) const
+{
+    return index < m_entries.size() && (m_entries[index].flags & Catalog::FLAG_ALIVE);
+}
+
+Item Catalog::at(Catalog::Index index) const
+{
+    const Catalog::Entry &entry = m_entries[index];
+    const Catalog::Parent &parent = m_parents[entry.parent];
+
+    return Item(Catalog::get_string(entry.nameOffset, entry.nameLength),
+                Catalog::get_string(entry.idOffset, entry.idLength),
+                Catalog::get_string(parent.idOffset, parent.idLength),
+                entry.flags & Catalog::FLAG_DIRECTORY,
+                entry.size,
+                entry.modifiedTime,
+                entry.checksumLength > 0 ? Catalog::get_string(entry.checksumOffset, entry.checksumLength)
+                                         : std::string_view{});
+}
+
+Catalog::Index Catalog::find_by_id(std::string_view id) const
+{
+    return m_idIndex.find(Catalog::hash_string(id), [this, id](Catalog::Index index) {
+        const Catalog::Entry &entry = m_entries[index];
+        return Catalog::get_string(entry.idOffset, entry.idLength) == id;
+    });
+}
+
+Catalog::Index Catalog::find_child(std::string_view parent, std::string_view name, bool isDirectory) const
+{
+    Catalog::Index parentHandle = Catalog::find_parent(parent);
+    if (parentHandle == Catalog::NOT_FOUND)
+    {
+        return Catalog::NOT_FOUND;
+    }
+
+    uint8_t directoryFlag = isDirectory ? Catalog::FLAG_DIRECTORY : 0;
+    return m_nameIndex.find(Catalog::hash_name(parentHandle, name, isDirectory), [&](Catalog::Index index) {
+        const Catalog::Entry &entry = m_entries[index];
+        return entry.parent == parentHandle && (entry.flags & Catalog::FLAG_DIRECTORY) == directoryFlag &&
+               Catalog::get_string(entry.nameOffset, entry.nameLength) == name;
+    });
+}
+
+Catalog::Iterator Catalog::begin(void) const
+{
+    return Catalog::Iterator(this, 0);
+}
+
+Catalog::Iterator Catalog::end(void) const
+{
+    return Catalog::Iterator(this, static_cast<Catalog::Index>(m_entries.size()));
+}
+
+size_t Catalog::memory_usage(void) const
+{
+    return (m_arena.size() * Catalog::SIZE_ARENA_BLOCK) + (m_entries.capacity() * sizeof(Catalog::Entry)) +
+           (m_parents.capacity() * sizeof(Catalog::Parent)) + m_idIndex.memory_usage() + m_nameIndex.memory_usage() +
+           m_parentIndex.memory_usage();
+}
+
+size_t Catalog::live_memory_usage(void) const
+{
+    // Strings still in use plus the record and two index slots at the tables' typical load for each item. Parents
+    // have their own record and a single slot.
+    size_t arenaUsed = m_arena.empty() ? 0 : ((m_arena.size() - 1) * Catalog::SIZE_ARENA_BLOCK) + m_blockUsed;
+    return (arenaUsed - m_deadBytes) + (m_count * (sizeof(Catalog::Entry) + (4 * sizeof(uint64_t)))) +
+           (m_parentCount * (sizeof(Catalog::Parent) + (2 * sizeof(uint64_t))));
+}
+
+bool Catalog::write(std::ostream &stream) const
+{
+    // This is checked when reading so a build with a different layout doesn't misread anything.
+    uint64_t layout = sizeof(Catalog::Entry) | (sizeof(Catalog::Parent) << 8) | (Catalog::SIZE_ARENA_BLOCK << 16);
+    write_value(stream, layout);
+    write_value<uint64_t>(stream, m_count);
+    write_value<uint64_t>(stream, m_deadBytes);
+    write_value(stream, m_freeHead);
+    write_vector(stream, m_entries);
+    write_vector(stream, m_parents);
+
+    // Only the used part of the last block is written.
+    write_value<uint64_t>(stream, m_arena.size());
+    write_value<uint64_t>(stream, m_blockUsed);
+    for (size_t i = 0; i < m_arena.size(); i++)
+    {
+        size_t length = i + 1 == m_arena.size() ? m_blockUsed : Catalog::SIZE_ARENA_BLOCK;
+        stream.write(m_arena[i].get(), length);
+    }
+
+    return m_idIndex.write(stream) && m_nameIndex.write(stream) && m_parentIndex.write(stream) && stream.good();
+}
+
+bool Catalog::read(std::string_view &data)
+{
+    Catalog::clear();
+
+    std::string_view cursor = data;
+    uint64_t layout = 0, count = 0, deadBytes = 0, blockCount = 0, blockUsed = 0;
+    if (!read_value(cursor, layout) ||
+        layout != (sizeof(Catalog::Entry) | (sizeof(Catalog::Parent) << 8) | (Catalog::SIZE_ARENA_BLOCK << 16)) ||
+        !read_value(cursor, count) || !read_value(cursor, deadBytes) || !read_value(cursor, m_freeHead) ||
+        !read_vector(cursor, m_entries) || !read_vector(cursor, m_parents) || !read_value(cursor, blockCount) ||
+        !read_value(cursor, blockUsed) || blockUsed > Catalog::SIZE_ARENA_BLOCK)
+    {
+        Catalog::clear();
+        return false;
+    }
+
+    for (uint64_t i = 0; i < blockCount; i++)
+    {
+        size_t length = i + 1 == blockCount ? blockUsed : Catalog::SIZE_ARENA_BLOCK;
+        if (cursor.length() < length)
+        {
+            Catalog::clear();
+            return false;
+        }
+
+        m_arena.push_back(std::make_unique_for_overwrite<char[]>(Catalog::SIZE_ARENA_BLOCK));
+        std::memcpy(m_arena.back().get(), cursor.data(), length);
+        cursor.remove_prefix(length);
+    }
+
+    if (!m_idIndex.read(cursor) || !m_nameIndex.read(cursor) || !m_parentIndex.read(cursor))
+    {
+        Catalog::clear();
+        return false;
+    }
+
+    m_count = count;
+    m_deadBytes = deadBytes;
+    m_blockUsed = blockCount > 0 ? blockUsed : Catalog::SIZE_ARENA_BLOCK;
+
+    // The checksum only covers what was written. Anything a bad write left inconsistent is caught here instead of
+    // being read through later.
+    if (!Catalog::validate())
+    {
+        Catalog::clear();
+        return false;
+    }
+    Catalog::link_free_parents();
+    data = cursor;
+
+    return true;
+}
+
+void Catalog::Table::insert(uint32_t hash, Catalog::Index value)
+{
+    // Keep the load factor, including tombstones, under 3/4. The new size is based on the values alone, so a table
+    // full of tombstones from churn is rebuilt at the same size instead of doubling every time.
+    if ((m_used + 1) * 4 > m_slots.size() * 3)
+    {
+        Table::rehash(std::max<size_t>(16, std::bit_ceil((m_live + 1) * 2)));
+    }
+
+    size_t mask = m_slots.size() - 1;
+    size_t i = hash & mask;
+    while (m_slots[i].value != Table::EMPTY && m_slots[i].value != Table::TOMBSTONE)
+    {
+        i = (i + 1) & mask;
+    }
+
+    if (m_slots[i].value == Table::EMPTY)
+    {
+        ++m_used;
+    }
+    m_slots[i] = {hash, value};
+    ++m_live;
+}
+
+void Catalog::Table::erase(uint32_t hash, Catalog::Index value)
+{
+    if (m_slots.empty())
+    {
+        return;
+    }
+
+    size_t mask = m_slots.size() - 1;
+    for (size_t i = hash & mask; m_slots[i].value != Table::EMPTY; i = (i + 1) & mask)
+    {
+        if (m_slots[i].value == value)
+        {
+            m_slots[i].value = Table::TOMBSTONE;
+            --m_live;
+            return;
+        }
+    }
+}
+
+void Catalog::Table::reserve(size_t count)
+{
+    size_t capacity = std::bit_ceil(std::max<size_t>(16, (count * 4 + 2) / 3));
+    if (capacity > m_slots.size())
+    {
+        Table::rehash(capacity);
+    }
+}
+
+void Catalog::Table::clear(void)
+{
+    m_slots.clear();
+    m_used = 0;
+    m_live = 0;
+}
+
+size_t Catalog::Table::memory_usage(void) const
+{
+    return m_slots.capacity() * sizeof(Slot);
+}
+
+bool Catalog::Table::write(std::ostream &stream) const
+{
+    write_value<uint64_t>(stream, m_used);
+    write_vector(stream, m_slots);
+    return stream.good();
+}
+
+bool Catalog::Table::read(std::string_view &data)
+{
+    uint64_t used = 0;
+    // The slot count has to stay a power of two for the mask to work.
+    if (!read_value(data, used) || !read_vector(data, m_slots) ||
+        (!m_slots.empty() && !std::has_single_bit(m_slots.size())))
+    {
+        Table::clear();
+        return false;
+    }
+
+    // The counts are taken from the slots themselves instead of trusting the one that was written.
+    m_used = std::count_if(m_slots.begin(), m_slots.end(), [](const Slot &slot) { return slot.value != Table::EMPTY; });
+    m_live = std::count_if(m_slots.begin(), m_slots.end(), [](const Slot &slot) {
+        return slot.value != Table::EMPTY && slot.value != Table::TOMBSTONE;
+    });
+    return true;
+}
+
+void Catalog::Table::rehash(size_t capacity)
+{
+    std::vector<Slot> oldSlots(capacity, Slot{0, Table::EMPTY});
+    oldSlots.swap(m_slots);
+    m_used = 0;
+    m_live = 0;
+
+    size_t mask = m_slots.size() - 1;
+    for (const Slot &slot : oldSlots)
+    {
+        if (slot.value == Table::EMPTY || slot.value == Table::TOMBSTONE)
+        {
+            continue;
+        }
+
+        size_t i = slot.hash & mask;
+        while (m_slots[i].value != Table::EMPTY)
+        {
+            i = (i + 1) & mask;
+        }
+        m_slots[i] = slot;
+        ++m_used;
+        ++m_live;
+    }
+}
+
+uint32_t Catalog::hash_string(std::string_view string)
+{
+    uint64_t hash = std::hash<std::string_view>{}(string);
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+uint32_t Catalog::hash_name(Catalog::Index parent, std::string_view name, bool isDirectory)
+{
+    // Mix the parent handle and type into the name hash.
+    uint32_t hash = Catalog::hash_string(name);
+    hash ^= (parent + 0x9E3779B9u + (hash << 6) + (hash >> 2));
+    return isDirectory ? ~hash : hash;
+}
+
+std::string_view Catalog::get_string(uint32_t offset, size_t length) const
+{
+    return std::string_view(m_arena[offset / Catalog::SIZE_ARENA_BLOCK].get() + (offset % Catalog::SIZE_ARENA_BLOCK),
+                            length);
+}
+
+bool Catalog::is_stored(uint32_t offset, size_t length) const
+{
+    size_t block = offset / Catalog::SIZE_ARENA_BLOCK;
+    size_t blockEnd = block + 1 == m_arena.size() ? m_blockUsed : Catalog::SIZE_ARENA_BLOCK;
+    return block < m_arena.size() && (offset % Catalog::SIZE_ARENA_BLOCK) + length <= blockEnd;
+}
+
+bool Catalog::validate(void) const
+{
+    auto isAlive = [this](Catalog::Index index) {
+        return index < m_entries.size() && (m_entries[index].flags & Catalog::FLAG_ALIVE);
+    };
+    auto isLink = [&isAlive](Catalog::Index index) { return index == Catalog::NOT_FOUND || isAlive(index); };
+
+    size_t alive = 0;
+    for (const Catalog::Entry &entry : m_entries)
+    {
+        if (!(entry.flags & Catalog::FLAG_ALIVE))
+        {
+            continue;
+        }
+
+        ++alive;
+        if (entry.parent >= m_parents.size() || m_parents[entry.parent].idLength == Catalog::DEAD_PARENT ||
+            !isLink(entry.previousSibling) || !isLink(entry.nextSibling) ||
+            !Catalog::is_stored(entry.nameOffset, entry.nameLength) ||
+            !Catalog::is_stored(entry.idOffset, entry.idLength) ||
+            (entry.checksumLength > 0 && !Catalog::is_stored(entry.checksumOffset, entry.checksumLength)))
+        {
+            return false;
+        }
+    }
+
+    // Every live entry is in exactly one child list, so walking more than that many means a list loops.
+    size_t walked = 0;
+    for (const Catalog::Parent &parent : m_parents)
+    {
+        // Freed parents have no children. Their free list links are rebuilt after reading instead of trusted.
+        if (parent.idLength == Catalog::DEAD_PARENT)
+        {
+            if (parent.firstChild != Catalog::NOT_FOUND)
+            {
+                return false;
+            }
+            continue;
+        }
+
+        if (!Catalog::is_stored(parent.idOffset, parent.idLength) || !isLink(parent.firstChild) ||
+            !isLink(parent.lastChild))
+        {
+            return false;
+        }
+
+        for (Catalog::Index index = parent.firstChild; index != Catalog::NOT_FOUND;
+             index = m_entries[index].nextSibling)
+        {
+            if (++walked > alive)
+            {
+                return false;
+            }
+        }
+    }
+
+    // The same goes for the free list and the dead entries.
+    size_t freed = 0;
+    for (Catalog::Index index = m_freeHead; index != Catalog::NOT_FOUND; index = m_entries[index].nextSibling)
+    {
+        if (index >= m_entries.size() || (m_entries[index].flags & Catalog::FLAG_ALIVE) ||
+            ++freed > m_entries.size() - alive)
+        {
+            return false;
+        }
+    }
+
+    return alive == m_count && m_idIndex.validate(isAlive) && m_nameIndex.validate(isAlive) &&
+           m_parentIndex.validate([this](Catalog::Index handle) {
+               return handle < m_parents.size() && m_parents[handle].idLength != Catalog::DEAD_PARENT;
+           });
+}
+
+uint32_t Catalog::store_string(std::string_view string)
+{
+    // Strings never cross blocks. If it doesn't fit, start a new one. An empty string still needs a block for its
+    // offset to point into.
+    if (m_arena.empty() || m_blockUsed + string.length() > Catalog::SIZE_ARENA_BLOCK)
+    {
+        m_arena.push_back(std::make_unique_for_overwrite<char[]>(Catalog::SIZE_ARENA_BLOCK));
+        m_blockUsed = 0;
+    }
+
+    uint32_t offset = static_cast<uint32_t>(((m_arena.size() - 1) * Catalog::SIZE_ARENA_BLOCK) + m_blockUsed);
+    std::memcpy(m_arena.back().get() + m_blockUsed, string.data(), string.length());
+    m_blockUsed += string.length();
+
+    return offset;
+}
+
+Catalog::Index Catalog::find_parent(std::string_view parent) const
+{
+    return m_parentIndex.find(Catalog::hash_string(parent), [this, parent](Catalog::Index handle) {
+        const Catalog::Parent &record = m_parents[handle];
+        return Catalog::get_string(record.idOffset, record.idLength) == parent;
+    });
+}
+
+Catalog::Index Catalog::intern_parent(std::string_view parent)
+{
+    Catalog::Index handle = Catalog::find_parent(parent);
+    if (handle != Catalog::NOT_FOUND)
+    {
+        return handle;
+    }
+
+    Catalog::Parent record = {Catalog::store_string(parent),
+                              static_cast<uint32_t>(parent.length()),
+                              Catalog::NOT_FOUND,
+                              Catalog::NOT_FOUND};
+
+    // Reuse a freed parent if there is one.
+    handle = m_freeParentHead;
+    if (handle != Catalog::NOT_FOUND)
+    {
+        m_freeParentHead = m_parents[handle].lastChild;
+        m_parents[handle] = record;
+    }
+    else
+    {
+        handle = static_cast<Catalog::Index>(m_parents.size());
+        m_parents.push_back(record);
+    }
+    m_parentIndex.insert(Catalog::hash_string(parent), handle);
+    ++m_parentCount;
+
+    return handle;
+}
+
+void Catalog::remove_entry(Catalog::Index index)
+{
+    Catalog::Entry &entry = m_entries[index];
+    std::string_view name = Catalog::get_string(entry.nameOffset, entry.nameLength);
+    std::string_view id = Catalog::get_string(entry.idOffset, entry.idLength);
+    bool isDirectory = entry.flags & Catalog::FLAG_DIRECTORY;
+
+    m_idIndex.erase(Catalog::hash_string(id), index);
+    m_nameIndex.erase(Catalog::hash_name(entry.parent, name, isDirectory), index);
+
+    // Unlink from the parent's child list.
+    Catalog::Parent &parent = m_parents[entry.parent];
+    if (entry.previousSibling != Catalog::NOT_FOUND)
+    {
+        m_entries[entry.previousSibling].nextSibling = entry.nextSibling;
+    }
+    else
+    {
+        parent.firstChild = entry.nextSibling;
+    }
+
+    if (entry.nextSibling != Catalog::NOT_FOUND)
+    {
+        m_entries[entry.nextSibling].previousSibling = entry.previousSibling;
+    }
+    else
+    {
+        parent.lastChild = entry.previousSibling;
+    }
+
+    m_deadBytes += entry.nameLength + (entry.idOffset != entry.nameOffset ? entry.idLength : 0) + entry.checksumLength;
+
+    // Push it onto the free list.
+    entry.flags = 0;
+    entry.nextSibling = m_freeHead;
+    m_freeHead = index;
+    --m_count;
+
+    // Nothing else refers to a parent, so one without children can go too.
+    if (parent.firstChild == Catalog::NOT_FOUND)
+    {
+        Catalog::free_parent(entry.parent);
+    }
+}
+
+void Catalog::free_parent(Catalog::Index handle)
+{
+    Catalog::Parent &parent = m_parents[handle];
+    m_parentIndex.erase(Catalog::hash_string(Catalog::get_string(parent.idOffset, parent.idLength)), handle);
+    m_deadBytes += parent.idLength;
+
+    parent.idOffset = 0;
+    parent.idLength = Catalog::DEAD_PARENT;
+    parent.lastChild = m_freeParentHead;
+    m_freeParentHead = handle;
+    --m_parentCount;
+}
+
+void Catalog::link_free_parents(void)
+{
+    m_freeParentHead = Catalog::NOT_FOUND;
+    m_parentCount = 0;
+    for (size_t i = m_parents.size(); i-- > 0;)
+    {
+        Catalog::Parent &parent = m_parents[i];
+        if (parent.idLength == Catalog::DEAD_PARENT)
+        {
+            parent.lastChild = m_freeParentHead;
+            m_freeParentHead = static_cast<Catalog::Index>(i);
+        }
+        else
+        {
+            ++m_parentCount;
+        }
+    }
+}
+
+void Catalog::compact_arena(void)
+{
+    size_t arenaSize = m_arena.size() * Catalog::SIZE_ARENA_BLOCK;
+    if (m_arena.size() < MIN_COMPACT_BLOCKS || m_deadBytes * 2 < arenaSize)
+    {
+        return;
+    }
+
+    // Swap the old blocks out and store everything still alive again.
+    std::vector<std::unique_ptr<char[]>> oldArena{};
+    oldArena.swap(m_arena);
+    m_blockUsed = Catalog::SIZE_ARENA_BLOCK;
+
+    auto moveString = [&](uint32_t offset, size_t length) {
+        const char *source = oldArena[offset / Catalog::SIZE_ARENA_BLOCK].get() + (offset % Catalog::SIZE_ARENA_BLOCK);
+        return Catalog::store_string(std::string_view(source, length));
+    };
+
+    for (Catalog::Parent &parent : m_parents)
+    {
+        if (parent.idLength != Catalog::DEAD_PARENT)
+        {
+            parent.idOffset = moveString(parent.idOffset, parent.idLength);
+        }
+    }
+
+    for (Catalog::Entry &entry : m_entries)
+    {
+        if (!(entry.flags & Catalog::FLAG_ALIVE))
+        {
+            continue;
+        }
+
+        bool sharedId = entry.idOffset == entry.nameOffset;
+        entry.nameOffset = moveString(entry.nameOffset, entry.nameLength);
+        entry.idOffset = sharedId ? entry.nameOffset : moveString(entry.idOffset, entry.idLength);
+        if (entry.checksumLength > 0)
+        {
+            entry.checksumOffset = moveString(entry.checksumOffset, entry.checksumLength);
+        }
+    }
+
+    m_deadBytes = 0;
+}
@@ -0,0 +1,244 @@
+#include "DriveBatch.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <strings.h>
+
+namespace
+{
+    /// @brief Line ending used for everything in the body.
+    constexpr std::string_view CRLF = "\r\n";
+
+    /// @brief Prefix of the boundary. A random number is appended to this.
+    constexpr std::string_view BOUNDARY_PREFIX = "jksv_batch_";
+
+    /// @brief Content-Type header for the batch. The boundary is appended.
+    constexpr std::string_view HEADER_CONTENT_TYPE_MULTIPART = "Content-Type: multipart/mixed; boundary=";
+
+    /// @brief Header every part starts with.
+    constexpr std::string_view HEADER_CONTENT_TYPE_HTTP = "Content-Type: application/http";
+
+    /// @brief Header for the JSON bodies of requests.
+    constexpr std::string_view HEADER_CONTENT_TYPE_JSON = "Content-Type: application/json; charset=UTF-8";
+
+    /// @brief Name of the header used to match responses to requests.
+    constexpr std::string_view HEADER_CONTENT_ID = "Content-ID";
+
+    /// @brief Content-IDs of requests are this followed by the index.
+    constexpr std::string_view CONTENT_ID_REQUEST = "item";
+
+    /// @brief Content-IDs of responses are this followed by the index.
+    constexpr std::string_view CONTENT_ID_RESPONSE = "response-item";
+
+    /// @brief Parameter of the Content-Type header that holds the boundary.
+    constexpr std::string_view PARAM_BOUNDARY = "boundary=";
+
+    /// @brief Finds the blank line that ends a block of headers. Google is consistent about CRLF, but this doesn't
+    /// rely on it.
+    /// @param data Data to search.
+    /// @param bodyOut Offset of the first byte after the blank line.
+    /// @return Offset of the blank line. npos if there isn't one.
+    size_t find_blank_line(std::string_view data, size_t &bodyOut)
+    {
+        size_t crlf = data.find("\r\n\r\n");
+        size_t lf = data.find("\n\n");
+        if (lf < crlf)
+        {
+            bodyOut = lf + 2;
+            return lf;
+        }
+        else if (crlf != data.npos)
+        {
+            bodyOut = crlf + 4;
+            return crlf;
+        }
+        return data.npos;
+    }
+
+    /// @brief Searches a block of headers for header and returns its value.
+    /// @param headers Headers to search.
+    /// @param header Name of the header.
+    /// @return Value of the header. Empty if it wasn't found.
+    std::string_view find_header(std::string_view headers, std::string_view header)
+    {
+        while (!headers.empty())
+        {
+            size_t lineEnd = headers.find('\n');
+            std::string_view line = headers.substr(0, lineEnd);
+            headers = lineEnd == headers.npos ? std::string_view{} : headers.substr(lineEnd + 1);
+
+            if (line.length() > header.length() && line[header.length()] == ':' &&
+                strncasecmp(line.data(), header.data(), header.length()) == 0)
+            {
+                std::string_view value = line.substr(header.length() + 1);
+                value.remove_prefix(std::min(value.find_first_not_of(' '), value.length()));
+                while (!value.empty() && (value.back() == '\r' || value.back() == ' '))
+                {
+                    value.remove_suffix(1);
+                }
+                return value;
+            }
+        }
+        return {};
+    }
+} // namespace
+
+DriveBatch::DriveBatch(void)
+{
+    // The boundary can't show up anywhere in the body. Names are escaped JSON, so this is plenty.
+    std::random_device device{};
+    m_boundary = std::string(BOUNDARY_PREFIX) + std::to_string(device()) + std::to_string(device());
+    m_contentTypeHeader = std::string(HEADER_CONTENT_TYPE_MULTIPART) + m_boundary;
+}
+
+size_t DriveBatch::add(std::string_view method, std::string_view path, std::string_view body)
+{
+    if (DriveBatch::full())
+    {
+        return MAX_REQUESTS;
+    }
+
+    // Reopen the body if get_body already closed it.
+    if (m_closed)
+    {
+        m_body.resize(m_body.length() - m_boundary.length() - 6);
+        m_closed = false;
+    }
+
+    size_t index = m_count++;
+    m_body.append("--").append(m_boundary).append(CRLF);
+    m_body.append(HEADER_CONTENT_TYPE_HTTP).append(CRLF);
+    m_body.append(HEADER_CONTENT_ID).append(": <").append(CONTENT_ID_REQUEST).append(std::to_string(index));
+    m_body.append(">").append(CRLF).append(CRLF);
+
+    m_body.append(method).append(" ").append(path).append(" HTTP/1.1").append(CRLF);
+    if (!body.empty())
+    {
+        m_body.append(HEADER_CONTENT_TYPE_JSON).append(CRLF).append(CRLF);
+        m_body.append(body);
+    }
+    m_body.append(CRLF).append(CRLF);
+
+    return index;
+}
+
+size_t DriveBatch::size(void) const
+{
+    return m_count;
+}
+
+bool DriveBatch::empty(void) const
+{
+    return m_count == 0;
+}
+
+bool DriveBatch::full(void) const
+{
+    return m_count >= MAX_REQUESTS;
+}
+
+void DriveBatch::clear(void)
+{
+    m_body.clear();
+    m_count = 0;
+    m_closed = false;
+}
+
+const std::string &DriveBatch::get_body(void)
+{
+    if (!m_closed)
+    {
+        // "--" + boundary + "--" + CRLF. add relies on this being 6 bytes longer than the boundary.
+        m_body.append("--").append(m_boundary).append("--").append(CRLF);
+        m_closed = true;
+    }
+    return m_body;
+}
+
+const std::string &DriveBatch::get_content_type_header(void) const
+{
+    return m_contentTypeHeader;
+}
+
+bool DriveBatch::parse_response(std::string_view contentType,
+                                std::string_view response,
+                                std::vector<DriveBatch::Response> &responsesOut) const
+{
+    responsesOut.assign(m_count, {});
+
+    // The response has its own boundary.
+    size_t boundaryBegin = contentType.find(PARAM_BOUNDARY);
+    if (boundaryBegin == contentType.npos)
+    {
+        return false;
+    }
+    std::string_view boundary = contentType.substr(boundaryBegin + PARAM_BOUNDARY.length());
+    boundary = boundary.substr(0, boundary.find(';'));
+    if (boundary.length() >= 2 && boundary.front() == '"' && boundary.back() == '"')
+    {
+        boundary = boundary.substr(1, boundary.length() - 2);
+    }
+
+    std::string delimiter = "--" + std::string(boundary);
+    size_t partBegin = response.find(delimiter);
+    // Parts without a Content-ID are assumed to be in order.
+    size_t ordinal = 0;
+    while (partBegin != response.npos)
+    {
+        partBegin += delimiter.length();
+        // A delimiter followed by -- is the end.
+        if (response.substr(partBegin, 2) == "--")
+        {
+            break;
+        }
+
+        size_t partEnd = response.find(delimiter, partBegin);
+        std::string_view part = response.substr(partBegin, partEnd - partBegin);
+        partBegin = partEnd;
+
+        // Outer headers. This is where the Content-ID is.
+        size_t httpBegin = 0;
+        size_t outerEnd = find_blank_line(part, httpBegin);
+        if (outerEnd == part.npos)
+        {
+            continue;
+        }
+
+        size_t index = ordinal++;
+        std::string_view contentId = find_header(part.substr(0, outerEnd), HEADER_CONTENT_ID);
+        size_t idBegin = contentId.find(CONTENT_ID_RESPONSE);
+        if (idBegin != contentId.npos)
+        {
+            index = std::strtoul(contentId.data() + idBegin + CONTENT_ID_RESPONSE.length(), nullptr, 10);
+        }
+
+        if (index >= m_count)
+        {
+            continue;
+        }
+
+        // Status line, then the headers of the response itself, then its body.
+        std::string_view http = part.substr(httpBegin);
+        size_t codeBegin = http.find(' ');
+        if (codeBegin == http.npos)
+        {
+            continue;
+        }
+        DriveBatch::Response &current = responsesOut[index];
+        current.code = std::strtol(http.data() + codeBegin + 1, nullptr, 10);
+
+        size_t bodyBegin = 0;
+        if (find_blank_line(http, bodyBegin) == http.npos)
+        {
+            continue;
+        }
+        std::string_view body = http.substr(bodyBegin);
+        while (!body.empty() && (body.back() == '\r' || body.back() == '\n'))
+        {
+            body.remove_suffix(1);
+        }
+        current.body.assign(body);
+    }
+
+    return true;
+}
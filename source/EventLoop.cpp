@@ -0,0 +1,369 @@
+#include "EventLoop.hpp"
+#include "logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace
+{
+    /// @brief Most epoll events handled per round.
+    constexpr int MAX_EPOLL_EVENTS = 64;
+} // namespace
+
+bool EventLoop::Transfer::await_suspend(std::coroutine_handle<> awaiting)
+{
+    m_awaiting = awaiting;
+    // The loop finds its way back here through the handle once the transfer is done.
+    curl::set_option(m_handle, CURLOPT_PRIVATE, this);
+    if (curl_multi_add_handle(m_loop.m_multi.get(), m_handle.get()) != CURLM_OK)
+    {
+        logger::error("Error adding transfer to the event loop.");
+        m_result = CURLE_FAILED_INIT;
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::Sleep::await_suspend(std::coroutine_handle<> awaiting)
+{
+    m_loop.m_timers.emplace(std::chrono::steady_clock::now() + m_delay, awaiting);
+}
+
+void EventLoop::Work::await_suspend(std::coroutine_handle<> awaiting)
+{
+    m_thread = std::thread([this, awaiting](void) {
+        m_function();
+        // Nothing here is touched after this. The loop might resume the coroutine and join before it returns.
+        m_loop.post(awaiting);
+    });
+}
+
+void EventLoop::Work::await_resume(void)
+{
+    m_thread.join();
+}
+
+EventLoop::EventLoop(void) : m_multi(curl::new_multi_handle())
+{
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeup = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (!m_multi || m_epoll < 0 || m_wakeup < 0)
+    {
+        logger::error("Error creating event loop: %s.", std::strerror(errno));
+        return;
+    }
+
+    epoll_event wakeupEvent{};
+    wakeupEvent.events = EPOLLIN;
+    wakeupEvent.data.fd = m_wakeup;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &wakeupEvent);
+
+    curl_multi_setopt(m_multi.get(), CURLMOPT_SOCKETFUNCTION, EventLoop::socket_callback);
+    curl_multi_setopt(m_multi.get(), CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(m_multi.get(), CURLMOPT_TIMERFUNCTION, EventLoop::timer_callback);
+    curl_multi_setopt(m_multi.get(), CURLMOPT_TIMERDATA, this);
+
+    m_thread = std::thread(&EventLoop::run_loop, this);
+    m_threadId = m_thread.get_id();
+}
+
+EventLoop::~EventLoop()
+{
+    EventLoop::stop();
+
+    if (m_epoll >= 0)
+    {
+        close(m_epoll);
+    }
+
+    if (m_wakeup >= 0)
+    {
+        close(m_wakeup);
+    }
+}
+
+bool EventLoop::is_running(void) const
+{
+    return m_thread.joinable();
+}
+
+bool EventLoop::in_loop_thread(void) const
+{
+    return std::this_thread::get_id() == m_threadId;
+}
+
+void EventLoop::spawn(Task<void> task)
+{
+    ++m_taskCount;
+    EventLoop::post(EventLoop::run_spawned(std::move(task)).handle);
+}
+
+void EventLoop::run(Task<void> task)
+{
+    EventLoop::run_until_done(std::move(task));
+}
+
+EventLoop::Transfer EventLoop::transfer(curl::Handle &handle)
+{
+    return EventLoop::Transfer(*this, handle);
+}
+
+Task<bool> EventLoop::perform(curl::Handle &handle)
+{
+    CURLcode error = co_await EventLoop::transfer(handle);
+    if (error != CURLE_OK)
+    {
+        logger::error("Error performing CURL: %i.", error);
+        co_return false;
+    }
+    co_return true;
+}
+
+EventLoop::Sleep EventLoop::sleep_for(std::chrono::milliseconds delay)
+{
+    return EventLoop::Sleep(*this, delay);
+}
+
+void EventLoop::stop(void)
+{
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+    else if (EventLoop::in_loop_thread())
+    {
+        logger::error("Event loop can't be stopped from its own thread.");
+        return;
+    }
+
+    m_stopping = true;
+    EventLoop::wake();
+    m_thread.join();
+}
+
+void EventLoop::run_loop(void)
+{
+    // Everything spawned gets to finish before the loop exits.
+    while (!m_stopping || m_taskCount > 0)
+    {
+        EventLoop::run_once(-1);
+    }
+}
+
+void EventLoop::run_once(int maxWait)
+{
+    // Sleep until the earliest of CURL's timeout, the next timer, and maxWait.
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    int timeout = maxWait;
+    auto waitUntil = [&](std::chrono::steady_clock::time_point deadline) {
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count();
+        int milliseconds = static_cast<int>(std::max<decltype(remaining)>(remaining, 0));
+        if (timeout < 0 || milliseconds < timeout)
+        {
+            timeout = milliseconds;
+        }
+    };
+
+    if (m_curlDeadline.has_value())
+    {
+        waitUntil(*m_curlDeadline);
+    }
+
+    if (!m_timers.empty())
+    {
+        waitUntil(m_timers.begin()->first);
+    }
+
+    epoll_event events[MAX_EPOLL_EVENTS];
+    int eventCount = epoll_wait(m_epoll, events, MAX_EPOLL_EVENTS, timeout);
+    if (eventCount < 0 && errno != EINTR)
+    {
+        logger::error("Error waiting for events: %s.", std::strerror(errno));
+    }
+
+    int running = 0;
+    for (int i = 0; i < eventCount; i++)
+    {
+        if (events[i].data.fd == m_wakeup)
+        {
+            uint64_t value = 0;
+            while (read(m_wakeup, &value, sizeof(uint64_t)) > 0) {};
+            continue;
+        }
+
+        int flags = 0;
+        flags |= (events[i].events & EPOLLIN) ? CURL_CSELECT_IN : 0;
+        flags |= (events[i].events & EPOLLOUT) ? CURL_CSELECT_OUT : 0;
+        flags |= (events[i].events & (EPOLLERR | EPOLLHUP)) ? CURL_CSELECT_ERR : 0;
+        curl_multi_socket_action(m_multi.get(), events[i].data.fd, flags, &running);
+    }
+
+    // CURL's timeout. It's cleared first because socket_action can set a new one.
+    now = std::chrono::steady_clock::now();
+    if (m_curlDeadline.has_value() && *m_curlDeadline <= now)
+    {
+        m_curlDeadline.reset();
+        curl_multi_socket_action(m_multi.get(), CURL_SOCKET_TIMEOUT, 0, &running);
+    }
+
+    EventLoop::check_transfers();
+
+    // Anything resumed below can end up back in here through run. Handles are taken off the queues one at a time so
+    // whatever is still waiting can be resumed by that nested run instead of being held until it returns.
+    while (!m_timers.empty() && m_timers.begin()->first <= now)
+    {
+        std::coroutine_handle<> handle = m_timers.begin()->second;
+        m_timers.erase(m_timers.begin());
+        handle.resume();
+    }
+
+    // Only as many as were already posted. Anything posted while resuming waits for the next pass.
+    size_t postedCount = 0;
+    {
+        std::lock_guard<std::mutex> postGuard(m_postLock);
+        postedCount = m_posted.size();
+    }
+
+    for (size_t i = 0; i < postedCount; i++)
+    {
+        std::coroutine_handle<> handle{};
+        {
+            std::lock_guard<std::mutex> postGuard(m_postLock);
+            if (m_posted.empty())
+            {
+                break;
+            }
+            handle = m_posted.front();
+            m_posted.pop_front();
+        }
+        handle.resume();
+    }
+}
+
+void EventLoop::check_transfers(void)
+{
+    std::vector<EventLoop::Transfer *> finished{};
+    int messagesLeft = 0;
+    CURLMsg *message = nullptr;
+    while ((message = curl_multi_info_read(m_multi.get(), &messagesLeft)))
+    {
+        if (message->msg != CURLMSG_DONE)
+        {
+            continue;
+        }
+
+        EventLoop::Transfer *transfer = nullptr;
+        curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &transfer);
+        transfer->m_result = message->data.result;
+        curl::record_transfer(message->easy_handle, message->data.result);
+        curl_multi_remove_handle(m_multi.get(), message->easy_handle);
+        finished.push_back(transfer);
+    }
+
+    // Resumed coroutines are free to reuse their handles right away, so this waits until they're all removed. They're
+    // posted instead of resumed here so one that runs the loop itself doesn't hold up the rest.
+    for (EventLoop::Transfer *transfer : finished)
+    {
+        EventLoop::post(transfer->m_awaiting);
+    }
+}
+
+void EventLoop::post(std::coroutine_handle<> handle)
+{
+    {
+        std::lock_guard<std::mutex> postGuard(m_postLock);
+        m_posted.push_back(handle);
+    }
+    EventLoop::wake();
+}
+
+void EventLoop::wake(void)
+{
+    uint64_t value = 1;
+    if (write(m_wakeup, &value, sizeof(uint64_t)) < 0 && errno != EAGAIN)
+    {
+        logger::error("Error waking event loop: %s.", std::strerror(errno));
+    }
+}
+
+task::Deferred EventLoop::run_spawned(Task<void> task)
+{
+    co_await task;
+    --m_taskCount;
+}
+
+Task<void> EventLoop::signal_done(Task<void> task, bool &done)
+{
+    co_await task;
+    {
+        std::lock_guard<std::mutex> doneGuard(m_doneLock);
+        done = true;
+    }
+    m_doneSignal.notify_all();
+}
+
+void EventLoop::run_until_done(Task<void> task)
+{
+    bool done = false;
+    EventLoop::spawn(EventLoop::signal_done(std::move(task), done));
+
+    // From the loop's own thread, waiting would never end. The loop is run from here instead.
+    if (EventLoop::in_loop_thread())
+    {
+        while (!done)
+        {
+            EventLoop::run_once(-1);
+        }
+        return;
+    }
+
+    std::unique_lock<std::mutex> doneGuard(m_doneLock);
+    m_doneSignal.wait(doneGuard, [&done]() { return done; });
+}
+
+int EventLoop::socket_callback(CURL *handle, curl_socket_t socket, int what, EventLoop *loop, void *socketData)
+{
+    (void)handle;
+
+    if (what == CURL_POLL_REMOVE)
+    {
+        epoll_ctl(loop->m_epoll, EPOLL_CTL_DEL, socket, nullptr);
+        curl_multi_assign(loop->m_multi.get(), socket, nullptr);
+        return 0;
+    }
+
+    epoll_event event{};
+    event.events |= (what & CURL_POLL_IN) ? static_cast<uint32_t>(EPOLLIN) : 0;
+    event.events |= (what & CURL_POLL_OUT) ? static_cast<uint32_t>(EPOLLOUT) : 0;
+    event.data.fd = socket;
+
+    // socketData is only set for sockets that were already added.
+    int operation = socketData ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(loop->m_epoll, operation, socket, &event) != 0 &&
+        (errno != EEXIST || epoll_ctl(loop->m_epoll, EPOLL_CTL_MOD, socket, &event) != 0))
+    {
+        logger::error("Error watching socket: %s.", std::strerror(errno));
+        return -1;
+    }
+    curl_multi_assign(loop->m_multi.get(), socket, loop);
+
+    return 0;
+}
+
+int EventLoop::timer_callback(CURLM *multi, long timeout, EventLoop *loop)
+{
+    (void)multi;
+
+    if (timeout < 0)
+    {
+        loop->m_curlDeadline.reset();
+    }
+    else
+    {
+        loop->m_curlDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    }
+
+    return 0;
+}
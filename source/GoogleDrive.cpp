@@ -1,14 +1,29 @@
 #include "GoogleDrive.hpp"
+#include "DriveBatch.hpp"
+#include "ListingParser.hpp"
+#include "Snapshot.hpp"
+#include "compression.hpp"
+#include "hasher.hpp"
 #include "json.hpp"
 #include "logger.hpp"
+#include "md5.hpp"
+#include "metrics.hpp"
+#include "stringutil.hpp"
 #include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <cinttypes>
 #include <cstdio>
 #include <cstring>
+#include <deque>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <random>
+#include <spanstream>
 #include <string>
-#include <thread>
+#include <unistd.h>
+#include <unordered_set>
 
 namespace
 {
@@ -19,21 +34,35 @@ namespace
     constexpr std::string_view HEADER_CONTENT_TYPE_JSON = "Content-Type: application/json";
     /// @brief Header string for URL encoded requests.
     constexpr std::string_view HEADER_CONTENT_TYPE_URL_ENCODED = "Content-Type: application/x-www-form-urlencoded";
+    /// @brief Name of the Content-Type header for reading it from responses.
+    constexpr std::string_view HEADER_NAME_CONTENT_TYPE = "Content-Type";
     /// @brief Authorization header string that is appended with the token after it's received.
     constexpr std::string_view HEADER_AUTHORIZATION_BEARER = "Authorization: Bearer ";
 
-    /// @brief Format string for getting the initial login code.
-    constexpr std::string_view URL_OAUTH2_DEVICE_CODE_FORMAT = "https://oauth2.googleapis.com/device/code";
-    /// @brief This is the OAUTH2 token URL.
-    constexpr std::string_view URL_OAUTH2_TOKEN_URL = "https://oauth2.googleapis.com/token";
+    /// @brief Base URL of Google's OAUTH2 endpoints unless the config says otherwise.
+    constexpr std::string_view URL_DEFAULT_OAUTH2_BASE = "https://oauth2.googleapis.com";
+    /// @brief Base URL of the Drive API unless the config says otherwise.
+    constexpr std::string_view URL_DEFAULT_DRIVE_BASE = "https://www.googleapis.com";
+
+    /// @brief Path for getting the initial login code.
+    constexpr std::string_view PATH_OAUTH2_DEVICE_CODE = "/device/code";
+    /// @brief This is the OAUTH2 token path.
+    constexpr std::string_view PATH_OAUTH2_TOKEN = "/token";
     /// @brief This endpoint is used once when first initializing Drive to get the ID of the root directory.
     /** @note Version 3 of Google's API doesn't support that and expects you to always use the alias root
      * for the root directory, which doesn't work with how I want this written. */
-    constexpr std::string_view URL_DRIVE_ABOUT_API = "https://www.googleapis.com/drive/v2/about";
-    /// @brief This is the main drive api endpoint used for pretty much everything?
-    constexpr std::string_view URL_DRIVE_FILE_API = "https://www.googleapis.com/drive/v3/files";
-    /// @brief API URL for starting file uploads.
-    constexpr std::string_view URL_DRIVE_UPLOAD_API = "https://www.googleapis.com/upload/drive/v3/files";
+    constexpr std::string_view PATH_DRIVE_ABOUT_API = "/drive/v2/about";
+    /// @brief This is the main drive api endpoint used for pretty much everything? This is also the path used inside
+    /// of batch requests.
+    constexpr std::string_view PATH_DRIVE_FILE_API = "/drive/v3/files";
+    /// @brief Endpoint for getting the starting page token for the changes feed.
+    constexpr std::string_view PATH_DRIVE_CHANGES_TOKEN_API = "/drive/v3/changes/startPageToken";
+    /// @brief Endpoint for the changes feed.
+    constexpr std::string_view PATH_DRIVE_CHANGES_API = "/drive/v3/changes";
+    /// @brief Endpoint batch requests are sent to.
+    constexpr std::string_view PATH_DRIVE_BATCH_API = "/batch/drive/v3";
+    /// @brief API path for starting file uploads.
+    constexpr std::string_view PATH_DRIVE_UPLOAD_API = "/upload/drive/v3/files";
 
     /// @brief Drive.file scope.
     constexpr std::string_view PARAM_DRIVE_FILE_SCOPE = "https://www.googleapis.com/auth/drive.file";
@@ -41,7 +70,19 @@ namespace
     constexpr std::string_view PARAM_POLL_GRANT_TYPE = "urn:ietf:params:oauth:grant-type:device_code";
     /// @brief These are the base query parameters for getting drive listings.
     constexpr std::string_view PARAM_DEFAULT_LIST_QUERY =
-        "fields=nextPageToken,files(name,id,size,parents,mimeType)&orderBy=name_natural&pageSize=256&q=trashed=false";
+        "fields=nextPageToken,files(name,id,size,parents,mimeType,modifiedTime,md5Checksum,appProperties)&"
+        "orderBy=name_natural&pageSize=256&q=trashed=false";
+    /// @brief Query parameters for listing the children of a single folder. The folder ID goes between this and
+    /// PARAM_FOLDER_LIST_QUERY_END.
+    constexpr std::string_view PARAM_FOLDER_LIST_QUERY =
+        "fields=nextPageToken,files(name,id,size,parents,mimeType,modifiedTime,md5Checksum,appProperties)&"
+        "pageSize=1000&q=trashed%3Dfalse%20and%20%27";
+    /// @brief Closes the folder list query.
+    constexpr std::string_view PARAM_FOLDER_LIST_QUERY_END = "%27%20in%20parents";
+    /// @brief Query parameters for reading the changes feed.
+    constexpr std::string_view PARAM_DEFAULT_CHANGES_QUERY =
+        "fields=nextPageToken,newStartPageToken,changes(fileId,removed,file(name,id,size,parents,mimeType,"
+        "modifiedTime,md5Checksum,appProperties,trashed))&pageSize=1000";
 
     // These are various keys I use repeatedly.
     constexpr std::string_view JSON_KEY_ACCESS_TOKEN = "access_token";
@@ -65,23 +106,457 @@ namespace
     constexpr std::string_view JSON_KEY_NAME = "name";
     /// @brief Key for the nextPageToken for reading listings.
     constexpr std::string_view JSON_KEY_NEXT_PAGE_TOKEN = "nextPageToken";
+    /// @brief Key for the token the changes feed should continue from once it's been read to the end.
+    constexpr std::string_view JSON_KEY_NEW_START_PAGE_TOKEN = "newStartPageToken";
+    /// @brief Key for the page token returned by changes.getStartPageToken.
+    constexpr std::string_view JSON_KEY_START_PAGE_TOKEN = "startPageToken";
     /// @brief Key for the parents array that doesn't need to be an array.
     constexpr std::string_view JSON_KEY_PARENTS = "parents";
+    /// @brief Size key.
+    constexpr std::string_view JSON_KEY_SIZE = "size";
+    /// @brief MD5 checksum key.
+    constexpr std::string_view JSON_KEY_MD5_CHECKSUM = "md5Checksum";
+    /// @brief JSON key for a file's last modification time.
+    constexpr std::string_view JSON_KEY_MODIFIED_TIME = "modifiedTime";
+    /// @brief JSON key for the private properties this app keeps on a file.
+    constexpr std::string_view JSON_KEY_APP_PROPERTIES = "appProperties";
     /// @brief Refresh token key.
     constexpr std::string_view JSON_KEY_REFRESH_TOKEN = "refresh_token";
     /// @brief Key for the time remaining for the token.
     constexpr std::string_view JSON_KEY_EXPIRES_IN = "expires_in";
+    /// @brief Optional config key for the number of files uploaded at once by upload_files and sync.
+    constexpr std::string_view JSON_KEY_UPLOAD_CONCURRENCY = "upload_concurrency";
+    /// @brief Optional config key for the number of connections large downloads are split across.
+    constexpr std::string_view JSON_KEY_DOWNLOAD_CONCURRENCY = "download_concurrency";
+    /// @brief Optional config key for the size of the chunks files are uploaded in.
+    constexpr std::string_view JSON_KEY_UPLOAD_CHUNK_SIZE = "upload_chunk_size";
+    /// @brief Optional config key for the number of concurrent listing requests.
+    constexpr std::string_view JSON_KEY_LISTING_CONCURRENCY = "listing_concurrency";
+    /// @brief Optional config key for the listing mode. "lazy" only lists folders as they're needed.
+    constexpr std::string_view JSON_KEY_LISTING_MODE = "listing_mode";
+    /// @brief Optional config key for the memory budget of cached folder listings in lazy mode.
+    constexpr std::string_view JSON_KEY_LISTING_CACHE_BUDGET = "listing_cache_budget";
+    /// @brief Optional config key for the codec uploads are compressed with. "zstd" is the only one.
+    constexpr std::string_view JSON_KEY_COMPRESSION = "compression";
+    /// @brief Optional config key for the level uploads are compressed at.
+    constexpr std::string_view JSON_KEY_COMPRESSION_LEVEL = "compression_level";
+    /// @brief Optional config key for the most requests the rate controller lets run at once.
+    constexpr std::string_view JSON_KEY_MAX_CONCURRENT_REQUESTS = "max_concurrent_requests";
+    /// @brief Optional config key for the base URL of the Drive API. This is for pointing at a stand-in server.
+    constexpr std::string_view JSON_KEY_DRIVE_BASE_URL = "drive_base_url";
+    /// @brief Optional config key for the base URL of the OAUTH2 endpoints.
+    constexpr std::string_view JSON_KEY_OAUTH2_BASE_URL = "oauth2_base_url";
 
     /// @brief This is the mimetype string for folders.
     constexpr std::string_view MIME_TYPE_DIRECTORY = "application/vnd.google-apps.folder";
+
+    /// @brief Drive's alias for the root folder. Listing it tells us the real root ID without asking for it.
+    constexpr std::string_view ALIAS_ROOT = "root";
+    /// @brief Value of listing_mode that enables lazy listing.
+    constexpr std::string_view LISTING_MODE_LAZY = "lazy";
+
+    /// @brief Fields requested for directories created in a batch.
+    constexpr std::string_view PARAM_BATCH_CREATE_QUERY = "fields=id";
+    /// @brief Fields requested for items renamed or moved in a batch. This is enough to update the catalog.
+    constexpr std::string_view PARAM_BATCH_UPDATE_QUERY =
+        "fields=id,name,size,parents,mimeType,modifiedTime,md5Checksum,appProperties";
+
+    /// @brief Fields returned once an upload completes. The checksum lets the uploader verify what Drive got.
+    constexpr std::string_view PARAM_UPLOAD_QUERY =
+        "fields=id,name,size,mimeType,modifiedTime,md5Checksum,appProperties";
+
+    /// @brief Query parameters for the metadata needed to download and verify a file.
+    constexpr std::string_view PARAM_FILE_METADATA_QUERY = "fields=size,md5Checksum,appProperties";
+
+    /// @brief Size of the buffer downloads are written to disk through.
+    constexpr size_t SIZE_DOWNLOAD_BUFFER = 0x100000;
+
+    /// @brief Rough size of the buffers an upload streamed straight from its file holds: curl's and the file's.
+    constexpr size_t SIZE_UPLOAD_STREAM_BUFFERS = 0x20000;
+
+    /// @brief Upload chunks need to be a multiple of this. Only the last one can be smaller.
+    constexpr uint64_t SIZE_UPLOAD_CHUNK_ALIGNMENT = 0x40000;
+
+    /// @brief Status Google returns when a chunk was received, but the upload isn't complete.
+    constexpr long HTTP_RESUME_INCOMPLETE = 308;
+
+    /// @brief Size passed to upload_chunk while the total size of a compressed upload isn't known yet.
+    constexpr uint64_t SIZE_UNKNOWN = UINT64_MAX;
+
+    /// @brief Smallest range a download is split into. Files under twice this are downloaded in one stream.
+    constexpr uint64_t SIZE_MIN_DOWNLOAD_SEGMENT = 0x800000;
+
+    /// @brief Largest range a download is split into.
+    constexpr uint64_t SIZE_MAX_DOWNLOAD_SEGMENT = 0x4000000;
+
+    /// @brief Target number of segments per connection so connections that finish early can pick up more work.
+    constexpr uint64_t DOWNLOAD_SEGMENTS_PER_CONNECTION = 4;
+
+    /// @brief Status returned for a successful range request.
+    constexpr long HTTP_PARTIAL_CONTENT = 206;
+
+    /// @brief Names tried for a download's temporary file before giving up.
+    constexpr int MAX_TEMPORARY_ATTEMPTS = 16;
+
+    /// @brief Upper limit for concurrent uploads and download connections.
+    constexpr int MAX_TRANSFER_CONCURRENCY = 16;
+
+    /// @brief Upper limit for concurrent listing requests.
+    constexpr int MAX_LISTING_CONCURRENCY = 64;
+
+    /// @brief Upper limit for max_concurrent_requests.
+    constexpr int MAX_REQUEST_CONCURRENCY = 128;
+
+    /// @brief Number of times in a row a request can fail before giving up on it. Uploads and downloads only count
+    /// failures since they last made progress.
+    constexpr int MAX_REQUEST_RETRIES = 8;
+
+    /// @brief How often tasks waiting on the rate controller check whether a slot is free.
+    constexpr std::chrono::milliseconds REQUEST_SLOT_WAIT{10};
+
+    /// @brief How often tasks waiting on another task's token refresh check whether it's done.
+    constexpr std::chrono::milliseconds TOKEN_REFRESH_WAIT{50};
+
+    /// @brief State of a download being streamed to disk.
+    struct DownloadTarget
+    {
+            /// @brief Descriptor of the file being written.
+            int descriptor;
+
+            /// @brief Offset in the file the download starts at.
+            uint64_t offset = 0;
+
+            /// @brief Most bytes the download should write. Anything past this means the server ignored the range.
+            uint64_t limit = UINT64_MAX;
+
+            /// @brief Buffer data is collected in before being written.
+            std::unique_ptr<char[]> buffer;
+
+            /// @brief Number of bytes in buffer.
+            size_t bufferUsed = 0;
+
+            /// @brief Number of bytes written to the file so far.
+            uint64_t written = 0;
+
+            /// @brief Number of bytes received so far, before decompression.
+            uint64_t received = 0;
+
+            /// @brief Optional MD5 of everything received so far. Ranges arrive out of order, so they're not hashed.
+            md5::Context *md5 = nullptr;
+
+            /// @brief Optional decompressor for files stored compressed. What's received is hashed before this.
+            compression::Decompressor *decompressor = nullptr;
+
+            /// @brief For range requests, the handle to check the response code of before writing anything.
+            CURL *rangeHandle = nullptr;
+
+            /// @brief Whether the response code was checked for the current request.
+            bool checkedRange = false;
+
+            /// @brief Whether the server answered a range request with something other than partial content.
+            bool rangeIgnored = false;
+    };
+
+    /// @brief Copy of what sync needs to know about a remote item. Items are views that don't survive the catalog
+    /// changing.
+    struct SyncItem
+    {
+            /// @brief ID of the item.
+            std::string id;
+
+            /// @brief Size of the item.
+            uint64_t size;
+
+            /// @brief Modification time in milliseconds since the Unix epoch.
+            int64_t modifiedTime;
+
+            /// @brief Hex MD5 checksum. Empty if Drive doesn't have one.
+            std::string md5Checksum;
+    };
+
+    /// @brief A file sync needs to upload.
+    struct SyncUpload
+    {
+            /// @brief Local path of the file.
+            std::filesystem::path path;
+
+            /// @brief ID of the folder to upload to.
+            std::string parent;
+
+            /// @brief ID of the file being replaced. Empty for new files.
+            std::string id;
+
+            /// @brief md5Checksum of the file being replaced. Set while it's still unknown whether it changed.
+            std::string md5Checksum;
+    };
+
+    /// @brief Reads the codec and uncompressed size of a file from its appProperties.
+    /// @return True if the file is stored compressed. False if it isn't.
+    bool read_compression(json_object *file, std::string_view &codecOut, uint64_t &sizeOut)
+    {
+        json_object *appProperties = json_object_object_get(file, JSON_KEY_APP_PROPERTIES.data());
+        json_object *codec = json_object_object_get(appProperties, compression::PROPERTY_CODEC.data());
+        json_object *size = json_object_object_get(appProperties, compression::PROPERTY_SIZE.data());
+        if (!codec)
+        {
+            return false;
+        }
+        codecOut = json_object_get_string(codec);
+        sizeOut = size ? std::strtoull(json_object_get_string(size), nullptr, 10) : 0;
+        return true;
+    }
+
+    /// @brief Reads the optional size, modification time, and checksum of a file resource. For compressed files, the
+    /// size is the uncompressed size and there's no checksum, since Drive's is of the compressed data.
+    void read_file_metadata(json_object *file, uint64_t &sizeOut, int64_t &modifiedTimeOut, std::string_view &md5Out)
+    {
+        json_object *size = json_object_object_get(file, JSON_KEY_SIZE.data());
+        json_object *modifiedTime = json_object_object_get(file, JSON_KEY_MODIFIED_TIME.data());
+        json_object *md5Checksum = json_object_object_get(file, JSON_KEY_MD5_CHECKSUM.data());
+
+        sizeOut = size ? std::strtoull(json_object_get_string(size), nullptr, 10) : 0;
+        modifiedTimeOut = 0;
+        if (modifiedTime)
+        {
+            stringutil::parse_timestamp(json_object_get_string(modifiedTime), modifiedTimeOut);
+        }
+        md5Out = md5Checksum ? json_object_get_string(md5Checksum) : std::string_view{};
+
+        std::string_view codec{};
+        if (read_compression(file, codec, sizeOut))
+        {
+            md5Out = {};
+        }
+    }
+
+    /// @brief Returns the modification time of a local file in milliseconds since the Unix epoch.
+    int64_t get_local_modified_time(const std::filesystem::path &path, std::error_code &error)
+    {
+        std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+        std::chrono::system_clock::time_point systemTime = std::chrono::file_clock::to_sys(time);
+        return std::chrono::floor<std::chrono::milliseconds>(systemTime.time_since_epoch()).count();
+    }
+
+    /// @brief Drops the part of a compressed upload chunk Google committed and compresses more in behind what's left.
+    /// @return True on success. False if compressing failed or Google committed something outside of the chunk.
+    bool fill_compressed_chunk(compression::Compressor &compressor,
+                               md5::Context *compressedMd5,
+                               char *chunk,
+                               size_t chunkSize,
+                               uint64_t &chunkOffset,
+                               size_t &chunkUsed,
+                               uint64_t committed)
+    {
+        if (committed < chunkOffset || committed > chunkOffset + chunkUsed)
+        {
+            logger::error("Upload session committed offset %" PRIu64 " outside of the chunk being sent.", committed);
+            return false;
+        }
+
+        size_t dropped = committed - chunkOffset;
+        std::memmove(chunk, chunk + dropped, chunkUsed - dropped);
+        chunkUsed -= dropped;
+        chunkOffset = committed;
+
+        // Only the last chunk can be short.
+        while (chunkUsed < chunkSize && !compressor.is_finished() && !compressor.has_failed())
+        {
+            size_t compressed = compressor.read(chunk + chunkUsed, chunkSize - chunkUsed);
+            if (compressedMd5)
+            {
+                compressedMd5->update(chunk + chunkUsed, compressed);
+            }
+            chunkUsed += compressed;
+        }
+        return !compressor.has_failed();
+    }
+
+    /// @brief Writes whatever is in the target's buffer to its file.
+    bool flush_download_target(DownloadTarget &target)
+    {
+        size_t offset = 0;
+        while (offset < target.bufferUsed)
+        {
+            ssize_t written = pwrite(target.descriptor,
+                                     target.buffer.get() + offset,
+                                     target.bufferUsed - offset,
+                                     target.offset + target.written + offset);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else if (written <= 0)
+            {
+                logger::error("Error writing download: %s.", std::strerror(errno));
+                return false;
+            }
+            offset += written;
+        }
+        target.written += target.bufferUsed;
+        target.bufferUsed = 0;
+        return true;
+    }
+
+    /// @brief Curl callback that hashes incoming data and writes it through the target's buffer, decompressing it on
+    /// the way if needed.
+    size_t write_download_target(const char *buffer, size_t size, size_t count, DownloadTarget *target)
+    {
+        size_t length = size * count;
+
+        // A 200 means the whole file is coming instead of the range, which would be written at the wrong offset.
+        long code = 0;
+        if (target->rangeHandle && !target->checkedRange)
+        {
+            curl_easy_getinfo(target->rangeHandle, CURLINFO_RESPONSE_CODE, &code);
+            if (code != HTTP_PARTIAL_CONTENT)
+            {
+                logger::warning("Range request returned %li instead of partial content.", code);
+                target->rangeIgnored = true;
+                return 0;
+            }
+            target->checkedRange = true;
+        }
+
+        if (target->written + target->bufferUsed + length > target->limit)
+        {
+            return 0;
+        }
+        target->received += length;
+
+        if (target->md5)
+        {
+            target->md5->update(buffer, length);
+        }
+
+        // Decompressed data can be much bigger than what came in. It's flushed every time the buffer fills up.
+        if (target->decompressor)
+        {
+            const char *data = buffer;
+            size_t remaining = length;
+            while (true)
+            {
+                if (!target->decompressor->decompress(data,
+                                                      remaining,
+                                                      target->buffer.get(),
+                                                      SIZE_DOWNLOAD_BUFFER,
+                                                      target->bufferUsed))
+                {
+                    return 0;
+                }
+                else if (target->bufferUsed < SIZE_DOWNLOAD_BUFFER)
+                {
+                    break;
+                }
+                else if (!flush_download_target(*target))
+                {
+                    return 0;
+                }
+            }
+            return length;
+        }
+
+        for (size_t offset = 0; offset < length;)
+        {
+            size_t toCopy = std::min(length - offset, SIZE_DOWNLOAD_BUFFER - target->bufferUsed);
+            std::memcpy(target->buffer.get() + target->bufferUsed, buffer + offset, toCopy);
+            target->bufferUsed += toCopy;
+            offset += toCopy;
+
+            // Returning less than length makes curl abort.
+            if (target->bufferUsed == SIZE_DOWNLOAD_BUFFER && !flush_download_target(*target))
+            {
+                return 0;
+            }
+        }
+        return length;
+    }
+
+    /// @brief Hashes the first size bytes of the file open as descriptor.
+    bool hash_file(int descriptor, uint64_t size, md5::Digest &digestOut)
+    {
+        md5::Context context{};
+        std::unique_ptr<char[]> buffer = std::make_unique<char[]>(SIZE_DOWNLOAD_BUFFER);
+        for (uint64_t offset = 0; offset < size;)
+        {
+            size_t toRead = std::min<uint64_t>(SIZE_DOWNLOAD_BUFFER, size - offset);
+            ssize_t bytesRead = pread(descriptor, buffer.get(), toRead, offset);
+            if (bytesRead < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else if (bytesRead <= 0)
+            {
+                return false;
+            }
+            context.update(buffer.get(), bytesRead);
+            offset += bytesRead;
+        }
+        digestOut = context.finish();
+        return true;
+    }
+
+    /// @brief Creates a temporary file next to path that didn't exist before. Nothing already on disk is ever opened,
+    /// so neither a user's file nor another download to the same path can be written through.
+    /// @param path Path the temporary file is for.
+    /// @param temporaryPathOut Path of the file created.
+    /// @return Descriptor of the file on success. -1 on failure.
+    int open_temporary(const std::filesystem::path &path, std::filesystem::path &temporaryPathOut)
+    {
+        std::random_device device{};
+        for (int attempt = 0; attempt < MAX_TEMPORARY_ATTEMPTS; attempt++)
+        {
+            char suffix[32] = {0};
+            std::snprintf(suffix, sizeof(suffix), ".%08x.tmp", device());
+            temporaryPathOut = path;
+            temporaryPathOut += suffix;
+
+            int descriptor = open(temporaryPathOut.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+            if (descriptor >= 0 || errno != EEXIST)
+            {
+                return descriptor;
+            }
+        }
+        errno = EEXIST;
+        return -1;
+    }
+
+    /// @brief Path of the catalog snapshot.
+    constexpr std::string_view PATH_CATALOG_SNAPSHOT = "./drive_catalog.bin";
+
+    /// @brief Publishes the limit and requests in flight of rateController.
+    void record_rate_controller(const RateController &rateController)
+    {
+        static metrics::Gauge &limit =
+            metrics::gauge("drive_request_limit", "Requests the rate controller currently allows in flight.");
+        static metrics::Gauge &inFlight = metrics::gauge("drive_requests_in_flight", "Requests currently in flight.");
+        limit.set(rateController.get_limit());
+        inFlight.set(rateController.get_in_flight());
+    }
+
+    /// @brief Counts how a request went.
+    void record_outcome(RateController::Outcome outcome)
+    {
+        static constexpr std::string_view HELP = "Drive requests by how the rate controller classified them.";
+        static metrics::Counter *outcomes[] = {
+            &metrics::counter("drive_request_outcomes_total", HELP, "outcome=\"success\""),
+            &metrics::counter("drive_request_outcomes_total", HELP, "outcome=\"retryable\""),
+            &metrics::counter("drive_request_outcomes_total", HELP, "outcome=\"throttled\""),
+            &metrics::counter("drive_request_outcomes_total", HELP, "outcome=\"fatal\"")};
+        outcomes[static_cast<int>(outcome)]->add();
+    }
 } // namespace
 
-GoogleDrive::GoogleDrive(std::string_view configFile) : m_curl(curl::new_handle())
+GoogleDrive::GoogleDrive(std::string_view configFile)
 {
+    if (!m_loop.is_running())
+    {
+        return;
+    }
+
     json::Object clientJson = json::new_object(json_object_from_file, configFile.data());
     if (!clientJson)
     {
-        logger::log("Error reading Google Drive configuration!");
+        logger::error("Error reading Google Drive configuration!");
         return;
     }
 
@@ -89,7 +564,7 @@ GoogleDrive::GoogleDrive(std::string_view configFile) : m_curl(curl::new_handle(
     json_object *installed = json_object_object_get(clientJson.get(), JSON_KEY_INSTALLED.data());
     if (!installed)
     {
-        logger::log("Drive configuration is invalid!");
+        logger::error("Drive configuration is invalid!");
         return;
     }
 
@@ -97,12 +572,83 @@ GoogleDrive::GoogleDrive(std::string_view configFile) : m_curl(curl::new_handle(
     json_object *clientSecret = json_object_object_get(installed, JSON_KEY_CLIENT_SECRET.data());
     if (!clientId || !clientSecret)
     {
-        logger::log("Drive configuration is corrupted or invalid.");
+        logger::error("Drive configuration is corrupted or invalid.");
         return;
     }
     m_clientId = json_object_get_string(clientId);
     m_clientSecret = json_object_get_string(clientSecret);
 
+    // Optional settings.
+    json_object *listingConcurrency = json_object_object_get(installed, JSON_KEY_LISTING_CONCURRENCY.data());
+    if (listingConcurrency)
+    {
+        m_listingConcurrency =
+            std::clamp(static_cast<int>(json_object_get_int64(listingConcurrency)), 1, MAX_LISTING_CONCURRENCY);
+    }
+
+    json_object *uploadConcurrency = json_object_object_get(installed, JSON_KEY_UPLOAD_CONCURRENCY.data());
+    if (uploadConcurrency)
+    {
+        m_uploadConcurrency =
+            std::clamp(static_cast<int>(json_object_get_int64(uploadConcurrency)), 1, MAX_TRANSFER_CONCURRENCY);
+    }
+
+    json_object *downloadConcurrency = json_object_object_get(installed, JSON_KEY_DOWNLOAD_CONCURRENCY.data());
+    if (downloadConcurrency)
+    {
+        m_downloadConcurrency =
+            std::clamp(static_cast<int>(json_object_get_int64(downloadConcurrency)), 1, MAX_TRANSFER_CONCURRENCY);
+    }
+
+    json_object *maxConcurrentRequests = json_object_object_get(installed, JSON_KEY_MAX_CONCURRENT_REQUESTS.data());
+    if (maxConcurrentRequests)
+    {
+        m_rateController.set_max_limit(
+            std::clamp(static_cast<int>(json_object_get_int64(maxConcurrentRequests)), 1, MAX_REQUEST_CONCURRENCY));
+    }
+
+    json_object *uploadChunkSize = json_object_object_get(installed, JSON_KEY_UPLOAD_CHUNK_SIZE.data());
+    if (uploadChunkSize)
+    {
+        // Round down to what Google will accept.
+        uint64_t chunkSize = json_object_get_uint64(uploadChunkSize);
+        m_uploadChunkSize =
+            std::max(chunkSize - (chunkSize % SIZE_UPLOAD_CHUNK_ALIGNMENT), SIZE_UPLOAD_CHUNK_ALIGNMENT);
+    }
+
+    json_object *listingMode = json_object_object_get(installed, JSON_KEY_LISTING_MODE.data());
+    m_lazyListing = listingMode && json_object_get_string(listingMode) == LISTING_MODE_LAZY;
+
+    json_object *listingCacheBudget = json_object_object_get(installed, JSON_KEY_LISTING_CACHE_BUDGET.data());
+    if (listingCacheBudget)
+    {
+        m_listingCacheBudget = json_object_get_uint64(listingCacheBudget);
+    }
+
+    json_object *compression = json_object_object_get(installed, JSON_KEY_COMPRESSION.data());
+    if (compression && !compression::parse_codec(json_object_get_string(compression), m_compression))
+    {
+        logger::warning("Unsupported compression codec %s. Uploads won't be compressed.",
+                        json_object_get_string(compression));
+    }
+
+    json_object *compressionLevel = json_object_object_get(installed, JSON_KEY_COMPRESSION_LEVEL.data());
+    if (compressionLevel)
+    {
+        m_compressionLevel = std::clamp(static_cast<int>(json_object_get_int64(compressionLevel)),
+                                        ZSTD_minCLevel(),
+                                        ZSTD_maxCLevel());
+    }
+
+    json_object *driveBaseUrl = json_object_object_get(installed, JSON_KEY_DRIVE_BASE_URL.data());
+    json_object *oauth2BaseUrl = json_object_object_get(installed, JSON_KEY_OAUTH2_BASE_URL.data());
+    GoogleDrive::set_base_urls(driveBaseUrl ? json_object_get_string(driveBaseUrl) : URL_DEFAULT_DRIVE_BASE,
+                               oauth2BaseUrl ? json_object_get_string(oauth2BaseUrl) : URL_DEFAULT_OAUTH2_BASE);
+
+    // Both hosts are about to be hit one after the other. Opening both connections at once saves a round of DNS and
+    // TLS on the critical path.
+    curl::warm_up({m_urlToken, m_urlFiles});
+
     // Check if the refresh_token is appended.
     json_object *refreshToken = json_object_object_get(installed, JSON_KEY_REFRESH_TOKEN.data());
     if (refreshToken)
@@ -114,9 +660,9 @@ GoogleDrive::GoogleDrive(std::string_view configFile) : m_curl(curl::new_handle(
             return;
         }
     }
-    else if (!refreshToken && GoogleDrive::sign_in()) // If the refresh token isn't in the config and sign_in succeeds.
+    else if (!refreshToken && m_loop.run(GoogleDrive::sign_in()))
     {
-        // Append the refresh token to the config.
+        // The refresh token wasn't in the config, so sign_in got one. Append it to the config.
         json_object *refreshToken = json_object_new_string(m_refreshToken.c_str());
         json_object_object_add(installed, JSON_KEY_REFRESH_TOKEN.data(), refreshToken);
 
@@ -129,137 +675,264 @@ GoogleDrive::GoogleDrive(std::string_view configFile) : m_curl(curl::new_handle(
         // Write
         driveConfig << json_object_get_string(clientJson.get());
 
-        logger::log("Refresh token written.");
+        logger::info("Refresh token written.");
     }
     else // Should always bail in this case.
     {
         return;
     }
 
-    // The root ID is needed to make sure this all operates as it should.
-    if (!GoogleDrive::get_set_root_id() || !GoogleDrive::request_listing())
+    // Lazy mode only needs the root folder. Listing it through the alias gets the root ID for free most of the time.
+    if (m_lazyListing)
     {
-        return;
+        if (!m_loop.run(GoogleDrive::request_folder_listing(std::string(ALIAS_ROOT))) ||
+            (m_root.empty() && !m_loop.run(GoogleDrive::get_set_root_id())))
+        {
+            return;
+        }
+        m_parent = m_root;
+        GoogleDrive::mark_folder_loaded(m_root);
+    }
+    // A good snapshot only needs whatever changed since it was written. Otherwise, the root ID is needed to make sure
+    // this all operates as it should and the full listing needs to be requested.
+    else if (!GoogleDrive::load_snapshot() || !GoogleDrive::refresh())
+    {
+        if (!m_loop.run(GoogleDrive::get_set_root_id()) || !m_loop.run(GoogleDrive::request_listing()))
+        {
+            return;
+        }
+        GoogleDrive::save_snapshot();
     }
 
     m_isInitialized = true;
 }
 
+GoogleDrive::~GoogleDrive()
+{
+    // Anything still running in the background gets to finish before the catalog is saved.
+    m_loop.stop();
+
+    // Only save if the catalog is actually complete.
+    if (m_isInitialized && !m_lazyListing)
+    {
+        GoogleDrive::save_snapshot();
+    }
+}
+
 void GoogleDrive::change_directory(std::string_view name)
 {
-    // This is the iterator.
-    Storage::ItemIterator targetDir;
-    if (name == ".." && (targetDir = GoogleDrive::find_directory_by_id(m_parent)) != m_list.end())
+    // This is the index of the target.
+    Storage::ItemIndex targetDir;
+    if (name == ".." && (targetDir = GoogleDrive::find_directory_by_id(m_parent)) != Catalog::NOT_FOUND)
     {
         // Set the parent to the parent of our current parent.
-        m_parent = targetDir->get_parent_id();
+        m_parent = m_list.at(targetDir).get_parent_id();
     }
-    else if ((targetDir = Storage::find_directory(name)) != m_list.end())
+    else if ((targetDir = Storage::find_directory(name)) != Catalog::NOT_FOUND)
     {
-        m_parent = targetDir->get_id();
+        m_parent = m_list.at(targetDir).get_id();
     }
     else
     {
         std::cout << "Drive error changing directory: Unable to locate target directory." << std::endl;
         return;
     }
+
+    // In lazy mode, the new parent's children might not be known yet.
+    if (m_lazyListing && !GoogleDrive::load_folder(m_parent))
+    {
+        std::cout << "Drive error changing directory: Unable to list target directory." << std::endl;
+    }
 }
 
 bool GoogleDrive::create_directory(std::string_view name)
 {
-    if (!GoogleDrive::token_is_valid() && !GoogleDrive::refresh_token())
+    return m_loop.run(GoogleDrive::create_directory_async(std::string(name)));
+}
+
+Task<bool> GoogleDrive::create_directory_async(std::string name)
+{
+    // The parent could change while this is waiting on Drive.
+    std::string id = co_await GoogleDrive::create_directory_async(std::move(name), m_parent);
+    co_return !id.empty();
+}
+
+Task<std::string> GoogleDrive::create_directory_async(std::string name, std::string parent)
+{
+    static metrics::Operation &operationMetrics = metrics::operation("drive", "create_directory");
+    metrics::ScopedOperation timer(operationMetrics);
+
+    std::string authHeader{};
+    bool authorized = co_await GoogleDrive::get_auth_header(authHeader);
+    if (!authorized)
     {
-        return false;
+        co_return std::string{};
     }
 
     // Headers.
     curl::HeaderList headers = curl::new_header_list();
-    curl::append_header(headers, m_authHeader.c_str());
+    curl::append_header(headers, authHeader);
     curl::append_header(headers, HEADER_CONTENT_TYPE_JSON.data());
 
     // Json
     json::Object postJson = json::new_object(json_object_new_object);
-    json_object *dirName = json_object_new_string(name.data());
+    json_object *dirName = json_object_new_string(name.c_str());
     json_object *mimeType = json_object_new_string(MIME_TYPE_DIRECTORY.data());
     json::add_object(postJson, JSON_KEY_NAME.data(), dirName);
     json::add_object(postJson, JSON_KEY_MIME_TYPE.data(), mimeType);
     // Add the parent array if the parent string isn't empty.
-    if (!m_parent.empty())
+    if (!parent.empty())
     {
         json_object *parentArray = json_object_new_array();
-        json_object *parentString = json_object_new_string(m_parent.c_str());
+        json_object *parentString = json_object_new_string(parent.c_str());
         json_object_array_add(parentArray, parentString);
         json::add_object(postJson, JSON_KEY_PARENTS.data(), parentArray);
     }
 
     // Response string.
     std::string response;
-    // Curl post.
-    curl::prepare_post(m_curl);
-    curl::set_option(m_curl, CURLOPT_HTTPHEADER, headers.get());
-    curl::set_option(m_curl, CURLOPT_URL, URL_DRIVE_FILE_API.data());
-    curl::set_option(m_curl, CURLOPT_WRITEFUNCTION, curl::write_response_string);
-    curl::set_option(m_curl, CURLOPT_WRITEDATA, &response);
-    curl::set_option(m_curl, CURLOPT_POSTFIELDS, json_object_get_string(postJson.get()));
-
-    if (!curl::perform(m_curl))
+    // Curl post. Every task gets its own handle so nothing else on the loop can touch it mid transfer.
+    curl::Handle handle = curl::new_handle();
+    curl::prepare_post(handle);
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_URL, m_urlFiles.c_str());
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, curl::write_response_string);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &response);
+    curl::set_option(handle, CURLOPT_POSTFIELDS, json_object_get_string(postJson.get()));
+
+    bool performed = co_await GoogleDrive::perform_request(handle, response);
+    if (!performed)
     {
-        return false;
+        co_return std::string{};
     }
 
     json::Object responseParser = json::new_object(json_tokener_parse, response.c_str());
     if (!responseParser || GoogleDrive::error_occurred(responseParser))
     {
-        return false;
+        co_return std::string{};
     }
 
     // This is all I really care about.
     json_object *id = json::get_object(responseParser, JSON_KEY_ID.data());
     if (!id)
     {
-        return false;
+        co_return std::string{};
     }
 
     // Emplace the new directory. Requesting a listing is a waste of time.
-    m_list.emplace_back(name, json_object_get_string(id), m_parent, true);
+    m_list.add(name, json_object_get_string(id), parent, true);
 
-    return true;
+    // It's empty, so there's nothing to list in lazy mode either.
+    if (m_lazyListing)
+    {
+        GoogleDrive::mark_folder_loaded(json_object_get_string(id));
+    }
+
+    timer.succeed();
+    co_return json_object_get_string(id);
 }
 
 bool GoogleDrive::delete_directory(std::string_view name)
 {
-    // For now, this will just call delete_file. To do: Make recursive deleting if needed?
-    return GoogleDrive::delete_file(name);
+    // If a directory with this name exists in the current parent, use its ID. Otherwise, assume name is an ID.
+    Storage::ItemIndex findDir = Storage::find_directory(name);
+    std::string id{findDir != Catalog::NOT_FOUND ? m_list.at(findDir).get_id() : name};
+
+    // Cached listings of anything under it are about to be useless.
+    if (m_lazyListing)
+    {
+        GoogleDrive::evict_folder(id);
+    }
+
+    // Drive deletes everything under a folder along with it, so this is a single request no matter how deep it goes.
+    if (!GoogleDrive::delete_file(id))
+    {
+        return false;
+    }
+
+    // The catalog doesn't know that, though.
+    m_list.remove_subtree(id);
+
+    return true;
+}
+
+std::optional<size_t> GoogleDrive::count_directory(std::string_view name)
+{
+    Storage::ItemIndex findDir = Storage::find_directory(name);
+    std::string id{findDir != Catalog::NOT_FOUND ? m_list.at(findDir).get_id() : name};
+
+    // Folders that aren't cached in lazy mode are listed into this instead so the counting doesn't evict anything.
+    Catalog scratch{};
+    size_t count = 1;
+    std::vector<std::string> pending{id};
+    while (!pending.empty())
+    {
+        std::string folder = std::move(pending.back());
+        pending.pop_back();
+
+        const Catalog *source = &m_list;
+        if (m_lazyListing && !m_loadedFolders.contains(folder))
+        {
+            if (!m_loop.run(GoogleDrive::request_folder_listing(folder, &scratch)))
+            {
+                return std::nullopt;
+            }
+            source = &scratch;
+        }
+
+        source->for_each_child(folder, [&](const Item &item) {
+            ++count;
+            if (item.is_directory())
+            {
+                pending.emplace_back(item.get_id());
+            }
+        });
+    }
+
+    return count;
 }
 
 bool GoogleDrive::delete_file(std::string_view name)
 {
-    if (!GoogleDrive::token_is_valid() && !GoogleDrive::refresh_token())
+    // Same as above. A file with this name in the current parent takes priority, otherwise name is the ID.
+    Storage::ItemIndex findFile = Storage::find_file(name);
+    std::string id{findFile != Catalog::NOT_FOUND ? m_list.at(findFile).get_id() : name};
+
+    return m_loop.run(GoogleDrive::delete_file_async(std::move(id)));
+}
+
+Task<bool> GoogleDrive::delete_file_async(std::string id)
+{
+    std::string authHeader{};
+    bool authorized = co_await GoogleDrive::get_auth_header(authHeader);
+    if (!authorized)
     {
-        return false;
+        co_return false;
     }
 
     // Header
     curl::HeaderList headers = curl::new_header_list();
-    curl::append_header(headers, m_authHeader);
+    curl::append_header(headers, authHeader);
 
     // URL.
     char urlBuffer[SIZE_URL_BUFFER] = {0};
-    std::snprintf(urlBuffer, SIZE_URL_BUFFER, "%s/%s", URL_DRIVE_FILE_API.data(), name.data());
+    std::snprintf(urlBuffer, SIZE_URL_BUFFER, "%s/%s", m_urlFiles.c_str(), id.c_str());
 
     // Response string. For this request, it's only to check for errors.
     std::string response;
     // Curl. This one is different.
-    curl_easy_reset(m_curl.get());
-    curl::set_option(m_curl, CURLOPT_CUSTOMREQUEST, "DELETE");
-    curl::set_option(m_curl, CURLOPT_HTTPHEADER, headers.get());
-    curl::set_option(m_curl, CURLOPT_URL, urlBuffer);
-    curl::set_option(m_curl, CURLOPT_WRITEFUNCTION, curl::write_response_string);
-    curl::set_option(m_curl, CURLOPT_WRITEDATA, &response);
-
-    if (!curl::perform(m_curl))
+    curl::Handle handle = curl::new_handle();
+    curl::attach_pool(handle);
+    curl::set_option(handle, CURLOPT_CUSTOMREQUEST, "DELETE");
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_URL, urlBuffer);
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, curl::write_response_string);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &response);
+
+    bool performed = co_await GoogleDrive::perform_request(handle, response);
+    if (!performed)
     {
-        return false;
+        co_return false;
     }
 
     // This request is weird. There is no response from the server if everything worked. This is only checked to see
@@ -267,156 +940,1574 @@ bool GoogleDrive::delete_file(std::string_view name)
     json::Object responseParser = json::new_object(json_tokener_parse, response.c_str());
     if (GoogleDrive::error_occurred(responseParser))
     {
-        return false;
+        co_return false;
     }
 
-    return true;
+    // Drop it from the list so the indexes stay correct.
+    m_list.remove(id);
+
+    co_return true;
 }
 
-void GoogleDrive::list_contents(void) const
+std::vector<bool> GoogleDrive::create_directories(const std::vector<std::string> &names)
 {
-    for (const Item &item : m_list)
+    std::vector<GoogleDrive::BatchOperation> operations{};
+    for (const std::string &name : names)
     {
-        if (item.get_parent_id() != m_parent)
-        {
-            continue;
-        }
+        operations.push_back(
+            {.type = BatchOperation::Type::CreateDirectory, .target = name, .value = m_parent, .id = {}});
+    }
+    GoogleDrive::run_batch(operations);
 
-        // Print information.
-        std::cout << item.get_name() << ":" << std::endl;
-        std::cout << "\tID: " << item.get_id() << std::endl;
-        std::cout << "\tParent: " << item.get_parent_id() << std::endl;
-        std::cout << "\tDirectory: " << (item.is_directory() ? "true" : "false") << std::endl;
+    std::vector<bool> results{};
+    for (const GoogleDrive::BatchOperation &operation : operations)
+    {
+        results.push_back(operation.success);
     }
+    return results;
 }
 
-bool GoogleDrive::upload_file(const std::filesystem::path &path)
+std::vector<bool> GoogleDrive::delete_files(const std::vector<std::string> &names)
 {
-    // Make sure the file can even be read before trying to continue.
-    std::ifstream target(path, target.binary);
-    if (!target.is_open())
+    std::vector<GoogleDrive::BatchOperation> operations{};
+    for (const std::string &name : names)
     {
-        return false;
+        // Same rules as delete_file. A file with this name in the current parent wins, otherwise it's an ID.
+        Storage::ItemIndex findFile = Storage::find_file(name);
+        std::string id{findFile != Catalog::NOT_FOUND ? m_list.at(findFile).get_id() : name};
+        operations.push_back({.type = BatchOperation::Type::Delete, .target = std::move(id), .value = {}, .id = {}});
     }
+    GoogleDrive::run_batch(operations);
 
-    if (!GoogleDrive::token_is_valid() && !GoogleDrive::refresh_token())
+    std::vector<bool> results{};
+    for (const GoogleDrive::BatchOperation &operation : operations)
     {
-        return false;
+        results.push_back(operation.success);
     }
+    return results;
+}
 
-    // Headers.
-    curl::HeaderList headers = curl::new_header_list();
-    curl::append_header(headers, m_authHeader);
-    curl::append_header(headers, HEADER_CONTENT_TYPE_JSON.data());
+bool GoogleDrive::run_batch(std::vector<GoogleDrive::BatchOperation> &operations)
+{
+    bool allAnswered = true;
+    for (size_t begin = 0; begin < operations.size(); begin += DriveBatch::MAX_REQUESTS)
+    {
+        size_t end = std::min(begin + DriveBatch::MAX_REQUESTS, operations.size());
+        // One bad batch shouldn't stop the rest from being sent.
+        if (!m_loop.run(GoogleDrive::send_batch(operations, begin, end)))
+        {
+            allAnswered = false;
+        }
+    }
+    return allAnswered;
+}
 
-    // URL.
-    char urlBuffer[SIZE_URL_BUFFER] = {0};
-    std::snprintf(urlBuffer, SIZE_URL_BUFFER, "%s?uploadType=resumable", URL_DRIVE_UPLOAD_API.data());
+GoogleDrive::SyncResult GoogleDrive::sync_directory(const std::filesystem::path &directory, bool dryRun)
+{
+    static metrics::Operation &operationMetrics = metrics::operation("drive", "sync");
+    metrics::ScopedOperation timer(operationMetrics);
+
+    GoogleDrive::SyncResult result{};
+    std::vector<SyncUpload> uploads{};
+    std::vector<SyncUpload> unverified{};
+    std::vector<GoogleDrive::BatchOperation> deletions{};
+    std::vector<std::string> deletionPaths{};
+
+    // Local directories and the IDs of the folders they're mirrored to. On a dry run, folders that would have been
+    // created have an empty ID.
+    std::vector<std::pair<std::filesystem::path, std::string>> pending{{directory, m_parent}};
+    while (!pending.empty())
+    {
+        auto [localDirectory, folder] = std::move(pending.back());
+        pending.pop_back();
+        std::filesystem::path relativeDirectory = localDirectory.lexically_relative(directory);
+
+        // Same as count_directory. Folders that aren't cached are listed into scratch so nothing is evicted.
+        std::unordered_map<std::string, SyncItem> remoteFiles{}, remoteDirectories{};
+        if (!folder.empty())
+        {
+            Catalog scratch{};
+            const Catalog *source = &m_list;
+            if (m_lazyListing && !m_loadedFolders.contains(folder))
+            {
+                if (!m_loop.run(GoogleDrive::request_folder_listing(folder, &scratch)))
+                {
+                    ++result.failed;
+                    continue;
+                }
+                source = &scratch;
+            }
+
+            source->for_each_child(folder, [&](const Item &item) {
+                SyncItem syncItem{.id = std::string(item.get_id()),
+                                  .size = item.get_size(),
+                                  .modifiedTime = item.get_modified_time(),
+                                  .md5Checksum = std::string(item.get_md5_checksum())};
+
+                // Drive allows more than one item with the same name. The most recently modified one is kept.
+                auto &items = item.is_directory() ? remoteDirectories : remoteFiles;
+                auto [findItem, inserted] = items.try_emplace(std::string(item.get_name()), syncItem);
+                if (inserted)
+                {
+                    return;
+                }
+                else if (syncItem.modifiedTime > findItem->second.modifiedTime)
+                {
+                    std::swap(findItem->second, syncItem);
+                }
+
+                // Older files go. Older folders could have anything in them, so they're only reported.
+                std::string path = (relativeDirectory / item.get_name()).lexically_normal().string();
+                if (item.is_directory())
+                {
+                    logger::warning("\"%s\" is on Drive more than once. Only the newest is synced.", path.c_str());
+                    result.duplicateDirectories.push_back(std::move(path));
+                    return;
+                }
+                deletions.push_back(
+                    {.type = BatchOperation::Type::Delete, .target = std::move(syncItem.id), .value = {}, .id = {}});
+                deletionPaths.push_back(std::move(path));
+            });
+        }
+
+        // Links aren't followed. A link back up the tree would never end.
+        std::error_code error{};
+        for (std::filesystem::directory_iterator entry{localDirectory, error}, end{}; !error && entry != end;
+             entry.increment(error))
+        {
+            std::string name = entry->path().filename().string();
+            if (entry->is_symlink())
+            {
+                continue;
+            }
+            else if (entry->is_directory())
+            {
+                auto findDirectory = remoteDirectories.find(name);
+                if (findDirectory != remoteDirectories.end())
+                {
+                    pending.emplace_back(entry->path(), std::move(findDirectory->second.id));
+                    remoteDirectories.erase(findDirectory);
+                    continue;
+                }
+
+                std::string id{};
+                if (!dryRun && (id = m_loop.run(GoogleDrive::create_directory_async(name, folder))).empty())
+                {
+                    ++result.failed;
+                    continue;
+                }
+                pending.emplace_back(entry->path(), std::move(id));
+            }
+            else if (entry->is_regular_file())
+            {
+                auto findFile = remoteFiles.find(name);
+                if (findFile == remoteFiles.end())
+                {
+                    uploads.push_back({.path = entry->path(), .parent = folder, .id = {}, .md5Checksum = {}});
+                    continue;
+                }
+                SyncItem remote = std::move(findFile->second);
+                remoteFiles.erase(findFile);
+
+                // Size is free to check. Matching times mean this copy is what was uploaded. Only when the times
+                // differ does the file need to be read to settle it. Those are all hashed together once the walk
+                // is done.
+                std::error_code fileError{};
+                uint64_t size = entry->file_size(fileError);
+                int64_t modifiedTime = fileError ? 0 : get_local_modified_time(entry->path(), fileError);
+                if (!fileError && size == remote.size && modifiedTime == remote.modifiedTime)
+                {
+                    ++result.unchanged;
+                    continue;
+                }
+
+                SyncUpload upload{
+                    .path = entry->path(), .parent = folder, .id = std::move(remote.id), .md5Checksum = {}};
+                if (!fileError && size == remote.size && !remote.md5Checksum.empty())
+                {
+                    upload.md5Checksum = std::move(remote.md5Checksum);
+                    unverified.push_back(std::move(upload));
+                    continue;
+                }
+                uploads.push_back(std::move(upload));
+            }
+        }
+
+        // Whatever's left on Drive isn't here anymore. A listing that failed partway can't be trusted to say that.
+        if (error)
+        {
+            logger::error("Error reading \"%s\" for sync: %s.", localDirectory.c_str(), error.message().c_str());
+            ++result.failed;
+            continue;
+        }
+
+        for (auto *items : {&remoteFiles, &remoteDirectories})
+        {
+            for (auto &[name, item] : *items)
+            {
+                deletions.push_back(
+                    {.type = BatchOperation::Type::Delete, .target = std::move(item.id), .value = {}, .id = {}});
+                deletionPaths.push_back((relativeDirectory / name).lexically_normal().string());
+            }
+        }
+    }
+
+    // Everything left to compare by content is hashed in one go so it's spread across every core. That happens off the
+    // loop so background transfers keep going while the files are read.
+    std::vector<std::filesystem::path> unverifiedPaths{};
+    for (const SyncUpload &upload : unverified)
+    {
+        unverifiedPaths.push_back(upload.path);
+    }
+
+    std::vector<hasher::Result> hashes = m_loop.run(
+        m_loop.run_in_thread([&unverifiedPaths](void) { return hasher::hash_files(unverifiedPaths); }));
+    for (size_t i = 0; i < unverified.size(); i++)
+    {
+        if (hashes[i].success && md5::to_hex(hashes[i].digest) == unverified[i].md5Checksum)
+        {
+            ++result.unchanged;
+            continue;
+        }
+        uploads.push_back(std::move(unverified[i]));
+    }
+
+    if (dryRun)
+    {
+        for (const SyncUpload &upload : uploads)
+        {
+            upload.id.empty() ? ++result.uploaded : ++result.replaced;
+        }
+        result.deleted = deletions.size();
+        result.deletedPaths = std::move(deletionPaths);
+        timer.succeed();
+        return result;
+    }
+
+    std::vector<GoogleDrive::UploadOperation> operations{};
+    for (SyncUpload &upload : uploads)
+    {
+        operations.push_back({.parent = std::move(upload.parent),
+                              .replaceId = std::move(upload.id),
+                              .result = {.path = std::move(upload.path), .success = false, .id = {}, .md5 = {}}});
+    }
+
+    GoogleDrive::run_uploads(operations);
+    for (const GoogleDrive::UploadOperation &operation : operations)
+    {
+        if (!operation.result.success)
+        {
+            logger::error("Error syncing \"%s\".", operation.result.path.c_str());
+            ++result.failed;
+            continue;
+        }
+        operation.replaceId.empty() ? ++result.uploaded : ++result.replaced;
+    }
+
+    // Deleting last means nothing is gone until everything new is up.
+    GoogleDrive::run_batch(deletions);
+    for (size_t i = 0; i < deletions.size(); i++)
+    {
+        if (!deletions[i].success)
+        {
+            logger::error("Error deleting \"%s\" for sync.", deletionPaths[i].c_str());
+            ++result.failed;
+            continue;
+        }
+        ++result.deleted;
+        result.deletedPaths.push_back(std::move(deletionPaths[i]));
+    }
+
+    // Uploads count their own bytes, so the sync itself only counts whether everything went through.
+    if (result.failed == 0)
+    {
+        timer.succeed();
+    }
+    return result;
+}
+
+void GoogleDrive::list_contents(void) const
+{
+    m_list.for_each_child(m_parent, [](const Item &item) {
+        // Print information.
+        std::cout << item.get_name() << ":" << std::endl;
+        std::cout << "\tID: " << item.get_id() << std::endl;
+        std::cout << "\tParent: " << item.get_parent_id() << std::endl;
+        std::cout << "\tDirectory: " << (item.is_directory() ? "true" : "false") << std::endl;
+    });
+}
+
+bool GoogleDrive::refresh(void)
+{
+    if (m_lazyListing)
+    {
+        return GoogleDrive::refresh_lazy();
+    }
+
+    // Without a token, there's no way to know what changed.
+    if (m_changesToken.empty())
+    {
+        return false;
+    }
+
+    return m_loop.run(GoogleDrive::request_changes());
+}
+
+Task<bool> GoogleDrive::request_changes(void)
+{
+    std::string authHeader{};
+    bool authorized = co_await GoogleDrive::get_auth_header(authHeader);
+    if (!authorized)
+    {
+        co_return false;
+    }
+
+    // Header
+    curl::HeaderList headers = curl::new_header_list();
+    curl::append_header(headers, authHeader);
+
+    // Response string.
+    std::string response;
+    curl::Handle handle = curl::new_handle();
+    curl::prepare_get(handle);
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, curl::write_response_string);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &response);
+
+    // This is the page currently being read. The feed is read until Google hands back the token to start the next
+    // refresh from instead of another page.
+    char urlBuffer[SIZE_URL_BUFFER] = {0};
+    std::string pageToken = m_changesToken;
+    do
+    {
+        std::snprintf(urlBuffer,
+                      SIZE_URL_BUFFER,
+                      "%s?%s&pageToken=%s",
+                      m_urlChanges.c_str(),
+                      PARAM_DEFAULT_CHANGES_QUERY.data(),
+                      pageToken.c_str());
+        curl::set_option(handle, CURLOPT_URL, urlBuffer);
+
+        bool performed = co_await GoogleDrive::perform_request(handle, response);
+        if (!performed)
+        {
+            co_return false;
+        }
+
+        json::Object responseParser = json::new_object(json_tokener_parse, response.c_str());
+        if (!responseParser || GoogleDrive::error_occurred(responseParser) ||
+            !GoogleDrive::process_changes(responseParser))
+        {
+            co_return false;
+        }
+
+        // If this is here, everything's been read.
+        json_object *newStartPageToken = json::get_object(responseParser, JSON_KEY_NEW_START_PAGE_TOKEN.data());
+        if (newStartPageToken)
+        {
+            m_changesToken = json_object_get_string(newStartPageToken);
+            break;
+        }
+
+        json_object *nextPageToken = json::get_object(responseParser, JSON_KEY_NEXT_PAGE_TOKEN.data());
+        if (!nextPageToken)
+        {
+            logger::error("Error reading changes: Response has neither a next page or new start page token.");
+            co_return false;
+        }
+        pageToken = json_object_get_string(nextPageToken);
+    } while (!pageToken.empty());
+
+    co_return true;
+}
+
+bool GoogleDrive::upload_file(const std::filesystem::path &path)
+{
+    return m_loop.run(GoogleDrive::upload_file_async(path));
+}
+
+Task<bool> GoogleDrive::upload_file_async(std::filesystem::path path)
+{
+    Remote::UploadResult result = co_await GoogleDrive::upload_file_async(std::move(path), m_parent);
+    co_return result.success;
+}
+
+Task<Remote::UploadResult> GoogleDrive::upload_file_async(std::filesystem::path path, std::string parent)
+{
+    Remote::UploadResult result{.path = std::move(path), .success = false, .id = {}, .md5 = {}};
+    curl::Handle handle = curl::new_handle();
+    result.success = co_await GoogleDrive::upload_file(handle, result.path, std::move(parent), &result);
+    co_return result;
+}
+
+std::vector<Remote::UploadResult> GoogleDrive::upload_files(const std::vector<std::filesystem::path> &paths)
+{
+    // The parent is copied so changing directories mid-upload can't change where anything goes.
+    std::vector<GoogleDrive::UploadOperation> operations{};
+    for (const std::filesystem::path &path : paths)
+    {
+        operations.push_back(
+            {.parent = m_parent, .replaceId = {}, .result = {.path = path, .success = false, .id = {}, .md5 = {}}});
+    }
+    GoogleDrive::run_uploads(operations);
+
+    std::vector<Remote::UploadResult> results{};
+    for (GoogleDrive::UploadOperation &operation : operations)
+    {
+        results.push_back(std::move(operation.result));
+    }
+    return results;
+}
+
+void GoogleDrive::run_uploads(std::vector<GoogleDrive::UploadOperation> &uploads)
+{
+    // They all run on the loop, so nothing here needs to be atomic.
+    size_t next = 0;
+    auto worker = [&](void) -> Task<bool> {
+        curl::Handle handle = curl::new_handle();
+        for (size_t i = next++; i < uploads.size(); i = next++)
+        {
+            GoogleDrive::UploadOperation &upload = uploads[i];
+            upload.result.success = co_await GoogleDrive::upload_file(
+                handle, upload.result.path, upload.parent, &upload.result, upload.replaceId);
+        }
+        co_return true;
+    };
+
+    std::vector<Task<bool>> workers{};
+    size_t workerCount = std::min<size_t>(m_uploadConcurrency, uploads.size());
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        workers.push_back(worker());
+    }
+    m_loop.run(when_all(std::move(workers)));
+}
+
+Task<bool> GoogleDrive::upload_file(curl::Handle &handle,
+                                    const std::filesystem::path &path,
+                                    std::string parent,
+                                    Remote::UploadResult *resultOut,
+                                    std::string replaceId)
+{
+    static metrics::Operation &operationMetrics = metrics::operation("drive", "upload");
+    metrics::ScopedOperation timer(operationMetrics);
+
+    // Make sure the file can even be read before trying to continue.
+    std::ifstream target(path, target.binary);
+    std::error_code error{};
+    uint64_t fileSize = std::filesystem::file_size(path, error);
+    if (!target.is_open() || error)
+    {
+        co_return false;
+    }
+
+    // Drive only ever sees the compressed data, so the original is hashed here while it's read.
+    md5::Context sourceMd5{}, compressedMd5{};
+    std::unique_ptr<compression::Compressor> compressor{};
+    if (m_compression == compression::Codec::Zstd)
+    {
+        compressor = std::make_unique<compression::Compressor>(target, m_compressionLevel, &sourceMd5);
+        if (!compressor->is_initialized())
+        {
+            co_return false;
+        }
+    }
+
+    std::string authHeader{};
+    bool authorized = co_await GoogleDrive::get_auth_header(authHeader);
+    if (!authorized)
+    {
+        co_return false;
+    }
+
+    // Headers.
+    curl::HeaderList headers = curl::new_header_list();
+    curl::append_header(headers, authHeader);
+    curl::append_header(headers, HEADER_CONTENT_TYPE_JSON.data());
+
+    // URL. Replacing a file's content starts the session on the file itself.
+    char urlBuffer[SIZE_URL_BUFFER] = {0};
+    if (replaceId.empty())
+    {
+        std::snprintf(urlBuffer,
+                      SIZE_URL_BUFFER,
+                      "%s?uploadType=resumable&%s",
+                      m_urlUpload.c_str(),
+                      PARAM_UPLOAD_QUERY.data());
+    }
+    else
+    {
+        std::snprintf(urlBuffer,
+                      SIZE_URL_BUFFER,
+                      "%s/%s?uploadType=resumable&%s",
+                      m_urlUpload.c_str(),
+                      replaceId.c_str(),
+                      PARAM_UPLOAD_QUERY.data());
+    }
+
+    // Post JSON.
+    json::Object postJson = json::new_object(json_object_new_object);
+    json_object *driveName = json_object_new_string(reinterpret_cast<const char *>(path.filename().u8string().c_str()));
+    json::add_object(postJson, JSON_KEY_NAME.data(), driveName);
+
+    // Drive keeps the local modification time instead of the upload time. That's what lets sync skip the file later.
+    std::error_code timeError{};
+    int64_t modifiedTime = get_local_modified_time(path, timeError);
+    if (!timeError)
+    {
+        std::string timestamp = stringutil::format_timestamp(modifiedTime);
+        json::add_object(postJson, JSON_KEY_MODIFIED_TIME.data(), json_object_new_string(timestamp.c_str()));
+    }
+
+    // This is how downloads know to decompress the file. Replacing a compressed file with one that isn't needs the old
+    // properties cleared, which setting them to null does.
+    if (compressor || !replaceId.empty())
+    {
+        json_object *appProperties = json_object_new_object();
+        std::string originalSize = std::to_string(fileSize);
+        json_object_object_add(appProperties,
+                               compression::PROPERTY_CODEC.data(),
+                               compressor ? json_object_new_string(compression::CODEC_NAME_ZSTD.data()) : nullptr);
+        json_object_object_add(appProperties,
+                               compression::PROPERTY_SIZE.data(),
+                               compressor ? json_object_new_string(originalSize.c_str()) : nullptr);
+        json::add_object(postJson, JSON_KEY_APP_PROPERTIES.data(), appProperties);
+    }
+
+    // Parents can't be set through an update.
+    if (replaceId.empty() && !parent.empty())
+    {
+        json_object *parents = json_object_new_array();
+        json_object *parentId = json_object_new_string(parent.c_str());
+        json_object_array_add(parents, parentId);
+        json::add_object(postJson, JSON_KEY_PARENTS.data(), parents);
+    }
+
+    // Header array. The body only matters if Google refuses to start the session.
+    curl::HeaderArray headerArray;
+    std::string sessionResponse;
+    // Curl
+    curl::prepare_post(handle);
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_HEADERFUNCTION, curl::write_headers_array);
+    curl::set_option(handle, CURLOPT_HEADERDATA, &headerArray);
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, curl::write_response_string);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &sessionResponse);
+    curl::set_option(handle, CURLOPT_URL, urlBuffer);
+    curl::set_option(handle, CURLOPT_POSTFIELDS, json_object_get_string(postJson.get()));
+    if (!replaceId.empty())
+    {
+        curl::set_option(handle, CURLOPT_CUSTOMREQUEST, "PATCH");
+    }
+
+    bool performed = co_await GoogleDrive::perform_request(handle, sessionResponse);
+    if (!performed)
+    {
+        co_return false;
+    }
+
+    // Extract upload location from headers. Only the attempt that succeeded has one.
+    std::string location;
+    if (!curl::get_header_value(headerArray, "location", location))
+    {
+        logger::error("Error extracting location from upload request headers: %s", sessionResponse.c_str());
+        co_return false;
+    }
+
+    // Response string.
+    std::string response;
+    // This is the actual upload. IIRC, this doesn't need the token to work.
+    bool uploaded = co_await GoogleDrive::upload_session(
+        handle, location, target, fileSize, response, compressor.get(), &compressedMd5);
+    if (!uploaded)
+    {
+        co_return false;
+    }
+
+    json::Object responseParser = json::new_object(json_tokener_parse, response.c_str());
+    if (!responseParser || GoogleDrive::error_occurred(responseParser))
+    {
+        co_return false;
+    }
+
+    // Drive's checksum is of the compressed data. Nobody but this has that to compare it to. The recorded size is
+    // only right if the file didn't change while it was read.
+    json_object *driveMd5 = json::get_object(responseParser, JSON_KEY_MD5_CHECKSUM.data());
+    std::string sourceDigest{};
+    if (compressor)
+    {
+        std::string compressedDigest = md5::to_hex(compressedMd5.finish());
+        if ((driveMd5 && compressedDigest != json_object_get_string(driveMd5)) ||
+            compressor->get_bytes_read() != fileSize)
+        {
+            logger::error("Compressed upload of \"%s\" failed verification.", path.c_str());
+            co_return false;
+        }
+        sourceDigest = md5::to_hex(sourceMd5.finish());
+    }
+
+    // Try to grab these.
+    json_object *id = json::get_object(responseParser, JSON_KEY_ID.data());
+    json_object *filename = json::get_object(responseParser, JSON_KEY_NAME.data());
+    json_object *mimeType = json::get_object(responseParser, JSON_KEY_MIME_TYPE.data());
+    // All of them are needed to continue.
+    if (!id || !filename || !mimeType)
+    {
+        co_return false;
+    }
+
+    // Emplace it. Replacing a file keeps its ID, so this replaces its entry too.
+    uint64_t size = 0;
+    std::string_view md5Checksum{};
+    read_file_metadata(responseParser.get(), size, modifiedTime, md5Checksum);
+    if (compressor)
+    {
+        md5Checksum = sourceDigest;
+    }
+    m_list.add(json_object_get_string(filename),
+               json_object_get_string(id),
+               parent,
+               std::strcmp(MIME_TYPE_DIRECTORY.data(), json_object_get_string(mimeType)) == 0,
+               size,
+               modifiedTime,
+               md5Checksum);
+
+    // Drive hashes what it received. Whoever uploaded the file can compare it against their own.
+    if (resultOut)
+    {
+        resultOut->id = json_object_get_string(id);
+        resultOut->md5 = md5Checksum;
+    }
+
+    // Assume it worked and everything is fine!
+    timer.succeed(fileSize);
+    co_return true;
+}
+
+size_t GoogleDrive::get_upload_memory(void) const
+{
+    // The compressor's own buffers are small next to the chunk.
+    if (m_compression == compression::Codec::Zstd)
+    {
+        return m_uploadChunkSize + SIZE_UPLOAD_STREAM_BUFFERS;
+    }
+    return SIZE_UPLOAD_STREAM_BUFFERS;
+}
+
+void GoogleDrive::spawn(Task<void> task)
+{
+    m_loop.spawn(std::move(task));
+}
+
+void GoogleDrive::shut_down(void)
+{
+    m_loop.stop();
+}
+
+bool GoogleDrive::download_file(std::string_view name, const std::filesystem::path &path)
+{
+    return m_loop.run(GoogleDrive::download_file_async(std::string(name), path));
+}
+
+Task<bool> GoogleDrive::download_file_async(std::string name, std::filesystem::path path)
+{
+    static metrics::Operation &operationMetrics = metrics::operation("drive", "download");
+    metrics::ScopedOperation timer(operationMetrics);
+
+    // If a file with this name exists in the current parent, use its ID. Otherwise, assume name is an ID.
+    Storage::ItemIndex findFile = Storage::find_file(name);
+    std::string id{findFile != Catalog::NOT_FOUND ? m_list.at(findFile).get_id() : name};
+
+    // The size and checksum are needed up front to preallocate and verify.
+    uint64_t fileSize = 0;
+    std::string md5Checksum{};
+    compression::Codec codec = compression::Codec::None;
+    bool found = co_await GoogleDrive::get_file_metadata(id, fileSize, md5Checksum, codec);
+    if (!found)
+    {
+        co_return false;
+    }
+
+    // Whatever is already at path is left alone until the download is verified. Segmented downloads need to read the
+    // file back to hash it.
+    std::filesystem::path temporaryPath{};
+    int descriptor = open_temporary(path, temporaryPath);
+    if (descriptor < 0)
+    {
+        logger::error("Error creating a file next to \"%s\" for download: %s.", path.c_str(), std::strerror(errno));
+        co_return false;
+    }
+
+    // Reserving everything up front keeps the file from fragmenting as it grows. Not every file system can do this.
+    if (fileSize > 0 && fallocate(descriptor, 0, 0, fileSize) != 0 && ftruncate(descriptor, fileSize) != 0)
+    {
+        logger::error("Error preallocating \"%s\": %s.", temporaryPath.c_str(), std::strerror(errno));
+    }
+
+    // Small files aren't worth the extra requests. Neither is splitting when there's only one connection. Compressed
+    // files can't be split since where a range ends up after decompressing isn't known.
+    bool success = false, rangeIgnored = false;
+    md5::Digest digest{};
+    bool segmented =
+        codec == compression::Codec::None && m_downloadConcurrency > 1 && fileSize >= SIZE_MIN_DOWNLOAD_SEGMENT * 2;
+    if (segmented)
+    {
+        success = co_await GoogleDrive::download_segments(id, descriptor, fileSize, rangeIgnored) &&
+                  hash_file(descriptor, fileSize, digest);
+    }
+
+    // A server that won't do ranges can still send the whole thing. The stream writes from the start, so whatever the
+    // segments left behind is overwritten.
+    if (rangeIgnored)
+    {
+        logger::warning("Ranges of %s aren't supported. Downloading it in one stream instead.", id.c_str());
+    }
+
+    if (!segmented || rangeIgnored)
+    {
+        std::optional<uint64_t> written = co_await GoogleDrive::download_stream(id, descriptor, digest, codec);
+        // The preallocated size could be off if the file changed in between.
+        success = written.has_value() && ftruncate(descriptor, *written) == 0;
+        if (success && *written != fileSize)
+        {
+            logger::error("Download of %s is the wrong size: %" PRIu64 " != %" PRIu64 ".",
+                          id.c_str(),
+                          *written,
+                          fileSize);
+            success = false;
+        }
+    }
+    close(descriptor);
+
+    std::string hexDigest = md5::to_hex(digest);
+    if (success && !md5Checksum.empty() && hexDigest != md5Checksum)
+    {
+        logger::error("Download of %s failed verification: %s != %s.",
+                      id.c_str(),
+                      hexDigest.c_str(),
+                      md5Checksum.c_str());
+        success = false;
+    }
+
+    std::error_code error{};
+    if (success)
+    {
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error)
+        {
+            logger::error("Error moving download to \"%s\": %s.", path.c_str(), error.message().c_str());
+            success = false;
+        }
+    }
+
+    // Don't leave a partial or corrupted file behind.
+    if (!success)
+    {
+        std::filesystem::remove(temporaryPath, error);
+    }
+    else
+    {
+        timer.succeed(fileSize);
+    }
+
+    co_return success;
+}
+
+Task<std::optional<uint64_t>> GoogleDrive::download_stream(std::string_view id,
+                                                           int descriptor,
+                                                           md5::Digest &digestOut,
+                                                           compression::Codec codec)
+{
+    std::string authHeader{};
+    bool authorized = co_await GoogleDrive::get_auth_header(authHeader);
+    if (!authorized)
+    {
+        co_return std::nullopt;
+    }
+
+    // Header
+    curl::HeaderList headers = curl::new_header_list();
+    curl::append_header(headers, authHeader);
+
+    // URL
+    char urlBuffer[SIZE_URL_BUFFER] = {0};
+    std::snprintf(urlBuffer, SIZE_URL_BUFFER, "%s/%s?alt=media", m_urlFiles.c_str(), std::string(id).c_str());
+
+    // Everything goes through a fixed buffer straight to the file, so memory use doesn't depend on the file's size.
+    md5::Context context{};
+    std::optional<compression::Decompressor> decompressor{};
+    if (codec == compression::Codec::Zstd && !decompressor.emplace().is_initialized())
+    {
+        co_return std::nullopt;
+    }
+
+    DownloadTarget target = {.descriptor = descriptor,
+                             .buffer = std::make_unique<char[]>(SIZE_DOWNLOAD_BUFFER),
+                             .md5 = &context,
+                             .decompressor = decompressor ? &*decompressor : nullptr};
+    curl::Handle handle = curl::new_handle();
+    curl::prepare_get(handle);
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_URL, urlBuffer);
+    curl::set_option(handle, CURLOPT_FAILONERROR, 1L);
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, write_download_target);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &target);
+
+    bool performed = false;
+    for (int failures = 0;;)
+    {
+        co_await GoogleDrive::acquire_request_slot();
+        performed = co_await m_loop.perform(handle);
+
+        // curl stops before the body of an HTTP error, and a connection that failed before anything arrived didn't
+        // write anything either, so both can start over. A stream cut off partway through can't be picked back up
+        // without a range.
+        long code = curl::get_response_code(handle);
+        RateController::Outcome outcome = RateController::classify(performed, code, {});
+        if (performed || target.received > 0)
+        {
+            GoogleDrive::release_request_slot(outcome);
+            break;
+        }
+
+        bool retry = co_await GoogleDrive::finish_request(outcome, failures);
+        if (!retry)
+        {
+            co_return std::nullopt;
+        }
+    }
+
+    if (!flush_download_target(target) || !performed)
+    {
+        co_return std::nullopt;
+    }
+
+    // A stream that stops partway through a frame decompresses fine right up until where it stops.
+    if (decompressor && !decompressor->is_finished())
+    {
+        logger::error("Compressed download of %s was cut off.", std::string(id).c_str());
+        co_return std::nullopt;
+    }
+
+    digestOut = context.finish();
+    co_return target.written;
+}
+
+Task<bool> GoogleDrive::download_segments(std::string_view id,
+                                          int descriptor,
+                                          uint64_t fileSize,
+                                          bool &rangeIgnoredOut)
+{
+    // Aim for a few segments per connection so one slow connection doesn't hold everything up at the end.
+    uint64_t segmentSize = fileSize / (m_downloadConcurrency * DOWNLOAD_SEGMENTS_PER_CONNECTION);
+    segmentSize = std::clamp(segmentSize - (segmentSize % SIZE_DOWNLOAD_BUFFER),
+                             SIZE_MIN_DOWNLOAD_SEGMENT,
+                             SIZE_MAX_DOWNLOAD_SEGMENT);
+    size_t segmentCount = (fileSize + segmentSize - 1) / segmentSize;
+    size_t workerCount = std::min<size_t>(m_downloadConcurrency, segmentCount);
+
+    // Segments are handed out in order. Once one fails for good, everyone stops picking up new ones.
+    size_t next = 0;
+    bool failed = false;
+    auto worker = [&](void) -> Task<bool> {
+        curl::Handle handle = curl::new_handle();
+        for (size_t i = next++; i < segmentCount && !failed; i = next++)
+        {
+            uint64_t begin = i * segmentSize;
+            uint64_t end = std::min(begin + segmentSize, fileSize);
+            bool downloaded = co_await GoogleDrive::download_range(handle, id, descriptor, begin, end, rangeIgnoredOut);
+            if (!downloaded)
+            {
+                failed = true;
+            }
+        }
+        co_return !failed;
+    };
+
+    std::vector<Task<bool>> workers{};
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        workers.push_back(worker());
+    }
+    co_await when_all(std::move(workers));
+
+    co_return !failed;
+}
+
+Task<bool> GoogleDrive::download_range(curl::Handle &handle,
+                                       std::string_view id,
+                                       int descriptor,
+                                       uint64_t begin,
+                                       uint64_t end,
+                                       bool &rangeIgnoredOut)
+{
+    char urlBuffer[SIZE_URL_BUFFER] = {0};
+    std::snprintf(urlBuffer, SIZE_URL_BUFFER, "%s/%s?alt=media", m_urlFiles.c_str(), std::string(id).c_str());
+
+    DownloadTarget target = {.descriptor = descriptor,
+                             .offset = begin,
+                             .limit = end - begin,
+                             .buffer = std::make_unique<char[]>(SIZE_DOWNLOAD_BUFFER),
+                             .rangeHandle = handle.get()};
+    for (int failures = 0;;)
+    {
+        std::string authHeader{};
+        bool authorized = co_await GoogleDrive::get_auth_header(authHeader);
+        if (!authorized)
+        {
+            co_return false;
+        }
+
+        curl::HeaderList headers = curl::new_header_list();
+        curl::append_header(headers, authHeader);
+
+        // Retries pick up after whatever made it to the file last time.
+        target.bufferUsed = 0;
+        target.checkedRange = false;
+        target.rangeIgnored = false;
+        char range[SIZE_URL_BUFFER] = {0};
+        std::snprintf(range, SIZE_URL_BUFFER, "%" PRIu64 "-%" PRIu64, begin + target.written, end - 1);
+
+        curl::prepare_get(handle);
+        curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+        curl::set_option(handle, CURLOPT_URL, urlBuffer);
+        curl::set_option(handle, CURLOPT_RANGE, range);
+        curl::set_option(handle, CURLOPT_FAILONERROR, 1L);
+        curl::set_option(handle, CURLOPT_WRITEFUNCTION, write_download_target);
+        curl::set_option(handle, CURLOPT_WRITEDATA, &target);
+
+        // Whatever was received is good even if the transfer failed, so it's always flushed.
+        uint64_t writtenBefore = target.written;
+        co_await GoogleDrive::acquire_request_slot();
+        bool performed = co_await m_loop.perform(handle);
+        bool complete = flush_download_target(target) && performed && target.written == target.limit;
+        if (target.written > writtenBefore)
+        {
+            failures = 0;
+        }
+
+        // A range that ends early without an error is still worth another try. One the server ignored isn't, since
+        // it'll just be ignored again.
+        RateController::Outcome outcome = RateController::classify(performed, curl::get_response_code(handle), {});
+        if (target.rangeIgnored)
+        {
+            outcome = RateController::Outcome::Fatal;
+            rangeIgnoredOut = true;
+        }
+        else if (!complete && outcome == RateController::Outcome::Success)
+        {
+            outcome = RateController::Outcome::Retryable;
+        }
+
+        bool retry = co_await GoogleDrive::finish_request(outcome, failures);
+        if (!retry)
+        {
+            if (!complete && !target.rangeIgnored)
+            {
+                logger::error("Range %s of %s failed.", range, urlBuffer);
+            }
+            co_return complete;
+        }
+    }
+}
+
+Task<bool> GoogleDrive::send_batch(std::vector<GoogleDrive::BatchOperation> &operations, size_t begin, size_t end)
+{
+    static metrics::Operation &operationMetrics = metrics::operation("drive", "batch");
+    metrics::ScopedOperation timer(operationMetrics);
+
+    std::string authHeader{};
+    bool authorized = co_await GoogleDrive::get_auth_header(authHeader);
+    if (!authorized)
+    {
+        co_return false;
+    }
+
+    // Batch index -> operation index. Operations that can't be sent are skipped.
+    DriveBatch batch{};
+    std::vector<size_t> sent{};
+    for (size_t i = begin; i < end; i++)
+    {
+        GoogleDrive::BatchOperation &operation = operations[i];
+        std::string path{PATH_DRIVE_FILE_API};
+        json::Object bodyJson = json::new_object(json_object_new_object);
+        std::string_view method{};
+        switch (operation.type)
+        {
+            case BatchOperation::Type::Delete:
+            {
+                method = "DELETE";
+                path.append("/").append(operation.target);
+            }
+            break;
+
+            case BatchOperation::Type::CreateDirectory:
+            {
+                if (operation.value.empty())
+                {
+                    operation.value = m_parent;
+                }
+                method = "POST";
+                path.append("?").append(PARAM_BATCH_CREATE_QUERY);
+
+                json_object *parentArray = json_object_new_array();
+                json_object_array_add(parentArray, json_object_new_string(operation.value.c_str()));
+                json::add_object(bodyJson, JSON_KEY_NAME.data(), json_object_new_string(operation.target.c_str()));
+                json_object *mimeType = json_object_new_string(MIME_TYPE_DIRECTORY.data());
+                json::add_object(bodyJson, JSON_KEY_MIME_TYPE.data(), mimeType);
+                json::add_object(bodyJson, JSON_KEY_PARENTS.data(), parentArray);
+            }
+            break;
+
+            case BatchOperation::Type::Rename:
+            {
+                method = "PATCH";
+                path.append("/").append(operation.target).append("?").append(PARAM_BATCH_UPDATE_QUERY);
+                json::add_object(bodyJson, JSON_KEY_NAME.data(), json_object_new_string(operation.value.c_str()));
+            }
+            break;
+
+            case BatchOperation::Type::Move:
+            {
+                // Drive only replaces the parent if it's told which one to remove.
+                Storage::ItemIndex findItem = m_list.find_by_id(operation.target);
+                if (findItem == Catalog::NOT_FOUND)
+                {
+                    logger::error("Error moving %s: Item isn't in the listing.", operation.target.c_str());
+                    continue;
+                }
+                method = "PATCH";
+                path.append("/").append(operation.target).append("?").append(PARAM_BATCH_UPDATE_QUERY);
+                path.append("&addParents=").append(operation.value);
+                path.append("&removeParents=").append(m_list.at(findItem).get_parent_id());
+            }
+            break;
+        }
+
+        // Deletes don't have a body at all.
+        std::string_view body{};
+        if (operation.type != BatchOperation::Type::Delete)
+        {
+            body = json_object_get_string(bodyJson.get());
+        }
+        batch.add(method, path, body);
+        sent.push_back(i);
+    }
+
+    if (batch.empty())
+    {
+        timer.succeed();
+        co_return true;
+    }
+
+    // Headers
+    curl::HeaderList headers = curl::new_header_list();
+    curl::append_header(headers, authHeader);
+    curl::append_header(headers, batch.get_content_type_header());
+
+    // The boundary of the response is in its Content-Type.
+    curl::HeaderArray responseHeaders{};
+    std::string response{};
+    const std::string &body = batch.get_body();
+    curl::Handle handle = curl::new_handle();
+    curl::prepare_post(handle);
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_URL, m_urlBatch.c_str());
+    curl::set_option(handle, CURLOPT_HEADERFUNCTION, curl::write_headers_array);
+    curl::set_option(handle, CURLOPT_HEADERDATA, &responseHeaders);
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, curl::write_response_string);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &response);
+    curl::set_option(handle, CURLOPT_POSTFIELDS, body.c_str());
+    curl::set_option(handle, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(body.length()));
+
+    // The headers of a failed attempt would hide the Content-Type of the next, so both are cleared every time.
+    bool performed = false;
+    for (int failures = 0;;)
+    {
+        response.clear();
+        responseHeaders.clear();
+        co_await GoogleDrive::acquire_request_slot();
+        performed = co_await m_loop.perform(handle);
+
+        long code = curl::get_response_code(handle);
+        RateController::Outcome outcome = RateController::classify(performed, code, response);
+        bool retry = co_await GoogleDrive::finish_request(outcome, failures);
+        if (!retry)
+        {
+            break;
+        }
+    }
+
+    if (!performed)
+    {
+        co_return false;
+    }
+
+    std::string contentType{};
+    std::vector<DriveBatch::Response> responses{};
+    bool validResponse = curl::get_response_code(handle) == 200 &&
+                         curl::get_header_value(responseHeaders, HEADER_NAME_CONTENT_TYPE, contentType) &&
+                         batch.parse_response(contentType, response, responses);
+    if (!validResponse)
+    {
+        // Anything else is an error for the batch as a whole.
+        json::Object responseParser = json::new_object(json_tokener_parse, response.c_str());
+        GoogleDrive::error_occurred(responseParser);
+        logger::error("Error sending Drive batch: Response code %li.", curl::get_response_code(handle));
+        co_return false;
+    }
+
+    for (size_t i = 0; i < sent.size(); i++)
+    {
+        GoogleDrive::BatchOperation &operation = operations[sent[i]];
+        const DriveBatch::Response &current = responses[i];
+        if (current.code < 200 || current.code >= 300)
+        {
+            logger::error("Drive batch operation on %s failed: %li: %s",
+                          operation.target.c_str(),
+                          current.code,
+                          current.body.c_str());
+            continue;
+        }
+        operation.success = GoogleDrive::apply_batch_operation(operation, current.body);
+    }
+
+    timer.succeed(body.length());
+    co_return true;
+}
+
+bool GoogleDrive::apply_batch_operation(GoogleDrive::BatchOperation &operation, const std::string &body)
+{
+    if (operation.type == BatchOperation::Type::Delete)
+    {
+        if (m_lazyListing)
+        {
+            GoogleDrive::evict_folder(operation.target);
+        }
+        // Folders take everything in them along.
+        m_list.remove_subtree(operation.target);
+        return true;
+    }
+
+    json::Object responseParser = json::new_object(json_tokener_parse, body.c_str());
+    json_object *id = json::get_object(responseParser, JSON_KEY_ID.data());
+    if (!id)
+    {
+        logger::error("Error applying Drive batch operation: Malformed or corrupted response.");
+        return false;
+    }
+
+    if (operation.type == BatchOperation::Type::CreateDirectory)
+    {
+        operation.id = json_object_get_string(id);
+        m_list.add(operation.target, operation.id, operation.value, true);
+        if (m_lazyListing)
+        {
+            GoogleDrive::mark_folder_loaded(operation.id);
+        }
+        return true;
+    }
+
+    // Renames and moves get the whole item back. Adding it again replaces the old entry.
+    json_object *name = json::get_object(responseParser, JSON_KEY_NAME.data());
+    json_object *mimeType = json::get_object(responseParser, JSON_KEY_MIME_TYPE.data());
+    json_object *parents = json::get_object(responseParser, JSON_KEY_PARENTS.data());
+    json_object *parent = parents ? json_object_array_get_idx(parents, 0) : nullptr;
+    if (!name || !mimeType || !parent)
+    {
+        logger::error("Error applying Drive batch operation: Malformed or corrupted response.");
+        return false;
+    }
+
+    bool isDirectory = std::strcmp(MIME_TYPE_DIRECTORY.data(), json_object_get_string(mimeType)) == 0;
+    // A folder moved somewhere that isn't cached can't keep its cached children either.
+    if (m_lazyListing && isDirectory && m_loadedFolders.find(json_object_get_string(parent)) == m_loadedFolders.end())
+    {
+        GoogleDrive::evict_folder(json_object_get_string(id));
+        m_list.remove(json_object_get_string(id));
+        return true;
+    }
+
+    uint64_t size = 0;
+    int64_t modifiedTime = 0;
+    std::string_view md5Checksum{};
+    read_file_metadata(responseParser.get(), size, modifiedTime, md5Checksum);
+    m_list.add(json_object_get_string(name),
+               json_object_get_string(id),
+               json_object_get_string(parent),
+               isDirectory,
+               size,
+               modifiedTime,
+               md5Checksum);
+    return true;
+}
+
+Task<bool> GoogleDrive::get_file_metadata(std::string_view id,
+                                          uint64_t &sizeOut,
+                                          std::string &md5Out,
+                                          compression::Codec &codecOut)
+{
+    static metrics::Operation &operationMetrics = metrics::operation("drive", "get_metadata");
+    metrics::ScopedOperation timer(operationMetrics);
+
+    std::string authHeader{};
+    bool authorized = co_await GoogleDrive::get_auth_header(authHeader);
+    if (!authorized)
+    {
+        co_return false;
+    }
+
+    // Header
+    curl::HeaderList headers = curl::new_header_list();
+    curl::append_header(headers, authHeader);
+
+    // URL
+    char urlBuffer[SIZE_URL_BUFFER] = {0};
+    std::snprintf(urlBuffer,
+                  SIZE_URL_BUFFER,
+                  "%s/%s?%s",
+                  m_urlFiles.c_str(),
+                  std::string(id).c_str(),
+                  PARAM_FILE_METADATA_QUERY.data());
+
+    std::string response;
+    curl::Handle handle = curl::new_handle();
+    curl::prepare_get(handle);
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_URL, urlBuffer);
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, curl::write_response_string);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &response);
+
+    bool performed = co_await GoogleDrive::perform_request(handle, response);
+    if (!performed)
+    {
+        co_return false;
+    }
+
+    json::Object responseParser = json::new_object(json_tokener_parse, response.c_str());
+    if (!responseParser || GoogleDrive::error_occurred(responseParser))
+    {
+        co_return false;
+    }
+
+    // Google Docs and the like have neither. They need to be exported instead.
+    json_object *size = json::get_object(responseParser, JSON_KEY_SIZE.data());
+    json_object *md5Checksum = json::get_object(responseParser, JSON_KEY_MD5_CHECKSUM.data());
+    if (!size)
+    {
+        logger::error("Error getting metadata for %s: File has no size and can't be downloaded.",
+                      std::string(id).c_str());
+        co_return false;
+    }
+
+    // Drive returns int64 values as strings.
+    sizeOut = std::strtoull(json_object_get_string(size), nullptr, 10);
+    md5Out = md5Checksum ? json_object_get_string(md5Checksum) : "";
+
+    // Compressed files are checked against Drive's checksum as they arrive, but their size is the original's.
+    std::string_view codec{};
+    codecOut = compression::Codec::None;
+    if (read_compression(responseParser.get(), codec, sizeOut) && !compression::parse_codec(codec, codecOut))
+    {
+        logger::error("Error downloading %s: Unsupported codec %s.",
+                      std::string(id).c_str(),
+                      std::string(codec).c_str());
+        co_return false;
+    }
+    timer.succeed();
+    co_return true;
+}
+
+Task<bool> GoogleDrive::upload_session(curl::Handle &handle,
+                                       const std::string &location,
+                                       std::ifstream &target,
+                                       uint64_t fileSize,
+                                       std::string &response,
+                                       compression::Compressor *compressor,
+                                       md5::Context *compressedMd5)
+{
+    // Compressed data can't be read again, so the chunk being sent is held until Google has all of it. How big the
+    // upload is isn't known until the compressor is done.
+    std::unique_ptr<char[]> chunk{};
+    uint64_t chunkOffset = 0;
+    size_t chunkUsed = 0;
+    if (compressor)
+    {
+        chunk = std::make_unique_for_overwrite<char[]>(m_uploadChunkSize);
+    }
+
+    uint64_t offset = 0;
+    int failures = 0;
+    bool isStatusQuery = false;
+    while (true)
+    {
+        // After a failure, Google is asked how much it actually got instead of assuming.
+        uint64_t previousOffset = offset;
+        uint64_t totalSize = fileSize;
+        uint64_t available = fileSize - offset;
+        std::ispanstream chunkStream{std::span<const char>{}};
+        std::istream *source = &target;
+        if (compressor)
+        {
+            if (!fill_compressed_chunk(
+                    *compressor, compressedMd5, chunk.get(), m_uploadChunkSize, chunkOffset, chunkUsed, offset))
+            {
+                co_return false;
+            }
+            chunkStream.span(std::span<const char>(chunk.get(), chunkUsed));
+            source = &chunkStream;
+            totalSize = compressor->is_finished() ? chunkOffset + chunkUsed : SIZE_UNKNOWN;
+            available = chunkUsed;
+        }
+        else
+        {
+            // The stream could be in a failed state from a previous attempt.
+            target.clear();
+            target.seekg(offset);
+        }
+        uint64_t length = isStatusQuery ? 0 : std::min(m_uploadChunkSize, available);
+
+        long code = 0;
+        co_await GoogleDrive::acquire_request_slot();
+        bool performed = co_await GoogleDrive::upload_chunk(
+            handle, location, *source, offset, length, totalSize, isStatusQuery, response, code);
+
+        RateController::Outcome outcome = RateController::classify(performed, code, response);
+        if (outcome == RateController::Outcome::Success && (code == 200 || code == 201))
+        {
+            GoogleDrive::release_request_slot(outcome);
+            co_return true;
+        }
+        else if (outcome == RateController::Outcome::Success && code == HTTP_RESUME_INCOMPLETE &&
+                 (isStatusQuery || offset > previousOffset))
+        {
+            // Only progress resets the retry count. Otherwise, a chunk that never sticks would loop forever.
+            GoogleDrive::release_request_slot(outcome);
+            if (offset > previousOffset)
+            {
+                failures = 0;
+            }
+            isStatusQuery = false;
+            continue;
+        }
+        else if (code == 404 || code == 410)
+        {
+            GoogleDrive::release_request_slot(RateController::Outcome::Fatal);
+            logger::error("Upload session expired. The upload needs to be started over.");
+            co_return false;
+        }
+        else if (outcome == RateController::Outcome::Fatal)
+        {
+            GoogleDrive::release_request_slot(outcome);
+            logger::error("Upload chunk rejected: %li: %s", code, response.c_str());
+            co_return false;
+        }
+        else if (outcome == RateController::Outcome::Success)
+        {
+            // A chunk that didn't stick. Google is asked where it's at after backing off.
+            outcome = RateController::Outcome::Retryable;
+        }
+
+        // Everything else is worth another try after backing off for a bit.
+        bool retry = co_await GoogleDrive::finish_request(outcome, failures);
+        if (!retry)
+        {
+            logger::error("Upload failed at offset %" PRIu64 ".", offset);
+            co_return false;
+        }
+        isStatusQuery = true;
+    }
+}
+
+Task<bool> GoogleDrive::upload_chunk(curl::Handle &handle,
+                                     const std::string &location,
+                                     std::istream &target,
+                                     uint64_t &offset,
+                                     uint64_t length,
+                                     uint64_t fileSize,
+                                     bool isStatusQuery,
+                                     std::string &response,
+                                     long &code)
+{
+    // Status queries don't send anything. The empty chunk of an empty file is sent the same way. Until the last
+    // chunk of a compressed upload, the total is left as *.
+    std::string total = fileSize == SIZE_UNKNOWN ? "*" : std::to_string(fileSize);
+    char contentRange[SIZE_URL_BUFFER] = {0};
+    if (isStatusQuery || length == 0)
+    {
+        std::snprintf(contentRange, SIZE_URL_BUFFER, "Content-Range: bytes */%s", total.c_str());
+    }
+    else
+    {
+        std::snprintf(contentRange,
+                      SIZE_URL_BUFFER,
+                      "Content-Range: bytes %" PRIu64 "-%" PRIu64 "/%s",
+                      offset,
+                      offset + length - 1,
+                      total.c_str());
+    }
+
+    curl::HeaderList headers = curl::new_header_list();
+    curl::append_header(headers, contentRange);
+
+    uint64_t sectionLength = isStatusQuery ? 0 : length;
+    curl::FileSection section = {
+        .file = &target, .begin = target.tellg(), .length = sectionLength, .remaining = sectionLength};
+
+    curl::HeaderArray headerArray{};
+    response.clear();
+    curl::prepare_upload(handle);
+    curl::set_option(handle, CURLOPT_URL, location.c_str());
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_INFILESIZE_LARGE, static_cast<curl_off_t>(section.remaining));
+    curl::set_option(handle, CURLOPT_READFUNCTION, curl::read_data_file_section);
+    curl::set_option(handle, CURLOPT_READDATA, &section);
+    curl::set_option(handle, CURLOPT_SEEKFUNCTION, curl::seek_data_file_section);
+    curl::set_option(handle, CURLOPT_SEEKDATA, &section);
+    curl::set_option(handle, CURLOPT_HEADERFUNCTION, curl::write_headers_array);
+    curl::set_option(handle, CURLOPT_HEADERDATA, &headerArray);
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, curl::write_response_string);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &response);
+
+    bool performed = co_await m_loop.perform(handle);
+    if (!performed)
+    {
+        co_return false;
+    }
 
-    // Post JSON.
-    json::Object postJson = json::new_object(json_object_new_object);
-    json_object *driveName = json_object_new_string(reinterpret_cast<const char *>(path.filename().u8string().c_str()));
-    json::add_object(postJson, JSON_KEY_NAME.data(), driveName);
-    if (!m_parent.empty())
+    code = curl::get_response_code(handle);
+    if (code != HTTP_RESUME_INCOMPLETE)
     {
-        json_object *parents = json_object_new_array();
-        json_object *parent = json_object_new_string(m_parent.c_str());
-        json_object_array_add(parents, parent);
-        json::add_object(postJson, JSON_KEY_PARENTS.data(), parents);
+        co_return true;
     }
 
-    // Header array.
-    curl::HeaderArray headerArray;
-    // Curl
-    curl::prepare_post(m_curl);
-    curl::set_option(m_curl, CURLOPT_HTTPHEADER, headers.get());
-    curl::set_option(m_curl, CURLOPT_HEADERFUNCTION, curl::write_headers_array);
-    curl::set_option(m_curl, CURLOPT_HEADERDATA, &headerArray);
-    curl::set_option(m_curl, CURLOPT_URL, urlBuffer);
-    curl::set_option(m_curl, CURLOPT_POSTFIELDS, json_object_get_string(postJson.get()));
+    // The range header is the only way to know what was actually committed. No range means nothing was.
+    std::string range{};
+    uint64_t lastByte = 0;
+    if (!curl::get_header_value(headerArray, "range", range) ||
+        std::sscanf(range.c_str(), "bytes=0-%" SCNu64, &lastByte) != 1)
+    {
+        offset = 0;
+        co_return true;
+    }
+    offset = lastByte + 1;
+
+    co_return true;
+}
 
-    if (!curl::perform(m_curl))
+Task<bool> GoogleDrive::get_auth_header(std::string &headerOut)
+{
+    // Only one task gets to refresh the token. The rest wait for it and use the new one.
+    while (m_refreshingToken)
     {
-        return false;
+        co_await m_loop.sleep_for(TOKEN_REFRESH_WAIT);
     }
 
-    // Extract upload location from headers.
-    std::string location;
-    if (!curl::get_header_value(headerArray, "location", location))
+    if (!GoogleDrive::token_is_valid())
     {
-        logger::log("Error extracting location from upload request headers.");
-        return false;
+        m_refreshingToken = true;
+        bool refreshed = co_await GoogleDrive::refresh_token_async();
+        m_refreshingToken = false;
+        if (!refreshed)
+        {
+            co_return false;
+        }
     }
 
-    // Response string.
-    std::string response;
-    // This is the actual upload. IIRC, this doesn't need the token to work.
-    curl::prepare_upload(m_curl);
-    curl::set_option(m_curl, CURLOPT_URL, location.c_str());
-    curl::set_option(m_curl, CURLOPT_READFUNCTION, curl::read_data_file);
-    curl::set_option(m_curl, CURLOPT_READDATA, &target);
-    curl::set_option(m_curl, CURLOPT_WRITEFUNCTION, curl::write_response_string);
-    curl::set_option(m_curl, CURLOPT_WRITEDATA, &response);
+    headerOut = m_authHeader;
+    co_return true;
+}
 
-    if (!curl::perform(m_curl))
+Task<void> GoogleDrive::acquire_request_slot(void)
+{
+    while (!m_rateController.try_acquire())
     {
-        return false;
+        co_await m_loop.sleep_for(REQUEST_SLOT_WAIT);
     }
+    record_rate_controller(m_rateController);
+}
 
-    json::Object responseParser = json::new_object(json_tokener_parse, response.c_str());
-    if (!responseParser || GoogleDrive::error_occurred(responseParser))
+void GoogleDrive::release_request_slot(RateController::Outcome outcome)
+{
+    m_rateController.release(outcome);
+    record_rate_controller(m_rateController);
+    record_outcome(outcome);
+}
+
+Task<bool> GoogleDrive::finish_request(RateController::Outcome outcome, int &failures)
+{
+    GoogleDrive::release_request_slot(outcome);
+    if (outcome == RateController::Outcome::Success || outcome == RateController::Outcome::Fatal)
     {
-        return false;
+        co_return false;
     }
 
-    // Try to grab these.
-    json_object *id = json::get_object(responseParser, JSON_KEY_ID.data());
-    json_object *filename = json::get_object(responseParser, JSON_KEY_NAME.data());
-    json_object *mimeType = json::get_object(responseParser, JSON_KEY_MIME_TYPE.data());
-    // All of them are needed to continue.
-    if (!id || !filename || !mimeType)
+    if (++failures > MAX_REQUEST_RETRIES)
     {
-        return false;
+        logger::error("Request failed after %i retries.", MAX_REQUEST_RETRIES);
+        co_return false;
     }
 
-    // Emplace it.
-    m_list.emplace_back(json_object_get_string(filename),
-                        json_object_get_string(id),
-                        m_parent,
-                        std::strcmp(MIME_TYPE_DIRECTORY.data(), json_object_get_string(mimeType)) == 0);
-
-    // Assume it worked and everything is fine!
-    return true;
+    std::chrono::milliseconds delay = m_rateController.get_backoff(failures);
+    logger::warning("%s Retrying in %lli ms. Up to %i requests are allowed in flight.",
+                    outcome == RateController::Outcome::Throttled ? "Drive is throttling requests." : "Request failed.",
+                    static_cast<long long>(delay.count()),
+                    m_rateController.get_limit());
+    co_await m_loop.sleep_for(delay);
+    co_return true;
 }
 
-bool GoogleDrive::download_file(std::string_view name, const std::filesystem::path &path)
+Task<bool> GoogleDrive::perform_request(curl::Handle &handle, std::string &response)
 {
-    // Header
-    curl::HeaderList headers = curl::new_header_list();
-    curl::append_header(headers, m_authHeader);
+    for (int failures = 0;;)
+    {
+        response.clear();
+        co_await GoogleDrive::acquire_request_slot();
+        bool performed = co_await m_loop.perform(handle);
 
-    // URL
-    char urlBuffer[SIZE_URL_BUFFER] = {0};
-    std::snprintf(urlBuffer, SIZE_URL_BUFFER, "%s/%s/download", URL_DRIVE_FILE_API.data(), name.data());
+        long code = curl::get_response_code(handle);
+        RateController::Outcome outcome = RateController::classify(performed, code, response);
+        bool retry = co_await GoogleDrive::finish_request(outcome, failures);
+        if (!retry)
+        {
+            co_return performed;
+        }
+    }
+}
 
-    // Response string.
-    std::string response;
-    // Curl
-    curl::prepare_post(m_curl);
-    curl::set_option(m_curl, CURLOPT_HTTPHEADER, headers.get());
-    curl::set_option(m_curl, CURLOPT_URL, urlBuffer);
-    curl::set_option(m_curl, CURLOPT_WRITEFUNCTION, curl::write_response_string);
-    curl::set_option(m_curl, CURLOPT_WRITEDATA, &response);
+void GoogleDrive::set_base_urls(std::string_view driveBaseUrl, std::string_view oauth2BaseUrl)
+{
+    // A trailing slash would double up with the paths.
+    while (driveBaseUrl.ends_with('/'))
+    {
+        driveBaseUrl.remove_suffix(1);
+    }
 
-    if (!curl::perform(m_curl))
+    while (oauth2BaseUrl.ends_with('/'))
     {
-        return false;
+        oauth2BaseUrl.remove_suffix(1);
     }
 
-    return true;
+    m_urlDeviceCode = std::string(oauth2BaseUrl).append(PATH_OAUTH2_DEVICE_CODE);
+    m_urlToken = std::string(oauth2BaseUrl).append(PATH_OAUTH2_TOKEN);
+    m_urlAbout = std::string(driveBaseUrl).append(PATH_DRIVE_ABOUT_API);
+    m_urlFiles = std::string(driveBaseUrl).append(PATH_DRIVE_FILE_API);
+    m_urlUpload = std::string(driveBaseUrl).append(PATH_DRIVE_UPLOAD_API);
+    m_urlBatch = std::string(driveBaseUrl).append(PATH_DRIVE_BATCH_API);
+    m_urlChanges = std::string(driveBaseUrl).append(PATH_DRIVE_CHANGES_API);
+    m_urlChangesToken = std::string(driveBaseUrl).append(PATH_DRIVE_CHANGES_TOKEN_API);
+
+    if (driveBaseUrl != URL_DEFAULT_DRIVE_BASE || oauth2BaseUrl != URL_DEFAULT_OAUTH2_BASE)
+    {
+        logger::warning("Google Drive requests are going to %.*s and %.*s instead of Google.",
+                        static_cast<int>(driveBaseUrl.length()),
+                        driveBaseUrl.data(),
+                        static_cast<int>(oauth2BaseUrl.length()),
+                        oauth2BaseUrl.data());
+    }
 }
 
-bool GoogleDrive::sign_in(void)
+Task<bool> GoogleDrive::sign_in(void)
 {
     // Header list
     curl::HeaderList headers = curl::new_header_list();
@@ -432,24 +2523,26 @@ bool GoogleDrive::sign_in(void)
     // Response string.
     std::string response;
     // Curl get.
-    curl::prepare_get(m_curl);
-    curl::set_option(m_curl, CURLOPT_HTTPHEADER, headers.get());
-    curl::set_option(m_curl, CURLOPT_URL, URL_OAUTH2_DEVICE_CODE_FORMAT.data());
-    curl::set_option(m_curl, CURLOPT_WRITEFUNCTION, curl::write_response_string);
-    curl::set_option(m_curl, CURLOPT_WRITEDATA, &response);
-    curl::set_option(m_curl, CURLOPT_POSTFIELDS, json_object_get_string(postJson.get()));
-
-    if (!curl::perform(m_curl))
+    curl::Handle handle = curl::new_handle();
+    curl::prepare_get(handle);
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_URL, m_urlDeviceCode.c_str());
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, curl::write_response_string);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &response);
+    curl::set_option(handle, CURLOPT_POSTFIELDS, json_object_get_string(postJson.get()));
+
+    bool performed = co_await GoogleDrive::perform_request(handle, response);
+    if (!performed)
     {
-        // curl::perform should log any errors.
-        return false;
+        // The loop should log any errors.
+        co_return false;
     }
 
     // Response parser and error check.
     json::Object responseParser = json::new_object(json_tokener_parse, response.c_str());
     if (!responseParser || GoogleDrive::error_occurred(responseParser))
     {
-        return false;
+        co_return false;
     }
 
     // This is what we need from the response.
@@ -461,8 +2554,8 @@ bool GoogleDrive::sign_in(void)
     // If any of this aren't found, bail.
     if (!deviceCode || !userCode || !verificationUrl || !expiresIn || !interval)
     {
-        logger::log("Error: Drive sign in response is abnormal.");
-        return false;
+        logger::error("Error: Drive sign in response is abnormal.");
+        co_return false;
     }
 
     // This is the time the login counter dies at.
@@ -488,18 +2581,24 @@ bool GoogleDrive::sign_in(void)
     // Response string.
     std::string pollingResponse;
     // Setup the curl request.
-    curl::prepare_post(m_curl);
-    curl::set_option(m_curl, CURLOPT_HTTPHEADER, headers.get());
-    curl::set_option(m_curl, CURLOPT_URL, URL_OAUTH2_TOKEN_URL.data());
-    curl::set_option(m_curl, CURLOPT_WRITEFUNCTION, curl::write_response_string);
-    curl::set_option(m_curl, CURLOPT_WRITEDATA, &pollingResponse);
-    curl::set_option(m_curl, CURLOPT_POSTFIELDS, json_object_get_string(pollingJson.get()));
+    curl::prepare_post(handle);
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_URL, m_urlToken.c_str());
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, curl::write_response_string);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &pollingResponse);
+    curl::set_option(handle, CURLOPT_POSTFIELDS, json_object_get_string(pollingJson.get()));
 
     // Get the polling interval.
     int pollingInterval = json_object_get_int64(interval);
-    // Loop until time runs out.
-    while (std::time(NULL) < expirationTime && curl::perform(m_curl))
+    // Loop until time runs out. Google answers with an error until the login is confirmed, so those aren't retried.
+    while (std::time(NULL) < expirationTime)
     {
+        bool polled = co_await GoogleDrive::perform_request(handle, pollingResponse);
+        if (!polled)
+        {
+            break;
+        }
+
         // Parse the response.
         json::Object pollingParser = json::new_object(json_tokener_parse, pollingResponse.c_str());
 
@@ -516,14 +2615,14 @@ bool GoogleDrive::sign_in(void)
 
         std::cout << "Still waiting..." << std::endl;
 
-        // Interval sleep.
-        std::this_thread::sleep_for(std::chrono::seconds(pollingInterval));
+        // Interval sleep. Anything else on the loop keeps going in the meantime.
+        co_await m_loop.sleep_for(std::chrono::seconds(pollingInterval));
     }
 
     // To do: This might not be safe. I'm going to assume if the response is empty, the user was too fat and slow to log in.
     if (pollingResponse.empty())
     {
-        return false;
+        co_return false;
     }
 
     // To do: Maybe try to figure out how to reuse the parser from the loop? The one from the loop is no more at this point.
@@ -531,7 +2630,7 @@ bool GoogleDrive::sign_in(void)
     // This is just in case access was denied.
     if (GoogleDrive::error_occurred(loginParser))
     {
-        return false;
+        co_return false;
     }
     json_object *accessToken = json::get_object(loginParser, JSON_KEY_ACCESS_TOKEN.data());
     expiresIn = json::get_object(loginParser, JSON_KEY_EXPIRES_IN.data());
@@ -548,67 +2647,71 @@ bool GoogleDrive::sign_in(void)
     m_authHeader = std::string(HEADER_AUTHORIZATION_BEARER) + m_token;
 
     // Should be good to go.
-    return true;
+    co_return true;
 }
 
-bool GoogleDrive::get_set_root_id(void)
+Task<bool> GoogleDrive::get_set_root_id(void)
 {
     // This should take place so early that this shouldn't be an issue, but you never know.
-    if (!GoogleDrive::token_is_valid() && !GoogleDrive::refresh_token())
+    std::string authHeader{};
+    bool authorized = co_await GoogleDrive::get_auth_header(authHeader);
+    if (!authorized)
     {
-        return false;
+        co_return false;
     }
 
     // Headers
     curl::HeaderList headers = curl::new_header_list();
-    curl::append_header(headers, m_authHeader);
-    logger::log("headers");
+    curl::append_header(headers, authHeader);
+    logger::debug("headers");
 
     // URL
     char urlBuffer[SIZE_URL_BUFFER] = {0};
-    std::snprintf(urlBuffer, SIZE_URL_BUFFER, "%s?fields=rootFolderId", URL_DRIVE_ABOUT_API.data());
-    logger::log(urlBuffer);
+    std::snprintf(urlBuffer, SIZE_URL_BUFFER, "%s?fields=rootFolderId", m_urlAbout.c_str());
+    logger::debug("%s", urlBuffer);
 
     // Response string.
     std::string response;
     // Curl
-    curl::prepare_get(m_curl);
-    curl::set_option(m_curl, CURLOPT_HTTPHEADER, headers.get());
-    curl::set_option(m_curl, CURLOPT_URL, urlBuffer);
-    curl::set_option(m_curl, CURLOPT_WRITEFUNCTION, curl::write_response_string);
-    curl::set_option(m_curl, CURLOPT_WRITEDATA, &response);
-    logger::log("curl");
-
-    if (!curl::perform(m_curl))
+    curl::Handle handle = curl::new_handle();
+    curl::prepare_get(handle);
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_URL, urlBuffer);
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, curl::write_response_string);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &response);
+    logger::debug("curl");
+
+    bool performed = co_await GoogleDrive::perform_request(handle, response);
+    if (!performed)
     {
-        return false;
+        co_return false;
     }
-    logger::log("curl::perform");
+    logger::debug("perform_request");
 
     // Response parsing.
     json::Object responseParser = json::new_object(json_tokener_parse, response.c_str());
     if (!responseParser || GoogleDrive::error_occurred(responseParser))
     {
-        return false;
+        co_return false;
     }
-    logger::log("response");
+    logger::debug("response");
 
     // Get the root ID.
     json_object *rootId = json::get_object(responseParser, "rootFolderId");
     if (!rootId)
     {
-        logger::log("Error getting root directory ID from Google Drive!");
-        return false;
+        logger::error("Error getting root directory ID from Google Drive!");
+        co_return false;
     }
-    logger::log("rootId");
+    logger::debug("rootId");
 
     // Save it and also set the current parent to it.
     m_root = json_object_get_string(rootId);
     m_parent = m_root;
 
-    logger::log("Root obtained: %s", m_root.c_str());
+    logger::info("Root obtained: %s", m_root.c_str());
 
-    return true;
+    co_return true;
 }
 
 bool GoogleDrive::token_is_valid(void) const
@@ -619,6 +2722,14 @@ bool GoogleDrive::token_is_valid(void) const
 
 bool GoogleDrive::refresh_token(void)
 {
+    return m_loop.run(GoogleDrive::refresh_token_async());
+}
+
+Task<bool> GoogleDrive::refresh_token_async(void)
+{
+    static metrics::Operation &operationMetrics = metrics::operation("drive", "refresh_token");
+    metrics::ScopedOperation timer(operationMetrics);
+
     // Add JSON content type headers.
     curl::HeaderList headers = curl::new_header_list();
     curl::append_header(headers, HEADER_CONTENT_TYPE_JSON.data());
@@ -637,22 +2748,24 @@ bool GoogleDrive::refresh_token(void)
     // Response string.
     std::string response;
     // Post request.
-    curl::prepare_post(m_curl);
-    curl::set_option(m_curl, CURLOPT_HTTPHEADER, headers.get());
-    curl::set_option(m_curl, CURLOPT_URL, URL_OAUTH2_TOKEN_URL.data());
-    curl::set_option(m_curl, CURLOPT_WRITEFUNCTION, curl::write_response_string);
-    curl::set_option(m_curl, CURLOPT_WRITEDATA, &response);
-    curl::set_option(m_curl, CURLOPT_POSTFIELDS, json_object_get_string(postJson.get()));
-
-    if (!curl::perform(m_curl))
+    curl::Handle handle = curl::new_handle();
+    curl::prepare_post(handle);
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_URL, m_urlToken.c_str());
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, curl::write_response_string);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &response);
+    curl::set_option(handle, CURLOPT_POSTFIELDS, json_object_get_string(postJson.get()));
+
+    bool performed = co_await GoogleDrive::perform_request(handle, response);
+    if (!performed)
     {
-        return false;
+        co_return false;
     }
 
     json::Object responseParser = json::new_object(json_tokener_parse, response.c_str());
     if (!responseParser || GoogleDrive::error_occurred(responseParser))
     {
-        return false;
+        co_return false;
     }
 
     // This is all I care about.
@@ -666,61 +2779,87 @@ bool GoogleDrive::refresh_token(void)
     // Re-do header string
     m_authHeader = std::string(HEADER_AUTHORIZATION_BEARER) + m_token;
 
-    return true;
+    timer.succeed();
+    co_return true;
 }
 
-bool GoogleDrive::request_listing(void)
+Task<bool> GoogleDrive::request_listing(void)
 {
-    // Block against even trying if either of these fail.
-    if (!GoogleDrive::token_is_valid() && !GoogleDrive::refresh_token())
+    // The changes token is grabbed first so anything that changes while the listing is read shows up in the next
+    // refresh instead of being lost.
+    bool tokenReceived = co_await GoogleDrive::request_changes_token();
+    if (!tokenReceived)
     {
-        return false;
+        co_return false;
+    }
+
+    // This is a full listing. Anything already in the list is replaced.
+    m_list.clear();
+
+    if (m_listingConcurrency > 1)
+    {
+        bool listed = co_await GoogleDrive::request_listing_concurrent();
+        co_return listed;
+    }
+
+    // Block against even trying if this fails.
+    std::string authHeader{};
+    bool authorized = co_await GoogleDrive::get_auth_header(authHeader);
+    if (!authorized)
+    {
+        co_return false;
     }
 
     // Initial URL.
     char urlBuffer[SIZE_URL_BUFFER] = {0};
-    std::snprintf(urlBuffer, SIZE_URL_BUFFER, "%s?%s", URL_DRIVE_FILE_API.data(), PARAM_DEFAULT_LIST_QUERY.data());
+    std::snprintf(urlBuffer, SIZE_URL_BUFFER, "%s?%s", m_urlFiles.c_str(), PARAM_DEFAULT_LIST_QUERY.data());
 
     // Header
     curl::HeaderList headers = curl::new_header_list();
-    curl::append_header(headers, m_authHeader);
+    curl::append_header(headers, authHeader);
 
-    // Response string.
-    std::string response;
+    // The response is parsed straight into the list as it comes in.
+    ListingParser parser(m_list);
     // Curl request. The URL will get updated in the loop processing the listing.
-    curl::prepare_get(m_curl);
-    curl::set_option(m_curl, CURLOPT_HTTPHEADER, headers.get());
-    curl::set_option(m_curl, CURLOPT_URL, urlBuffer);
-    curl::set_option(m_curl, CURLOPT_WRITEFUNCTION, curl::write_response_string);
-    curl::set_option(m_curl, CURLOPT_WRITEDATA, &response);
+    curl::Handle handle = curl::new_handle();
+    curl::prepare_get(handle);
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_URL, urlBuffer);
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, ListingParser::write_callback);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &parser);
 
     // This is used as our loop condition.
-    json_object *nextPageToken = nullptr;
+    std::string_view nextPageToken{};
     do
     {
-        // Clear the string first.
-        response.clear();
-
-        if (!curl::perform(m_curl))
+        // Catalog::add replaces items with the same ID, so a page can be requested again even if part of it was
+        // already parsed.
+        bool listed = false;
+        for (int failures = 0;;)
         {
-            // Bail. To do: Handle this better? Maybe?
-            return false;
+            parser.reset();
+            co_await GoogleDrive::acquire_request_slot();
+            bool performed = co_await m_loop.perform(handle);
+
+            long code = curl::get_response_code(handle);
+            RateController::Outcome outcome = RateController::classify(performed, code, parser.get_error_message());
+            bool retry = co_await GoogleDrive::finish_request(outcome, failures);
+            if (!retry)
+            {
+                listed = performed && parser.finish();
+                break;
+            }
         }
 
-        // Response token/parser
-        json::Object responseParser = json::new_object(json_tokener_parse, response.c_str());
-        if (!responseParser || GoogleDrive::error_occurred(responseParser) ||
-            !GoogleDrive::process_listing(responseParser))
+        if (!listed)
         {
-            // Just bail. An error occurred.
-            return false;
+            co_return false;
         }
 
-        // Try to get the nextPageToken.
-        nextPageToken = json::get_object(responseParser, JSON_KEY_NEXT_PAGE_TOKEN.data());
-        if (!nextPageToken)
+        // No token means this was the last page.
+        nextPageToken = parser.get_next_page_token();
+        if (nextPageToken.empty())
         {
-            // Break the loop, making the condition kind of redundant...
             break;
         }
 
@@ -728,68 +2867,431 @@ bool GoogleDrive::request_listing(void)
         std::snprintf(urlBuffer,
                       SIZE_URL_BUFFER,
                       "%s?%s&pageToken=%s",
-                      URL_DRIVE_FILE_API.data(),
+                      m_urlFiles.c_str(),
                       PARAM_DEFAULT_LIST_QUERY.data(),
-                      json_object_get_string(nextPageToken));
-        curl::set_option(m_curl, CURLOPT_URL, urlBuffer);
-    } while (nextPageToken);
+                      nextPageToken.data());
+        curl::set_option(handle, CURLOPT_URL, urlBuffer);
+    } while (!nextPageToken.empty());
+
+    co_return true;
+}
+
+Task<bool> GoogleDrive::request_listing_concurrent(void)
+{
+    // Folders waiting to be listed. Everything starts from the root. The workers all run on the loop and share its
+    // rate controller, so nothing here needs to be atomic.
+    std::vector<std::string> pending{m_root};
+    int listing = 0;
+    bool failed = false;
+    auto worker = [&](void) -> Task<bool> {
+        while (!failed)
+        {
+            // Nothing queued and nothing being listed means nothing else can ever be queued. Otherwise, whatever is
+            // being listed might still turn up more folders.
+            if (pending.empty())
+            {
+                if (listing == 0)
+                {
+                    break;
+                }
+                co_await m_loop.sleep_for(REQUEST_SLOT_WAIT);
+                continue;
+            }
+
+            std::string folder = std::move(pending.back());
+            pending.pop_back();
+
+            ++listing;
+            bool listed = co_await GoogleDrive::request_folder_listing(folder);
+            --listing;
+            if (!listed)
+            {
+                failed = true;
+                break;
+            }
+
+            // Every folder found gets listed too.
+            m_list.for_each_child(folder, [&pending](const Item &item) {
+                if (item.is_directory())
+                {
+                    pending.emplace_back(item.get_id());
+                }
+            });
+        }
+        co_return !failed;
+    };
+
+    std::vector<Task<bool>> workers{};
+    for (int i = 0; i < m_listingConcurrency; i++)
+    {
+        workers.push_back(worker());
+    }
+    co_await when_all(std::move(workers));
+
+    co_return !failed;
+}
+
+Task<bool> GoogleDrive::request_folder_listing(std::string folder, Catalog *catalog)
+{
+    static metrics::Operation &operationMetrics = metrics::operation("drive", "list_folder");
+    metrics::ScopedOperation timer(operationMetrics);
+
+    Catalog &target = catalog ? *catalog : m_list;
+
+    std::string authHeader{};
+    bool authorized = co_await GoogleDrive::get_auth_header(authHeader);
+    if (!authorized)
+    {
+        co_return false;
+    }
+
+    // Header
+    curl::HeaderList headers = curl::new_header_list();
+    curl::append_header(headers, authHeader);
+
+    // The response is parsed straight into the list as it comes in.
+    ListingParser parser(target);
+    curl::Handle handle = curl::new_handle();
+    curl::prepare_get(handle);
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, ListingParser::write_callback);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &parser);
+
+    char urlBuffer[SIZE_URL_BUFFER] = {0};
+    std::string pageToken{};
+    do
+    {
+        int urlLength = std::snprintf(urlBuffer,
+                                      SIZE_URL_BUFFER,
+                                      "%s?%s%s%s",
+                                      m_urlFiles.c_str(),
+                                      PARAM_FOLDER_LIST_QUERY.data(),
+                                      folder.c_str(),
+                                      PARAM_FOLDER_LIST_QUERY_END.data());
+        if (!pageToken.empty())
+        {
+            std::snprintf(urlBuffer + urlLength, SIZE_URL_BUFFER - urlLength, "&pageToken=%s", pageToken.c_str());
+        }
+        curl::set_option(handle, CURLOPT_URL, urlBuffer);
+
+        // Catalog::add replaces items with the same ID, so a page can be requested again even if part of it was
+        // already parsed.
+        bool listed = false;
+        for (int failures = 0;;)
+        {
+            parser.reset();
+            co_await GoogleDrive::acquire_request_slot();
+            bool performed = co_await m_loop.perform(handle);
+
+            long code = curl::get_response_code(handle);
+            RateController::Outcome outcome = RateController::classify(performed, code, parser.get_error_message());
+            bool retry = co_await GoogleDrive::finish_request(outcome, failures);
+            if (!retry)
+            {
+                listed = performed && parser.finish();
+                break;
+            }
+        }
+
+        if (!listed)
+        {
+            co_return false;
+        }
+
+        // When the root is listed through its alias, the parent of anything in it is the real root ID.
+        if (folder == ALIAS_ROOT && m_root.empty() && !target.empty())
+        {
+            m_root = (*target.begin()).get_parent_id();
+        }
+
+        pageToken = parser.get_next_page_token();
+    } while (!pageToken.empty());
+
+    timer.succeed();
+    co_return true;
+}
+
+bool GoogleDrive::load_folder(std::string_view id)
+{
+    return m_loop.run(GoogleDrive::load_folder_async(std::string(id)));
+}
+
+Task<bool> GoogleDrive::load_folder_async(std::string id)
+{
+    // Full listings already have everything.
+    if (!m_lazyListing)
+    {
+        co_return true;
+    }
+
+    // Already cached. Just move it to the front.
+    auto findFolder = m_loadedFolders.find(id);
+    if (findFolder != m_loadedFolders.end())
+    {
+        m_folderLru.splice(m_folderLru.begin(), m_folderLru, findFolder->second);
+        co_return true;
+    }
+
+    bool listed = co_await GoogleDrive::request_folder_listing(id);
+    if (!listed)
+    {
+        co_return false;
+    }
+    GoogleDrive::mark_folder_loaded(id);
+
+    // Evict the coldest folders until the catalog fits again. The path from the root to the current parent is never
+    // evicted or .. would stop working.
+    std::unordered_set<std::string> pinned{};
+    for (std::string current = m_parent; pinned.insert(current).second && current != m_root;)
+    {
+        Storage::ItemIndex findCurrent = m_list.find_by_id(current);
+        if (findCurrent == Catalog::NOT_FOUND)
+        {
+            break;
+        }
+        current = m_list.at(findCurrent).get_parent_id();
+    }
+
+    while (m_list.live_memory_usage() > m_listingCacheBudget)
+    {
+        auto coldest = std::find_if(m_folderLru.rbegin(), m_folderLru.rend(), [&pinned](const std::string &folder) {
+            return !pinned.contains(folder);
+        });
+        if (coldest == m_folderLru.rend())
+        {
+            break;
+        }
+        GoogleDrive::evict_folder(std::string(*coldest));
+    }
+
+    co_return true;
+}
+
+void GoogleDrive::mark_folder_loaded(std::string_view id)
+{
+    std::string folder{id};
+    if (m_loadedFolders.contains(folder))
+    {
+        return;
+    }
+    m_folderLru.push_front(folder);
+    m_loadedFolders.emplace(std::move(folder), m_folderLru.begin());
+}
+
+void GoogleDrive::evict_folder(const std::string &id)
+{
+    auto findFolder = m_loadedFolders.find(id);
+    if (findFolder == m_loadedFolders.end())
+    {
+        return;
+    }
+    m_folderLru.erase(findFolder->second);
+    m_loadedFolders.erase(findFolder);
+
+    // Grab the children first. Removing them while walking the list isn't safe.
+    std::vector<std::pair<std::string, bool>> children{};
+    m_list.for_each_child(id, [&children](const Item &item) {
+        children.emplace_back(item.get_id(), item.is_directory());
+    });
+
+    for (const auto &[childId, isDirectory] : children)
+    {
+        if (isDirectory)
+        {
+            GoogleDrive::evict_folder(childId);
+        }
+        m_list.remove(childId);
+    }
+}
+
+bool GoogleDrive::refresh_lazy(void)
+{
+    // Remember the path from the root to the current parent before throwing everything out.
+    std::vector<std::string> path{m_parent};
+    while (path.back() != m_root)
+    {
+        Storage::ItemIndex findCurrent = m_list.find_by_id(path.back());
+        if (findCurrent == Catalog::NOT_FOUND)
+        {
+            break;
+        }
+        path.emplace_back(m_list.at(findCurrent).get_parent_id());
+    }
+
+    m_list.clear();
+    m_folderLru.clear();
+    m_loadedFolders.clear();
+
+    // Relist it from the root down.
+    for (auto folder = path.rbegin(); folder != path.rend(); ++folder)
+    {
+        if (!m_loop.run(GoogleDrive::request_folder_listing(*folder)))
+        {
+            return false;
+        }
+        GoogleDrive::mark_folder_loaded(*folder);
+    }
 
     return true;
 }
 
-bool GoogleDrive::process_listing(json::Object &json)
+Task<bool> GoogleDrive::request_changes_token(void)
+{
+    std::string authHeader{};
+    bool authorized = co_await GoogleDrive::get_auth_header(authHeader);
+    if (!authorized)
+    {
+        co_return false;
+    }
+
+    // Header
+    curl::HeaderList headers = curl::new_header_list();
+    curl::append_header(headers, authHeader);
+
+    // Response string.
+    std::string response;
+    curl::Handle handle = curl::new_handle();
+    curl::prepare_get(handle);
+    curl::set_option(handle, CURLOPT_HTTPHEADER, headers.get());
+    curl::set_option(handle, CURLOPT_URL, m_urlChangesToken.c_str());
+    curl::set_option(handle, CURLOPT_WRITEFUNCTION, curl::write_response_string);
+    curl::set_option(handle, CURLOPT_WRITEDATA, &response);
+
+    bool performed = co_await GoogleDrive::perform_request(handle, response);
+    if (!performed)
+    {
+        co_return false;
+    }
+
+    json::Object responseParser = json::new_object(json_tokener_parse, response.c_str());
+    if (!responseParser || GoogleDrive::error_occurred(responseParser))
+    {
+        co_return false;
+    }
+
+    json_object *startPageToken = json::get_object(responseParser, JSON_KEY_START_PAGE_TOKEN.data());
+    if (!startPageToken)
+    {
+        logger::error("Error getting start page token for changes.");
+        co_return false;
+    }
+    m_changesToken = json_object_get_string(startPageToken);
+
+    co_return true;
+}
+
+bool GoogleDrive::process_changes(json::Object &json)
 {
-    json_object *files = json::get_object(json, "files");
-    if (!files)
+    json_object *changes = json::get_object(json, "changes");
+    if (!changes)
     {
         return false;
     }
 
-    // Loop through the array and read off everything.
-    size_t arrayLength = json_object_array_length(files);
+    size_t arrayLength = json_object_array_length(changes);
     for (size_t i = 0; i < arrayLength; i++)
     {
-        // Grab the current object at i
-        json_object *currentFile = json_object_array_get_idx(files, i);
-        if (!currentFile)
+        json_object *currentChange = json_object_array_get_idx(changes, i);
+        json_object *fileId = json_object_object_get(currentChange, "fileId");
+        if (!fileId)
         {
-            return false;
+            // Drive changes without a file ID aren't anything the catalog cares about.
+            continue;
         }
 
-        json_object *mimeType = json_object_object_get(currentFile, JSON_KEY_MIME_TYPE.data());
-        json_object *parents = json_object_object_get(currentFile, JSON_KEY_PARENTS.data());
-        json_object *id = json_object_object_get(currentFile, JSON_KEY_ID.data());
-        json_object *name = json_object_object_get(currentFile, JSON_KEY_NAME.data());
-        if (!mimeType || !parents || !id || !name)
+        // Deleted files and trashed files are both gone as far as the catalog is concerned. Files without a parent
+        // aren't reachable from the root either.
+        json_object *removed = json_object_object_get(currentChange, "removed");
+        json_object *file = json_object_object_get(currentChange, "file");
+        json_object *trashed = file ? json_object_object_get(file, "trashed") : nullptr;
+        json_object *parents = file ? json_object_object_get(file, JSON_KEY_PARENTS.data()) : nullptr;
+        json_object *parent = parents ? json_object_array_get_idx(parents, 0) : nullptr;
+        if ((removed && json_object_get_boolean(removed)) || (trashed && json_object_get_boolean(trashed)) || !parent)
         {
-            // Just bail. Something is really wrong.
-            logger::log("Error processing Google Drive list: Malformed or corrupted response.");
-            return false;
+            // Folders take everything in them along, same as deleting them does.
+            std::string id = json_object_get_string(fileId);
+            if (m_lazyListing)
+            {
+                GoogleDrive::evict_folder(id);
+            }
+            m_list.remove_subtree(id);
+            continue;
         }
 
-        // I don't understand why this needs to be an array if files can only have one parent.
-        json_object *parent = json_object_array_get_idx(parents, 0);
-        if (!parent)
+        json_object *mimeType = json_object_object_get(file, JSON_KEY_MIME_TYPE.data());
+        json_object *name = json_object_object_get(file, JSON_KEY_NAME.data());
+        if (!mimeType || !name)
         {
-            logger::log("Error reading parents array.");
+            logger::error("Error processing Google Drive changes: Malformed or corrupted response.");
             return false;
         }
 
-        // Emplace
-        m_list.emplace_back(json_object_get_string(name),
-                            json_object_get_string(id),
-                            json_object_get_string(parent),
-                            std::strcmp(MIME_TYPE_DIRECTORY.data(), json_object_get_string(mimeType)) == 0);
+        uint64_t size = 0;
+        int64_t modifiedTime = 0;
+        std::string_view md5Checksum{};
+        read_file_metadata(file, size, modifiedTime, md5Checksum);
+
+        // Adding replaces whatever was there with the same ID, so this covers new files, renames, and moves.
+        m_list.add(json_object_get_string(name),
+                   json_object_get_string(fileId),
+                   json_object_get_string(parent),
+                   std::strcmp(MIME_TYPE_DIRECTORY.data(), json_object_get_string(mimeType)) == 0,
+                   size,
+                   modifiedTime,
+                   md5Checksum);
     }
 
     return true;
 }
 
-Storage::ItemIterator GoogleDrive::find_directory_by_id(std::string_view id)
+bool GoogleDrive::load_snapshot(void)
 {
-    return std::find_if(m_list.begin(), m_list.end(), [id](const Item &item) {
-        return item.is_directory() && item.get_id() == id;
-    });
+    snapshot::Metadata metadata{};
+    if (!snapshot::read(PATH_CATALOG_SNAPSHOT, m_list, metadata))
+    {
+        return false;
+    }
+
+    // Make sure it's ours. Without a changes token, there's no way to bring it up to date either.
+    if (metadata.account != GoogleDrive::get_account_key() || metadata.root.empty() || metadata.changesToken.empty())
+    {
+        logger::warning("Drive snapshot is stale or belongs to a different account. Requesting full listing.");
+        m_list.clear();
+        return false;
+    }
+
+    m_root = metadata.root;
+    m_parent = m_root;
+    m_changesToken = metadata.changesToken;
+
+    logger::info("Drive catalog loaded from snapshot: %zu items.", m_list.size());
+
+    return true;
+}
+
+bool GoogleDrive::save_snapshot(void)
+{
+    snapshot::Metadata metadata = {.account = GoogleDrive::get_account_key(),
+                                   .root = m_root,
+                                   .changesToken = m_changesToken,
+                                   .timestamp = std::time(NULL)};
+    return snapshot::write(PATH_CATALOG_SNAPSHOT, m_list, metadata);
+}
+
+std::string GoogleDrive::get_account_key(void) const
+{
+    // The refresh token itself shouldn't be written anywhere else, so only a hash of it is used.
+    return m_clientId + ":" + std::to_string(std::hash<std::string>{}(m_refreshToken));
+}
+
+Storage::ItemIndex GoogleDrive::find_directory_by_id(std::string_view id) const
+{
+    Storage::ItemIndex findId = m_list.find_by_id(id);
+    if (findId == Catalog::NOT_FOUND || !m_list.at(findId).is_directory())
+    {
+        return Catalog::NOT_FOUND;
+    }
+    return findId;
 }
 
 bool GoogleDrive::error_occurred(json::Object &json)
@@ -802,9 +3304,9 @@ bool GoogleDrive::error_occurred(json::Object &json)
 
         // Log them. Google is inconsistent with the structure of errors and I don't feel like handling every
         // single different format of them.
-        logger::log("Google Drive Error: %s: %s.",
-                    json_object_get_string(error),
-                    json_object_get_string(errorDescription));
+        logger::error("Google Drive Error: %s: %s.",
+                      json_object_get_string(error),
+                      json_object_get_string(errorDescription));
 
         return true;
     }
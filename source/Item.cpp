@@ -1,7 +1,14 @@
 #include "Item.hpp"
 
-Item::Item(std::string_view name, std::string_view id, std::string_view parent, bool isDirectory)
-    : m_name(name), m_id(id), m_parent(parent), m_isDirectory(isDirectory) {};
+Item::Item(std::string_view name,
+           std::string_view id,
+           std::string_view parent,
+           bool isDirectory,
+           uint64_t size,
+           int64_t modifiedTime,
+           std::string_view md5Checksum)
+    : m_name(name), m_id(id), m_parent(parent), m_isDirectory(isDirectory), m_size(size),
+      m_modifiedTime(modifiedTime), m_md5Checksum(md5Checksum) {};
 
 std::string_view Item::get_name(void) const
 {
@@ -23,22 +30,17 @@ bool Item::is_directory(void) const
     return m_isDirectory;
 }
 
-void Item::set_name(std::string_view name)
+uint64_t Item::get_size(void) const
 {
-    m_name = name;
+    return m_size;
 }
 
-void Item::set_id(std::string_view id)
+int64_t Item::get_modified_time(void) const
 {
-    m_id = id;
+    return m_modifiedTime;
 }
 
-void Item::set_parent_id(std::string_view parent)
+std::string_view Item::get_md5_checksum(void) const
 {
-    m_parent = parent;
-}
-
-void Item::set_is_directory(bool isDirectory)
-{
-    m_isDirectory = isDirectory;
+    return m_md5Checksum;
 }
@@ -0,0 +1,643 @@
+#include "ListingParser.hpp"
+#include "compression.hpp"
+#include "logger.hpp"
+#include "stringutil.hpp"
+#include <charconv>
+#include <cstring>
+
+namespace
+{
+    // Keys the parser cares about.
+    constexpr std::string_view JSON_KEY_APP_PROPERTIES = "appProperties";
+    constexpr std::string_view JSON_KEY_ERROR = "error";
+    constexpr std::string_view JSON_KEY_FILES = "files";
+    constexpr std::string_view JSON_KEY_ID = "id";
+    constexpr std::string_view JSON_KEY_MD5_CHECKSUM = "md5Checksum";
+    constexpr std::string_view JSON_KEY_MESSAGE = "message";
+    constexpr std::string_view JSON_KEY_MIME_TYPE = "mimeType";
+    constexpr std::string_view JSON_KEY_MODIFIED_TIME = "modifiedTime";
+    constexpr std::string_view JSON_KEY_NAME = "name";
+    constexpr std::string_view JSON_KEY_NEXT_PAGE_TOKEN = "nextPageToken";
+    constexpr std::string_view JSON_KEY_PARENTS = "parents";
+    constexpr std::string_view JSON_KEY_SIZE = "size";
+
+    /// @brief Mimetype of directories.
+    constexpr std::string_view MIME_TYPE_DIRECTORY = "application/vnd.google-apps.folder";
+
+    // Depths of everything the parser reads. These are the number of containers open while inside of them.
+    constexpr size_t DEPTH_TOP = 1;
+    constexpr size_t DEPTH_FILES = 2;
+    constexpr size_t DEPTH_FILE = 3;
+    constexpr size_t DEPTH_PARENTS = 4;
+    constexpr size_t DEPTH_APP_PROPERTIES = 4;
+    constexpr size_t DEPTH_ERROR = 2;
+
+    // Bits for the fields read for a file. Size, modification time, and checksum are optional, so they aren't tracked.
+    constexpr uint8_t FIELD_ID = 1 << 0;
+    constexpr uint8_t FIELD_NAME = 1 << 1;
+    constexpr uint8_t FIELD_MIME_TYPE = 1 << 2;
+    constexpr uint8_t FIELD_PARENT = 1 << 3;
+    constexpr uint8_t FIELD_ALL = FIELD_ID | FIELD_NAME | FIELD_MIME_TYPE | FIELD_PARENT;
+
+    /// @brief Code point written in place of broken surrogate pairs.
+    constexpr uint32_t CODE_POINT_REPLACEMENT = 0xFFFD;
+
+    /// @brief Returns whether byte is JSON whitespace.
+    inline bool is_whitespace(char byte)
+    {
+        return byte == ' ' || byte == '\n' || byte == '\r' || byte == '\t';
+    }
+
+    /// @brief Returns whether byte can be part of a number, true, false, or null.
+    inline bool is_literal(char byte)
+    {
+        return (byte >= '0' && byte <= '9') || (byte >= 'a' && byte <= 'z') || byte == '-' || byte == '+' ||
+               byte == '.' || byte == 'E';
+    }
+} // namespace
+
+ListingParser::ListingParser(Catalog &catalog) : m_catalog(catalog) {};
+
+void ListingParser::reset(std::vector<std::string> *directories)
+{
+    m_directories = directories;
+    m_state = ListingParser::State::Value;
+    m_expect = ListingParser::Expect::Value;
+    m_section = ListingParser::Section::None;
+    m_depth = 0;
+    m_readingKey = false;
+    m_highSurrogate = 0;
+    m_target = nullptr;
+    m_fields = 0;
+    m_foundFiles = false;
+    m_error = false;
+    m_key.clear();
+    m_nextPageToken.clear();
+    m_errorMessage.clear();
+}
+
+bool ListingParser::feed(const char *data, size_t length)
+{
+    const char *end = data + length;
+    while (data < end)
+    {
+        switch (m_state)
+        {
+            case ListingParser::State::String:
+            {
+                // Copy or skip runs of plain characters in one go. Most strings never leave this.
+                const char *run = data;
+                while (run < end && *run != '"' && *run != '\\')
+                {
+                    run++;
+                }
+
+                if (m_target && run != data)
+                {
+                    ListingParser::flush_surrogate();
+                    m_target->append(data, run);
+                }
+                data = run;
+
+                if (data == end)
+                {
+                    break;
+                }
+                else if (*data++ == '\\')
+                {
+                    m_state = ListingParser::State::Escape;
+                    break;
+                }
+
+                // End of the string.
+                ListingParser::flush_surrogate();
+                m_state = ListingParser::State::Value;
+                if (m_readingKey)
+                {
+                    m_readingKey = false;
+                    m_expect = ListingParser::Expect::Colon;
+                }
+                else
+                {
+                    ListingParser::end_value();
+                }
+            }
+            break;
+
+            case ListingParser::State::Escape:
+            {
+                if (!ListingParser::process_escape(*data++))
+                {
+                    m_state = ListingParser::State::Failed;
+                }
+            }
+            break;
+
+            case ListingParser::State::Unicode:
+            {
+                if (!ListingParser::process_unicode(*data++))
+                {
+                    m_state = ListingParser::State::Failed;
+                }
+            }
+            break;
+
+            case ListingParser::State::Literal:
+            {
+                // The byte ending the literal still needs to be processed, so it's only consumed if it's part of it.
+                if (is_literal(*data))
+                {
+                    data++;
+                    break;
+                }
+                m_state = ListingParser::State::Value;
+                ListingParser::end_value();
+            }
+            break;
+
+            case ListingParser::State::Value:
+            {
+                // Drive pretty prints responses, so there's a lot of indentation to get through.
+                while (data < end && is_whitespace(*data))
+                {
+                    data++;
+                }
+
+                if (data < end && !ListingParser::process_structure(*data++))
+                {
+                    m_state = ListingParser::State::Failed;
+                }
+            }
+            break;
+
+            case ListingParser::State::Done:
+            {
+                // Only trailing whitespace is allowed.
+                if (!is_whitespace(*data++))
+                {
+                    m_state = ListingParser::State::Failed;
+                }
+            }
+            break;
+
+            case ListingParser::State::Failed:
+            {
+                return false;
+            }
+        }
+    }
+    return m_state != ListingParser::State::Failed;
+}
+
+bool ListingParser::finish(void)
+{
+    if (m_error)
+    {
+        logger::error("Google Drive Error: %s.", m_errorMessage.c_str());
+        return false;
+    }
+    else if (m_state != ListingParser::State::Done || !m_foundFiles)
+    {
+        logger::error("Error processing Google Drive list: Malformed or corrupted response.");
+        return false;
+    }
+    return true;
+}
+
+std::string_view ListingParser::get_next_page_token(void) const
+{
+    return m_nextPageToken;
+}
+
+bool ListingParser::error_occurred(void) const
+{
+    return m_error;
+}
+
+std::string_view ListingParser::get_error_message(void) const
+{
+    return m_errorMessage;
+}
+
+size_t ListingParser::write_callback(const char *buffer, size_t size, size_t count, ListingParser *parser)
+{
+    return parser->feed(buffer, size * count) ? size * count : 0;
+}
+
+bool ListingParser::process_structure(char byte)
+{
+    if (is_whitespace(byte))
+    {
+        return true;
+    }
+
+    switch (m_expect)
+    {
+        case ListingParser::Expect::Key:
+        {
+            if (byte == '"')
+            {
+                m_key.clear();
+                m_target = &m_key;
+                m_readingKey = true;
+                m_state = ListingParser::State::String;
+                return true;
+            }
+            return byte == '}' && ListingParser::close_container(true);
+        }
+
+        case ListingParser::Expect::Colon:
+        {
+            m_expect = ListingParser::Expect::Value;
+            return byte == ':';
+        }
+
+        case ListingParser::Expect::Comma:
+        {
+            if (byte == ',')
+            {
+                m_expect = m_containers[m_depth - 1] ? ListingParser::Expect::Key : ListingParser::Expect::Value;
+                return true;
+            }
+            return (byte == '}' || byte == ']') && ListingParser::close_container(byte == '}');
+        }
+
+        case ListingParser::Expect::Value:
+        {
+            // Google's error can be a string or an object, depending on which API it came from.
+            if (m_depth == DEPTH_TOP && m_key == JSON_KEY_ERROR)
+            {
+                m_error = true;
+            }
+
+            if (byte == '"')
+            {
+                ListingParser::begin_string_value();
+                m_state = ListingParser::State::String;
+                return true;
+            }
+            else if (byte == '{' || byte == '[')
+            {
+                return ListingParser::open_container(byte == '{');
+            }
+            else if (byte == ']' && m_depth > 0 && !m_containers[m_depth - 1])
+            {
+                // Empty array.
+                return ListingParser::close_container(false);
+            }
+            else if (is_literal(byte))
+            {
+                m_state = ListingParser::State::Literal;
+                return true;
+            }
+            return false;
+        }
+    }
+    return false;
+}
+
+bool ListingParser::process_escape(char byte)
+{
+    m_state = ListingParser::State::String;
+
+    char decoded = 0;
+    switch (byte)
+    {
+        case '"':
+        case '\\':
+        case '/':
+        {
+            decoded = byte;
+        }
+        break;
+
+        case 'b':
+        {
+            decoded = '\b';
+        }
+        break;
+
+        case 'f':
+        {
+            decoded = '\f';
+        }
+        break;
+
+        case 'n':
+        {
+            decoded = '\n';
+        }
+        break;
+
+        case 'r':
+        {
+            decoded = '\r';
+        }
+        break;
+
+        case 't':
+        {
+            decoded = '\t';
+        }
+        break;
+
+        case 'u':
+        {
+            m_codePoint = 0;
+            m_hexDigits = 0;
+            m_state = ListingParser::State::Unicode;
+            return true;
+        }
+
+        default:
+        {
+            return false;
+        }
+    }
+
+    if (m_target)
+    {
+        ListingParser::flush_surrogate();
+        m_target->push_back(decoded);
+    }
+    return true;
+}
+
+bool ListingParser::process_unicode(char byte)
+{
+    uint32_t digit = 0;
+    if (byte >= '0' && byte <= '9')
+    {
+        digit = byte - '0';
+    }
+    else if (byte >= 'a' && byte <= 'f')
+    {
+        digit = byte - 'a' + 10;
+    }
+    else if (byte >= 'A' && byte <= 'F')
+    {
+        digit = byte - 'A' + 10;
+    }
+    else
+    {
+        return false;
+    }
+
+    m_codePoint = (m_codePoint << 4) | digit;
+    if (++m_hexDigits == 4)
+    {
+        m_state = ListingParser::State::String;
+        if (m_target)
+        {
+            ListingParser::append_code_point(m_codePoint);
+        }
+    }
+    return true;
+}
+
+void ListingParser::append_code_point(uint32_t codePoint)
+{
+    if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+    {
+        ListingParser::flush_surrogate();
+        m_highSurrogate = codePoint;
+        return;
+    }
+    else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF)
+    {
+        if (!m_highSurrogate)
+        {
+            codePoint = CODE_POINT_REPLACEMENT;
+        }
+        else
+        {
+            codePoint = 0x10000 + ((m_highSurrogate - 0xD800) << 10) + (codePoint - 0xDC00);
+            m_highSurrogate = 0;
+        }
+    }
+    else
+    {
+        ListingParser::flush_surrogate();
+    }
+
+    if (codePoint < 0x80)
+    {
+        m_target->push_back(static_cast<char>(codePoint));
+    }
+    else if (codePoint < 0x800)
+    {
+        m_target->push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        m_target->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+    else if (codePoint < 0x10000)
+    {
+        m_target->push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        m_target->push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        m_target->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+    else
+    {
+        m_target->push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        m_target->push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        m_target->push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        m_target->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+void ListingParser::flush_surrogate(void)
+{
+    if (m_highSurrogate)
+    {
+        m_highSurrogate = 0;
+        ListingParser::append_code_point(CODE_POINT_REPLACEMENT);
+    }
+}
+
+void ListingParser::begin_string_value(void)
+{
+    m_target = nullptr;
+    if (m_depth == DEPTH_TOP && m_key == JSON_KEY_NEXT_PAGE_TOKEN)
+    {
+        m_target = &m_nextPageToken;
+    }
+    else if (m_depth == DEPTH_TOP && m_key == JSON_KEY_ERROR)
+    {
+        m_target = &m_errorMessage;
+    }
+    else if (m_section == ListingParser::Section::Error && m_depth == DEPTH_ERROR && m_key == JSON_KEY_MESSAGE)
+    {
+        m_target = &m_errorMessage;
+    }
+    else if (m_section == ListingParser::Section::File && m_depth == DEPTH_FILE)
+    {
+        if (m_key == JSON_KEY_ID)
+        {
+            m_target = &m_id;
+            m_fields |= FIELD_ID;
+        }
+        else if (m_key == JSON_KEY_NAME)
+        {
+            m_target = &m_name;
+            m_fields |= FIELD_NAME;
+        }
+        else if (m_key == JSON_KEY_MIME_TYPE)
+        {
+            m_target = &m_mimeType;
+            m_fields |= FIELD_MIME_TYPE;
+        }
+        else if (m_key == JSON_KEY_SIZE)
+        {
+            // Drive sends 64-bit numbers as strings.
+            m_target = &m_size;
+        }
+        else if (m_key == JSON_KEY_MODIFIED_TIME)
+        {
+            m_target = &m_modifiedTime;
+        }
+        else if (m_key == JSON_KEY_MD5_CHECKSUM)
+        {
+            m_target = &m_md5Checksum;
+        }
+    }
+    else if (m_section == ListingParser::Section::AppProperties && m_depth == DEPTH_APP_PROPERTIES)
+    {
+        if (m_key == compression::PROPERTY_CODEC)
+        {
+            m_target = &m_codec;
+        }
+        else if (m_key == compression::PROPERTY_SIZE)
+        {
+            m_target = &m_originalSize;
+        }
+    }
+    else if (m_section == ListingParser::Section::Parents && m_depth == DEPTH_PARENTS && !(m_fields & FIELD_PARENT))
+    {
+        // Files can only have one parent. Only the first is kept.
+        m_target = &m_parent;
+        m_fields |= FIELD_PARENT;
+    }
+
+    if (m_target)
+    {
+        m_target->clear();
+    }
+}
+
+bool ListingParser::open_container(bool isObject)
+{
+    if (m_depth == ListingParser::MAX_DEPTH)
+    {
+        return false;
+    }
+
+    // Sections only change at the exact depth and key they're expected at. Anything else is skipped over.
+    if (m_section == ListingParser::Section::None && m_depth == DEPTH_TOP)
+    {
+        if (!isObject && m_key == JSON_KEY_FILES)
+        {
+            m_section = ListingParser::Section::Files;
+            m_foundFiles = true;
+        }
+        else if (isObject && m_key == JSON_KEY_ERROR)
+        {
+            m_section = ListingParser::Section::Error;
+        }
+    }
+    else if (m_section == ListingParser::Section::Files && m_depth == DEPTH_FILES && isObject)
+    {
+        m_section = ListingParser::Section::File;
+        m_fields = 0;
+        m_size.clear();
+        m_modifiedTime.clear();
+        m_md5Checksum.clear();
+        m_codec.clear();
+        m_originalSize.clear();
+    }
+    else if (m_section == ListingParser::Section::File && m_depth == DEPTH_FILE && !isObject &&
+             m_key == JSON_KEY_PARENTS)
+    {
+        m_section = ListingParser::Section::Parents;
+    }
+    else if (m_section == ListingParser::Section::File && m_depth == DEPTH_FILE && isObject &&
+             m_key == JSON_KEY_APP_PROPERTIES)
+    {
+        m_section = ListingParser::Section::AppProperties;
+    }
+
+    m_containers[m_depth++] = isObject;
+    m_expect = isObject ? ListingParser::Expect::Key : ListingParser::Expect::Value;
+    return true;
+}
+
+bool ListingParser::close_container(bool isObject)
+{
+    if (m_depth == 0 || m_containers[m_depth - 1] != isObject)
+    {
+        return false;
+    }
+    m_depth--;
+
+    if ((m_section == ListingParser::Section::Parents || m_section == ListingParser::Section::AppProperties) &&
+        m_depth == DEPTH_FILE)
+    {
+        m_section = ListingParser::Section::File;
+    }
+    else if (m_section == ListingParser::Section::File && m_depth == DEPTH_FILES)
+    {
+        m_section = ListingParser::Section::Files;
+        if (!ListingParser::add_file())
+        {
+            return false;
+        }
+    }
+    else if ((m_section == ListingParser::Section::Files || m_section == ListingParser::Section::Error) &&
+             m_depth == DEPTH_TOP)
+    {
+        m_section = ListingParser::Section::None;
+    }
+
+    ListingParser::end_value();
+    return true;
+}
+
+bool ListingParser::add_file(void)
+{
+    if (m_fields != FIELD_ALL)
+    {
+        logger::error("Error processing Google Drive list: File is missing fields.");
+        return false;
+    }
+
+    // Google's own file types and folders don't have a size or checksum. Those are left at 0 and empty.
+    uint64_t size = 0;
+    int64_t modifiedTime = 0;
+    std::from_chars(m_size.data(), m_size.data() + m_size.length(), size);
+    stringutil::parse_timestamp(m_modifiedTime, modifiedTime);
+
+    // Drive's size and checksum of a compressed file are of the compressed data. The original size is kept in its
+    // properties. Its checksum isn't known.
+    if (!m_codec.empty())
+    {
+        size = 0;
+        std::from_chars(m_originalSize.data(), m_originalSize.data() + m_originalSize.length(), size);
+        m_md5Checksum.clear();
+    }
+
+    bool isDirectory = m_mimeType == MIME_TYPE_DIRECTORY;
+    m_catalog.add(m_name, m_id, m_parent, isDirectory, size, modifiedTime, m_md5Checksum);
+
+    if (isDirectory && m_directories)
+    {
+        m_directories->emplace_back(m_id);
+    }
+    return true;
+}
+
+void ListingParser::end_value(void)
+{
+    m_expect = ListingParser::Expect::Comma;
+    if (m_depth == 0)
+    {
+        m_state = ListingParser::State::Done;
+    }
+}
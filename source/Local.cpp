@@ -1,5 +1,7 @@
 #include "Local.hpp"
-#include <algorithm>
+#include "hasher.hpp"
+#include "metrics.hpp"
+#include "scanner.hpp"
 #include <filesystem>
 #include <iostream>
 
@@ -32,22 +34,66 @@ void Local::change_directory(std::string_view name)
 
 bool Local::create_directory(std::string_view name)
 {
+    static metrics::Operation &operationMetrics = metrics::operation("local", "create_directory");
+    metrics::ScopedOperation timer(operationMetrics);
+
     // Full path.
     std::filesystem::path fullPath = std::filesystem::path(m_parent) / name;
     // This should be good enough.
-    return std::filesystem::create_directory(fullPath);
+    if (!std::filesystem::create_directory(fullPath))
+    {
+        return false;
+    }
+    timer.succeed();
+    return true;
 }
 
 bool Local::delete_directory(std::string_view name)
 {
+    static metrics::Operation &operationMetrics = metrics::operation("local", "delete_directory");
+    metrics::ScopedOperation timer(operationMetrics);
+
     // Path
     std::filesystem::path fullPath = std::filesystem::path(m_parent) / name;
     // This might need a better check for return some time?
-    return std::filesystem::remove_all(fullPath) > 0;
+    if (std::filesystem::remove_all(fullPath) == 0)
+    {
+        return false;
+    }
+    timer.succeed();
+    return true;
+}
+
+std::optional<size_t> Local::count_directory(std::string_view name)
+{
+    std::filesystem::path fullPath = std::filesystem::path(m_parent) / name;
+
+    std::error_code error{};
+    if (!std::filesystem::is_directory(fullPath, error))
+    {
+        return std::nullopt;
+    }
+
+    std::vector<scanner::Directory> directories{};
+    if (!scanner::scan_tree(fullPath.string(), directories))
+    {
+        return std::nullopt;
+    }
+
+    // Start at one for the directory itself.
+    size_t count = 1;
+    for (const scanner::Directory &directory : directories)
+    {
+        count += directory.entries.size();
+    }
+    return count;
 }
 
 bool Local::delete_file(std::string_view name)
 {
+    static metrics::Operation &operationMetrics = metrics::operation("local", "delete_file");
+    metrics::ScopedOperation timer(operationMetrics);
+
     if (!Local::file_exists(name))
     {
         return false;
@@ -56,8 +102,12 @@ bool Local::delete_file(std::string_view name)
     // Path
     std::filesystem::path fullPath = std::filesystem::path(m_parent) / name;
 
-    // This already returns a bool.
-    return std::filesystem::remove(fullPath);
+    if (!std::filesystem::remove(fullPath))
+    {
+        return false;
+    }
+    timer.succeed();
+    return true;
 }
 
 void Local::list_contents(void) const
@@ -68,21 +118,108 @@ void Local::list_contents(void) const
         std::cout << "\tID: " << item.get_id() << std::endl;
         std::cout << "\tParent: " << item.get_parent_id() << std::endl;
         std::cout << "\tDirectory: " << (item.is_directory() ? "true" : "false") << std::endl;
+        if (!item.get_md5_checksum().empty())
+        {
+            std::cout << "\tMD5: " << item.get_md5_checksum() << std::endl;
+        }
+    }
+}
+
+bool Local::refresh(void)
+{
+    Local::load_parent_listing();
+    return true;
+}
+
+std::vector<hasher::Result> Local::hash_files(const std::vector<std::string> &names)
+{
+    std::vector<std::filesystem::path> paths{};
+    std::vector<std::filesystem::path> directories{};
+    if (names.empty())
+    {
+        directories.emplace_back(m_parent);
+    }
+
+    for (const std::string &name : names)
+    {
+        std::filesystem::path fullPath = std::filesystem::path(m_parent) / name;
+        std::error_code error{};
+        std::filesystem::is_directory(fullPath, error) ? directories.push_back(fullPath) : paths.push_back(fullPath);
+    }
+
+    // No names only hashes what's directly in the current directory. Named directories are hashed all the way down.
+    for (const std::filesystem::path &directory : directories)
+    {
+        std::error_code error{};
+        if (names.empty())
+        {
+            for (std::filesystem::directory_iterator entry{directory, error}, end{}; !error && entry != end;
+                 entry.increment(error))
+            {
+                if (entry->is_regular_file(error) && !entry->is_symlink(error))
+                {
+                    paths.push_back(entry->path());
+                }
+            }
+            continue;
+        }
+
+        for (std::filesystem::recursive_directory_iterator entry{directory, error}, end{}; !error && entry != end;
+             entry.increment(error))
+        {
+            if (entry->is_regular_file(error) && !entry->is_symlink(error))
+            {
+                paths.push_back(entry->path());
+            }
+        }
     }
+
+    std::vector<hasher::Result> results = hasher::hash_files(paths);
+
+    // Anything hashed here is now cached, so the listing can show it.
+    Local::load_parent_listing();
+    return results;
 }
 
 void Local::load_parent_listing(void)
 {
+    static metrics::Operation &operationMetrics = metrics::operation("local", "list");
+    metrics::ScopedOperation timer(operationMetrics);
+
     // Clear the list vector.
     m_list.clear();
 
     // Load the listing for m_parent.
-    for (const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(m_parent))
+    std::vector<scanner::Entry> entries{};
+    if (!scanner::scan_directory(m_parent, entries))
+    {
+        return;
+    }
+
+    m_list.reserve(entries.size());
+    for (const scanner::Entry &entry : entries)
     {
-        // This is used twice for this storage type and I think it looks stupid.
-        std::string name = entry.path().filename().string();
+        // Files get their size and time from the same stat the hash cache is keyed by. The MD5 is only filled in if
+        // it's already cached. Listing a directory never reads its files.
+        md5::Digest digest{};
+        std::string md5Checksum{};
+        hasher::FileKey key{.device = entry.device,
+                            .inode = entry.inode,
+                            .size = entry.size,
+                            .modifiedTime = entry.modifiedTime};
+        if (entry.isRegularFile && hasher::find_cached(key, digest))
+        {
+            md5Checksum = md5::to_hex(digest);
+        }
 
-        // Push back the name of the file.
-        m_list.emplace_back(name, name, entry.path().parent_path().string(), entry.is_directory());
+        // The name doubles as the ID for this storage type.
+        m_list.add(entry.name,
+                   entry.name,
+                   m_parent,
+                   entry.isDirectory,
+                   entry.size,
+                   entry.modifiedTime / 1000000,
+                   md5Checksum);
     }
+    timer.succeed();
 }
\ No newline at end of file
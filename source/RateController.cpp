@@ -0,0 +1,123 @@
+#include "RateController.hpp"
+#include <algorithm>
+
+namespace
+{
+    /// @brief Reasons Google gives in the body of a 403 that's really a rate limit. The second is the message that
+    /// goes with them, in case only the message made it through.
+    constexpr std::string_view RATE_LIMIT_REASONS[] = {"rateLimitExceeded", "Rate Limit Exceeded"};
+
+    /// @brief Retries past this don't make the backoff any longer. It's capped long before then anyway.
+    constexpr int MAX_BACKOFF_DOUBLINGS = 16;
+} // namespace
+
+RateController::RateController(int maxLimit)
+{
+    RateController::set_max_limit(maxLimit);
+}
+
+RateController::Outcome RateController::classify(bool performed, long code, std::string_view response)
+{
+    // The status code goes first. curl reports HTTP errors as transport errors when CURLOPT_FAILONERROR is set.
+    if (code == 429)
+    {
+        return RateController::Outcome::Throttled;
+    }
+    else if (code == 403)
+    {
+        // userRateLimitExceeded contains rateLimitExceeded, so that's covered too. Everything else is permissions
+        // or the daily quota and won't get better by waiting a few seconds.
+        bool rateLimited = std::any_of(std::begin(RATE_LIMIT_REASONS),
+                                       std::end(RATE_LIMIT_REASONS),
+                                       [response](std::string_view reason) {
+                                           return response.find(reason) != response.npos;
+                                       });
+        return rateLimited ? RateController::Outcome::Throttled : RateController::Outcome::Fatal;
+    }
+    else if (code == 503)
+    {
+        // Google returns this when the backend is overloaded.
+        return RateController::Outcome::Throttled;
+    }
+    else if (code == 408 || code >= 500)
+    {
+        return RateController::Outcome::Retryable;
+    }
+    else if (code >= 400)
+    {
+        return RateController::Outcome::Fatal;
+    }
+    else if (!performed)
+    {
+        // Connection problems and transfers cut off part way through.
+        return RateController::Outcome::Retryable;
+    }
+    return RateController::Outcome::Success;
+}
+
+void RateController::set_max_limit(int maxLimit)
+{
+    m_maxLimit = std::max(maxLimit, 1);
+    m_limit = std::min(m_limit, static_cast<double>(m_maxLimit));
+}
+
+bool RateController::try_acquire(void)
+{
+    if (m_inFlight >= static_cast<int>(m_limit) || Clock::now() < m_pausedUntil)
+    {
+        return false;
+    }
+    ++m_inFlight;
+    return true;
+}
+
+void RateController::release(RateController::Outcome outcome)
+{
+    --m_inFlight;
+    if (outcome == RateController::Outcome::Success)
+    {
+        // One more slot for every limit's worth of successes.
+        m_throttleStreak = 0;
+        m_limit = std::min(m_limit + (1.0 / m_limit), static_cast<double>(m_maxLimit));
+    }
+    else if (outcome == RateController::Outcome::Throttled)
+    {
+        // Requests that were already in flight when the limit was cut come back throttled too. That's the same event,
+        // so the limit isn't cut again until what's in flight fits under it.
+        ++m_throttleStreak;
+        if (m_inFlight >= static_cast<int>(m_limit))
+        {
+            return;
+        }
+
+        // Once a single request at a time is too much, everything waits out the backoff.
+        if (m_limit >= 2.0)
+        {
+            m_limit /= 2.0;
+        }
+        else
+        {
+            m_pausedUntil = std::max(m_pausedUntil, Clock::now() + RateController::get_backoff(m_throttleStreak));
+        }
+    }
+}
+
+std::chrono::milliseconds RateController::get_backoff(int attempt)
+{
+    int doublings = std::clamp(attempt - 1, 0, MAX_BACKOFF_DOUBLINGS);
+    std::chrono::milliseconds ceiling = std::min(RateController::BACKOFF_BASE * (1 << doublings),
+                                                 std::chrono::milliseconds(RateController::BACKOFF_MAX));
+
+    std::uniform_int_distribution<std::chrono::milliseconds::rep> distribution(0, ceiling.count());
+    return std::chrono::milliseconds(distribution(m_random));
+}
+
+int RateController::get_limit(void) const
+{
+    return static_cast<int>(m_limit);
+}
+
+int RateController::get_in_flight(void) const
+{
+    return m_inFlight;
+}
@@ -0,0 +1,234 @@
+#include "Snapshot.hpp"
+#include "logger.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    /// @brief Magic at the beginning of every snapshot.
+    constexpr char SNAPSHOT_MAGIC[8] = {'J', 'K', 'S', 'V', 'C', 'T', 'L', 'G'};
+
+    /// @brief Current version of the snapshot format. Bump this whenever the layout changes.
+    constexpr uint32_t SNAPSHOT_VERSION = 3;
+
+    /// @brief Snapshot file header.
+    struct Header
+    {
+            char magic[8];
+            uint32_t version;
+            uint32_t reserved;
+            uint64_t payloadLength;
+            uint64_t checksum;
+    };
+
+    /// @brief Shared memory mapping of a whole file that unmaps itself.
+    class FileMapping
+    {
+        public:
+            FileMapping(const std::filesystem::path &path, bool writable)
+            {
+                int descriptor = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+                if (descriptor < 0)
+                {
+                    return;
+                }
+
+                struct stat fileStat{};
+                if (fstat(descriptor, &fileStat) == 0 && fileStat.st_size > 0)
+                {
+                    int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+                    void *mapping = mmap(nullptr, fileStat.st_size, protection, MAP_SHARED, descriptor, 0);
+                    if (mapping != MAP_FAILED)
+                    {
+                        m_data = static_cast<char *>(mapping);
+                        m_size = fileStat.st_size;
+                        madvise(m_data, m_size, MADV_SEQUENTIAL);
+                    }
+                }
+                // The mapping stays valid after the descriptor is closed.
+                close(descriptor);
+            }
+
+            FileMapping(const FileMapping &) = delete;
+            FileMapping &operator=(const FileMapping &) = delete;
+
+            ~FileMapping()
+            {
+                if (m_data)
+                {
+                    munmap(m_data, m_size);
+                }
+            }
+
+            char *data(void) const
+            {
+                return m_data;
+            }
+
+            size_t size(void) const
+            {
+                return m_size;
+            }
+
+        private:
+            char *m_data = nullptr;
+            size_t m_size = 0;
+    };
+
+    /// @brief Fast checksum of data. Four independent lanes so the multiplies don't wait on each other.
+    uint64_t checksum(std::string_view data)
+    {
+        constexpr uint64_t PRIME = 0x100000001B3ull;
+        uint64_t lanes[4] = {0xCBF29CE484222325ull,
+                             0x84222325CBF29CE4ull,
+                             0x9E3779B97F4A7C15ull,
+                             0xC2B2AE3D27D4EB4Full};
+
+        size_t offset = 0;
+        for (; offset + 32 <= data.length(); offset += 32)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                uint64_t word = 0;
+                std::memcpy(&word, data.data() + offset + (i * 8), sizeof(uint64_t));
+                lanes[i] = (lanes[i] ^ word) * PRIME;
+                lanes[i] ^= lanes[i] >> 29;
+            }
+        }
+
+        uint64_t hash = lanes[0] ^ (lanes[1] << 1) ^ (lanes[2] << 2) ^ (lanes[3] << 3);
+        for (; offset < data.length(); offset++)
+        {
+            hash = (hash ^ static_cast<unsigned char>(data[offset])) * PRIME;
+        }
+        return hash ^ data.length();
+    }
+
+    /// @brief Writes a length prefixed string.
+    void write_string(std::ostream &stream, std::string_view string)
+    {
+        uint32_t length = static_cast<uint32_t>(string.length());
+        stream.write(reinterpret_cast<const char *>(&length), sizeof(uint32_t));
+        stream.write(string.data(), string.length());
+    }
+
+    /// @brief Reads a length prefixed string and advances data.
+    bool read_string(std::string_view &data, std::string &string)
+    {
+        uint32_t length = 0;
+        if (data.length() < sizeof(uint32_t))
+        {
+            return false;
+        }
+        std::memcpy(&length, data.data(), sizeof(uint32_t));
+        data.remove_prefix(sizeof(uint32_t));
+
+        if (data.length() < length)
+        {
+            return false;
+        }
+        string.assign(data.data(), length);
+        data.remove_prefix(length);
+        return true;
+    }
+} // namespace
+
+bool snapshot::write(const std::filesystem::path &path, const Catalog &catalog, const snapshot::Metadata &metadata)
+{
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += ".tmp";
+
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            logger::error("Error opening snapshot \"%s\" for writing.", temporaryPath.c_str());
+            return false;
+        }
+
+        // The header is filled in once the payload is written and can be checksummed.
+        Header header{};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+
+        write_string(file, metadata.account);
+        write_string(file, metadata.root);
+        write_string(file, metadata.changesToken);
+        int64_t timestamp = metadata.timestamp;
+        file.write(reinterpret_cast<const char *>(&timestamp), sizeof(int64_t));
+
+        if (!catalog.write(file) || !file.flush())
+        {
+            logger::error("Error writing snapshot.");
+            return false;
+        }
+    }
+
+    {
+        FileMapping mapping(temporaryPath, true);
+        if (!mapping.data() || mapping.size() < sizeof(Header))
+        {
+            return false;
+        }
+
+        std::string_view payload(mapping.data() + sizeof(Header), mapping.size() - sizeof(Header));
+
+        Header header{};
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        header.version = SNAPSHOT_VERSION;
+        header.payloadLength = payload.length();
+        header.checksum = checksum(payload);
+        std::memcpy(mapping.data(), &header, sizeof(Header));
+        msync(mapping.data(), sizeof(Header), MS_SYNC);
+    }
+
+    std::error_code error{};
+    std::filesystem::rename(temporaryPath, path, error);
+    return !error;
+}
+
+bool snapshot::read(const std::filesystem::path &path, Catalog &catalog, snapshot::Metadata &metadata)
+{
+    FileMapping mapping(path, false);
+    if (!mapping.data() || mapping.size() < sizeof(Header))
+    {
+        return false;
+    }
+
+    Header header{};
+    std::memcpy(&header, mapping.data(), sizeof(Header));
+    std::string_view payload(mapping.data() + sizeof(Header), mapping.size() - sizeof(Header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header.version != SNAPSHOT_VERSION)
+    {
+        logger::warning("Snapshot \"%s\" is from a different version.", path.c_str());
+        return false;
+    }
+    else if (header.payloadLength != payload.length() || header.checksum != checksum(payload))
+    {
+        logger::error("Snapshot \"%s\" is corrupted.", path.c_str());
+        return false;
+    }
+
+    int64_t timestamp = 0;
+    if (!read_string(payload, metadata.account) || !read_string(payload, metadata.root) ||
+        !read_string(payload, metadata.changesToken) || payload.length() < sizeof(int64_t))
+    {
+        return false;
+    }
+    std::memcpy(&timestamp, payload.data(), sizeof(int64_t));
+    payload.remove_prefix(sizeof(int64_t));
+    metadata.timestamp = timestamp;
+
+    // Everything should be consumed by the catalog. Anything left over means something is off.
+    if (!catalog.read(payload) || !payload.empty())
+    {
+        logger::error("Snapshot \"%s\" catalog is invalid.", path.c_str());
+        catalog.clear();
+        return false;
+    }
+
+    return true;
+}
@@ -1,5 +1,4 @@
 #include "Storage.hpp"
-#include <algorithm>
 #include <iostream>
 
 Storage::Storage(std::string_view root) : m_root(root), m_parent(root) {};
@@ -14,32 +13,37 @@ void Storage::return_to_root(void)
     m_parent = m_root;
 }
 
+const std::string &Storage::get_parent_id(void) const
+{
+    return m_parent;
+}
+
 bool Storage::directory_exists(std::string_view name)
 {
-    return Storage::find_directory(name) != m_list.end();
+    return Storage::find_directory(name) != Catalog::NOT_FOUND;
 }
 
 bool Storage::file_exists(std::string_view name)
 {
-    return Storage::find_file(name) != m_list.end();
+    return Storage::find_file(name) != Catalog::NOT_FOUND;
 }
 
 bool Storage::get_directory_id(std::string_view name, std::string &out)
 {
-    Storage::ItemIterator findDir = Storage::find_directory(name);
-    if (findDir == m_list.end())
+    Storage::ItemIndex findDir = Storage::find_directory(name);
+    if (findDir == Catalog::NOT_FOUND)
     {
         return false;
     }
     // Set out to the ID of the dir found.
-    out = findDir->get_id();
+    out = m_list.at(findDir).get_id();
     // Success!?
     return true;
 }
 
 bool Storage::get_directory_id(int index, std::string &out)
 {
-    if (index < 0 || index >= m_list.size())
+    if (index < 0 || !m_list.is_valid(index))
     {
         return false;
     }
@@ -49,18 +53,18 @@ bool Storage::get_directory_id(int index, std::string &out)
 
 bool Storage::get_file_id(std::string_view name, std::string &out)
 {
-    Storage::ItemIterator findFile = Storage::find_file(name);
-    if (findFile == m_list.end())
+    Storage::ItemIndex findFile = Storage::find_file(name);
+    if (findFile == Catalog::NOT_FOUND)
     {
         return false;
     }
-    out = findFile->get_id();
+    out = m_list.at(findFile).get_id();
     return true;
 }
 
 bool Storage::get_file_id(int index, std::string &out)
 {
-    if (index < 0 || index >= m_list.size())
+    if (index < 0 || !m_list.is_valid(index))
     {
         return false;
     }
@@ -79,16 +83,12 @@ void Storage::list_contents(void) const
     }
 }
 
-Storage::ItemIterator Storage::find_directory(std::string_view name)
+Storage::ItemIndex Storage::find_directory(std::string_view name) const
 {
-    return std::find_if(m_list.begin(), m_list.end(), [name, this](const Item &item) {
-        return item.is_directory() && item.get_parent_id() == this->m_parent && name == item.get_name();
-    });
+    return m_list.find_child(m_parent, name, true);
 }
 
-Storage::ItemIterator Storage::find_file(std::string_view name)
+Storage::ItemIndex Storage::find_file(std::string_view name) const
 {
-    return std::find_if(m_list.begin(), m_list.end(), [name, this](const Item &item) {
-        return !item.is_directory() && item.get_parent_id() == this->m_parent && item.get_name() == name;
-    });
+    return m_list.find_child(m_parent, name, false);
 }
\ No newline at end of file
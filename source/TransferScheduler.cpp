@@ -0,0 +1,420 @@
+#include "TransferScheduler.hpp"
+#include "logger.hpp"
+#include <algorithm>
+
+const std::string &TransferScheduler::Job::get_name(void) const
+{
+    return m_name;
+}
+
+TransferScheduler::Job::Progress TransferScheduler::Job::get_progress(void) const
+{
+    return {.itemsTotal = m_itemsTotal,
+            .itemsDone = m_itemsDone,
+            .itemsFailed = m_itemsFailed,
+            .bytesTotal = m_bytesTotal,
+            .bytesTransferred = m_bytesTransferred};
+}
+
+bool TransferScheduler::Job::is_finished(void) const
+{
+    return m_itemsDone == m_itemsTotal;
+}
+
+void TransferScheduler::Job::wait(void)
+{
+    std::unique_lock<std::mutex> jobGuard(m_lock);
+    m_finishedSignal.wait(jobGuard, [this]() { return m_finished; });
+}
+
+std::vector<std::filesystem::path> TransferScheduler::Job::get_failures(void)
+{
+    std::lock_guard<std::mutex> jobGuard(m_lock);
+    return m_failures;
+}
+
+TransferScheduler::TransferScheduler(Remote &remote, size_t workerCount, size_t memoryBudget, size_t maxTransfers)
+    : m_remote(remote), m_memoryBudget(std::max<size_t>(memoryBudget, 1)),
+      m_maxTransfers(std::max<size_t>(maxTransfers, 1))
+{
+    if (workerCount == 0)
+    {
+        workerCount = std::max(std::thread::hardware_concurrency(), 1U);
+    }
+
+    // Every worker needs to exist before any of them start looking for work to steal.
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        m_workers.push_back(std::make_unique<TransferScheduler::Worker>());
+    }
+
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        m_workers[i]->thread = std::thread(&TransferScheduler::run_worker, this, i);
+    }
+}
+
+TransferScheduler::~TransferScheduler()
+{
+    TransferScheduler::shut_down();
+}
+
+std::shared_ptr<TransferScheduler::Job> TransferScheduler::backup(const std::filesystem::path &directory,
+                                                                  std::string_view parent)
+{
+    std::shared_ptr<TransferScheduler::Job> job = std::make_shared<TransferScheduler::Job>(directory.string());
+    {
+        std::lock_guard<std::mutex> jobGuard(m_jobLock);
+        m_jobs.push_back(job);
+    }
+
+    // Trailing slashes would leave the directory without a name.
+    std::shared_ptr<TransferScheduler::Entry> root = std::make_shared<TransferScheduler::Entry>();
+    root->job = job;
+    root->path = directory.has_filename() ? directory : directory.parent_path();
+    root->remote = parent;
+    root->isDirectory = true;
+
+    // The directory needs to exist on the remote before anything can go in it.
+    ++job->m_itemsTotal;
+    TransferScheduler::submit({.type = TaskType::Transfer, .entry = std::move(root)});
+
+    return job;
+}
+
+std::shared_ptr<TransferScheduler::Job> TransferScheduler::restore(
+    const std::vector<std::pair<std::string, std::filesystem::path>> &files)
+{
+    std::shared_ptr<TransferScheduler::Job> job = std::make_shared<TransferScheduler::Job>("restore");
+    {
+        std::lock_guard<std::mutex> jobGuard(m_jobLock);
+        m_jobs.push_back(job);
+    }
+
+    if (files.empty())
+    {
+        job->m_finished = true;
+        return job;
+    }
+
+    // Everything is counted up front so the job can't look finished before the last file is queued.
+    job->m_itemsTotal = files.size();
+    for (const auto &[remote, path] : files)
+    {
+        std::shared_ptr<TransferScheduler::Entry> entry = std::make_shared<TransferScheduler::Entry>();
+        entry->job = job;
+        entry->path = path;
+        entry->remote = remote;
+        entry->isRestore = true;
+        TransferScheduler::submit({.type = TaskType::Transfer, .entry = std::move(entry)});
+    }
+
+    return job;
+}
+
+std::vector<std::shared_ptr<TransferScheduler::Job>> TransferScheduler::get_jobs(void)
+{
+    std::lock_guard<std::mutex> jobGuard(m_jobLock);
+    return m_jobs;
+}
+
+void TransferScheduler::shut_down(void)
+{
+    if (m_stopping)
+    {
+        return;
+    }
+
+    for (std::shared_ptr<TransferScheduler::Job> &job : TransferScheduler::get_jobs())
+    {
+        job->wait();
+    }
+
+    {
+        std::lock_guard<std::mutex> idleGuard(m_idleLock);
+        m_stopping = true;
+    }
+    m_idleSignal.notify_all();
+
+    for (std::unique_ptr<TransferScheduler::Worker> &worker : m_workers)
+    {
+        worker->thread.join();
+    }
+}
+
+void TransferScheduler::run_worker(size_t index)
+{
+    while (true)
+    {
+        TransferScheduler::Work work{};
+        if (!TransferScheduler::take_work(index, work))
+        {
+            std::unique_lock<std::mutex> idleGuard(m_idleLock);
+            m_idleSignal.wait(idleGuard, [this]() { return m_queued > 0 || m_stopping; });
+            if (m_stopping && m_queued == 0)
+            {
+                return;
+            }
+            continue;
+        }
+
+        switch (work.type)
+        {
+            case TaskType::Read:
+            {
+                TransferScheduler::read_directory(std::move(work.entry), index);
+            }
+            break;
+
+            case TaskType::Transfer:
+            {
+                TransferScheduler::start_transfer(std::move(work));
+            }
+            break;
+        }
+    }
+}
+
+bool TransferScheduler::take_work(size_t index, TransferScheduler::Work &workOut)
+{
+    // Newest work first from our own queue. It's the most likely to still be in the cache.
+    {
+        TransferScheduler::Worker &worker = *m_workers[index];
+        std::lock_guard<std::mutex> queueGuard(worker.lock);
+        if (!worker.queue.empty())
+        {
+            workOut = std::move(worker.queue.back());
+            worker.queue.pop_back();
+            --m_queued;
+            return true;
+        }
+    }
+
+    // Oldest work first from everyone else's.
+    for (size_t i = 1; i < m_workers.size(); i++)
+    {
+        TransferScheduler::Worker &victim = *m_workers[(index + i) % m_workers.size()];
+        std::lock_guard<std::mutex> queueGuard(victim.lock);
+        if (!victim.queue.empty())
+        {
+            workOut = std::move(victim.queue.front());
+            victim.queue.pop_front();
+            --m_queued;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void TransferScheduler::submit(TransferScheduler::Work work, size_t index)
+{
+    if (index >= m_workers.size())
+    {
+        index = m_nextWorker++ % m_workers.size();
+    }
+
+    {
+        TransferScheduler::Worker &worker = *m_workers[index];
+        std::lock_guard<std::mutex> queueGuard(worker.lock);
+        worker.queue.push_back(std::move(work));
+    }
+    ++m_queued;
+
+    // Taking the lock makes sure a worker about to wait sees the new count instead of missing the signal.
+    {
+        std::lock_guard<std::mutex> idleGuard(m_idleLock);
+    }
+    m_idleSignal.notify_one();
+}
+
+void TransferScheduler::read_directory(std::shared_ptr<TransferScheduler::Entry> entry, size_t index)
+{
+    TransferScheduler::Job &job = *entry->job;
+
+    std::error_code error{};
+    std::filesystem::directory_iterator directory(entry->path, error);
+    for (; !error && directory != std::filesystem::directory_iterator{}; directory.increment(error))
+    {
+        // Links are skipped so a loop can't make the job go on forever.
+        std::error_code statusError{};
+        if (directory->is_symlink(statusError))
+        {
+            continue;
+        }
+
+        std::shared_ptr<TransferScheduler::Entry> child = std::make_shared<TransferScheduler::Entry>();
+        child->job = entry->job;
+        child->path = directory->path();
+        child->remote = entry->remote;
+
+        if (directory->is_directory(statusError))
+        {
+            child->isDirectory = true;
+            ++job.m_itemsTotal;
+            TransferScheduler::submit({.type = TaskType::Transfer, .entry = std::move(child)}, index);
+        }
+        else if (directory->is_regular_file(statusError))
+        {
+            // The upload reads the file itself. These are only kept to tell if it changed while it was uploading.
+            child->size = directory->file_size(statusError);
+            child->modifiedTime = directory->last_write_time(statusError);
+            ++job.m_itemsTotal;
+            job.m_bytesTotal += child->size;
+            TransferScheduler::submit({.type = TaskType::Transfer, .entry = std::move(child)}, index);
+        }
+    }
+
+    if (error)
+    {
+        logger::error("Error reading \"%s\" for backup: %s.", entry->path.c_str(), error.message().c_str());
+    }
+    TransferScheduler::finish_item(*entry, !error);
+}
+
+void TransferScheduler::start_transfer(TransferScheduler::Work work)
+{
+    // Uploads hold their buffers until they finish. Ones waiting for a slot keep what they already have.
+    TransferScheduler::Entry &entry = *work.entry;
+    if (!entry.isDirectory && !entry.isRestore && entry.memory == 0)
+    {
+        size_t memory = std::min(m_remote.get_upload_memory(), m_memoryBudget);
+        if (memory > 0 && !TransferScheduler::acquire_memory(work, memory))
+        {
+            return;
+        }
+        entry.memory = memory;
+    }
+
+    {
+        std::lock_guard<std::mutex> transferGuard(m_transferLock);
+        if (m_transfersRunning >= m_maxTransfers)
+        {
+            m_transferWaiters.push_back(std::move(work));
+            return;
+        }
+        ++m_transfersRunning;
+    }
+
+    // The remote runs it from here. The worker is free to move on.
+    m_remote.spawn(TransferScheduler::run_transfer(std::move(work.entry)));
+}
+
+Task<void> TransferScheduler::run_transfer(std::shared_ptr<TransferScheduler::Entry> entry)
+{
+    bool success = false;
+    if (entry->isRestore)
+    {
+        success = co_await m_remote.download_file_async(entry->remote, entry->path);
+    }
+    else if (entry->isDirectory)
+    {
+        std::string id = co_await m_remote.create_directory_async(entry->path.filename().string(), entry->remote);
+        success = !id.empty();
+        entry->remote = std::move(id);
+    }
+    else
+    {
+        Remote::UploadResult result = co_await m_remote.upload_file_async(entry->path, entry->remote);
+        success = result.success;
+
+        // What was uploaded could be a mix of before and after if the file was written to in the meantime.
+        std::error_code error{};
+        if (success && (std::filesystem::file_size(entry->path, error) != entry->size ||
+                        std::filesystem::last_write_time(entry->path, error) != entry->modifiedTime || error))
+        {
+            logger::warning("\"%s\" changed while it was being backed up.", entry->path.c_str());
+            success = false;
+        }
+
+        if (entry->memory > 0)
+        {
+            TransferScheduler::release_memory(entry->memory);
+            entry->memory = 0;
+        }
+    }
+    TransferScheduler::finish_transfer();
+
+    // Directories aren't done until everything in them is queued.
+    if (success && entry->isDirectory)
+    {
+        TransferScheduler::submit({.type = TaskType::Read, .entry = std::move(entry)});
+        co_return;
+    }
+    TransferScheduler::finish_item(*entry, success);
+}
+
+void TransferScheduler::finish_transfer(void)
+{
+    // The slot is handed straight to the next transfer waiting for one.
+    TransferScheduler::Work next{};
+    {
+        std::lock_guard<std::mutex> transferGuard(m_transferLock);
+        if (m_transferWaiters.empty())
+        {
+            --m_transfersRunning;
+            return;
+        }
+        next = std::move(m_transferWaiters.front());
+        m_transferWaiters.pop_front();
+    }
+    m_remote.spawn(TransferScheduler::run_transfer(std::move(next.entry)));
+}
+
+bool TransferScheduler::acquire_memory(TransferScheduler::Work &work, size_t size)
+{
+    std::lock_guard<std::mutex> memoryGuard(m_memoryLock);
+    if (m_memoryUsed + size > m_memoryBudget)
+    {
+        m_memoryWaiters.push_back(std::move(work));
+        return false;
+    }
+    m_memoryUsed += size;
+    return true;
+}
+
+void TransferScheduler::release_memory(size_t size)
+{
+    std::deque<TransferScheduler::Work> waiters{};
+    {
+        std::lock_guard<std::mutex> memoryGuard(m_memoryLock);
+        m_memoryUsed -= size;
+        waiters.swap(m_memoryWaiters);
+    }
+
+    // Whichever ones don't fit are parked again.
+    for (TransferScheduler::Work &work : waiters)
+    {
+        TransferScheduler::submit(std::move(work));
+    }
+}
+
+void TransferScheduler::finish_item(TransferScheduler::Entry &entry, bool success)
+{
+    TransferScheduler::Job &job = *entry.job;
+    if (!success)
+    {
+        std::lock_guard<std::mutex> jobGuard(job.m_lock);
+        job.m_failures.push_back(entry.path);
+        ++job.m_itemsFailed;
+    }
+    else if (entry.isRestore)
+    {
+        std::error_code error{};
+        job.m_bytesTransferred += std::filesystem::file_size(entry.path, error);
+    }
+    else if (!entry.isDirectory)
+    {
+        job.m_bytesTransferred += entry.size;
+    }
+
+    // Everything in a directory is counted before the directory finishes, so this can only be true at the very end.
+    if (++job.m_itemsDone == job.m_itemsTotal)
+    {
+        {
+            std::lock_guard<std::mutex> jobGuard(job.m_lock);
+            job.m_finished = true;
+        }
+        job.m_finishedSignal.notify_all();
+    }
+}
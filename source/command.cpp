@@ -2,10 +2,20 @@
 #include "CommandReader.hpp"
 #include "GoogleDrive.hpp"
 #include "Local.hpp"
+#include "Remote.hpp"
 #include "Storage.hpp"
+#include "Task.hpp"
+#include "TransferScheduler.hpp"
+#include "md5.hpp"
+#include "metrics.hpp"
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <string>
+#include <vector>
 
 namespace
 {
@@ -15,19 +25,47 @@ namespace
         ID_LIST,
         ID_CHDIR,
         ID_MKDIR,
-        ID_DELETE
+        ID_DELETE,
+        ID_REFRESH,
+        ID_UPLOAD,
+        ID_DOWNLOAD,
+        ID_BACKUP,
+        ID_RESTORE,
+        ID_JOBS,
+        ID_SYNC,
+        ID_HASH,
+        ID_STATS
     };
 
     // Map of commands.
     std::map<std::string_view, int> COMMAND_MAP = {{"list", COMMAND_IDS::ID_LIST},
                                                    {"chdir", COMMAND_IDS::ID_CHDIR},
                                                    {"mkdir", COMMAND_IDS::ID_MKDIR},
-                                                   {"delete", COMMAND_IDS::ID_DELETE}};
+                                                   {"delete", COMMAND_IDS::ID_DELETE},
+                                                   {"refresh", COMMAND_IDS::ID_REFRESH},
+                                                   {"upload", COMMAND_IDS::ID_UPLOAD},
+                                                   {"download", COMMAND_IDS::ID_DOWNLOAD},
+                                                   {"backup", COMMAND_IDS::ID_BACKUP},
+                                                   {"restore", COMMAND_IDS::ID_RESTORE},
+                                                   {"jobs", COMMAND_IDS::ID_JOBS},
+                                                   {"sync", COMMAND_IDS::ID_SYNC},
+                                                   {"hash", COMMAND_IDS::ID_HASH},
+                                                   {"stats", COMMAND_IDS::ID_STATS}};
+
+    /// @brief Flag that makes delete and sync report what they would change instead of changing it.
+    constexpr std::string_view FLAG_DRY_RUN = "--dry-run";
 
     // Error strings for commands.
     constexpr std::string_view ERROR_CHDIR = "Error executing command chdir: ";
     constexpr std::string_view ERROR_MKDIR = "Error executing command mkdir: ";
     constexpr std::string_view ERROR_DELETE = "Error executing command delete: ";
+    constexpr std::string_view ERROR_REFRESH = "Error executing command refresh: ";
+    constexpr std::string_view ERROR_UPLOAD = "Error executing command upload: ";
+    constexpr std::string_view ERROR_DOWNLOAD = "Error executing command download: ";
+    constexpr std::string_view ERROR_BACKUP = "Error executing command backup: ";
+    constexpr std::string_view ERROR_RESTORE = "Error executing command restore: ";
+    constexpr std::string_view ERROR_SYNC = "Error executing command sync: ";
+    constexpr std::string_view ERROR_HASH = "Error executing command hash: ";
 } // namespace
 
 /// @brief Function for executing the command chdir.
@@ -35,17 +73,59 @@ namespace
 /// @return True on success. False on failure.
 static bool chdir(Storage &storage);
 
-/// @brief Creates a new directory.
+/// @brief Creates one or more new directories.
 /// @param storage Target storage system.
 /// @return True on success. False on failure.
 static bool mkdir(Storage &storage);
 
-/// @brief Deletes the target item.
+/// @brief Deletes one or more target items.
 /// @param storage Target storage system.
 /// @return True on success. False on failure.
 static bool deleteItem(Storage &storage);
 
-bool execute_command(Storage &storage)
+/// @brief Starts uploading a file in the background. More than one file is uploaded all at once before returning.
+/// @param storage Target storage system. This needs to be a remote.
+/// @return True if the upload was started or every file was uploaded. False on failure.
+static bool upload(Storage &storage);
+
+/// @brief Starts downloading a file in the background.
+/// @param storage Target storage system. This needs to be a remote.
+/// @return True if the download was started. False on failure.
+static bool download(Storage &storage);
+
+/// @brief Starts backing up a local directory to the current parent directory.
+/// @param storage Target storage system. This needs to be a remote.
+/// @param scheduler Scheduler to run the job on.
+/// @return True if the backup was started. False on failure.
+static bool backup(Storage &storage, TransferScheduler &scheduler);
+
+/// @brief Starts restoring files from the current parent directory to a local directory.
+/// @param storage Target storage system. This needs to be a remote.
+/// @param scheduler Scheduler to run the job on.
+/// @return True if the restore was started. False on failure.
+static bool restore(Storage &storage, TransferScheduler &scheduler);
+
+/// @brief Mirrors a local directory to the current parent directory.
+/// @param storage Target storage system. This needs to be Google Drive.
+/// @return True if nothing failed. False on failure.
+static bool sync(Storage &storage);
+
+/// @brief Prints the MD5 of files in the current parent directory.
+/// @param storage Target storage system. This needs to be local.
+/// @return True if every file was hashed. False on failure.
+static bool hash(Storage &storage);
+
+/// @brief Prints the progress of every job.
+/// @param scheduler Scheduler to get the jobs from.
+static void print_jobs(TransferScheduler &scheduler);
+
+/// @brief Waits for a background transfer and prints how it went.
+/// @param transfer Transfer to wait for.
+/// @param name Name of the transfer to print.
+/// @param target File being transferred.
+static Task<void> report_transfer(Task<bool> transfer, std::string_view name, std::string target);
+
+bool execute_command(Storage &storage, TransferScheduler &scheduler)
 {
     // Start by grabbing the command string.
     std::string command;
@@ -80,6 +160,67 @@ bool execute_command(Storage &storage)
             return deleteItem(storage);
         }
         break;
+
+        case ID_REFRESH:
+        {
+            if (!storage.refresh())
+            {
+                std::cout << ERROR_REFRESH << "Unable to bring the listing up to date." << std::endl;
+                return false;
+            }
+            return true;
+        }
+        break;
+
+        case ID_UPLOAD:
+        {
+            return upload(storage);
+        }
+        break;
+
+        case ID_DOWNLOAD:
+        {
+            return download(storage);
+        }
+        break;
+
+        case ID_BACKUP:
+        {
+            return backup(storage, scheduler);
+        }
+        break;
+
+        case ID_RESTORE:
+        {
+            return restore(storage, scheduler);
+        }
+        break;
+
+        case ID_JOBS:
+        {
+            print_jobs(scheduler);
+            return true;
+        }
+        break;
+
+        case ID_SYNC:
+        {
+            return sync(storage);
+        }
+        break;
+
+        case ID_HASH:
+        {
+            return hash(storage);
+        }
+        break;
+
+        case ID_STATS:
+        {
+            std::cout << metrics::export_summary();
+            return true;
+        }
+        break;
     }
 
     return true;
@@ -105,13 +246,40 @@ static bool chdir(Storage &storage)
 
 static bool mkdir(Storage &storage)
 {
+    std::vector<std::string> directories{};
     std::string directory;
-    if (!CommandReader::get_next_parameter(directory) || !storage.create_directory(directory))
+    while (CommandReader::get_next_parameter(directory))
+    {
+        directories.push_back(std::move(directory));
+    }
+
+    if (directories.empty())
     {
-        std::cout << ERROR_MKDIR << "No directory passed or creating directory failed!" << std::endl;
+        std::cout << ERROR_MKDIR << "No directory passed!" << std::endl;
         return false;
     }
-    return true;
+    else if (directories.size() == 1)
+    {
+        if (!storage.create_directory(directories.front()))
+        {
+            std::cout << ERROR_MKDIR << "Creating directory failed!" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // More than one can go through the storage's bulk path.
+    bool success = true;
+    std::vector<bool> results = storage.create_directories(directories);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        if (!results[i])
+        {
+            std::cout << ERROR_MKDIR << "Creating " << directories[i] << " failed!" << std::endl;
+            success = false;
+        }
+    }
+    return success;
 }
 
 static bool deleteItem(Storage &storage)
@@ -130,15 +298,308 @@ static bool deleteItem(Storage &storage)
         directory = true;
     }
 
-    bool success = false;
-    if (directory)
+    // Anything after the first target is more targets.
+    bool dryRun = false;
+    std::vector<std::string> targets{};
+    do
+    {
+        if (target == FLAG_DRY_RUN)
+        {
+            dryRun = true;
+            continue;
+        }
+        targets.push_back(std::move(target));
+    } while (CommandReader::get_next_parameter(target));
+
+    if (targets.empty())
+    {
+        std::cout << ERROR_DELETE << "Missing parameter" << std::endl;
+        return false;
+    }
+
+    bool success = true;
+    if (dryRun)
+    {
+        size_t total = 0;
+        for (const std::string &current : targets)
+        {
+            std::optional<size_t> count = std::nullopt;
+            if (directory)
+            {
+                count = storage.count_directory(current);
+            }
+            else if (storage.file_exists(current))
+            {
+                count = 1;
+            }
+
+            if (!count.has_value())
+            {
+                std::cout << ERROR_DELETE << "Unable to count " << current << "." << std::endl;
+                success = false;
+                continue;
+            }
+            total += count.value();
+        }
+        std::cout << total << " item(s) would be deleted." << std::endl;
+    }
+    else if (directory)
     {
-        success = storage.delete_directory(target);
+        for (const std::string &current : targets)
+        {
+            success = storage.delete_directory(current) && success;
+        }
+    }
+    else if (targets.size() == 1)
+    {
+        success = storage.delete_file(targets.front());
     }
     else
     {
-        success = storage.delete_file(target);
+        std::vector<bool> results = storage.delete_files(targets);
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            if (!results[i])
+            {
+                std::cout << ERROR_DELETE << "Deleting " << targets[i] << " failed!" << std::endl;
+                success = false;
+            }
+        }
     }
 
     return success;
 }
+
+static bool upload(Storage &storage)
+{
+    Remote *remote = dynamic_cast<Remote *>(&storage);
+    if (!remote)
+    {
+        std::cout << ERROR_UPLOAD << "Only remote storage can be uploaded to." << std::endl;
+        return false;
+    }
+
+    std::vector<std::filesystem::path> paths{};
+    std::string path;
+    while (CommandReader::get_next_parameter(path))
+    {
+        paths.emplace_back(std::move(path));
+    }
+
+    if (paths.empty())
+    {
+        std::cout << ERROR_UPLOAD << "No file passed!" << std::endl;
+        return false;
+    }
+    else if (paths.size() == 1)
+    {
+        // This returns right away. The result is printed whenever the upload finishes.
+        std::string target = paths.front().string();
+        remote->spawn(report_transfer(remote->upload_file_async(target), "Upload", target));
+        return true;
+    }
+
+    // More than one can go through the remote's bulk path.
+    size_t uploaded = 0;
+    for (const Remote::UploadResult &result : remote->upload_files(paths))
+    {
+        if (!result.success)
+        {
+            std::cout << ERROR_UPLOAD << "Uploading " << result.path.string() << " failed!" << std::endl;
+            continue;
+        }
+        ++uploaded;
+    }
+    std::cout << "Uploaded " << uploaded << " of " << paths.size() << " file(s)." << std::endl;
+    return uploaded == paths.size();
+}
+
+static bool download(Storage &storage)
+{
+    Remote *remote = dynamic_cast<Remote *>(&storage);
+    if (!remote)
+    {
+        std::cout << ERROR_DOWNLOAD << "Only remote storage can be downloaded from." << std::endl;
+        return false;
+    }
+
+    std::string name, path;
+    if (!CommandReader::get_next_parameter(name) || !CommandReader::get_next_parameter(path))
+    {
+        std::cout << ERROR_DOWNLOAD << "Missing parameter" << std::endl;
+        return false;
+    }
+
+    remote->spawn(report_transfer(remote->download_file_async(name, path), "Download", name));
+    return true;
+}
+
+static bool backup(Storage &storage, TransferScheduler &scheduler)
+{
+    if (!dynamic_cast<Remote *>(&storage))
+    {
+        std::cout << ERROR_BACKUP << "Only remote storage can be backed up to." << std::endl;
+        return false;
+    }
+
+    std::string directory;
+    if (!CommandReader::get_next_parameter(directory) || !std::filesystem::is_directory(directory))
+    {
+        std::cout << ERROR_BACKUP << "No directory passed or directory doesn't exist." << std::endl;
+        return false;
+    }
+
+    scheduler.backup(directory, storage.get_parent_id());
+    std::cout << "Backing up " << directory << " in the background. Use jobs to check on it." << std::endl;
+    return true;
+}
+
+static bool restore(Storage &storage, TransferScheduler &scheduler)
+{
+    if (!dynamic_cast<Remote *>(&storage))
+    {
+        std::cout << ERROR_RESTORE << "Only remote storage can be restored from." << std::endl;
+        return false;
+    }
+
+    // The last parameter is the directory. Everything before it is a file.
+    std::vector<std::string> parameters{};
+    std::string parameter;
+    while (CommandReader::get_next_parameter(parameter))
+    {
+        parameters.push_back(std::move(parameter));
+    }
+
+    if (parameters.size() < 2)
+    {
+        std::cout << ERROR_RESTORE << "Missing parameter" << std::endl;
+        return false;
+    }
+
+    std::filesystem::path directory{parameters.back()};
+    parameters.pop_back();
+    if (!std::filesystem::is_directory(directory))
+    {
+        std::cout << ERROR_RESTORE << directory.string() << " isn't a directory." << std::endl;
+        return false;
+    }
+
+    // Files are looked up by ID now since the current parent might have changed by the time they're downloaded.
+    std::vector<std::pair<std::string, std::filesystem::path>> files{};
+    for (const std::string &name : parameters)
+    {
+        std::string id;
+        if (!storage.get_file_id(name, id))
+        {
+            std::cout << ERROR_RESTORE << name << " doesn't exist within current parent." << std::endl;
+            return false;
+        }
+        files.emplace_back(std::move(id), directory / name);
+    }
+
+    scheduler.restore(files);
+    std::cout << "Restoring " << files.size() << " file(s) in the background. Use jobs to check on it." << std::endl;
+    return true;
+}
+
+static bool sync(Storage &storage)
+{
+    GoogleDrive *drive = dynamic_cast<GoogleDrive *>(&storage);
+    if (!drive)
+    {
+        std::cout << ERROR_SYNC << "Only Google Drive can be synced to." << std::endl;
+        return false;
+    }
+
+    std::string directory, flag;
+    if (!CommandReader::get_next_parameter(directory) || !std::filesystem::is_directory(directory))
+    {
+        std::cout << ERROR_SYNC << "No directory passed or directory doesn't exist." << std::endl;
+        return false;
+    }
+
+    bool dryRun = CommandReader::get_next_parameter(flag) && flag == FLAG_DRY_RUN;
+    GoogleDrive::SyncResult result = drive->sync_directory(directory, dryRun);
+    for (const std::string &path : result.deletedPaths)
+    {
+        std::cout << (dryRun ? "    Would delete: " : "    Deleted: ") << path << std::endl;
+    }
+
+    for (const std::string &path : result.duplicateDirectories)
+    {
+        std::cout << "    Duplicate folder left alone: " << path << std::endl;
+    }
+
+    std::cout << (dryRun ? "Would have uploaded " : "Uploaded ") << result.uploaded << ", replaced "
+              << result.replaced << ", and deleted " << result.deleted << " item(s). " << result.unchanged
+              << " unchanged, " << result.failed << " failed." << std::endl;
+
+    return result.failed == 0;
+}
+
+static bool hash(Storage &storage)
+{
+    Local *local = dynamic_cast<Local *>(&storage);
+    if (!local)
+    {
+        std::cout << ERROR_HASH << "Only local files can be hashed." << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> names{};
+    std::string name;
+    while (CommandReader::get_next_parameter(name))
+    {
+        names.push_back(std::move(name));
+    }
+
+    size_t cached = 0, failed = 0;
+    for (const hasher::Result &result : local->hash_files(names))
+    {
+        if (!result.success)
+        {
+            std::cout << ERROR_HASH << "Unable to hash " << result.path.string() << "." << std::endl;
+            ++failed;
+            continue;
+        }
+        cached += result.cached;
+        std::cout << md5::to_hex(result.digest) << "  " << result.path.string() << std::endl;
+    }
+    std::cout << cached << " file(s) were already cached. " << failed << " failed." << std::endl;
+
+    return failed == 0;
+}
+
+static void print_jobs(TransferScheduler &scheduler)
+{
+    for (const std::shared_ptr<TransferScheduler::Job> &job : scheduler.get_jobs())
+    {
+        TransferScheduler::Job::Progress progress = job->get_progress();
+        std::printf("%s: %zu/%zu items, %zu failed, %" PRIu64 "/%" PRIu64 " bytes transferred%s\n",
+                    job->get_name().c_str(),
+                    progress.itemsDone,
+                    progress.itemsTotal,
+                    progress.itemsFailed,
+                    progress.bytesTransferred,
+                    progress.bytesTotal,
+                    job->is_finished() ? " (finished)" : "");
+
+        for (const std::filesystem::path &failure : job->get_failures())
+        {
+            std::printf("    Failed: %s\n", failure.c_str());
+        }
+    }
+}
+
+static Task<void> report_transfer(Task<bool> transfer, std::string_view name, std::string target)
+{
+    bool finished = co_await transfer;
+    if (finished)
+    {
+        std::cout << name << " of " << target << " finished." << std::endl;
+    }
+    else
+    {
+        std::cout << name << " of " << target << " failed!" << std::endl;
+    }
+}
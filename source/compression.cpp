@@ -0,0 +1,145 @@
+#include "compression.hpp"
+#include "logger.hpp"
+
+bool compression::parse_codec(std::string_view name, compression::Codec &codecOut)
+{
+    if (name == compression::CODEC_NAME_ZSTD)
+    {
+        codecOut = compression::Codec::Zstd;
+        return true;
+    }
+    return false;
+}
+
+compression::Compressor::Compressor(std::istream &source, int level, md5::Context *sourceMd5)
+    : m_source(source), m_context(ZSTD_createCCtx(), ZSTD_freeCCtx),
+      m_input(std::make_unique_for_overwrite<char[]>(ZSTD_CStreamInSize())), m_sourceMd5(sourceMd5)
+{
+    if (!m_context)
+    {
+        logger::error("Error creating zstd compression context.");
+        return;
+    }
+
+    // The checksum lets whoever decompresses this know they got back exactly what went in.
+    ZSTD_CCtx_setParameter(m_context.get(), ZSTD_c_compressionLevel, level);
+    ZSTD_CCtx_setParameter(m_context.get(), ZSTD_c_checksumFlag, 1);
+}
+
+bool compression::Compressor::is_initialized(void) const
+{
+    return m_context != nullptr;
+}
+
+size_t compression::Compressor::read(char *buffer, size_t length)
+{
+    ZSTD_outBuffer output = {.dst = buffer, .size = length, .pos = 0};
+    while (output.pos < output.size && !m_finished && !m_failed)
+    {
+        // zstd only takes more input once it's done with the last.
+        if (m_inputBuffer.pos == m_inputBuffer.size && !m_sourceFinished)
+        {
+            m_source.read(m_input.get(), ZSTD_CStreamInSize());
+            size_t bytesRead = m_source.gcount();
+            if (m_source.bad())
+            {
+                logger::error("Error reading source to compress.");
+                m_failed = true;
+                break;
+            }
+            else if (m_sourceMd5)
+            {
+                m_sourceMd5->update(m_input.get(), bytesRead);
+            }
+
+            m_bytesRead += bytesRead;
+            m_sourceFinished = m_source.eof();
+            m_inputBuffer = {.src = m_input.get(), .size = bytesRead, .pos = 0};
+        }
+
+        ZSTD_EndDirective directive = m_sourceFinished ? ZSTD_e_end : ZSTD_e_continue;
+        size_t remaining = ZSTD_compressStream2(m_context.get(), &output, &m_inputBuffer, directive);
+        if (ZSTD_isError(remaining))
+        {
+            logger::error("Error compressing: %s.", ZSTD_getErrorName(remaining));
+            m_failed = true;
+            break;
+        }
+
+        // With ZSTD_e_end, 0 means the frame is closed and everything's been flushed.
+        m_finished = m_sourceFinished && m_inputBuffer.pos == m_inputBuffer.size && remaining == 0;
+    }
+    return output.pos;
+}
+
+bool compression::Compressor::is_finished(void) const
+{
+    return m_finished;
+}
+
+bool compression::Compressor::has_failed(void) const
+{
+    return m_failed;
+}
+
+uint64_t compression::Compressor::get_bytes_read(void) const
+{
+    return m_bytesRead;
+}
+
+compression::Decompressor::Decompressor(void) : m_context(ZSTD_createDCtx(), ZSTD_freeDCtx)
+{
+    if (!m_context)
+    {
+        logger::error("Error creating zstd decompression context.");
+    }
+}
+
+bool compression::Decompressor::is_initialized(void) const
+{
+    return m_context != nullptr;
+}
+
+bool compression::Decompressor::decompress(const char *&data,
+                                           size_t &length,
+                                           char *output,
+                                           size_t outputSize,
+                                           size_t &outputUsed)
+{
+    ZSTD_inBuffer inputBuffer = {.src = data, .size = length, .pos = 0};
+    ZSTD_outBuffer outputBuffer = {.dst = output, .size = outputSize, .pos = outputUsed};
+
+    // This runs at least once even without input. zstd might still be holding output from last time.
+    while (outputBuffer.pos < outputBuffer.size)
+    {
+        size_t inputBefore = inputBuffer.pos, outputBefore = outputBuffer.pos;
+        size_t hint = ZSTD_decompressStream(m_context.get(), &outputBuffer, &inputBuffer);
+        if (ZSTD_isError(hint))
+        {
+            logger::error("Error decompressing: %s.", ZSTD_getErrorName(hint));
+            return false;
+        }
+
+        // A call that does nothing right after a frame ends reports what the next frame needs. That isn't news.
+        if (inputBuffer.pos != inputBefore || outputBuffer.pos != outputBefore)
+        {
+            m_frameFinished = hint == 0;
+        }
+
+        // Once there's no input left and room left over, zstd has flushed everything it can.
+        if (inputBuffer.pos == inputBuffer.size && outputBuffer.pos < outputBuffer.size)
+        {
+            break;
+        }
+    }
+
+    data += inputBuffer.pos;
+    length -= inputBuffer.pos;
+    outputUsed = outputBuffer.pos;
+    return true;
+}
+
+bool compression::Decompressor::is_finished(void) const
+{
+    return m_frameFinished;
+}
@@ -1,12 +1,221 @@
 #include "curl.hpp"
+#include "metrics.hpp"
 #include "stringutil.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <mutex>
+#include <strings.h>
+#include <utility>
 
 namespace
 {
     /// @brief This is the size of the upload buffer used by CURL uploads.
     constexpr size_t SIZE_CURL_UPLOAD_BUFFER = 0x10000;
+
+    /// @brief How long DNS results stay in the shared cache in seconds.
+    constexpr long DNS_CACHE_TIMEOUT = 600;
+
+    /// @brief Longest a warm up connection is allowed to take in seconds.
+    constexpr long WARM_UP_TIMEOUT = 10;
+
+    /// @brief Drive endpoints requests are broken down by. Each is matched by a piece of the URL, checked in order.
+    /// Anything that doesn't match any of them is counted as other.
+    constexpr std::pair<std::string_view, std::string_view> ENDPOINTS[] = {
+        {"upload", "/upload/drive/"},
+        {"batch", "/batch/"},
+        {"changes", "/changes"},
+        {"about", "/about"},
+        {"files", "/drive/v3/files"},
+        {"oauth", "oauth2"}};
+
+    /// @brief Status classes requests are broken down by. The first is for transfers that failed without a response.
+    constexpr std::string_view STATUS_CLASSES[] = {"error", "1xx", "2xx", "3xx", "4xx", "5xx"};
+
+    /// @brief Number of endpoints counting other.
+    constexpr size_t ENDPOINT_COUNT = std::size(ENDPOINTS) + 1;
+
+    /// @brief Metrics of a single endpoint.
+    struct EndpointMetrics
+    {
+            /// @brief Requests by status class.
+            metrics::Counter *requests[std::size(STATUS_CLASSES)];
+
+            /// @brief Time requests took from start to finish.
+            metrics::Histogram *duration;
+
+            /// @brief Bytes sent.
+            metrics::Counter *sent;
+
+            /// @brief Bytes received.
+            metrics::Counter *received;
+    };
+
+    /// @brief Returns the metrics of every endpoint. They're registered the first time this is called.
+    std::array<EndpointMetrics, ENDPOINT_COUNT> &get_endpoint_metrics(void)
+    {
+        static std::array<EndpointMetrics, ENDPOINT_COUNT> endpointMetrics = []() {
+            std::array<EndpointMetrics, ENDPOINT_COUNT> endpoints{};
+            for (size_t i = 0; i < ENDPOINT_COUNT; i++)
+            {
+                std::string endpoint = "endpoint=\"";
+                endpoint.append(i < std::size(ENDPOINTS) ? ENDPOINTS[i].first : "other").append("\"");
+
+                for (size_t j = 0; j < std::size(STATUS_CLASSES); j++)
+                {
+                    std::string labels = endpoint + ",status=\"" + std::string(STATUS_CLASSES[j]) + "\"";
+                    endpoints[i].requests[j] =
+                        &metrics::counter("http_requests_total", "HTTP requests by endpoint and status class.", labels);
+                }
+                endpoints[i].duration = &metrics::histogram("http_request_duration_seconds",
+                                                            "Time HTTP requests took from start to finish.",
+                                                            endpoint);
+                endpoints[i].sent =
+                    &metrics::counter("http_sent_bytes_total", "Bytes sent in HTTP requests.", endpoint);
+                endpoints[i].received =
+                    &metrics::counter("http_received_bytes_total", "Bytes received in HTTP responses.", endpoint);
+            }
+            return endpoints;
+        }();
+        return endpointMetrics;
+    }
+
+    /// @brief Share handle every pooled handle uses.
+    CURLSH *s_share = nullptr;
+
+    /// @brief One lock per kind of data shared. Handles on different threads can touch the pool at the same time.
+    std::mutex s_shareLocks[CURL_LOCK_DATA_LAST];
+
+    /// @brief Lock callback for the share.
+    void lock_share(CURL *handle, curl_lock_data data, curl_lock_access access, void *userData)
+    {
+        (void)handle;
+        (void)access;
+        (void)userData;
+        s_shareLocks[data].lock();
+    }
+
+    /// @brief Unlock callback for the share.
+    void unlock_share(CURL *handle, curl_lock_data data, void *userData)
+    {
+        (void)handle;
+        (void)userData;
+        s_shareLocks[data].unlock();
+    }
 } // namespace
 
+bool curl::initialize(void)
+{
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK)
+    {
+        return false;
+    }
+
+    // Without the share, everything still works. It's just slower.
+    s_share = curl_share_init();
+    if (!s_share)
+    {
+        logger::error("Error creating CURL share. Connections won't be pooled.");
+        return true;
+    }
+
+    curl_share_setopt(s_share, CURLSHOPT_LOCKFUNC, lock_share);
+    curl_share_setopt(s_share, CURLSHOPT_UNLOCKFUNC, unlock_share);
+    curl_share_setopt(s_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(s_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(s_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    return true;
+}
+
+void curl::exit(void)
+{
+    // Every handle using the share needs to be cleaned up before this.
+    if (s_share)
+    {
+        curl_share_cleanup(s_share);
+        s_share = nullptr;
+    }
+    curl_global_cleanup();
+}
+
+void curl::attach_pool(curl::Handle &handle)
+{
+    if (s_share)
+    {
+        curl::set_option(handle, CURLOPT_SHARE, s_share);
+    }
+    curl::set_option(handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    // Wait for an existing connection that can multiplex instead of opening another one.
+    curl::set_option(handle, CURLOPT_PIPEWAIT, 1L);
+    curl::set_option(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl::set_option(handle, CURLOPT_DNS_CACHE_TIMEOUT, DNS_CACHE_TIMEOUT);
+}
+
+void curl::warm_up(const std::vector<std::string_view> &urls)
+{
+    curl::MultiHandle multi = curl::new_multi_handle();
+    std::vector<curl::Handle> handles{};
+    for (std::string_view url : urls)
+    {
+        // A HEAD request is enough to get through DNS and TLS. Whatever it responds with doesn't matter.
+        curl::Handle &handle = handles.emplace_back(curl::new_handle());
+        curl::prepare_get(handle);
+        curl::set_option(handle, CURLOPT_URL, std::string(url).c_str());
+        curl::set_option(handle, CURLOPT_NOBODY, 1L);
+        curl::set_option(handle, CURLOPT_TIMEOUT, WARM_UP_TIMEOUT);
+        curl_multi_add_handle(multi.get(), handle.get());
+    }
+
+    int running = 0;
+    do
+    {
+        if (curl_multi_perform(multi.get(), &running) != CURLM_OK)
+        {
+            break;
+        }
+
+        if (running > 0)
+        {
+            curl_multi_poll(multi.get(), nullptr, 0, 1000, nullptr);
+        }
+    } while (running > 0);
+
+    // The connections stay in the share after the handles are gone.
+    for (curl::Handle &handle : handles)
+    {
+        curl_multi_remove_handle(multi.get(), handle.get());
+    }
+}
+
+void curl::record_transfer(CURL *handle, CURLcode result)
+{
+    const char *url = nullptr;
+    long code = 0;
+    curl_off_t totalTime = 0;
+    curl_off_t sent = 0;
+    curl_off_t received = 0;
+    curl_easy_getinfo(handle, CURLINFO_EFFECTIVE_URL, &url);
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &code);
+    curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME_T, &totalTime);
+    curl_easy_getinfo(handle, CURLINFO_SIZE_UPLOAD_T, &sent);
+    curl_easy_getinfo(handle, CURLINFO_SIZE_DOWNLOAD_T, &received);
+
+    size_t endpoint = 0;
+    std::string_view urlView = url ? url : "";
+    while (endpoint < std::size(ENDPOINTS) && urlView.find(ENDPOINTS[endpoint].second) == urlView.npos)
+    {
+        ++endpoint;
+    }
+
+    size_t statusClass = result != CURLE_OK || code < 100 || code > 599 ? 0 : code / 100;
+
+    EndpointMetrics &endpointMetrics = get_endpoint_metrics()[endpoint];
+    endpointMetrics.requests[statusClass]->add();
+    endpointMetrics.duration->observe(std::chrono::microseconds(totalTime));
+    endpointMetrics.sent->add(sent);
+    endpointMetrics.received->add(received);
+}
+
 size_t curl::read_data_file(char *buffer, size_t size, size_t count, std::ifstream *file)
 {
     file->read(buffer, size * count);
@@ -14,6 +223,32 @@ size_t curl::read_data_file(char *buffer, size_t size, size_t count, std::ifstre
     return file->gcount();
 }
 
+size_t curl::read_data_file_section(char *buffer, size_t size, size_t count, curl::FileSection *section)
+{
+    size_t toRead = std::min<uint64_t>(size * count, section->remaining);
+    section->file->read(buffer, toRead);
+    section->remaining -= section->file->gcount();
+    return section->file->gcount();
+}
+
+int curl::seek_data_file_section(curl::FileSection *section, curl_off_t offset, int origin)
+{
+    if (origin != SEEK_SET || offset < 0 || static_cast<uint64_t>(offset) > section->length)
+    {
+        return CURL_SEEKFUNC_CANTSEEK;
+    }
+
+    // The stream could be at its end or failed from the last attempt.
+    section->file->clear();
+    section->file->seekg(section->begin + static_cast<std::streamoff>(offset));
+    if (!*section->file)
+    {
+        return CURL_SEEKFUNC_FAIL;
+    }
+    section->remaining = section->length - offset;
+    return CURL_SEEKFUNC_OK;
+}
+
 size_t curl::write_headers_array(const char *buffer, size_t size, size_t count, curl::HeaderArray *array)
 {
     // Emplace the header.
@@ -41,7 +276,7 @@ bool curl::get_header_value(const curl::HeaderArray &array, std::string_view hea
         {
             continue;
         }
-        else if (currentHeader.substr(0, colon) != header)
+        else if (colon != header.length() || strncasecmp(currentHeader.c_str(), header.data(), colon) != 0)
         {
             continue;
         }
@@ -64,6 +299,7 @@ void curl::prepare_get(curl::Handle &handle)
 {
     // Reset
     curl_easy_reset(handle.get());
+    curl::attach_pool(handle);
 
     curl::set_option(handle, CURLOPT_HTTPGET, 1L);
     curl::set_option(handle, CURLOPT_USERAGENT, curl::USER_AGENT_STRING.data());
@@ -73,6 +309,7 @@ void curl::prepare_get(curl::Handle &handle)
 void curl::prepare_post(curl::Handle &handle)
 {
     curl_easy_reset(handle.get());
+    curl::attach_pool(handle);
 
     curl::set_option(handle, CURLOPT_POST, 1L);
     curl::set_option(handle, CURLOPT_USERAGENT, curl::USER_AGENT_STRING.data());
@@ -82,6 +319,7 @@ void curl::prepare_post(curl::Handle &handle)
 void curl::prepare_upload(curl::Handle &handle)
 {
     curl_easy_reset(handle.get());
+    curl::attach_pool(handle);
 
     curl::set_option(handle, CURLOPT_UPLOAD, 1L);
     curl::set_option(handle, CURLOPT_USERAGENT, curl::USER_AGENT_STRING.data());
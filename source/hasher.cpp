@@ -0,0 +1,481 @@
+#include "hasher.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace
+{
+    /// @brief Path of the hash cache.
+    constexpr std::string_view PATH_HASH_CACHE = "./hash_cache.bin";
+
+    /// @brief Magic the cache file starts with.
+    constexpr char CACHE_MAGIC[8] = {'J', 'K', 'S', 'V', 'H', 'A', 'S', 'H'};
+
+    /// @brief Current version of the cache format. Bump this whenever the layout changes.
+    constexpr uint32_t CACHE_VERSION = 1;
+
+    /// @brief Once the cache holds more than this, entries that weren't used this session are dropped when it's
+    /// saved.
+    constexpr size_t MAX_CACHE_ENTRIES = 0x100000;
+
+    /// @brief Size of each lane's read buffer.
+    constexpr size_t SIZE_LANE_BUFFER = 0x40000;
+
+    /// @brief Lanes read more once they have less than this buffered.
+    constexpr size_t SIZE_LANE_REFILL = SIZE_LANE_BUFFER / 2;
+
+    /// @brief Header of the cache file.
+    struct CacheHeader
+    {
+            char magic[8];
+            uint32_t version;
+            uint32_t reserved;
+            uint64_t count;
+    };
+
+    /// @brief A single cached digest as it's stored in the file.
+    struct CacheRecord
+    {
+            hasher::FileKey key;
+            md5::Digest digest;
+    };
+
+    /// @brief Hashes FileKeys for the cache map.
+    struct FileKeyHash
+    {
+            size_t operator()(const hasher::FileKey &key) const
+            {
+                uint64_t hash = key.inode * 0x9E3779B97F4A7C15ull;
+                hash ^= (key.device + (hash << 6) + (hash >> 2));
+                hash ^= (key.size + (hash << 6) + (hash >> 2));
+                hash ^= (static_cast<uint64_t>(key.modifiedTime) + (hash << 6) + (hash >> 2));
+                return static_cast<size_t>(hash);
+            }
+    };
+
+    /// @brief Cached digest.
+    struct CacheEntry
+    {
+            /// @brief MD5 of the file.
+            md5::Digest digest;
+
+            /// @brief Whether the entry was looked up or added this session.
+            bool used;
+    };
+
+    /// @brief Files shared by every worker in a single hash_files call.
+    struct Batch
+    {
+            Batch(std::vector<hasher::Result> &results) : results(results) {};
+
+            /// @brief Results being filled in.
+            std::vector<hasher::Result> &results;
+
+            /// @brief Key of each file from before it was read.
+            std::vector<hasher::FileKey> keys;
+
+            /// @brief Indexes of the files that need to be read.
+            std::vector<size_t> pending;
+
+            /// @brief Next entry in pending to hand out.
+            std::atomic<size_t> next = 0;
+    };
+
+    /// @brief A file being hashed in one of a worker's lanes.
+    struct Lane
+    {
+            /// @brief Index of the file in the batch's results. SIZE_MAX when the lane is free.
+            size_t index = SIZE_MAX;
+
+            /// @brief Descriptor of the file.
+            int descriptor = -1;
+
+            /// @brief Hash of everything before begin.
+            md5::Context context{};
+
+            /// @brief Read buffer.
+            std::unique_ptr<uint8_t[]> buffer = std::make_unique_for_overwrite<uint8_t[]>(SIZE_LANE_BUFFER);
+
+            /// @brief Offset of the first byte in buffer that hasn't been hashed.
+            size_t begin = 0;
+
+            /// @brief Offset past the last byte read into buffer.
+            size_t end = 0;
+
+            /// @brief Whether the whole file was read.
+            bool eof = false;
+    };
+
+    /// @brief Guards everything below.
+    std::mutex s_cacheLock;
+
+    /// @brief Cached digests.
+    std::unordered_map<hasher::FileKey, CacheEntry, FileKeyHash> s_cache;
+
+    /// @brief Whether anything was added since the cache was loaded.
+    bool s_cacheChanged = false;
+
+    /// @brief Converts the result of stat to a key.
+    hasher::FileKey make_key(const struct stat &status)
+    {
+        return {.device = static_cast<uint64_t>(status.st_dev),
+                .inode = static_cast<uint64_t>(status.st_ino),
+                .size = static_cast<uint64_t>(status.st_size),
+                .modifiedTime = (static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000) + status.st_mtim.tv_nsec};
+    }
+
+    /// @brief Moves what's left in a lane's buffer to the front and reads more after it.
+    bool read_lane(Lane &lane)
+    {
+        std::memmove(lane.buffer.get(), lane.buffer.get() + lane.begin, lane.end - lane.begin);
+        lane.end -= lane.begin;
+        lane.begin = 0;
+
+        ssize_t bytesRead = 0;
+        while ((bytesRead = read(lane.descriptor, lane.buffer.get() + lane.end, SIZE_LANE_BUFFER - lane.end)) < 0 &&
+               errno == EINTR) {};
+
+        if (bytesRead < 0)
+        {
+            return false;
+        }
+        lane.end += bytesRead;
+        lane.eof = bytesRead == 0;
+        return true;
+    }
+
+    /// @brief Writes a lane's result, caches it, and frees the lane.
+    void finish_lane(Lane &lane, Batch &batch, bool success)
+    {
+        hasher::Result &result = batch.results[lane.index];
+        if (!success)
+        {
+            logger::error("Error reading \"%s\" to hash: %s.", result.path.c_str(), std::strerror(errno));
+            lane.context = md5::Context{};
+        }
+        else
+        {
+            result.success = true;
+            result.digest = lane.context.finish();
+        }
+
+        // A file written to while it was being read hashes to something that never existed. It's not cached.
+        struct stat status{};
+        if (success && fstat(lane.descriptor, &status) == 0 && make_key(status) == batch.keys[lane.index])
+        {
+            std::lock_guard<std::mutex> cacheGuard(s_cacheLock);
+            s_cache[batch.keys[lane.index]] = {.digest = result.digest, .used = true};
+            s_cacheChanged = true;
+        }
+
+        close(lane.descriptor);
+        lane.descriptor = -1;
+        lane.index = SIZE_MAX;
+    }
+
+    /// @brief Hashes files from the batch until there aren't any left.
+    void run_worker(Batch &batch)
+    {
+        Lane lanes[md5::LANES];
+        while (true)
+        {
+            // Free lanes take the next file.
+            size_t active = 0;
+            for (Lane &lane : lanes)
+            {
+                size_t position = 0;
+                while (lane.index == SIZE_MAX && (position = batch.next++) < batch.pending.size())
+                {
+                    size_t index = batch.pending[position];
+                    int descriptor = open(batch.results[index].path.c_str(), O_RDONLY | O_CLOEXEC);
+                    if (descriptor < 0)
+                    {
+                        logger::error("Error opening \"%s\" to hash: %s.",
+                                      batch.results[index].path.c_str(),
+                                      std::strerror(errno));
+                        continue;
+                    }
+                    posix_fadvise(descriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+                    lane.index = index;
+                    lane.descriptor = descriptor;
+                    lane.begin = 0;
+                    lane.end = 0;
+                    lane.eof = false;
+                }
+                active += lane.index != SIZE_MAX;
+            }
+
+            if (active == 0)
+            {
+                return;
+            }
+
+            // Every lane hashes the same number of blocks, so the one with the least buffered sets the pace. Lanes
+            // down to their last partial block are finished on their own.
+            size_t blocks = SIZE_MAX;
+            size_t hashing = 0;
+            for (Lane &lane : lanes)
+            {
+                if (lane.index == SIZE_MAX)
+                {
+                    continue;
+                }
+                else if (!lane.eof && lane.end - lane.begin < SIZE_LANE_REFILL && !read_lane(lane))
+                {
+                    finish_lane(lane, batch, false);
+                    continue;
+                }
+
+                size_t available = lane.end - lane.begin;
+                if (lane.eof && available < 64)
+                {
+                    lane.context.update(lane.buffer.get() + lane.begin, available);
+                    finish_lane(lane, batch, true);
+                    continue;
+                }
+                blocks = std::min(blocks, available / 64);
+                ++hashing;
+            }
+
+            if (hashing == 0 || blocks == 0)
+            {
+                continue;
+            }
+
+            md5::Context *contexts[md5::LANES] = {nullptr};
+            const uint8_t *data[md5::LANES] = {nullptr};
+            for (size_t i = 0; i < md5::LANES; i++)
+            {
+                if (lanes[i].index != SIZE_MAX)
+                {
+                    contexts[i] = &lanes[i].context;
+                    data[i] = lanes[i].buffer.get() + lanes[i].begin;
+                }
+            }
+
+            // A lane to itself is faster through the regular transform.
+            if (hashing == 1)
+            {
+                Lane &lane =
+                    *std::find_if(lanes, lanes + md5::LANES, [](Lane &other) { return other.index != SIZE_MAX; });
+                blocks = (lane.end - lane.begin) / 64;
+                lane.context.update(lane.buffer.get() + lane.begin, blocks * 64);
+                lane.begin += blocks * 64;
+                continue;
+            }
+
+            md5::Context::update_lanes(contexts, data, blocks);
+            for (Lane &lane : lanes)
+            {
+                if (lane.index != SIZE_MAX)
+                {
+                    lane.begin += blocks * 64;
+                }
+            }
+        }
+    }
+} // namespace
+
+void hasher::initialize(void)
+{
+    std::ifstream cacheFile(PATH_HASH_CACHE.data(), std::ios::binary);
+    if (!cacheFile.is_open())
+    {
+        return;
+    }
+
+    CacheHeader header{};
+    if (!cacheFile.read(reinterpret_cast<char *>(&header), sizeof(CacheHeader)) ||
+        std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION)
+    {
+        logger::warning("Hash cache is from a different version.");
+        return;
+    }
+
+    // The count is checked against what's actually in the file before anything is reserved for it.
+    std::error_code error{};
+    uint64_t fileSize = std::filesystem::file_size(PATH_HASH_CACHE, error);
+    if (error || header.count > (fileSize - sizeof(CacheHeader)) / sizeof(CacheRecord))
+    {
+        logger::warning("Hash cache is truncated.");
+        return;
+    }
+
+    std::lock_guard<std::mutex> cacheGuard(s_cacheLock);
+    s_cache.reserve(header.count);
+    CacheRecord record{};
+    for (uint64_t i = 0; i < header.count; i++)
+    {
+        if (!cacheFile.read(reinterpret_cast<char *>(&record), sizeof(CacheRecord)))
+        {
+            logger::warning("Hash cache is truncated.");
+            s_cache.clear();
+            return;
+        }
+        s_cache[record.key] = {.digest = record.digest, .used = false};
+    }
+}
+
+void hasher::exit(void)
+{
+    std::lock_guard<std::mutex> cacheGuard(s_cacheLock);
+    if (!s_cacheChanged)
+    {
+        return;
+    }
+
+    // Files that haven't been seen in a while are the first to go.
+    if (s_cache.size() > MAX_CACHE_ENTRIES)
+    {
+        std::erase_if(s_cache, [](const auto &entry) { return !entry.second.used; });
+    }
+
+    // Same as snapshots. Written next to the real one and renamed over it so it's never half written.
+    std::filesystem::path cachePath{PATH_HASH_CACHE};
+    std::filesystem::path temporaryPath = cachePath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream cacheFile(temporaryPath, std::ios::binary | std::ios::trunc);
+        CacheHeader header{};
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.version = CACHE_VERSION;
+        header.count = s_cache.size();
+        cacheFile.write(reinterpret_cast<const char *>(&header), sizeof(CacheHeader));
+
+        for (const auto &[key, entry] : s_cache)
+        {
+            CacheRecord record{.key = key, .digest = entry.digest};
+            cacheFile.write(reinterpret_cast<const char *>(&record), sizeof(CacheRecord));
+        }
+
+        if (!cacheFile.flush())
+        {
+            logger::error("Error writing hash cache.");
+            return;
+        }
+    }
+
+    std::error_code error{};
+    std::filesystem::rename(temporaryPath, cachePath, error);
+    s_cacheChanged = false;
+}
+
+bool hasher::get_file_key(const std::filesystem::path &path, hasher::FileKey &keyOut)
+{
+    struct stat status{};
+    if (stat(path.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+    {
+        return false;
+    }
+    keyOut = make_key(status);
+    return true;
+}
+
+bool hasher::find_cached(const std::filesystem::path &path, md5::Digest &digestOut)
+{
+    hasher::FileKey key{};
+    if (!hasher::get_file_key(path, key))
+    {
+        return false;
+    }
+    return hasher::find_cached(key, digestOut);
+}
+
+bool hasher::find_cached(const hasher::FileKey &key, md5::Digest &digestOut)
+{
+    std::lock_guard<std::mutex> cacheGuard(s_cacheLock);
+    auto findEntry = s_cache.find(key);
+    if (findEntry == s_cache.end())
+    {
+        return false;
+    }
+    findEntry->second.used = true;
+    digestOut = findEntry->second.digest;
+    return true;
+}
+
+std::vector<hasher::Result> hasher::hash_files(const std::vector<std::filesystem::path> &paths)
+{
+    static metrics::Operation &operationMetrics = metrics::operation("local", "hash");
+    static metrics::Counter &cacheHits =
+        metrics::counter("hash_cache_lookups_total", "Hash cache lookups by result.", "result=\"hit\"");
+    static metrics::Counter &cacheMisses =
+        metrics::counter("hash_cache_lookups_total", "Hash cache lookups by result.", "result=\"miss\"");
+    metrics::ScopedOperation timer(operationMetrics);
+
+    std::vector<hasher::Result> results(paths.size());
+    Batch batch{results};
+    batch.keys.resize(paths.size());
+
+    // Anything the cache has is answered without touching the file.
+    {
+        std::lock_guard<std::mutex> cacheGuard(s_cacheLock);
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            results[i].path = paths[i];
+            if (!hasher::get_file_key(paths[i], batch.keys[i]))
+            {
+                logger::error("Error hashing \"%s\": Not a regular file.", paths[i].c_str());
+                continue;
+            }
+
+            auto findEntry = s_cache.find(batch.keys[i]);
+            if (findEntry != s_cache.end())
+            {
+                findEntry->second.used = true;
+                results[i].success = true;
+                results[i].cached = true;
+                results[i].digest = findEntry->second.digest;
+                continue;
+            }
+            batch.pending.push_back(i);
+        }
+    }
+
+    // Workers are only worth starting if they'll have lanes to fill.
+    size_t fullWorkers = (batch.pending.size() + md5::LANES - 1) / md5::LANES;
+    size_t workerCount = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), fullWorkers);
+    std::vector<std::thread> workers{};
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        workers.emplace_back(run_worker, std::ref(batch));
+    }
+
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    // Only files actually read count toward the bytes hashed.
+    bool allHashed = true;
+    uint64_t bytesHashed = 0;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        allHashed = allHashed && results[i].success;
+        bytesHashed += results[i].success && !results[i].cached ? batch.keys[i].size : 0;
+        if (results[i].cached)
+        {
+            cacheHits.add();
+        }
+    }
+    cacheMisses.add(batch.pending.size());
+    if (allHashed)
+    {
+        timer.succeed(bytesHashed);
+    }
+
+    return results;
+}
@@ -1,38 +1,278 @@
 #include "logger.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <cstdarg>
-#include <fstream>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
 #include <string_view>
+#include <thread>
+#include <unistd.h>
 
 namespace
 {
-    /// @brief Size of the buffer for logging messages.
-    constexpr int VA_BUFFER_SIZE = 0x1000;
-
     /// @brief Path/name of the log file.
     constexpr std::string_view LOG_FILE_PATH = "./log.txt";
+
+    /// @brief Number of lines the queue holds. This needs to be a power of two.
+    constexpr uint64_t QUEUE_CAPACITY = 0x1000;
+
+    /// @brief Every time this many lines are queued, the producer that queues the last one wakes the writer early so a
+    /// burst doesn't overflow the queue before the next flush.
+    constexpr uint64_t WAKE_INTERVAL = QUEUE_CAPACITY / 4;
+
+    /// @brief Longest a single line can be. Anything past this is cut off.
+    constexpr size_t SIZE_LINE = 0x200;
+
+    /// @brief How often the writer thread wakes up to write whatever was queued.
+    constexpr std::chrono::milliseconds FLUSH_INTERVAL{25};
+
+    /// @brief Size the writer lets a batch grow to before writing it out early.
+    constexpr size_t SIZE_BATCH = 0x10000;
+
+    /// @brief Tag written before each line for each level.
+    constexpr std::string_view LEVEL_TAGS[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+
+    /// @brief A single queued line. Producers and the writer take turns on each slot. Even turns mean the slot is free
+    /// for a producer, odd turns mean it holds a line for the writer. Every lap around the queue moves it two turns
+    /// forward, so a zeroed slot is free for the first lap.
+    struct alignas(64) Slot
+    {
+            /// @brief Whose turn it is.
+            std::atomic<uint64_t> turn;
+
+            /// @brief Time the line was logged in milliseconds since the Unix epoch.
+            int64_t time;
+
+            /// @brief Severity of the line.
+            logger::Level level;
+
+            /// @brief Length of the line.
+            uint32_t length;
+
+            /// @brief The line itself.
+            char text[SIZE_LINE];
+    };
+
+    /// @brief The queue itself. This is zero initialized, so it's usable before initialize is called.
+    Slot s_slots[QUEUE_CAPACITY];
+
+    /// @brief Position the next producer claims.
+    alignas(64) std::atomic<uint64_t> s_head = 0;
+
+    /// @brief Position the writer reads next. Only the writer touches this.
+    alignas(64) uint64_t s_tail = 0;
+
+    /// @brief Number of lines dropped because the queue was full.
+    std::atomic<uint64_t> s_dropped = 0;
+
+    /// @brief Whether the writer thread is running.
+    std::atomic<bool> s_running = false;
+
+    /// @brief Descriptor of the log file.
+    int s_descriptor = -1;
+
+    /// @brief Writer thread.
+    std::thread s_writer;
+
+    /// @brief The writer sleeps on this. Producers never lock it.
+    std::mutex s_wakeLock;
+
+    /// @brief Signaled to stop the writer or to wake it up early.
+    std::condition_variable s_wake;
+
+    /// @brief Guards writes made straight to the file while the writer isn't running.
+    std::mutex s_directLock;
+
+    /// @brief Appends a formatted line to out.
+    void append_line(std::string &out, int64_t time, logger::Level level, std::string_view text)
+    {
+        std::time_t seconds = static_cast<std::time_t>(time / 1000);
+        std::tm local{};
+        localtime_r(&seconds, &local);
+
+        char prefix[64] = {0};
+        int prefixLength = std::snprintf(prefix,
+                                         sizeof(prefix),
+                                         "[%02d:%02d:%02d.%03d] [%s] ",
+                                         local.tm_hour,
+                                         local.tm_min,
+                                         local.tm_sec,
+                                         static_cast<int>(time % 1000),
+                                         LEVEL_TAGS[static_cast<int>(level)].data());
+        out.append(prefix, prefixLength);
+        out.append(text);
+        out.push_back('\n');
+    }
+
+    /// @brief Writes out to the log file and clears it.
+    void write_out(std::string &out)
+    {
+        size_t offset = 0;
+        while (offset < out.length())
+        {
+            ssize_t written = ::write(s_descriptor, out.data() + offset, out.length() - offset);
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            else if (written <= 0)
+            {
+                break;
+            }
+            offset += written;
+        }
+        out.clear();
+    }
+
+    /// @brief Moves every line that's ready from the queue to the batch, writing the batch out whenever it fills up.
+    void drain(std::string &batch)
+    {
+        while (true)
+        {
+            Slot &slot = s_slots[s_tail % QUEUE_CAPACITY];
+            uint64_t turn = ((s_tail / QUEUE_CAPACITY) * 2) + 1;
+            if (slot.turn.load(std::memory_order_acquire) != turn)
+            {
+                break;
+            }
+
+            append_line(batch, slot.time, slot.level, std::string_view(slot.text, slot.length));
+            slot.turn.store(turn + 1, std::memory_order_release);
+            ++s_tail;
+
+            if (batch.length() >= SIZE_BATCH)
+            {
+                write_out(batch);
+            }
+        }
+
+        uint64_t dropped = s_dropped.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0)
+        {
+            int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                              std::chrono::system_clock::now().time_since_epoch())
+                              .count();
+            std::string message = std::to_string(dropped) + " lines were dropped. The log queue was full.";
+            append_line(batch, now, logger::Level::Warning, message);
+        }
+        write_out(batch);
+    }
+
+    /// @brief Writer thread. Everything queued is written in one go every FLUSH_INTERVAL.
+    void run_writer(void)
+    {
+        std::string batch{};
+        batch.reserve(SIZE_BATCH + SIZE_LINE + 64);
+        while (s_running.load(std::memory_order_acquire))
+        {
+            drain(batch);
+
+            std::unique_lock<std::mutex> wakeGuard(s_wakeLock);
+            s_wake.wait_for(wakeGuard, FLUSH_INTERVAL, []() { return !s_running.load(std::memory_order_acquire); });
+        }
+        drain(batch);
+    }
 } // namespace
 
 void logger::initialize(void)
 {
-    std::ofstream logFile(LOG_FILE_PATH.data());
+    s_descriptor = open(LOG_FILE_PATH.data(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (s_descriptor < 0)
+    {
+        return;
+    }
+
+    s_running.store(true, std::memory_order_release);
+    s_writer = std::thread(run_writer);
 }
 
-void logger::log(const char *format, ...)
+void logger::exit(void)
 {
-    // Buffer for formatting string.
-    char vaBuffer[VA_BUFFER_SIZE] = {0};
+    if (!s_writer.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> wakeGuard(s_wakeLock);
+        s_running.store(false, std::memory_order_release);
+    }
+    s_wake.notify_one();
+    s_writer.join();
+}
 
-    // VA
+void logger::write(logger::Level level, const char *format, ...)
+{
     std::va_list vaList;
     va_start(vaList, format);
-    std::vsnprintf(vaBuffer, VA_BUFFER_SIZE, format, vaList);
+    logger::write_list(level, format, vaList);
     va_end(vaList);
+}
+
+void logger::write_list(logger::Level level, const char *format, std::va_list vaList)
+{
+    int64_t time =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch())
+            .count();
 
-    std::ofstream logFile(LOG_FILE_PATH.data(), logFile.app);
-    if (!logFile.is_open())
+    // Without the writer, lines go straight to the file. This only happens before initialize and after exit.
+    if (!s_running.load(std::memory_order_acquire))
     {
+        char text[SIZE_LINE] = {0};
+        int length = std::vsnprintf(text, SIZE_LINE, format, vaList);
+
+        std::lock_guard<std::mutex> directGuard(s_directLock);
+        if (s_descriptor >= 0 && length >= 0)
+        {
+            std::string line{};
+            append_line(line, time, level, std::string_view(text, std::min<size_t>(length, SIZE_LINE - 1)));
+            write_out(line);
+        }
         return;
     }
-    // Write the buffer with std::endl for the flush.
-    logFile << vaBuffer << std::endl;
+
+    // Claim a slot. A slot that's still on the last lap's line means the writer is a whole queue behind.
+    uint64_t position = s_head.load(std::memory_order_relaxed);
+    Slot *slot = nullptr;
+    while (true)
+    {
+        slot = &s_slots[position % QUEUE_CAPACITY];
+        uint64_t turn = (position / QUEUE_CAPACITY) * 2;
+        uint64_t slotTurn = slot->turn.load(std::memory_order_acquire);
+        if (slotTurn == turn)
+        {
+            if (s_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (slotTurn < turn)
+        {
+            s_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            position = s_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    int length = std::vsnprintf(slot->text, SIZE_LINE, format, vaList);
+
+    slot->time = time;
+    slot->level = level;
+    slot->length = length < 0 ? 0 : std::min<uint32_t>(length, SIZE_LINE - 1);
+    slot->turn.store(((position / QUEUE_CAPACITY) * 2) + 1, std::memory_order_release);
+
+    if ((position + 1) % WAKE_INTERVAL == 0)
+    {
+        s_wake.notify_one();
+    }
 }
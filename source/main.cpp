@@ -1,9 +1,12 @@
 #include "CommandReader.hpp"
 #include "GoogleDrive.hpp"
 #include "Local.hpp"
+#include "TransferScheduler.hpp"
 #include "command.hpp"
 #include "curl.hpp"
+#include "hasher.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
 #include <iostream>
 #include <map>
 #include <optional>
@@ -13,6 +16,19 @@ namespace
 {
     /// @brief This is the name of the JKSV folder on Google Drive.
     constexpr std::string_view DIR_JKSV_FOLDER = "JKSV";
+
+    /// @brief Shuts down CURL, the metrics exporter and the logger's writer when main returns, whichever way it
+    /// returns. A thread still running when the program exits takes it down with std::terminate and whatever it
+    /// hadn't written yet.
+    struct ShutdownGuard
+    {
+            ~ShutdownGuard()
+            {
+                curl::exit();
+                metrics::exit();
+                logger::exit();
+            };
+    };
 }; // namespace
 
 /// @brief Inline declaration of function to select the target storage. This keeps the main loop looking cleaner.
@@ -33,6 +49,13 @@ int main(int argc, const char *argv[])
 
     // Init logger.
     logger::initialize();
+    ShutdownGuard shutdownGuard{};
+
+    // Start writing metrics out.
+    metrics::initialize();
+
+    // Init the hash cache. Local listings read from it, so this goes first.
+    hasher::initialize();
 
     // Init local.
     std::string localRoot;
@@ -48,6 +71,9 @@ int main(int argc, const char *argv[])
         return -2;
     }
 
+    // Backups and restores run on this. Their transfers go through drive's event loop.
+    TransferScheduler scheduler{drive};
+
     // This is the string used to get the target storage.
     std::string storage;
 
@@ -65,11 +91,24 @@ int main(int argc, const char *argv[])
             continue;
         }
 
-        // Execute the command.
-        execute_command(target.value().get());
+        // Execute the command. Drive's commands run on its event loop's thread so they can't race with transfers
+        // running in the background.
+        Storage &selected = target.value().get();
+        if (&selected == &drive)
+        {
+            drive.call([&drive, &scheduler]() { execute_command(drive, scheduler); });
+        }
+        else
+        {
+            execute_command(selected, scheduler);
+        }
     }
 
-    curl::exit();
+    // Transfers still running in the background need CURL until they're done. Jobs hand theirs to drive, so they go
+    // first.
+    scheduler.shut_down();
+    drive.shut_down();
+    hasher::exit();
     return 0;
 }
 
@@ -0,0 +1,286 @@
+#include "md5.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace
+{
+    /// @brief Initial hash state.
+    constexpr uint32_t INITIAL_STATE[4] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476};
+
+    /// @brief Per round constants. floor(abs(sin(i + 1)) * 2^32).
+    constexpr uint32_t ROUND_CONSTANTS[64] = {
+        0xD76AA478, 0xE8C7B756, 0x242070DB, 0xC1BDCEEE, 0xF57C0FAF, 0x4787C62A, 0xA8304613, 0xFD469501,
+        0x698098D8, 0x8B44F7AF, 0xFFFF5BB1, 0x895CD7BE, 0x6B901122, 0xFD987193, 0xA679438E, 0x49B40821,
+        0xF61E2562, 0xC040B340, 0x265E5A51, 0xE9B6C7AA, 0xD62F105D, 0x02441453, 0xD8A1E681, 0xE7D3FBC8,
+        0x21E1CDE6, 0xC33707D6, 0xF4D50D87, 0x455A14ED, 0xA9E3E905, 0xFCEFA3F8, 0x676F02D9, 0x8D2A4C8A,
+        0xFFFA3942, 0x8771F681, 0x6D9D6122, 0xFDE5380C, 0xA4BEEA44, 0x4BDECFA9, 0xF6BB4B60, 0xBEBFBC70,
+        0x289B7EC6, 0xEAA127FA, 0xD4EF3085, 0x04881D05, 0xD9D4D039, 0xE6DB99E5, 0x1FA27CF8, 0xC4AC5665,
+        0xF4292244, 0x432AFF97, 0xAB9423A7, 0xFC93A039, 0x655B59C3, 0x8F0CCC92, 0xFFEFF47D, 0x85845DD1,
+        0x6FA87E4F, 0xFE2CE6E0, 0xA3014314, 0x4E0811A1, 0xF7537E82, 0xBD3AF235, 0x2AD7D2BB, 0xEB86D391};
+
+    /// @brief Per round shift amounts.
+    constexpr int ROUND_SHIFTS[64] = {7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+                                      5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20, 5, 9,  14, 20,
+                                      4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+                                      6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21};
+
+    /// @brief One 32-bit word from each lane.
+    using LaneWords = uint32_t __attribute__((vector_size(md5::LANES * sizeof(uint32_t))));
+
+    /// @brief Reads a little endian 32-bit word.
+    inline uint32_t read_word(const uint8_t *data)
+    {
+        uint32_t word = 0;
+        std::memcpy(&word, data, sizeof(uint32_t));
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            word = std::byteswap(word);
+        }
+        return word;
+    }
+} // namespace
+
+md5::Context::Context(void)
+{
+    Context::reset();
+}
+
+void md5::Context::update(const void *data, size_t length)
+{
+    if (length == 0)
+    {
+        return;
+    }
+
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    size_t blockUsed = m_length % 64;
+    m_length += length;
+
+    // Finish the partial block first.
+    if (blockUsed > 0)
+    {
+        size_t toCopy = std::min(length, 64 - blockUsed);
+        std::memcpy(m_block + blockUsed, bytes, toCopy);
+        bytes += toCopy;
+        length -= toCopy;
+        if (blockUsed + toCopy < 64)
+        {
+            return;
+        }
+        md5::transform(m_state, m_block, 1);
+    }
+
+    // Whole blocks are hashed straight from data.
+    md5::transform(m_state, bytes, length / 64);
+    std::memcpy(m_block, bytes + (length & ~size_t(63)), length % 64);
+}
+
+md5::Digest md5::Context::finish(void)
+{
+    // Padding is a single 1 bit, zeros, then the length in bits.
+    uint64_t bitLength = m_length * 8;
+    uint8_t padding[72] = {0x80};
+    size_t paddingLength = ((m_length % 64) < 56 ? 56 : 120) - (m_length % 64);
+    Context::update(padding, paddingLength);
+
+    uint8_t lengthBytes[8] = {0};
+    for (int i = 0; i < 8; i++)
+    {
+        lengthBytes[i] = static_cast<uint8_t>(bitLength >> (i * 8));
+    }
+    Context::update(lengthBytes, 8);
+
+    md5::Digest digest{};
+    for (int i = 0; i < 16; i++)
+    {
+        digest[i] = static_cast<uint8_t>(m_state[i / 4] >> ((i % 4) * 8));
+    }
+
+    Context::reset();
+    return digest;
+}
+
+void md5::Context::update_lanes(md5::Context *const contexts[md5::LANES],
+                                const uint8_t *const data[md5::LANES],
+                                size_t blocks)
+{
+    uint32_t states[md5::LANES][4] = {{0}};
+    const uint8_t *laneData[md5::LANES] = {nullptr};
+    for (size_t lane = 0; lane < md5::LANES; lane++)
+    {
+        md5::Context *context = contexts[lane];
+        if (!context)
+        {
+            continue;
+        }
+        else if (context->m_length % 64 != 0)
+        {
+            context->update(data[lane], blocks * 64);
+            continue;
+        }
+
+        std::memcpy(states[lane], context->m_state, sizeof(context->m_state));
+        laneData[lane] = data[lane];
+    }
+
+    md5::transform_lanes(states, laneData, blocks);
+
+    for (size_t lane = 0; lane < md5::LANES; lane++)
+    {
+        if (laneData[lane])
+        {
+            std::memcpy(contexts[lane]->m_state, states[lane], sizeof(states[lane]));
+            contexts[lane]->m_length += blocks * 64;
+        }
+    }
+}
+
+void md5::Context::reset(void)
+{
+    std::memcpy(m_state, INITIAL_STATE, sizeof(m_state));
+    m_length = 0;
+}
+
+void md5::transform(uint32_t state[4], const uint8_t *data, size_t blocks)
+{
+    for (size_t block = 0; block < blocks; block++, data += 64)
+    {
+        uint32_t words[16];
+        for (int i = 0; i < 16; i++)
+        {
+            words[i] = read_word(data + (i * 4));
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        for (int i = 0; i < 64; i++)
+        {
+            uint32_t f = 0;
+            int g = 0;
+            if (i < 16)
+            {
+                f = (b & c) | (~b & d);
+                g = i;
+            }
+            else if (i < 32)
+            {
+                f = (d & b) | (~d & c);
+                g = (5 * i + 1) % 16;
+            }
+            else if (i < 48)
+            {
+                f = b ^ c ^ d;
+                g = (3 * i + 5) % 16;
+            }
+            else
+            {
+                f = c ^ (b | ~d);
+                g = (7 * i) % 16;
+            }
+
+            f += a + ROUND_CONSTANTS[i] + words[g];
+            a = d;
+            d = c;
+            c = b;
+            b += std::rotl(f, ROUND_SHIFTS[i]);
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+    }
+}
+
+#if defined(__x86_64__)
+// AVX2 holds every lane in one register. The default build splits each vector across SSE2 registers, which is still
+// several messages per instruction.
+__attribute__((target_clones("avx2", "default")))
+#endif
+void md5::transform_lanes(uint32_t states[md5::LANES][4], const uint8_t *const data[md5::LANES], size_t blocks)
+{
+    LaneWords a{}, b{}, c{}, d{};
+    for (size_t lane = 0; lane < md5::LANES; lane++)
+    {
+        a[lane] = states[lane][0];
+        b[lane] = states[lane][1];
+        c[lane] = states[lane][2];
+        d[lane] = states[lane][3];
+    }
+
+    for (size_t block = 0; block < blocks; block++)
+    {
+        // Lanes without data hash zeros. Their results are thrown away.
+        LaneWords words[16];
+        for (int i = 0; i < 16; i++)
+        {
+            for (size_t lane = 0; lane < md5::LANES; lane++)
+            {
+                words[i][lane] = data[lane] ? read_word(data[lane] + (block * 64) + (i * 4)) : 0;
+            }
+        }
+
+        // Same rounds as transform.
+        LaneWords laneA = a, laneB = b, laneC = c, laneD = d;
+        for (int i = 0; i < 64; i++)
+        {
+            LaneWords f{};
+            int g = 0;
+            if (i < 16)
+            {
+                f = (laneB & laneC) | (~laneB & laneD);
+                g = i;
+            }
+            else if (i < 32)
+            {
+                f = (laneD & laneB) | (~laneD & laneC);
+                g = (5 * i + 1) % 16;
+            }
+            else if (i < 48)
+            {
+                f = laneB ^ laneC ^ laneD;
+                g = (3 * i + 5) % 16;
+            }
+            else
+            {
+                f = laneC ^ (laneB | ~laneD);
+                g = (7 * i) % 16;
+            }
+
+            f += laneA + ROUND_CONSTANTS[i] + words[g];
+            laneA = laneD;
+            laneD = laneC;
+            laneC = laneB;
+            laneB += (f << ROUND_SHIFTS[i]) | (f >> (32 - ROUND_SHIFTS[i]));
+        }
+
+        a += laneA;
+        b += laneB;
+        c += laneC;
+        d += laneD;
+    }
+
+    for (size_t lane = 0; lane < md5::LANES; lane++)
+    {
+        if (data[lane])
+        {
+            states[lane][0] = a[lane];
+            states[lane][1] = b[lane];
+            states[lane][2] = c[lane];
+            states[lane][3] = d[lane];
+        }
+    }
+}
+
+std::string md5::to_hex(const md5::Digest &digest)
+{
+    constexpr char HEX_DIGITS[] = "0123456789abcdef";
+
+    std::string hex(digest.size() * 2, '0');
+    for (size_t i = 0; i < digest.size(); i++)
+    {
+        hex[i * 2] = HEX_DIGITS[digest[i] >> 4];
+        hex[(i * 2) + 1] = HEX_DIGITS[digest[i] & 0xF];
+    }
+    return hex;
+}
@@ -0,0 +1,520 @@
+#include "metrics.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    /// @brief Path the Prometheus export is written to.
+    constexpr std::string_view PATH_EXPORT = "./metrics.prom";
+
+    /// @brief Prefix added to every metric name.
+    constexpr std::string_view NAME_PREFIX = "jksv_";
+
+    /// @brief How often the export is written.
+    constexpr std::chrono::seconds EXPORT_INTERVAL{15};
+
+    /// @brief Quantile the summary estimates from histograms.
+    constexpr double SUMMARY_QUANTILE = 0.99;
+
+    /// @brief BUCKET_BOUNDS in nanoseconds so observing is an integer compare.
+    constexpr auto BUCKET_BOUNDS_NS = []() {
+        std::array<int64_t, metrics::BUCKET_COUNT - 1> bounds{};
+        for (size_t i = 0; i < bounds.size(); i++)
+        {
+            bounds[i] = static_cast<int64_t>(metrics::BUCKET_BOUNDS[i] * 1e9);
+        }
+        return bounds;
+    }();
+
+    /// @brief Kind of metric a family holds.
+    enum class Type
+    {
+        Counter,
+        Gauge,
+        Histogram
+    };
+
+    /// @brief Type names written to the export for each type.
+    constexpr std::string_view TYPE_NAMES[] = {"counter", "gauge", "histogram"};
+
+    /// @brief A single labeled series of a family. Only the pointer matching the family's type is set. Metrics are
+    /// allocated on their own so references handed out survive the vector growing.
+    struct Series
+    {
+            std::string labels;
+            std::unique_ptr<metrics::Counter> counter;
+            std::unique_ptr<metrics::Gauge> gauge;
+            std::unique_ptr<metrics::Histogram> histogram;
+    };
+
+    /// @brief Every series sharing a name. They share the HELP and TYPE lines in the export.
+    struct Family
+    {
+            std::string name;
+            std::string help;
+            Type type;
+            std::vector<Series> series;
+    };
+
+    /// @brief Every family in the order they were registered. Families are allocated on their own for the same reason
+    /// as series.
+    std::vector<std::unique_ptr<Family>> s_families;
+
+    /// @brief Operations by subsystem and name.
+    std::map<std::string, metrics::Operation, std::less<>> s_operations;
+
+    /// @brief Guards the registry. Updating a metric never takes this, only registering and exporting do.
+    std::mutex s_registryLock;
+
+    /// @brief Whether the export thread is running.
+    bool s_running = false;
+
+    /// @brief Export thread.
+    std::thread s_exporter;
+
+    /// @brief Guards s_running.
+    std::mutex s_exportLock;
+
+    /// @brief Signaled to stop the export thread.
+    std::condition_variable s_exportWake;
+
+    /// @brief Finds or registers a series. This needs to be called with s_registryLock held. The series itself can move
+    /// the next time one is registered, so only the metric it points to should be held on to.
+    Series &get_series(std::string_view name, std::string_view help, Type type, std::string_view labels)
+    {
+        Family *family = nullptr;
+        for (std::unique_ptr<Family> &existing : s_families)
+        {
+            if (existing->name.compare(NAME_PREFIX.length(), std::string::npos, name) == 0)
+            {
+                family = existing.get();
+                break;
+            }
+        }
+
+        if (!family)
+        {
+            std::string fullName{NAME_PREFIX};
+            fullName.append(name);
+            s_families.push_back(std::make_unique<Family>(Family{.name = std::move(fullName),
+                                                                 .help = std::string(help),
+                                                                 .type = type,
+                                                                 .series = {}}));
+            family = s_families.back().get();
+        }
+
+        for (Series &series : family->series)
+        {
+            if (series.labels == labels)
+            {
+                return series;
+            }
+        }
+
+        Series &series = family->series.emplace_back();
+        series.labels = labels;
+        switch (family->type)
+        {
+            case Type::Counter:
+            {
+                series.counter = std::make_unique<metrics::Counter>();
+            }
+            break;
+
+            case Type::Gauge:
+            {
+                series.gauge = std::make_unique<metrics::Gauge>();
+            }
+            break;
+
+            case Type::Histogram:
+            {
+                series.histogram = std::make_unique<metrics::Histogram>();
+            }
+            break;
+        }
+        return series;
+    }
+
+    /// @brief Appends a name and its labels to out. extra is added after the series' own labels.
+    void append_series_name(std::string &out, std::string_view name, std::string_view labels, std::string_view extra)
+    {
+        out.append(name);
+        if (labels.empty() && extra.empty())
+        {
+            return;
+        }
+
+        out.push_back('{');
+        out.append(labels);
+        if (!labels.empty() && !extra.empty())
+        {
+            out.push_back(',');
+        }
+        out.append(extra);
+        out.push_back('}');
+    }
+
+    /// @brief Estimates a quantile from a histogram as the upper bound of the bucket it falls in.
+    /// @return Estimate in seconds. Negative if it falls in +Inf.
+    double estimate_quantile(const metrics::Histogram::Snapshot &snapshot, double quantile)
+    {
+        uint64_t target = static_cast<uint64_t>(snapshot.count * quantile);
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < metrics::BUCKET_COUNT - 1; i++)
+        {
+            cumulative += snapshot.buckets[i];
+            if (cumulative > target || cumulative == snapshot.count)
+            {
+                return metrics::BUCKET_BOUNDS[i];
+            }
+        }
+        return -1.0;
+    }
+
+    /// @brief Writes the export next to its final path and renames it over it so it's never read half written.
+    void write_export(void)
+    {
+        std::string text = metrics::export_prometheus();
+
+        std::filesystem::path exportPath{PATH_EXPORT};
+        std::filesystem::path temporaryPath = exportPath;
+        temporaryPath += ".tmp";
+        {
+            std::ofstream exportFile(temporaryPath, std::ios::binary | std::ios::trunc);
+            exportFile.write(text.data(), text.length());
+            if (!exportFile.flush())
+            {
+                logger::error("Error writing metrics export.");
+                return;
+            }
+        }
+
+        std::error_code error{};
+        std::filesystem::rename(temporaryPath, exportPath, error);
+    }
+
+    /// @brief Export thread. Writes the export every EXPORT_INTERVAL until it's stopped.
+    void run_exporter(void)
+    {
+        std::unique_lock<std::mutex> exportGuard(s_exportLock);
+        while (!s_exportWake.wait_for(exportGuard, EXPORT_INTERVAL, []() { return !s_running; }))
+        {
+            exportGuard.unlock();
+            write_export();
+            exportGuard.lock();
+        }
+    }
+} // namespace
+
+uint64_t metrics::Counter::get(void) const
+{
+    uint64_t total = 0;
+    for (const Cell &cell : m_cells)
+    {
+        total += cell.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+int64_t metrics::Gauge::get(void) const
+{
+    return m_value.load(std::memory_order_relaxed);
+}
+
+void metrics::Histogram::observe(std::chrono::nanoseconds duration)
+{
+    int64_t nanoseconds = duration.count() < 0 ? 0 : duration.count();
+    // Buckets are inclusive of their upper bound, same as Prometheus' le.
+    size_t bucket = std::lower_bound(BUCKET_BOUNDS_NS.begin(), BUCKET_BOUNDS_NS.end(), nanoseconds) -
+                    BUCKET_BOUNDS_NS.begin();
+
+    // The count isn't kept on its own. It's the total of the buckets, which saves an atomic add per observation.
+    Cell &cell = m_cells[metrics::get_stripe()];
+    cell.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    cell.sumNs.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+metrics::Histogram::Snapshot metrics::Histogram::get(void) const
+{
+    // Cells are read one at a time, so a snapshot taken mid update can be off by that update. That's fine for
+    // reporting.
+    Histogram::Snapshot snapshot{};
+    uint64_t sumNs = 0;
+    for (const Cell &cell : m_cells)
+    {
+        for (size_t i = 0; i < metrics::BUCKET_COUNT; i++)
+        {
+            uint64_t bucketCount = cell.buckets[i].load(std::memory_order_relaxed);
+            snapshot.buckets[i] += bucketCount;
+            snapshot.count += bucketCount;
+        }
+        sumNs += cell.sumNs.load(std::memory_order_relaxed);
+    }
+    snapshot.sum = static_cast<double>(sumNs) / 1e9;
+    return snapshot;
+}
+
+metrics::ScopedOperation::~ScopedOperation()
+{
+    m_operation.duration.observe(std::chrono::steady_clock::now() - m_start);
+    if (m_succeeded)
+    {
+        m_operation.succeeded.add();
+    }
+    else
+    {
+        m_operation.failed.add();
+    }
+}
+
+void metrics::ScopedOperation::succeed(uint64_t bytes)
+{
+    m_succeeded = true;
+    if (bytes > 0)
+    {
+        m_operation.bytes.add(bytes);
+    }
+}
+
+void metrics::initialize(void)
+{
+    std::lock_guard<std::mutex> exportGuard(s_exportLock);
+    if (s_running)
+    {
+        return;
+    }
+    s_running = true;
+    s_exporter = std::thread(run_exporter);
+}
+
+void metrics::exit(void)
+{
+    if (!s_exporter.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> exportGuard(s_exportLock);
+        s_running = false;
+    }
+    s_exportWake.notify_one();
+    s_exporter.join();
+    write_export();
+}
+
+metrics::Counter &metrics::counter(std::string_view name, std::string_view help, std::string_view labels)
+{
+    std::lock_guard<std::mutex> registryGuard(s_registryLock);
+    return *get_series(name, help, Type::Counter, labels).counter;
+}
+
+metrics::Gauge &metrics::gauge(std::string_view name, std::string_view help, std::string_view labels)
+{
+    std::lock_guard<std::mutex> registryGuard(s_registryLock);
+    return *get_series(name, help, Type::Gauge, labels).gauge;
+}
+
+metrics::Histogram &metrics::histogram(std::string_view name, std::string_view help, std::string_view labels)
+{
+    std::lock_guard<std::mutex> registryGuard(s_registryLock);
+    return *get_series(name, help, Type::Histogram, labels).histogram;
+}
+
+metrics::Operation &metrics::operation(std::string_view subsystem, std::string_view name)
+{
+    std::lock_guard<std::mutex> registryGuard(s_registryLock);
+
+    std::string key{subsystem};
+    key.push_back('.');
+    key.append(name);
+    auto findOperation = s_operations.find(key);
+    if (findOperation != s_operations.end())
+    {
+        return findOperation->second;
+    }
+
+    std::string prefix{subsystem};
+    std::string operationLabel = "operation=\"" + std::string(name) + "\"";
+    metrics::Counter &succeeded = *get_series(prefix + "_operations_total",
+                                              "Operations finished by result.",
+                                              Type::Counter,
+                                              operationLabel + ",result=\"success\"")
+                                       .counter;
+    metrics::Counter &failed = *get_series(prefix + "_operations_total",
+                                           "Operations finished by result.",
+                                           Type::Counter,
+                                           operationLabel + ",result=\"failure\"")
+                                    .counter;
+    metrics::Counter &bytes = *get_series(prefix + "_operation_bytes_total",
+                                          "Bytes moved by successful operations.",
+                                          Type::Counter,
+                                          operationLabel)
+                                   .counter;
+    metrics::Histogram &duration = *get_series(prefix + "_operation_duration_seconds",
+                                               "Time operations took from start to finish.",
+                                               Type::Histogram,
+                                               operationLabel)
+                                        .histogram;
+
+    auto [inserted, added] = s_operations.emplace(
+        key,
+        metrics::Operation{.succeeded = succeeded, .failed = failed, .bytes = bytes, .duration = duration});
+    return inserted->second;
+}
+
+std::string metrics::export_prometheus(void)
+{
+    std::lock_guard<std::mutex> registryGuard(s_registryLock);
+
+    std::string out{};
+    char value[64] = {0};
+    for (const std::unique_ptr<Family> &family : s_families)
+    {
+        out.append("# HELP ").append(family->name).append(" ").append(family->help).append("\n");
+        out.append("# TYPE ").append(family->name).append(" ");
+        out.append(TYPE_NAMES[static_cast<int>(family->type)]).append("\n");
+
+        for (const Series &series : family->series)
+        {
+            switch (family->type)
+            {
+                case Type::Counter:
+                {
+                    append_series_name(out, family->name, series.labels, {});
+                    std::snprintf(value, sizeof(value), " %" PRIu64 "\n", series.counter->get());
+                    out.append(value);
+                }
+                break;
+
+                case Type::Gauge:
+                {
+                    append_series_name(out, family->name, series.labels, {});
+                    std::snprintf(value, sizeof(value), " %" PRId64 "\n", series.gauge->get());
+                    out.append(value);
+                }
+                break;
+
+                case Type::Histogram:
+                {
+                    metrics::Histogram::Snapshot snapshot = series.histogram->get();
+
+                    // Prometheus buckets are cumulative.
+                    uint64_t cumulative = 0;
+                    std::string bucketName = family->name + "_bucket";
+                    for (size_t i = 0; i < metrics::BUCKET_COUNT; i++)
+                    {
+                        cumulative += snapshot.buckets[i];
+
+                        char bound[32] = {0};
+                        if (i < metrics::BUCKET_COUNT - 1)
+                        {
+                            std::snprintf(bound, sizeof(bound), "le=\"%g\"", metrics::BUCKET_BOUNDS[i]);
+                        }
+                        else
+                        {
+                            std::snprintf(bound, sizeof(bound), "le=\"+Inf\"");
+                        }
+
+                        append_series_name(out, bucketName, series.labels, bound);
+                        std::snprintf(value, sizeof(value), " %" PRIu64 "\n", cumulative);
+                        out.append(value);
+                    }
+
+                    append_series_name(out, family->name + "_sum", series.labels, {});
+                    std::snprintf(value, sizeof(value), " %.9g\n", snapshot.sum);
+                    out.append(value);
+
+                    append_series_name(out, family->name + "_count", series.labels, {});
+                    std::snprintf(value, sizeof(value), " %" PRIu64 "\n", snapshot.count);
+                    out.append(value);
+                }
+                break;
+            }
+        }
+    }
+    return out;
+}
+
+std::string metrics::export_summary(void)
+{
+    std::lock_guard<std::mutex> registryGuard(s_registryLock);
+
+    std::string out{};
+    char value[128] = {0};
+    for (const std::unique_ptr<Family> &family : s_families)
+    {
+        for (const Series &series : family->series)
+        {
+            switch (family->type)
+            {
+                case Type::Counter:
+                {
+                    // Series that never moved are left out so the summary only shows what was used.
+                    uint64_t count = series.counter->get();
+                    if (count == 0)
+                    {
+                        continue;
+                    }
+                    append_series_name(out, family->name, series.labels, {});
+                    std::snprintf(value, sizeof(value), " %" PRIu64 "\n", count);
+                }
+                break;
+
+                case Type::Gauge:
+                {
+                    append_series_name(out, family->name, series.labels, {});
+                    std::snprintf(value, sizeof(value), " %" PRId64 "\n", series.gauge->get());
+                }
+                break;
+
+                case Type::Histogram:
+                {
+                    metrics::Histogram::Snapshot snapshot = series.histogram->get();
+                    if (snapshot.count == 0)
+                    {
+                        continue;
+                    }
+
+                    append_series_name(out, family->name, series.labels, {});
+                    double mean = snapshot.sum / snapshot.count;
+                    double quantile = estimate_quantile(snapshot, SUMMARY_QUANTILE);
+                    if (quantile < 0)
+                    {
+                        std::snprintf(value,
+                                      sizeof(value),
+                                      " count %" PRIu64 ", mean %.3fms, p99 > %gs\n",
+                                      snapshot.count,
+                                      mean * 1e3,
+                                      metrics::BUCKET_BOUNDS[metrics::BUCKET_COUNT - 2]);
+                    }
+                    else
+                    {
+                        std::snprintf(value,
+                                      sizeof(value),
+                                      " count %" PRIu64 ", mean %.3fms, p99 <= %gms\n",
+                                      snapshot.count,
+                                      mean * 1e3,
+                                      quantile * 1e3);
+                    }
+                }
+                break;
+            }
+            out.append(value);
+        }
+    }
+    return out;
+}
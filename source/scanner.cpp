@@ -0,0 +1,221 @@
+#include "scanner.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+    /// @brief Size of the buffer entries are read into. This holds around two thousand entries with typical names.
+    constexpr size_t SIZE_ENTRY_BUFFER = 0x10000;
+
+    /// @brief Directories shared by every thread in a single scan_tree call.
+    struct Walk
+    {
+            Walk(std::vector<scanner::Directory> &directories) : directories(directories) {};
+
+            /// @brief Guards everything below.
+            std::mutex lock;
+
+            /// @brief Signaled when directories are queued or the walk is over.
+            std::condition_variable signal;
+
+            /// @brief Paths of directories waiting to be read. This is used as a stack to keep it short.
+            std::vector<std::string> pending;
+
+            /// @brief Directories being read right now. Each one can still queue more.
+            size_t active = 0;
+
+            /// @brief Whether any directory couldn't be read.
+            bool failed = false;
+
+            /// @brief Directories every thread read. Threads only add theirs once they're done.
+            std::vector<scanner::Directory> &directories;
+    };
+
+    /// @brief Fills in entry from whatever the directory says it is. Only regular files and entries the file system
+    /// didn't give a type for are stat'd.
+    /// @param directory Descriptor of the directory the entry is in.
+    /// @param type d_type of the entry.
+    /// @param entry Entry to fill in. The name must already be set.
+    void describe_entry(int directory, unsigned char type, scanner::Entry &entry)
+    {
+        if (type == DT_DIR)
+        {
+            entry.isDirectory = true;
+            return;
+        }
+        else if (type != DT_REG && type != DT_LNK && type != DT_UNKNOWN)
+        {
+            return;
+        }
+
+        // Links report what they point to. Ones that point nowhere are left as neither.
+        struct stat status{};
+        int flags = type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW;
+        if (fstatat(directory, entry.name.c_str(), &status, flags) != 0)
+        {
+            entry.isLink = type == DT_LNK;
+            return;
+        }
+        entry.isLink = type == DT_LNK || S_ISLNK(status.st_mode);
+        if (S_ISLNK(status.st_mode) && fstatat(directory, entry.name.c_str(), &status, 0) != 0)
+        {
+            return;
+        }
+
+        entry.isDirectory = S_ISDIR(status.st_mode);
+        entry.isRegularFile = S_ISREG(status.st_mode);
+        if (entry.isRegularFile)
+        {
+            entry.device = static_cast<uint64_t>(status.st_dev);
+            entry.inode = static_cast<uint64_t>(status.st_ino);
+            entry.size = static_cast<uint64_t>(status.st_size);
+            entry.modifiedTime = (static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000) + status.st_mtim.tv_nsec;
+        }
+    }
+
+    /// @brief Reads every entry in a directory with getdents64.
+    /// @param path Path of the directory.
+    /// @param entriesOut Vector to append the entries to.
+    /// @param buffer Buffer of SIZE_ENTRY_BUFFER bytes to read into.
+    /// @return True on success. False on failure.
+    bool read_directory(const std::string &path, std::vector<scanner::Entry> &entriesOut, char *buffer)
+    {
+        int descriptor = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (descriptor < 0)
+        {
+            logger::error("Error opening \"%s\": %s.", path.c_str(), std::strerror(errno));
+            return false;
+        }
+
+        ssize_t length = 0;
+        while ((length = getdents64(descriptor, buffer, SIZE_ENTRY_BUFFER)) > 0)
+        {
+            for (ssize_t offset = 0; offset < length;)
+            {
+                const struct dirent64 *record = reinterpret_cast<const struct dirent64 *>(buffer + offset);
+                offset += record->d_reclen;
+
+                const char *name = record->d_name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                {
+                    continue;
+                }
+
+                scanner::Entry &entry = entriesOut.emplace_back();
+                entry.name = name;
+                describe_entry(descriptor, record->d_type, entry);
+            }
+        }
+
+        if (length < 0)
+        {
+            logger::error("Error reading \"%s\": %s.", path.c_str(), std::strerror(errno));
+        }
+        close(descriptor);
+        return length == 0;
+    }
+
+    /// @brief Takes directories off the walk's stack and reads them until there are none left and none being read.
+    void run_walker(Walk &walk)
+    {
+        std::unique_ptr<char[]> buffer = std::make_unique_for_overwrite<char[]>(SIZE_ENTRY_BUFFER);
+        std::vector<scanner::Directory> directories{};
+        std::vector<std::string> found{};
+        bool failed = false;
+
+        std::unique_lock<std::mutex> walkGuard(walk.lock);
+        while (true)
+        {
+            // Nothing queued and nothing being read means nothing else can ever be queued.
+            walk.signal.wait(walkGuard, [&walk]() { return !walk.pending.empty() || walk.active == 0; });
+            if (walk.pending.empty())
+            {
+                break;
+            }
+
+            scanner::Directory &directory = directories.emplace_back();
+            directory.path = std::move(walk.pending.back());
+            walk.pending.pop_back();
+            ++walk.active;
+            walkGuard.unlock();
+
+            failed = !read_directory(directory.path, directory.entries, buffer.get()) || failed;
+
+            const char *separator = directory.path.ends_with('/') ? "" : "/";
+            for (const scanner::Entry &entry : directory.entries)
+            {
+                if (entry.isDirectory && !entry.isLink)
+                {
+                    found.push_back(directory.path + separator + entry.name);
+                }
+            }
+
+            walkGuard.lock();
+            --walk.active;
+            size_t foundCount = found.size();
+            std::move(found.begin(), found.end(), std::back_inserter(walk.pending));
+            found.clear();
+
+            // Everyone waiting has to wake up to see the walk is over.
+            if (foundCount > 1 || (walk.pending.empty() && walk.active == 0))
+            {
+                walk.signal.notify_all();
+            }
+            else if (foundCount == 1)
+            {
+                walk.signal.notify_one();
+            }
+        }
+
+        walk.failed = walk.failed || failed;
+        std::move(directories.begin(), directories.end(), std::back_inserter(walk.directories));
+    }
+} // namespace
+
+bool scanner::scan_directory(std::string_view path, std::vector<scanner::Entry> &entriesOut)
+{
+    std::unique_ptr<char[]> buffer = std::make_unique_for_overwrite<char[]>(SIZE_ENTRY_BUFFER);
+    return read_directory(std::string(path), entriesOut, buffer.get());
+}
+
+bool scanner::scan_tree(std::string_view root, std::vector<scanner::Directory> &directoriesOut, size_t threads)
+{
+    static metrics::Operation &operationMetrics = metrics::operation("local", "scan");
+    metrics::ScopedOperation timer(operationMetrics);
+
+    Walk walk{directoriesOut};
+    walk.pending.emplace_back(root);
+
+    // The calling thread walks too, so one thread doesn't start any others.
+    size_t workerCount = threads > 0 ? threads : std::max(std::thread::hardware_concurrency(), 1u);
+    std::vector<std::thread> workers{};
+    for (size_t i = 1; i < workerCount; i++)
+    {
+        workers.emplace_back(run_walker, std::ref(walk));
+    }
+    run_walker(walk);
+
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    if (walk.failed)
+    {
+        return false;
+    }
+    timer.succeed();
+    return true;
+}
@@ -1,4 +1,23 @@
 #include "stringutil.hpp"
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+
+namespace
+{
+    /// @brief Parses a fixed number of digits from timestamp at offset.
+    bool parse_digits(std::string_view timestamp, size_t offset, size_t length, int &out)
+    {
+        if (offset + length > timestamp.length())
+        {
+            return false;
+        }
+
+        const char *begin = timestamp.data() + offset;
+        std::from_chars_result result = std::from_chars(begin, begin + length, out);
+        return result.ec == std::errc{} && result.ptr == begin + length;
+    }
+} // namespace
 
 void stringutil::strip_character(std::string &target, char c)
 {
@@ -8,3 +27,71 @@ void stringutil::strip_character(std::string &target, char c)
         target.erase(target.begin() + charPosition);
     }
 }
+
+bool stringutil::parse_timestamp(std::string_view timestamp, int64_t &millisecondsOut)
+{
+    // YYYY-MM-DDTHH:MM:SS, then optional fractional seconds, then Z.
+    int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+    if (!parse_digits(timestamp, 0, 4, year) || !parse_digits(timestamp, 5, 2, month) ||
+        !parse_digits(timestamp, 8, 2, day) || !parse_digits(timestamp, 11, 2, hour) ||
+        !parse_digits(timestamp, 14, 2, minute) || !parse_digits(timestamp, 17, 2, second) || timestamp[4] != '-' ||
+        timestamp[7] != '-' || (timestamp[10] != 'T' && timestamp[10] != 't') || timestamp[13] != ':' ||
+        timestamp[16] != ':')
+    {
+        return false;
+    }
+
+    // Only the first three digits of the fraction matter.
+    size_t offset = 19;
+    int milliseconds = 0;
+    if (offset < timestamp.length() && timestamp[offset] == '.')
+    {
+        int scale = 100;
+        for (++offset; offset < timestamp.length() && timestamp[offset] >= '0' && timestamp[offset] <= '9'; offset++)
+        {
+            milliseconds += (timestamp[offset] - '0') * scale;
+            scale /= 10;
+        }
+    }
+
+    if (offset + 1 != timestamp.length() || (timestamp[offset] != 'Z' && timestamp[offset] != 'z'))
+    {
+        return false;
+    }
+
+    std::chrono::year_month_day date{std::chrono::year{year},
+                                     std::chrono::month{static_cast<unsigned>(month)},
+                                     std::chrono::day{static_cast<unsigned>(day)}};
+    if (!date.ok() || hour > 23 || minute > 59 || second > 60)
+    {
+        return false;
+    }
+
+    std::chrono::sys_time<std::chrono::milliseconds> time = std::chrono::sys_days{date} + std::chrono::hours{hour} +
+                                                            std::chrono::minutes{minute} +
+                                                            std::chrono::seconds{second} +
+                                                            std::chrono::milliseconds{milliseconds};
+    millisecondsOut = time.time_since_epoch().count();
+    return true;
+}
+
+std::string stringutil::format_timestamp(int64_t milliseconds)
+{
+    std::chrono::sys_time<std::chrono::milliseconds> time{std::chrono::milliseconds{milliseconds}};
+    std::chrono::sys_days days = std::chrono::floor<std::chrono::days>(time);
+    std::chrono::year_month_day date{days};
+    std::chrono::hh_mm_ss<std::chrono::milliseconds> clock{time - days};
+
+    char buffer[32] = {0};
+    std::snprintf(buffer,
+                  sizeof(buffer),
+                  "%04d-%02u-%02uT%02d:%02d:%02d.%03dZ",
+                  static_cast<int>(date.year()),
+                  static_cast<unsigned>(date.month()),
+                  static_cast<unsigned>(date.day()),
+                  static_cast<int>(clock.hours().count()),
+                  static_cast<int>(clock.minutes().count()),
+                  static_cast<int>(clock.seconds().count()),
+                  static_cast<int>(clock.subseconds().count()));
+    return buffer;
+}